@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The little the pod and wmark_active governor cores need from the kernel.
+ * Outside the kernel the same names are provided on top of libc, so
+ * governor_pod_scaling.h and governor_wmark_active.h can be built into a
+ * user-space simulator unchanged. Times are in ns there.
+ */
+
+#ifndef __GOVERNOR_CORE_TYPES_H
+#define __GOVERNOR_CORE_TYPES_H
+
+#ifdef __KERNEL__
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/string.h>
+#include <linux/types.h>
+
+#else
+
+#include <stdint.h>
+#include <string.h>
+
+typedef int64_t s64;
+typedef uint64_t u64;
+typedef int64_t ktime_t;
+
+#define ktime_us_delta(later, earlier)	(((later) - (earlier)) / 1000)
+
+#ifndef min
+#define min(x, y)	((x) < (y) ? (x) : (y))
+#endif
+#ifndef max
+#define max(x, y)	((x) > (y) ? (x) : (y))
+#endif
+
+#endif /* __KERNEL__ */
+
+#endif
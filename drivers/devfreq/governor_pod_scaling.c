@@ -37,19 +37,13 @@
 #include <trace/events/nvhost_podgov.h>
 
 #include "governor.h"
+#include "governor_pod_scaling.h"
 
 #include <linux/platform_device.h>
 #include <linux/pm_runtime.h>
 
 #define GET_TARGET_FREQ_DONTSCALE	1
 
-#ifdef CONFIG_DEVFREQ_GOV_POD_SCALING_HISTORY_BUFFER_SIZE_MAX
-#define MAX_HISTORY_BUF_SIZE		\
-	CONFIG_DEVFREQ_GOV_POD_SCALING_HISTORY_BUFFER_SIZE_MAX
-#else
-#define MAX_HISTORY_BUF_SIZE	0
-#endif
-
 static void podgov_enable(struct devfreq *df, int enable);
 static void podgov_set_user_ctl(struct devfreq *df, int enable);
 
@@ -63,39 +57,18 @@ struct podgov_info_rec {
 	int			enable;
 	int			init;
 
-	ktime_t			last_scale;
+	/* frequency selection state */
+	struct podgov_core	core;
 
-	unsigned int		p_block_window;
-	unsigned int		p_smooth;
-	int			p_damp;
-	int			p_load_max;
-	int			p_load_target;
-	int			p_bias;
 	unsigned int		p_user;
 	unsigned int		p_freq_request;
 
-	unsigned long		cycles_norm;
-	unsigned long		cycles_avg;
-
-	unsigned long		*cycles_history_buf;
-	int			p_history_buf_size;
-	int			history_next;
-	int			history_count;
-	unsigned long		recent_high;
-
-	unsigned long		rt_load;
-
 	int			adjustment_type;
 	unsigned long		adjustment_frequency;
 
 	struct devfreq		*power_manager;
 	struct dentry		*debugdir;
 
-	unsigned long		*freqlist;
-	int			freq_count;
-
-	int			freq_avg;
-
 	struct kobj_attribute	enable_3d_scaling_attr;
 	struct kobj_attribute	user_attr;
 	struct kobj_attribute	freq_request_attr;
@@ -292,81 +265,21 @@ static unsigned long scaling_state_check(struct devfreq *df, ktime_t time)
 {
 	struct podgov_info_rec *pg = df->data;
 	struct devfreq_dev_status *ds = &df->last_status;
-	unsigned long dt, busyness, rt_load = pg->rt_load;
-	long max_boost, damp, freq, boost, res;
+	unsigned long busyness, res;
 
-	dt = (unsigned long) ktime_us_delta(time, pg->last_scale);
-	if (dt < pg->p_block_window || df->previous_freq == 0)
+	res = podgov_core_scale(&pg->core, time, df->previous_freq,
+				ds->current_frequency, df->min_freq,
+				df->max_freq, &busyness);
+	if (!res)
 		return 0;
 
-	/* convert to mhz to avoid overflow */
-	freq = df->previous_freq / 1000000;
-	max_boost = (df->max_freq/3) / 1000000;
-
-	/* calculate and trace load */
-	busyness = 1000ULL * pg->cycles_avg / ds->current_frequency;
-
-	/* consider recent high load if required */
-	if (pg->p_history_buf_size && pg->history_count)
-		busyness = 1000ULL * pg->recent_high / ds->current_frequency;
-
-	trace_podgov_load(df->dev.parent, rt_load);
+	trace_podgov_load(df->dev.parent, pg->core.rt_load);
 	trace_podgov_busy(df->dev.parent, busyness);
-
-	damp = pg->p_damp;
-
-	if (rt_load > pg->p_load_max) {
-		/* if too busy, scale up max/3, do not damp */
-		boost = max_boost;
-		damp = 10;
-	} else {
-		/* boost = bias * freq * (busyness - target)/target */
-		boost = busyness - pg->p_load_target;
-		boost *= (pg->p_bias * freq);
-		boost /= (100 * pg->p_load_target);
-
-		/* clamp to max boost */
-		boost = (boost < max_boost) ? boost : max_boost;
-	}
-
-	/* calculate new request */
-	res = freq + boost;
-
-	/* Maintain average request */
-	pg->freq_avg = (pg->freq_avg * pg->p_smooth) + res;
-	pg->freq_avg /= (pg->p_smooth+1);
-
-	/* Applying damping to frequencies */
-	res = ((damp * res) + ((10 - damp)*pg->freq_avg)) / 10;
-
-	/* Convert to hz, limit, and apply */
-	res = res * 1000000;
-	scaling_limit(df, &res);
 	trace_podgov_scaling_state_check(df->dev.parent,
 					 df->previous_freq, res);
 	return res;
 }
 
-/*******************************************************************************
- * freqlist_up(podgov, target, steps)
- *
- * This function determines the frequency that is "steps" frequency steps
- * higher compared to the target frequency.
- ******************************************************************************/
-
-static int freqlist_up(struct podgov_info_rec *podgov, unsigned long target,
-			int steps)
-{
-	int i, pos;
-
-	for (i = 0; i < podgov->freq_count; i++)
-		if (podgov->freqlist[i] >= target)
-			break;
-
-	pos = min(podgov->freq_count - 1, i + steps);
-	return podgov->freqlist[pos];
-}
-
 /*******************************************************************************
  * debugfs interface for controlling 3d clock scaling on the fly
  ******************************************************************************/
@@ -398,7 +311,7 @@ static void nvhost_scale_emc_debug_init(struct devfreq *df)
 #define CREATE_PODGOV_FILE(fname) \
 	do {\
 		f = debugfs_create_u32(#fname, S_IRUGO | S_IWUSR, \
-			podgov->debugdir, &podgov->p_##fname); \
+			podgov->debugdir, &podgov->core.p_##fname); \
 		if (NULL == f) { \
 			pr_err("podgov: can\'t create file " #fname "\n"); \
 			return; \
@@ -551,13 +464,8 @@ static int nvhost_pod_estimate_freq(struct devfreq *df,
 {
 	struct podgov_info_rec *pg = df->data;
 	struct devfreq_dev_status *ds;
-	int err, i;
-	int buf_size = pg->p_history_buf_size;
-	int buf_next = pg->history_next;
-	int buf_count = pg->history_count;
-	unsigned long *cycles_buffer = pg->cycles_history_buf;
+	int err;
 	ktime_t now;
-	unsigned long long norm_load;
 
 	/* Ensure maximal clock when scaling is disabled */
 	if (!pg->enable) {
@@ -604,30 +512,8 @@ static int nvhost_pod_estimate_freq(struct devfreq *df,
 		return 0;
 	}
 
-	/* Sustain local variables */
-	norm_load = (u64)ds->current_frequency * ds->busy_time / ds->total_time;
-	pg->cycles_norm = norm_load;
-	pg->cycles_avg = ((u64)pg->cycles_avg * pg->p_smooth + norm_load) /
-		(pg->p_smooth + 1);
-	pg->rt_load = 1000ULL * ds->busy_time / ds->total_time;
-
-	/* Update history of normalized cycle counts and recent highest count */
-	if (buf_size) {
-		if (buf_count == buf_size) {
-			pg->recent_high = 0;
-			i = (buf_next + 1) % buf_size;
-			for (; i != buf_next; i = (i + 1) % buf_size) {
-				if (cycles_buffer[i] > pg->recent_high)
-					pg->recent_high = cycles_buffer[i];
-			}
-		}
-		cycles_buffer[buf_next] = norm_load;
-		pg->history_next = (buf_next + 1) % buf_size;
-		if (buf_count < buf_size)
-			pg->history_count += 1;
-		if (norm_load > pg->recent_high)
-			pg->recent_high = norm_load;
-	}
+	podgov_core_update_load(&pg->core, ds->current_frequency,
+				ds->busy_time, ds->total_time);
 
 	*freq = scaling_state_check(df, now);
 
@@ -636,10 +522,11 @@ static int nvhost_pod_estimate_freq(struct devfreq *df,
 		return 0;
 	}
 
-	if ((*freq = freqlist_up(pg, *freq, 0)) == ds->current_frequency)
+	*freq = podgov_core_freqlist_up(&pg->core, *freq, 0);
+	if (*freq == ds->current_frequency)
 		return 0;
 
-	pg->last_scale = now;
+	pg->core.last_scale = now;
 
 	trace_podgov_estimate_freq(df->dev.parent, df->previous_freq, *freq);
 
@@ -658,6 +545,7 @@ static int nvhost_pod_init(struct devfreq *df)
 	struct podgov_info_rec *podgov;
 	struct platform_device *d = to_platform_device(df->dev.parent);
 	ktime_t now = ktime_get();
+	unsigned long *history_buf;
 
 	struct kobj_attribute *attr = NULL;
 
@@ -665,36 +553,22 @@ static int nvhost_pod_init(struct devfreq *df)
 	if (!podgov)
 		goto err_alloc_podgov;
 
-	podgov->cycles_history_buf =
-		kzalloc(sizeof(unsigned long) * MAX_HISTORY_BUF_SIZE,
-			GFP_KERNEL);
-	if (!podgov->cycles_history_buf)
+	history_buf = kzalloc(sizeof(unsigned long) * MAX_HISTORY_BUF_SIZE,
+			      GFP_KERNEL);
+	if (!history_buf)
 		goto err_alloc_history_buffer;
 
-	podgov->p_history_buf_size =
-		MAX_HISTORY_BUF_SIZE < 100 ? MAX_HISTORY_BUF_SIZE : 100;
-	podgov->history_count = 0;
-	podgov->history_next = 0;
-	podgov->recent_high = 0;
-
 	df->data = (void *)podgov;
 
-	/* Set scaling parameter defaults */
+	/* Set scaling parameter defaults and reset clock counters */
 	podgov->enable = 1;
-
-	podgov->p_load_max = 900;
-	podgov->p_load_target = 700;
-	podgov->p_bias = 80;
-	podgov->p_smooth = 10;
-	podgov->p_damp = 7;
-	podgov->p_block_window = 50000;
+	podgov_core_init(&podgov->core, df->profile->freq_table,
+			 df->profile->max_state, history_buf,
+			 MAX_HISTORY_BUF_SIZE, now);
 
 	podgov->adjustment_type = ADJUSTMENT_DEVICE_REQ;
 	podgov->p_user = 0;
 
-	/* Reset clock counters */
-	podgov->last_scale = now;
-
 	podgov->power_manager = df;
 
 	mutex_init(&podgov->lock);
@@ -726,18 +600,14 @@ static int nvhost_pod_init(struct devfreq *df)
 	if (sysfs_create_file(&df->dev.parent->kobj, &attr->attr))
 		goto err_create_user_sysfs_entry;
 
-	podgov->freq_count = df->profile->max_state;
-	podgov->freqlist = df->profile->freq_table;
-	if (!podgov->freq_count || !podgov->freqlist)
+	if (!podgov->core.freq_count || !podgov->core.freqlist)
 		goto err_get_freqs;
 
 	/* store the limits */
-	df->min_freq = podgov->freqlist[0];
-	df->max_freq = podgov->freqlist[podgov->freq_count - 1];
+	df->min_freq = podgov->core.freqlist[0];
+	df->max_freq = podgov->core.freqlist[podgov->core.freq_count - 1];
 	podgov->p_freq_request = df->max_freq;
 
-	podgov->freq_avg = 0;
-
 	nvhost_scale_emc_debug_init(df);
 
 	devfreq_monitor_start(df);
@@ -754,7 +624,7 @@ err_create_request_sysfs_entry:
 			  &podgov->enable_3d_scaling_attr.attr);
 err_create_enable_sysfs_entry:
 	dev_err(&d->dev, "failed to create sysfs attributes");
-	kfree(podgov->cycles_history_buf);
+	kfree(podgov->core.cycles_history_buf);
 err_alloc_history_buffer:
 	kfree(podgov);
 err_alloc_podgov:
@@ -780,7 +650,7 @@ static void nvhost_pod_exit(struct devfreq *df)
 			  &podgov->enable_3d_scaling_attr.attr);
 
 	nvhost_scale_emc_debug_deinit(df);
-	kfree(podgov->cycles_history_buf);
+	kfree(podgov->core.cycles_history_buf);
 	kfree(podgov);
 }
 
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GOVERNOR_POD_SCALING_H
+#define __GOVERNOR_POD_SCALING_H
+
+#include "governor_core_types.h"
+
+#ifdef CONFIG_DEVFREQ_GOV_POD_SCALING_HISTORY_BUFFER_SIZE_MAX
+#define MAX_HISTORY_BUF_SIZE		\
+	CONFIG_DEVFREQ_GOV_POD_SCALING_HISTORY_BUFFER_SIZE_MAX
+#else
+#define MAX_HISTORY_BUF_SIZE	0
+#endif
+
+/*
+ * Frequency selection state of the pod governor. The core below does not
+ * depend on a devfreq device or on other kernel code (see
+ * governor_core_types.h), so the governor simulator, or a user-space
+ * build of this header, can drive it with recorded or synthetic load.
+ */
+struct podgov_core {
+	ktime_t			last_scale;
+
+	unsigned int		p_block_window;
+	unsigned int		p_smooth;
+	int			p_damp;
+	int			p_load_max;
+	int			p_load_target;
+	int			p_bias;
+
+	unsigned long		cycles_norm;
+	unsigned long		cycles_avg;
+
+	unsigned long		*cycles_history_buf;
+	int			p_history_buf_size;
+	int			history_next;
+	int			history_count;
+	unsigned long		recent_high;
+
+	unsigned long		rt_load;
+
+	int			freq_avg;
+
+	unsigned long		*freqlist;
+	int			freq_count;
+};
+
+/*******************************************************************************
+ * podgov_core_init(pg, freqlist, freq_count, history_buf, history_size, now)
+ *
+ * Set the scaling parameter defaults and reset the load history. history_buf
+ * must hold at least history_size entries.
+ ******************************************************************************/
+
+static inline void podgov_core_init(struct podgov_core *pg,
+				    unsigned long *freqlist, int freq_count,
+				    unsigned long *history_buf,
+				    int history_size, ktime_t now)
+{
+	memset(pg, 0, sizeof(*pg));
+
+	pg->cycles_history_buf = history_buf;
+	pg->p_history_buf_size = history_size < 100 ? history_size : 100;
+
+	pg->p_load_max = 900;
+	pg->p_load_target = 700;
+	pg->p_bias = 80;
+	pg->p_smooth = 10;
+	pg->p_damp = 7;
+	pg->p_block_window = 50000;
+
+	/* Reset clock counters */
+	pg->last_scale = now;
+
+	pg->freqlist = freqlist;
+	pg->freq_count = freq_count;
+}
+
+/*******************************************************************************
+ * podgov_core_update_load(pg, current_frequency, busy_time, total_time)
+ *
+ * Account a new load sample. total_time must not be zero.
+ ******************************************************************************/
+
+static inline void podgov_core_update_load(struct podgov_core *pg,
+					   unsigned long current_frequency,
+					   unsigned long busy_time,
+					   unsigned long total_time)
+{
+	int i;
+	int buf_size = pg->p_history_buf_size;
+	int buf_next = pg->history_next;
+	int buf_count = pg->history_count;
+	unsigned long *cycles_buffer = pg->cycles_history_buf;
+	unsigned long long norm_load;
+
+	/* Sustain local variables */
+	norm_load = (u64)current_frequency * busy_time / total_time;
+	pg->cycles_norm = norm_load;
+	pg->cycles_avg = ((u64)pg->cycles_avg * pg->p_smooth + norm_load) /
+		(pg->p_smooth + 1);
+	pg->rt_load = 1000ULL * busy_time / total_time;
+
+	/* Update history of normalized cycle counts and recent highest count */
+	if (buf_size) {
+		if (buf_count == buf_size) {
+			pg->recent_high = 0;
+			i = (buf_next + 1) % buf_size;
+			for (; i != buf_next; i = (i + 1) % buf_size) {
+				if (cycles_buffer[i] > pg->recent_high)
+					pg->recent_high = cycles_buffer[i];
+			}
+		}
+		cycles_buffer[buf_next] = norm_load;
+		pg->history_next = (buf_next + 1) % buf_size;
+		if (buf_count < buf_size)
+			pg->history_count += 1;
+		if (norm_load > pg->recent_high)
+			pg->recent_high = norm_load;
+	}
+}
+
+/*******************************************************************************
+ * freq = podgov_core_scale(pg, time, previous_freq, current_frequency,
+ *			    min_freq, max_freq, busyness)
+ *
+ * This function returns the desired frequency for the clock, limited to
+ * [min_freq, max_freq]. If there is no need to tune the clock immediately,
+ * 0 is returned. The load used for the decision is stored to busyness.
+ ******************************************************************************/
+
+static inline unsigned long podgov_core_scale(struct podgov_core *pg,
+					      ktime_t time,
+					      unsigned long previous_freq,
+					      unsigned long current_frequency,
+					      unsigned long min_freq,
+					      unsigned long max_freq,
+					      unsigned long *busyness)
+{
+	unsigned long dt, rt_load = pg->rt_load;
+	long max_boost, damp, freq, boost, res;
+
+	*busyness = 0;
+
+	dt = (unsigned long) ktime_us_delta(time, pg->last_scale);
+	if (dt < pg->p_block_window || previous_freq == 0)
+		return 0;
+
+	/* convert to mhz to avoid overflow */
+	freq = previous_freq / 1000000;
+	max_boost = (max_freq/3) / 1000000;
+
+	/* calculate load */
+	*busyness = 1000ULL * pg->cycles_avg / current_frequency;
+
+	/* consider recent high load if required */
+	if (pg->p_history_buf_size && pg->history_count)
+		*busyness = 1000ULL * pg->recent_high / current_frequency;
+
+	damp = pg->p_damp;
+
+	if (rt_load > pg->p_load_max) {
+		/* if too busy, scale up max/3, do not damp */
+		boost = max_boost;
+		damp = 10;
+	} else {
+		/* boost = bias * freq * (busyness - target)/target */
+		boost = *busyness - pg->p_load_target;
+		boost *= (pg->p_bias * freq);
+		boost /= (100 * pg->p_load_target);
+
+		/* clamp to max boost */
+		boost = (boost < max_boost) ? boost : max_boost;
+	}
+
+	/* calculate new request */
+	res = freq + boost;
+
+	/* Maintain average request */
+	pg->freq_avg = (pg->freq_avg * pg->p_smooth) + res;
+	pg->freq_avg /= (pg->p_smooth+1);
+
+	/* Applying damping to frequencies */
+	res = ((damp * res) + ((10 - damp)*pg->freq_avg)) / 10;
+
+	/* Convert to hz and limit */
+	res = res * 1000000;
+	if (res < (long)min_freq)
+		res = min_freq;
+	else if (res > (long)max_freq)
+		res = max_freq;
+
+	return res;
+}
+
+/*******************************************************************************
+ * podgov_core_freqlist_up(pg, target, steps)
+ *
+ * This function determines the frequency that is "steps" frequency steps
+ * higher compared to the target frequency.
+ ******************************************************************************/
+
+static inline unsigned long podgov_core_freqlist_up(struct podgov_core *pg,
+						    unsigned long target,
+						    int steps)
+{
+	int i, pos;
+
+	for (i = 0; i < pg->freq_count; i++)
+		if (pg->freqlist[i] >= target)
+			break;
+
+	pos = min(pg->freq_count - 1, i + steps);
+	return pg->freqlist[pos];
+}
+
+#endif
@@ -0,0 +1,840 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Devfreq governor simulator
+ *
+ * Runs the frequency selection of the pod_scaling and wmark_active
+ * governors against load traces instead of a device, so that parameter
+ * changes can be evaluated without hardware. A trace is a list of segments
+ * "<duration_us> <demand_khz>", where the demand is the clock rate that
+ * would complete the submitted work in real time. Work that the simulated
+ * device cannot complete at its current rate is carried over.
+ *
+ * Every sample_us the simulated device reports its busy time; pod_scaling
+ * is called on every sample like the devfreq monitor does, wmark_active
+ * only when the load crosses one of its watermarks.
+ *
+ * debugfs devfreq_gov_sim/:
+ *   freq_table	write the frequency table in kHz, ascending
+ *   trace	write trace segments, one per line; opening with O_TRUNC
+ *		drops the previous trace
+ *   params	write parameter sets, one per line, as
+ *		"pod|wmark [name=value ...]"; names match the governor
+ *		debugfs tunables
+ *   sample_us	governor sampling period
+ *   report	run the built-in scenarios and the trace with every
+ *		parameter set and report time at frequency, latency to
+ *		load steps, completed work and an energy proxy
+ *
+ * The energy proxy integrates f * V^2 with the voltage interpolated
+ * linearly from 0.6V at the lowest to 1.0V at the highest rate; idle time
+ * is charged at a tenth of busy time.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/string.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+
+#include "governor_pod_scaling.h"
+#include "governor_wmark_active.h"
+
+#define SIM_MAX_FREQS		32
+#define SIM_MAX_SEGS		65536
+#define SIM_MAX_SETS		8
+#define SIM_MAX_PARAMS		6
+#define SIM_SCENARIO_SEGS	400
+#define SIM_STEP_PERMILLE	100
+#define SIM_DEFAULT_SAMPLE_US	16000
+
+enum sim_gov {
+	SIM_GOV_POD,
+	SIM_GOV_WMARK,
+};
+
+static const char * const sim_gov_names[] = {
+	[SIM_GOV_POD] = "pod",
+	[SIM_GOV_WMARK] = "wmark",
+};
+
+struct sim_key {
+	const char *name;
+	size_t offset;
+};
+
+static const struct sim_key sim_pod_keys[] = {
+	{ "block_window", offsetof(struct podgov_core, p_block_window) },
+	{ "smooth", offsetof(struct podgov_core, p_smooth) },
+	{ "damp", offsetof(struct podgov_core, p_damp) },
+	{ "load_max", offsetof(struct podgov_core, p_load_max) },
+	{ "load_target", offsetof(struct podgov_core, p_load_target) },
+	{ "bias", offsetof(struct podgov_core, p_bias) },
+	{ NULL, 0 },
+};
+
+static const struct sim_key sim_wmark_keys[] = {
+	{ "block_window", offsetof(struct wmark_core, p_block_window) },
+	{ "load_target", offsetof(struct wmark_core, p_load_target) },
+	{ "load_max", offsetof(struct wmark_core, p_load_max) },
+	{ "smooth", offsetof(struct wmark_core, p_smooth) },
+	{ NULL, 0 },
+};
+
+struct sim_param {
+	const struct sim_key *key;
+	u32 value;
+};
+
+struct sim_param_set {
+	enum sim_gov gov;
+	unsigned int count;
+	struct sim_param param[SIM_MAX_PARAMS];
+};
+
+struct sim_seg {
+	u32 dur_us;
+	u32 demand_khz;
+};
+
+struct sim_result {
+	u64 duration_us;
+	u64 time_at[SIM_MAX_FREQS];
+	u64 energy;
+	u64 demand_cycles;
+	u64 done_cycles;
+	u64 max_backlog;
+	unsigned int transitions;
+	unsigned int steps;
+	unsigned int steps_met;
+	u64 latency_total_us;
+	u64 latency_max_us;
+};
+
+static struct {
+	struct mutex lock;
+	struct dentry *debugdir;
+
+	unsigned long freqs[SIM_MAX_FREQS];
+	int freq_count;
+	u32 sample_us;
+
+	struct sim_param_set sets[SIM_MAX_SETS];
+	unsigned int set_count;
+
+	struct sim_seg *trace;
+	unsigned int trace_count;
+	char trace_line[64];
+	unsigned int trace_line_len;
+
+	struct sim_seg scenario[SIM_SCENARIO_SEGS];
+	unsigned long history[MAX_HISTORY_BUF_SIZE + 1];
+} sim;
+
+/* GP10B like default table, in kHz */
+static const unsigned long sim_default_freqs[] = {
+	114750, 216750, 318750, 420750, 522750, 624750, 726750,
+	828750, 930750, 1032750, 1134750, 1236750, 1300500,
+};
+
+static int sim_freq_index(unsigned long freq)
+{
+	int i;
+
+	for (i = 0; i < sim.freq_count - 1; i++)
+		if (sim.freqs[i] >= freq)
+			break;
+
+	return i;
+}
+
+/* MHz * mV^2 / 1000 */
+static u64 sim_power(unsigned long freq)
+{
+	unsigned long fmin = sim.freqs[0];
+	unsigned long fmax = sim.freqs[sim.freq_count - 1];
+	u64 mv = 1000;
+
+	if (fmax > fmin)
+		mv = 600 + div64_u64(400ULL * (freq - fmin), fmax - fmin);
+
+	return div_u64((u64)(freq / 1000000) * mv * mv, 1000);
+}
+
+static void sim_apply_params(const struct sim_param_set *set, void *core)
+{
+	unsigned int i;
+
+	for (i = 0; i < set->count; i++)
+		*(u32 *)((char *)core + set->param[i].key->offset) =
+			set->param[i].value;
+}
+
+static void sim_run(const struct sim_seg *segs, unsigned int count,
+		    const struct sim_param_set *set, struct sim_result *res)
+{
+	unsigned long fmin = sim.freqs[0];
+	unsigned long fmax = sim.freqs[sim.freq_count - 1];
+	unsigned long freq = fmin, new_freq, target, busyness, ideal;
+	unsigned long low = WMARK_CORE_LOW_DISABLED;
+	unsigned long high = WMARK_CORE_HIGH_DISABLED;
+	u64 t = 0, step_t = 0, backlog = 0, acc_busy = 0, acc_total = 0;
+	u64 arrived, capacity, work, done, lat;
+	unsigned long step_target = 0, prev_demand;
+	u32 left, take, elapsed, busy_us, seg_off = 0;
+	struct podgov_core pod;
+	struct wmark_core wmark;
+	unsigned int i = 0, load, samples = 0;
+	bool pending = false;
+	ktime_t now;
+
+	memset(res, 0, sizeof(*res));
+
+	if (set->gov == SIM_GOV_POD) {
+		podgov_core_init(&pod, sim.freqs, sim.freq_count, sim.history,
+				 MAX_HISTORY_BUF_SIZE, ktime_set(0, 0));
+		sim_apply_params(set, &pod);
+	} else {
+		wmark_core_init(&wmark, sim.freqs, sim.freq_count);
+		sim_apply_params(set, &wmark);
+		wmark_core_reset(&wmark, freq);
+		wmark_core_watermarks(&wmark, freq, freq, &low, &high);
+	}
+
+	prev_demand = (unsigned long)segs[0].demand_khz * 1000;
+
+	while (i < count) {
+		/* collect the work submitted during this sample */
+		arrived = 0;
+		left = sim.sample_us;
+		while (left && i < count) {
+			if (!seg_off && i) {
+				target = (unsigned long)segs[i].demand_khz *
+					1000;
+				if (target >= prev_demand +
+				    fmax / 1000 * SIM_STEP_PERMILLE) {
+					pending = true;
+					res->steps++;
+					step_t = t + sim.sample_us - left;
+					step_target = sim.freqs[sim_freq_index(
+						min(target, fmax))];
+				}
+				prev_demand = target;
+			}
+
+			take = min(left, segs[i].dur_us - seg_off);
+			arrived += div_u64((u64)segs[i].demand_khz * take,
+					   1000);
+			left -= take;
+			seg_off += take;
+			if (seg_off == segs[i].dur_us) {
+				seg_off = 0;
+				i++;
+			}
+		}
+
+		elapsed = sim.sample_us - left;
+		if (!elapsed)
+			break;
+
+		/* run the device at freq for the sample */
+		capacity = div_u64((u64)(freq / 1000) * elapsed, 1000);
+		work = backlog + arrived;
+		done = min(work, capacity);
+		backlog = work - done;
+		busy_us = capacity ? div64_u64(done * elapsed, capacity) : 0;
+
+		res->time_at[sim_freq_index(freq)] += elapsed;
+		res->energy += sim_power(freq) *
+			(busy_us + (elapsed - busy_us) / 10);
+		res->demand_cycles += arrived;
+		res->done_cycles += done;
+		res->max_backlog = max(res->max_backlog, backlog);
+
+		t += elapsed;
+		now = ns_to_ktime(t * NSEC_PER_USEC);
+
+		/* let the governor pick the rate for the next sample */
+		new_freq = freq;
+		if (set->gov == SIM_GOV_POD) {
+			podgov_core_update_load(&pod, freq, busy_us, elapsed);
+			target = podgov_core_scale(&pod, now, freq, freq,
+						   fmin, fmax, &busyness);
+			if (target) {
+				target = podgov_core_freqlist_up(&pod, target,
+								 0);
+				if (target != freq) {
+					pod.last_scale = now;
+					new_freq = target;
+				}
+			}
+		} else {
+			acc_busy += busy_us;
+			acc_total += elapsed;
+			load = div_u64((u64)busy_us * 1000, elapsed);
+			if ((high < WMARK_CORE_HIGH_DISABLED && load > high) ||
+			    (low > WMARK_CORE_LOW_DISABLED && load < low)) {
+				new_freq = wmark_core_target_freq(&wmark, now,
+						freq, acc_busy, acc_total,
+						&ideal);
+				wmark_core_watermarks(&wmark, freq, ideal,
+						      &low, &high);
+				acc_busy = 0;
+				acc_total = 0;
+			}
+		}
+
+		if (pending && (freq >= step_target ||
+				new_freq >= step_target)) {
+			lat = freq >= step_target ? 0 : t - step_t;
+			pending = false;
+			res->steps_met++;
+			res->latency_total_us += lat;
+			res->latency_max_us = max(res->latency_max_us, lat);
+		}
+
+		if (new_freq != freq)
+			res->transitions++;
+		freq = new_freq;
+
+		if (!(++samples % 1024))
+			cond_resched();
+	}
+
+	res->duration_us = t;
+}
+
+static void sim_report(struct seq_file *s, const char *name,
+		       const struct sim_seg *segs, unsigned int count)
+{
+	struct sim_result res;
+	unsigned int set, i, permille;
+	u32 energy_frac, perf_frac;
+	u64 energy, perf;
+
+	for (set = 0; set < sim.set_count; set++) {
+		sim_run(segs, count, &sim.sets[set], &res);
+
+		energy = div_u64_rem(div_u64(res.energy, 1000000), 1000,
+				     &energy_frac);
+		perf = div_u64_rem(res.energy ?
+				   div64_u64(res.done_cycles * 1000000,
+					     res.energy) : 0,
+				   1000, &perf_frac);
+		permille = res.demand_cycles ?
+			div64_u64(res.done_cycles * 1000, res.demand_cycles) :
+			1000;
+
+		seq_printf(s, "%-8s set%u %-5s: energy %llu.%03u, work %u.%u%%, Mcycles/energy %llu.%03u, max backlog %llu us, transitions %u\n",
+			   name, set, sim_gov_names[sim.sets[set].gov],
+			   energy, energy_frac, permille / 10, permille % 10,
+			   perf, perf_frac,
+			   div64_u64(res.max_backlog * 1000,
+				     sim.freqs[sim.freq_count - 1] / 1000),
+			   res.transitions);
+		seq_printf(s, "    load steps %u, met %u, latency avg %llu us, max %llu us\n",
+			   res.steps, res.steps_met,
+			   res.steps_met ? div_u64(res.latency_total_us,
+						   res.steps_met) : 0,
+			   res.latency_max_us);
+		seq_puts(s, "    time at MHz:");
+		for (i = 0; i < sim.freq_count; i++) {
+			if (!res.time_at[i])
+				continue;
+			permille = div64_u64(res.time_at[i] * 1000,
+					     res.duration_us);
+			seq_printf(s, " %lu:%u.%u%%",
+				   sim.freqs[i] / 1000000,
+				   permille / 10, permille % 10);
+		}
+		seq_putc(s, '\n');
+	}
+}
+
+static unsigned int sim_add_seg(unsigned int n, u32 dur_us, u32 permille)
+{
+	unsigned long fmax_khz = sim.freqs[sim.freq_count - 1] / 1000;
+
+	if (n < SIM_SCENARIO_SEGS) {
+		sim.scenario[n].dur_us = dur_us;
+		sim.scenario[n].demand_khz = fmax_khz * permille / 1000;
+	}
+
+	return n + 1;
+}
+
+/* idle, a sustained high load, idle again */
+static unsigned int sim_scenario_step(void)
+{
+	unsigned int n = 0;
+
+	n = sim_add_seg(n, 1000000, 100);
+	n = sim_add_seg(n, 2000000, 800);
+	n = sim_add_seg(n, 2000000, 100);
+
+	return n;
+}
+
+/* 60 fps frames, each busy for 10 ms at 90% */
+static unsigned int sim_scenario_frames(void)
+{
+	unsigned int n = 0, i;
+
+	for (i = 0; i < 180; i++) {
+		n = sim_add_seg(n, 10000, 900);
+		n = sim_add_seg(n, 6667, 50);
+	}
+
+	return n;
+}
+
+/* load ramping up to 100% and back in 10% steps */
+static unsigned int sim_scenario_ramp(void)
+{
+	unsigned int n = 0, i;
+
+	for (i = 1; i <= 10; i++)
+		n = sim_add_seg(n, 200000, i * 100);
+	for (i = 9; i >= 1; i--)
+		n = sim_add_seg(n, 200000, i * 100);
+
+	return n;
+}
+
+static int sim_report_show(struct seq_file *s, void *data)
+{
+	static const struct {
+		const char *name;
+		unsigned int (*fill)(void);
+	} scenarios[] = {
+		{ "step", sim_scenario_step },
+		{ "frames", sim_scenario_frames },
+		{ "ramp", sim_scenario_ramp },
+	};
+	struct sim_param_set defaults[] = {
+		{ .gov = SIM_GOV_POD },
+		{ .gov = SIM_GOV_WMARK },
+	};
+	unsigned int i, j, n;
+	bool use_defaults;
+
+	mutex_lock(&sim.lock);
+
+	use_defaults = !sim.set_count;
+	if (use_defaults) {
+		memcpy(sim.sets, defaults, sizeof(defaults));
+		sim.set_count = ARRAY_SIZE(defaults);
+	}
+
+	seq_printf(s, "sample %u us, %d rates %lu-%lu MHz\n", sim.sample_us,
+		   sim.freq_count, sim.freqs[0] / 1000000,
+		   sim.freqs[sim.freq_count - 1] / 1000000);
+	for (i = 0; i < sim.set_count; i++) {
+		seq_printf(s, "set%u: %s", i, sim_gov_names[sim.sets[i].gov]);
+		for (j = 0; j < sim.sets[i].count; j++)
+			seq_printf(s, " %s=%u", sim.sets[i].param[j].key->name,
+				   sim.sets[i].param[j].value);
+		seq_puts(s, sim.sets[i].count ? "\n" : " defaults\n");
+	}
+
+	for (i = 0; i < ARRAY_SIZE(scenarios); i++) {
+		n = min_t(unsigned int, scenarios[i].fill(),
+			  SIM_SCENARIO_SEGS);
+		sim_report(s, scenarios[i].name, sim.scenario, n);
+	}
+
+	if (sim.trace_count)
+		sim_report(s, "trace", sim.trace, sim.trace_count);
+
+	if (use_defaults)
+		sim.set_count = 0;
+
+	mutex_unlock(&sim.lock);
+
+	return 0;
+}
+
+static int sim_report_open(struct inode *inode, struct file *file)
+{
+	return single_open_size(file, sim_report_show, inode->i_private,
+				PAGE_SIZE * 16);
+}
+
+static const struct file_operations sim_report_fops = {
+	.open = sim_report_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int sim_parse_set(char *line, struct sim_param_set *set)
+{
+	const struct sim_key *keys, *key;
+	char *tok, *val;
+	u32 value;
+
+	memset(set, 0, sizeof(*set));
+
+	tok = strsep(&line, " \t");
+	if (!strcmp(tok, "pod")) {
+		set->gov = SIM_GOV_POD;
+		keys = sim_pod_keys;
+	} else if (!strcmp(tok, "wmark")) {
+		set->gov = SIM_GOV_WMARK;
+		keys = sim_wmark_keys;
+	} else {
+		return -EINVAL;
+	}
+
+	while ((tok = strsep(&line, " \t"))) {
+		if (!*tok)
+			continue;
+
+		val = strchr(tok, '=');
+		if (!val || kstrtou32(val + 1, 0, &value))
+			return -EINVAL;
+		*val = '\0';
+
+		for (key = keys; key->name; key++)
+			if (!strcmp(key->name, tok))
+				break;
+		if (!key->name || set->count == SIM_MAX_PARAMS)
+			return -EINVAL;
+
+		set->param[set->count].key = key;
+		set->param[set->count].value = value;
+		set->count++;
+	}
+
+	return 0;
+}
+
+static ssize_t sim_params_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct sim_param_set set;
+	char *kbuf, *cur, *line;
+	int ret = 0;
+
+	kbuf = memdup_user_nul(buf, min_t(size_t, count, PAGE_SIZE));
+	if (IS_ERR(kbuf))
+		return PTR_ERR(kbuf);
+
+	mutex_lock(&sim.lock);
+	if ((file->f_flags & O_TRUNC) && *ppos == 0)
+		sim.set_count = 0;
+
+	cur = kbuf;
+	while ((line = strsep(&cur, "\n"))) {
+		line = strim(line);
+		if (!*line || *line == '#')
+			continue;
+
+		ret = sim_parse_set(line, &set);
+		if (ret)
+			break;
+		if (sim.set_count == SIM_MAX_SETS) {
+			ret = -ENOSPC;
+			break;
+		}
+		sim.sets[sim.set_count++] = set;
+	}
+	mutex_unlock(&sim.lock);
+
+	kfree(kbuf);
+	if (ret)
+		return ret;
+
+	*ppos += count;
+	return count;
+}
+
+static int sim_params_show(struct seq_file *s, void *data)
+{
+	unsigned int i, j;
+
+	mutex_lock(&sim.lock);
+	for (i = 0; i < sim.set_count; i++) {
+		seq_puts(s, sim_gov_names[sim.sets[i].gov]);
+		for (j = 0; j < sim.sets[i].count; j++)
+			seq_printf(s, " %s=%u", sim.sets[i].param[j].key->name,
+				   sim.sets[i].param[j].value);
+		seq_putc(s, '\n');
+	}
+	mutex_unlock(&sim.lock);
+
+	return 0;
+}
+
+static int sim_params_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sim_params_show, inode->i_private);
+}
+
+static const struct file_operations sim_params_fops = {
+	.open = sim_params_open,
+	.read = seq_read,
+	.write = sim_params_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static ssize_t sim_freq_table_write(struct file *file,
+				    const char __user *buf, size_t count,
+				    loff_t *ppos)
+{
+	unsigned long freqs[SIM_MAX_FREQS];
+	char *kbuf, *cur, *tok;
+	unsigned long khz;
+	int n = 0, ret = 0;
+
+	kbuf = memdup_user_nul(buf, min_t(size_t, count, PAGE_SIZE));
+	if (IS_ERR(kbuf))
+		return PTR_ERR(kbuf);
+
+	cur = kbuf;
+	while ((tok = strsep(&cur, " \t\n,"))) {
+		if (!*tok)
+			continue;
+		if (n == SIM_MAX_FREQS || kstrtoul(tok, 0, &khz) || !khz ||
+		    (n && khz * 1000 <= freqs[n - 1])) {
+			ret = -EINVAL;
+			break;
+		}
+		freqs[n++] = khz * 1000;
+	}
+	kfree(kbuf);
+
+	if (!ret && !n)
+		ret = -EINVAL;
+	if (ret)
+		return ret;
+
+	mutex_lock(&sim.lock);
+	memcpy(sim.freqs, freqs, n * sizeof(*freqs));
+	sim.freq_count = n;
+	mutex_unlock(&sim.lock);
+
+	return count;
+}
+
+static int sim_freq_table_show(struct seq_file *s, void *data)
+{
+	int i;
+
+	mutex_lock(&sim.lock);
+	for (i = 0; i < sim.freq_count; i++)
+		seq_printf(s, "%lu%c", sim.freqs[i] / 1000,
+			   i == sim.freq_count - 1 ? '\n' : ' ');
+	mutex_unlock(&sim.lock);
+
+	return 0;
+}
+
+static int sim_freq_table_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sim_freq_table_show, inode->i_private);
+}
+
+static const struct file_operations sim_freq_table_fops = {
+	.open = sim_freq_table_open,
+	.read = seq_read,
+	.write = sim_freq_table_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* call with sim.lock held */
+static int sim_trace_parse(const char *line)
+{
+	unsigned int dur_us, demand_khz;
+
+	line = skip_spaces(line);
+	if (!*line || *line == '#')
+		return 0;
+
+	if (sscanf(line, "%u %u", &dur_us, &demand_khz) != 2 || !dur_us)
+		return -EINVAL;
+
+	if (sim.trace_count == SIM_MAX_SEGS)
+		return -ENOSPC;
+
+	sim.trace[sim.trace_count].dur_us = dur_us;
+	sim.trace[sim.trace_count].demand_khz = demand_khz;
+	sim.trace_count++;
+
+	return 0;
+}
+
+static int sim_trace_open(struct inode *inode, struct file *file)
+{
+	mutex_lock(&sim.lock);
+	if (file->f_flags & O_TRUNC)
+		sim.trace_count = 0;
+	sim.trace_line_len = 0;
+	mutex_unlock(&sim.lock);
+
+	return nonseekable_open(inode, file);
+}
+
+static ssize_t sim_trace_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	char kbuf[256 + sizeof(sim.trace_line)];
+	size_t done = 0, len, chunk;
+	char *line, *nl;
+	int ret = 0;
+
+	mutex_lock(&sim.lock);
+
+	if (!sim.trace) {
+		sim.trace = vmalloc(SIM_MAX_SEGS * sizeof(*sim.trace));
+		if (!sim.trace) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	while (done < count) {
+		len = sim.trace_line_len;
+		memcpy(kbuf, sim.trace_line, len);
+		chunk = min(count - done, sizeof(kbuf) - len - 1);
+		if (copy_from_user(kbuf + len, buf + done, chunk)) {
+			ret = -EFAULT;
+			goto out;
+		}
+		done += chunk;
+		len += chunk;
+		kbuf[len] = '\0';
+
+		line = kbuf;
+		while ((nl = strchr(line, '\n'))) {
+			*nl = '\0';
+			ret = sim_trace_parse(line);
+			if (ret)
+				goto out;
+			line = nl + 1;
+		}
+
+		len = kbuf + len - line;
+		if (len >= sizeof(sim.trace_line)) {
+			ret = -EINVAL;
+			goto out;
+		}
+		memcpy(sim.trace_line, line, len);
+		sim.trace_line_len = len;
+	}
+
+out:
+	if (ret)
+		sim.trace_line_len = 0;
+	mutex_unlock(&sim.lock);
+
+	return ret ? ret : count;
+}
+
+static int sim_trace_release(struct inode *inode, struct file *file)
+{
+	mutex_lock(&sim.lock);
+	if (sim.trace_line_len) {
+		sim.trace_line[sim.trace_line_len] = '\0';
+		if (sim_trace_parse(sim.trace_line))
+			pr_err("devfreq_gov_sim: bad trace line \"%s\"\n",
+			       sim.trace_line);
+		sim.trace_line_len = 0;
+	}
+	mutex_unlock(&sim.lock);
+
+	return 0;
+}
+
+static const struct file_operations sim_trace_fops = {
+	.open = sim_trace_open,
+	.write = sim_trace_write,
+	.release = sim_trace_release,
+	.llseek = no_llseek,
+};
+
+static int sim_sample_us_set(void *data, u64 val)
+{
+	if (!val || val > USEC_PER_SEC)
+		return -EINVAL;
+
+	mutex_lock(&sim.lock);
+	sim.sample_us = val;
+	mutex_unlock(&sim.lock);
+
+	return 0;
+}
+
+static int sim_sample_us_get(void *data, u64 *val)
+{
+	*val = sim.sample_us;
+	return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(sim_sample_us_fops, sim_sample_us_get,
+			sim_sample_us_set, "%llu\n");
+
+static int __init devfreq_gov_sim_init(void)
+{
+	int i;
+
+	mutex_init(&sim.lock);
+	sim.sample_us = SIM_DEFAULT_SAMPLE_US;
+	sim.freq_count = ARRAY_SIZE(sim_default_freqs);
+	for (i = 0; i < sim.freq_count; i++)
+		sim.freqs[i] = sim_default_freqs[i] * 1000;
+
+	sim.debugdir = debugfs_create_dir("devfreq_gov_sim", NULL);
+	if (!sim.debugdir) {
+		pr_err("devfreq_gov_sim: cannot create debugfs directory\n");
+		return -ENOMEM;
+	}
+
+	debugfs_create_file("freq_table", S_IRUGO | S_IWUSR, sim.debugdir,
+			    NULL, &sim_freq_table_fops);
+	debugfs_create_file("trace", S_IWUSR, sim.debugdir, NULL,
+			    &sim_trace_fops);
+	debugfs_create_file("params", S_IRUGO | S_IWUSR, sim.debugdir, NULL,
+			    &sim_params_fops);
+	debugfs_create_file("sample_us", S_IRUGO | S_IWUSR, sim.debugdir,
+			    NULL, &sim_sample_us_fops);
+	debugfs_create_file("report", S_IRUGO, sim.debugdir, NULL,
+			    &sim_report_fops);
+
+	return 0;
+}
+
+static void __exit devfreq_gov_sim_exit(void)
+{
+	debugfs_remove_recursive(sim.debugdir);
+	vfree(sim.trace);
+}
+
+module_init(devfreq_gov_sim_init);
+module_exit(devfreq_gov_sim_exit);
+MODULE_DESCRIPTION("Trace driven simulator for the nvhost devfreq governors");
+MODULE_LICENSE("GPL v2");
@@ -24,118 +24,29 @@
 #include <linux/module.h>
 
 #include "governor.h"
+#include "governor_wmark_active.h"
 
 struct wmark_gov_info {
-	/* probed from the devfreq */
-	unsigned long		*freqlist;
-	int			freq_count;
-
-	/* algorithm parameters */
-	unsigned int		p_block_window;
-	unsigned int		p_load_target;
-	unsigned int		p_load_max;
-	unsigned int		p_smooth;
+	/* frequency selection state */
+	struct wmark_core	core;
 
 	/* common data */
 	struct devfreq		*df;
 	struct platform_device	*pdev;
 	struct dentry		*debugdir;
-
-	/* used for ensuring that we do not update frequency too often */
-	ktime_t			last_frequency_update;
-
-	/* variable for keeping the average frequency request */
-	unsigned long long	average_target_freq;
 };
 
-static unsigned long freqlist_up(struct wmark_gov_info *wmarkinfo,
-			unsigned long curr_freq)
-{
-	int i, pos;
-
-	for (i = 0; i < wmarkinfo->freq_count; i++)
-		if (wmarkinfo->freqlist[i] > curr_freq)
-			break;
-
-	pos = min(wmarkinfo->freq_count - 1, i);
-
-	return wmarkinfo->freqlist[pos];
-}
-
-static unsigned long freqlist_down(struct wmark_gov_info *wmarkinfo,
-			unsigned long curr_freq)
-{
-	int i, pos;
-
-	for (i = wmarkinfo->freq_count - 1; i >= 0; i--)
-		if (wmarkinfo->freqlist[i] < curr_freq)
-			break;
-
-	pos = max(0, i);
-	return wmarkinfo->freqlist[pos];
-}
-
-static unsigned long freqlist_round(struct wmark_gov_info *wmarkinfo,
-				    unsigned long freq)
-{
-	int i, pos;
-
-	for (i = 0; i < wmarkinfo->freq_count; i++)
-		if (wmarkinfo->freqlist[i] >= freq)
-			break;
-
-	pos = min(wmarkinfo->freq_count - 1, i);
-	return wmarkinfo->freqlist[pos];
-}
-
-
- /*
-  * update_watermarks - Re-estimate low and high watermarks
-  *     @df: pointer to the devfreq structure
-  *     @current_frequency: current frequency of the device
-  *     @ideal_frequency: frequency that would change load to target load.
-  *
-  * This function updates the devfreq high and low watermarks. Target is
-  * to ensure that the interrupts are triggered whenever the load changes
-  * enough to make a change to the ideal frequency (given the DVFS table).
-  */
-
 static void update_watermarks(struct devfreq *df,
 			      unsigned long current_frequency,
 			      unsigned long ideal_frequency)
 {
 	struct wmark_gov_info *wmarkinfo = df->data;
-	unsigned long long relation = 0, next_freq = 0;
-	unsigned long long current_frequency_khz = current_frequency / 1000;
-
-	if (ideal_frequency == wmarkinfo->freqlist[0]) {
-		/* disable the low watermark if we are at lowest clock */
-		df->profile->set_low_wmark(df->dev.parent, 0);
-	} else {
-		/* calculate the low threshold; what is the load value
-		 * at which we would go into lower frequency given the
-		 * that we are running at the new frequency? */
-		next_freq = freqlist_down(wmarkinfo, ideal_frequency);
-		relation = ((next_freq / current_frequency_khz) *
-			wmarkinfo->p_load_target) / 1000;
-		df->profile->set_low_wmark(df->dev.parent, relation);
-	}
+	unsigned long low_wmark, high_wmark;
 
-	if (ideal_frequency ==
-	    wmarkinfo->freqlist[wmarkinfo->freq_count - 1]) {
-		/* disable the high watermark if we are at highest clock */
-		df->profile->set_high_wmark(df->dev.parent, 1000);
-	} else {
-		/* calculate the high threshold; what is the load value
-		 * at which we would go into highest frequency given the
-		 * that we are running at the new frequency? */
-		next_freq = freqlist_up(wmarkinfo, ideal_frequency);
-		relation = ((next_freq / current_frequency_khz) *
-			wmarkinfo->p_load_target) / 1000;
-		relation = min((unsigned long long)wmarkinfo->p_load_max,
-			       relation);
-		df->profile->set_high_wmark(df->dev.parent, relation);
-	}
+	wmark_core_watermarks(&wmarkinfo->core, current_frequency,
+			      ideal_frequency, &low_wmark, &high_wmark);
+	df->profile->set_low_wmark(df->dev.parent, low_wmark);
+	df->profile->set_high_wmark(df->dev.parent, high_wmark);
 }
 
 static int devfreq_watermark_target_freq(struct devfreq *df,
@@ -143,9 +54,7 @@ static int devfreq_watermark_target_freq(struct devfreq *df,
 {
 	struct wmark_gov_info *wmarkinfo = df->data;
 	struct devfreq_dev_status dev_stat;
-	unsigned long long load, relation, ideal_freq;
-	ktime_t current_time = ktime_get();
-	s64 dt = ktime_us_delta(current_time, wmarkinfo->last_frequency_update);
+	unsigned long ideal_freq;
 	int err;
 
 	err = df->profile->get_dev_status(df->dev.parent, &dev_stat);
@@ -159,49 +68,14 @@ static int devfreq_watermark_target_freq(struct devfreq *df,
 	if (!dev_stat.total_time)
 		return 0;
 
-	/* calculate first load and relation load/p_load_target */
-	load = (dev_stat.busy_time * 1000) / dev_stat.total_time;
-
-	/* if we cross load max...  */
-	if (load >= wmarkinfo->p_load_max) {
-		/* we go directly to the highest frequency. depending
-		 * on frequency table we might never go higher than
-		 * the current frequency (i.e. load should be over 100%
-		 * to make relation push to the next frequency). */
-		ideal_freq = wmarkinfo->freqlist[wmarkinfo->freq_count - 1];
-	} else {
-		/* otherwise, based on relation between current load and
-		 * load target we calculate the "ideal" frequency
-		 * where we would be just at the target */
-		relation = (load * 1000) / wmarkinfo->p_load_target;
-		ideal_freq = relation * (dev_stat.current_frequency / 1000);
-
-		/* round this frequency */
-		ideal_freq = freqlist_round(wmarkinfo, ideal_freq);
-	}
-
-	/* update average target frequency */
-	wmarkinfo->average_target_freq =
-		(wmarkinfo->p_smooth * wmarkinfo->average_target_freq +
-		 ideal_freq) / (wmarkinfo->p_smooth + 1);
+	*freq = wmark_core_target_freq(&wmarkinfo->core, ktime_get(),
+				       dev_stat.current_frequency,
+				       dev_stat.busy_time,
+				       dev_stat.total_time, &ideal_freq);
 
 	/* update watermarks to match the ideal frequency */
 	update_watermarks(df, dev_stat.current_frequency, ideal_freq);
 
-	/* do not scale too often */
-	if (dt < wmarkinfo->p_block_window)
-		return 0;
-
-	/* update the frequency */
-	*freq = freqlist_round(wmarkinfo, wmarkinfo->average_target_freq);
-
-	/* check if frequency actually got updated */
-	if (*freq == dev_stat.current_frequency)
-		return 0;
-
-	/* enable hysteresis - frequency is updated */
-	wmarkinfo->last_frequency_update = current_time;
-
 	return 0;
 }
 
@@ -226,7 +100,7 @@ static void devfreq_watermark_debug_start(struct devfreq *df)
 #define CREATE_DBG_FILE(fname) \
 	do {\
 		f = debugfs_create_u32(#fname, S_IRUGO | S_IWUSR, \
-			wmarkinfo->debugdir, &wmarkinfo->p_##fname); \
+			wmarkinfo->debugdir, &wmarkinfo->core.p_##fname); \
 		if (NULL == f) { \
 			pr_warn("cannot create debug entry " #fname "\n"); \
 			return; \
@@ -262,12 +136,8 @@ static int devfreq_watermark_start(struct devfreq *df)
 		return -ENOMEM;
 
 	df->data = (void *)wmarkinfo;
-	wmarkinfo->freqlist = df->profile->freq_table;
-	wmarkinfo->freq_count = df->profile->max_state;
-	wmarkinfo->p_load_target = 700;
-	wmarkinfo->p_load_max = 900;
-	wmarkinfo->p_smooth = 10;
-	wmarkinfo->p_block_window = 50000;
+	wmark_core_init(&wmarkinfo->core, df->profile->freq_table,
+			df->profile->max_state);
 	wmarkinfo->df = df;
 	wmarkinfo->pdev = pdev;
 
@@ -296,7 +166,7 @@ static int devfreq_watermark_event_handler(struct devfreq *df,
 
 		/* initialize average target freq */
 		wmarkinfo = df->data;
-		wmarkinfo->average_target_freq = dev_stat.current_frequency;
+		wmark_core_reset(&wmarkinfo->core, dev_stat.current_frequency);
 
 		update_watermarks(df, dev_stat.current_frequency,
 					dev_stat.current_frequency);
@@ -317,7 +187,7 @@ static int devfreq_watermark_event_handler(struct devfreq *df,
 
 		/* reset average target freq to current freq */
 		wmarkinfo = df->data;
-		wmarkinfo->average_target_freq = dev_stat.current_frequency;
+		wmark_core_reset(&wmarkinfo->core, dev_stat.current_frequency);
 
 		update_watermarks(df, dev_stat.current_frequency,
 					dev_stat.current_frequency);
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GOVERNOR_WMARK_ACTIVE_H
+#define __GOVERNOR_WMARK_ACTIVE_H
+
+#include "governor_core_types.h"
+
+/* watermark values that disable the low and the high interrupt */
+#define WMARK_CORE_LOW_DISABLED		0
+#define WMARK_CORE_HIGH_DISABLED	1000
+
+/*
+ * Frequency selection state of the wmark_active governor. Like the pod
+ * core, it only needs governor_core_types.h, so the governor simulator or
+ * a user-space build can run it without a devfreq device.
+ */
+struct wmark_core {
+	/* probed from the devfreq */
+	unsigned long		*freqlist;
+	int			freq_count;
+
+	/* algorithm parameters */
+	unsigned int		p_block_window;
+	unsigned int		p_load_target;
+	unsigned int		p_load_max;
+	unsigned int		p_smooth;
+
+	/* used for ensuring that we do not update frequency too often */
+	ktime_t			last_frequency_update;
+
+	/* variable for keeping the average frequency request */
+	unsigned long long	average_target_freq;
+};
+
+static inline unsigned long wmark_core_freqlist_up(struct wmark_core *core,
+						   unsigned long curr_freq)
+{
+	int i, pos;
+
+	for (i = 0; i < core->freq_count; i++)
+		if (core->freqlist[i] > curr_freq)
+			break;
+
+	pos = min(core->freq_count - 1, i);
+
+	return core->freqlist[pos];
+}
+
+static inline unsigned long wmark_core_freqlist_down(struct wmark_core *core,
+						     unsigned long curr_freq)
+{
+	int i, pos;
+
+	for (i = core->freq_count - 1; i >= 0; i--)
+		if (core->freqlist[i] < curr_freq)
+			break;
+
+	pos = max(0, i);
+	return core->freqlist[pos];
+}
+
+static inline unsigned long wmark_core_freqlist_round(struct wmark_core *core,
+						      unsigned long freq)
+{
+	int i, pos;
+
+	for (i = 0; i < core->freq_count; i++)
+		if (core->freqlist[i] >= freq)
+			break;
+
+	pos = min(core->freq_count - 1, i);
+	return core->freqlist[pos];
+}
+
+static inline void wmark_core_init(struct wmark_core *core,
+				   unsigned long *freqlist, int freq_count)
+{
+	memset(core, 0, sizeof(*core));
+	core->freqlist = freqlist;
+	core->freq_count = freq_count;
+	core->p_load_target = 700;
+	core->p_load_max = 900;
+	core->p_smooth = 10;
+	core->p_block_window = 50000;
+}
+
+static inline void wmark_core_reset(struct wmark_core *core,
+				    unsigned long current_frequency)
+{
+	core->average_target_freq = current_frequency;
+}
+
+ /*
+  * wmark_core_watermarks - Re-estimate low and high watermarks
+  *     @core: governor state
+  *     @current_frequency: current frequency of the device
+  *     @ideal_frequency: frequency that would change load to target load.
+  *     @low_wmark, @high_wmark: the new watermarks
+  *
+  * Target is to ensure that the interrupts are triggered whenever the load
+  * changes enough to make a change to the ideal frequency (given the DVFS
+  * table).
+  */
+
+static inline void wmark_core_watermarks(struct wmark_core *core,
+					 unsigned long current_frequency,
+					 unsigned long ideal_frequency,
+					 unsigned long *low_wmark,
+					 unsigned long *high_wmark)
+{
+	unsigned long long relation = 0, next_freq = 0;
+	unsigned long long current_frequency_khz = current_frequency / 1000;
+
+	if (ideal_frequency == core->freqlist[0]) {
+		/* disable the low watermark if we are at lowest clock */
+		*low_wmark = WMARK_CORE_LOW_DISABLED;
+	} else {
+		/* calculate the low threshold; what is the load value
+		 * at which we would go into lower frequency given the
+		 * that we are running at the new frequency? */
+		next_freq = wmark_core_freqlist_down(core, ideal_frequency);
+		relation = ((next_freq / current_frequency_khz) *
+			core->p_load_target) / 1000;
+		*low_wmark = relation;
+	}
+
+	if (ideal_frequency == core->freqlist[core->freq_count - 1]) {
+		/* disable the high watermark if we are at highest clock */
+		*high_wmark = WMARK_CORE_HIGH_DISABLED;
+	} else {
+		/* calculate the high threshold; what is the load value
+		 * at which we would go into highest frequency given the
+		 * that we are running at the new frequency? */
+		next_freq = wmark_core_freqlist_up(core, ideal_frequency);
+		relation = ((next_freq / current_frequency_khz) *
+			core->p_load_target) / 1000;
+		relation = min((unsigned long long)core->p_load_max,
+			       relation);
+		*high_wmark = relation;
+	}
+}
+
+/*
+ * wmark_core_target_freq - pick the next frequency for the given busy and
+ * total time. total_time must not be zero. The frequency that would bring
+ * the load to the target is returned in ideal_freq.
+ */
+static inline unsigned long wmark_core_target_freq(struct wmark_core *core,
+						   ktime_t now,
+						   unsigned long current_frequency,
+						   unsigned long busy_time,
+						   unsigned long total_time,
+						   unsigned long *ideal_freq)
+{
+	unsigned long long load, relation, ideal;
+	s64 dt = ktime_us_delta(now, core->last_frequency_update);
+	unsigned long freq;
+
+	/* calculate first load and relation load/p_load_target */
+	load = ((unsigned long long)busy_time * 1000) / total_time;
+
+	/* if we cross load max...  */
+	if (load >= core->p_load_max) {
+		/* we go directly to the highest frequency. depending
+		 * on frequency table we might never go higher than
+		 * the current frequency (i.e. load should be over 100%
+		 * to make relation push to the next frequency). */
+		ideal = core->freqlist[core->freq_count - 1];
+	} else {
+		/* otherwise, based on relation between current load and
+		 * load target we calculate the "ideal" frequency
+		 * where we would be just at the target */
+		relation = (load * 1000) / core->p_load_target;
+		ideal = relation * (current_frequency / 1000);
+
+		/* round this frequency */
+		ideal = wmark_core_freqlist_round(core, ideal);
+	}
+	*ideal_freq = ideal;
+
+	/* update average target frequency */
+	core->average_target_freq =
+		(core->p_smooth * core->average_target_freq +
+		 ideal) / (core->p_smooth + 1);
+
+	/* do not scale too often */
+	if (dt < core->p_block_window)
+		return current_frequency;
+
+	/* update the frequency */
+	freq = wmark_core_freqlist_round(core, core->average_target_freq);
+
+	/* enable hysteresis if frequency is updated */
+	if (freq != current_frequency)
+		core->last_frequency_update = now;
+
+	return freq;
+}
+
+#endif
@@ -0,0 +1,424 @@
+/* Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* NVS = NVidia Sensor framework */
+/* See nvs_iio.c and nvs.h for documentation */
+/* Software simulated FIFO accelerometer for exercising the NVS batch path at
+ * high rates without hardware.
+ * Samples are produced on a virtual timeline at the batch period.  An hrtimer
+ * plays the FIFO watermark interrupt and a work item drains the FIFO and
+ * hands it to handler_batch.  If the drain is late (see the stall_us device
+ * attribute) and more samples than the FIFO size accumulated, the oldest are
+ * dropped and reported as lost, like a FIFO in stream mode.
+ * Data is x = sample sequence bits 15:0, y = bits 31:16, z = 1g so that
+ * user space can check for gaps and reordering.
+ */
+
+
+#include <linux/delay.h>
+#include <linux/hrtimer.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/nvs.h>
+#include <linux/of.h>
+#include <linux/platform_device.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+
+#define NVS_SIM_NAME			"nvs-sim"
+#define NVS_SIM_AXIS_N			(3)
+#define NVS_SIM_1G			(16384)
+#define NVS_SIM_DELAY_US_MIN		(125)
+#define NVS_SIM_DELAY_US_DFLT		(10000)
+
+static unsigned int fifo_size = 1024;
+module_param(fifo_size, uint, 0444);
+MODULE_PARM_DESC(fifo_size, "simulated hardware FIFO size in samples");
+
+static bool sim_dev = true;
+module_param(sim_dev, bool, 0444);
+MODULE_PARM_DESC(sim_dev, "register a device without a device tree node");
+
+struct nvs_sim_state {
+	struct device *dev;
+	struct nvs_fn_if *nvs;
+	void *nvs_st;
+	struct sensor_cfg cfg;
+	struct mutex lock;
+	struct hrtimer timer;
+	struct work_struct work;
+	unsigned int sts;
+	unsigned int errs;
+	unsigned int enabled;
+	unsigned int period_us;
+	unsigned int timeout_us;
+	unsigned int wm;		/* FIFO watermark in samples */
+	unsigned int fifo_n;		/* FIFO size in samples */
+	unsigned int stall_us;		/* injected drain latency */
+	u64 seq;			/* sequence number of next sample */
+	s64 ts_start;			/* timestamp of sample 0 */
+	u64 drains;
+	u64 lost;
+	s16 *fifo;
+};
+
+static s64 nvs_sim_period_ns(struct nvs_sim_state *st)
+{
+	return (s64)st->period_us * NSEC_PER_USEC;
+}
+
+static void nvs_sim_wm(struct nvs_sim_state *st)
+{
+	unsigned int wm = 1;
+
+	if (st->timeout_us)
+		wm = st->timeout_us / st->period_us;
+	st->wm = clamp_t(unsigned int, wm, 1, st->fifo_n);
+}
+
+static void nvs_sim_start(struct nvs_sim_state *st)
+{
+	ktime_t interval = ns_to_ktime(nvs_sim_period_ns(st) * st->wm);
+
+	st->seq = 0;
+	st->ts_start = nvs_timestamp();
+	hrtimer_start(&st->timer, interval, HRTIMER_MODE_REL);
+}
+
+static enum hrtimer_restart nvs_sim_timer(struct hrtimer *timer)
+{
+	struct nvs_sim_state *st = container_of(timer, struct nvs_sim_state,
+						timer);
+
+	/* the watermark "interrupt" */
+	queue_work(system_highpri_wq, &st->work);
+	hrtimer_forward_now(timer,
+			    ns_to_ktime(nvs_sim_period_ns(st) * st->wm));
+	return HRTIMER_RESTART;
+}
+
+static unsigned int nvs_sim_fill(struct nvs_sim_state *st, unsigned int n)
+{
+	s16 axis[NVS_SIM_AXIS_N];
+	unsigned int i;
+	unsigned int j;
+	unsigned int k = 0;
+	u64 seq;
+
+	for (i = 0; i < n; i++) {
+		seq = st->seq + i;
+		axis[0] = (s16)(seq & 0xFFFF);
+		axis[1] = (s16)((seq >> 16) & 0xFFFF);
+		axis[2] = NVS_SIM_1G;
+		/* only the enabled channels are packed */
+		for (j = 0; j < NVS_SIM_AXIS_N; j++) {
+			if (st->enabled & (1 << j))
+				st->fifo[k++] = axis[j];
+		}
+	}
+	return k;
+}
+
+static void nvs_sim_work(struct work_struct *work)
+{
+	struct nvs_sim_state *st = container_of(work, struct nvs_sim_state,
+						work);
+	unsigned int lost = 0;
+	unsigned int n;
+	s64 period;
+	s64 ts;
+	u64 avail;
+
+	if (st->stall_us)
+		usleep_range(st->stall_us, st->stall_us + (st->stall_us >> 3));
+	mutex_lock(&st->lock);
+	if (!st->enabled) {
+		mutex_unlock(&st->lock);
+		return;
+	}
+
+	period = nvs_sim_period_ns(st);
+	ts = nvs_timestamp() - st->ts_start;
+	if (ts < 0) {
+		mutex_unlock(&st->lock);
+		return;
+	}
+
+	avail = div64_u64((u64)ts, (u64)period) + 1 - st->seq;
+	if (avail > st->fifo_n) {
+		/* stream mode FIFO overwrites the oldest samples */
+		lost = avail - st->fifo_n;
+		avail = st->fifo_n;
+		st->seq += lost;
+		st->lost += lost;
+	}
+	n = avail;
+	if (n) {
+		nvs_sim_fill(st, n);
+		/* timestamp of the newest sample */
+		ts = st->ts_start + (s64)(st->seq + n - 1) * period;
+		st->nvs->handler_batch(st->nvs_st, st->fifo, n, ts, lost);
+		st->seq += n;
+		st->drains++;
+	}
+	mutex_unlock(&st->lock);
+}
+
+static void nvs_sim_stop(struct nvs_sim_state *st)
+{
+	hrtimer_cancel(&st->timer);
+	cancel_work_sync(&st->work);
+}
+
+static int nvs_sim_enable(void *client, int snsr_id, int enable)
+{
+	struct nvs_sim_state *st = (struct nvs_sim_state *)client;
+	unsigned int enabled;
+
+	if (enable < 0)
+		return st->enabled;
+
+	mutex_lock(&st->lock);
+	enabled = st->enabled;
+	st->enabled = enable & ((1 << NVS_SIM_AXIS_N) - 1);
+	mutex_unlock(&st->lock);
+	if (enabled)
+		nvs_sim_stop(st);
+	if (st->enabled)
+		nvs_sim_start(st);
+	return 0;
+}
+
+static int nvs_sim_batch(void *client, int snsr_id, int flags,
+			 unsigned int period_us, unsigned int timeout_us)
+{
+	struct nvs_sim_state *st = (struct nvs_sim_state *)client;
+
+	if (period_us < st->cfg.delay_us_min)
+		period_us = st->cfg.delay_us_min;
+	if (period_us > st->cfg.delay_us_max)
+		period_us = st->cfg.delay_us_max;
+	if (st->enabled)
+		nvs_sim_stop(st);
+	mutex_lock(&st->lock);
+	st->period_us = period_us;
+	st->timeout_us = timeout_us;
+	nvs_sim_wm(st);
+	mutex_unlock(&st->lock);
+	if (st->enabled)
+		nvs_sim_start(st);
+	return 0;
+}
+
+static int nvs_sim_batch_read(void *client, int snsr_id,
+			      unsigned int *period_us, unsigned int *timeout_us)
+{
+	struct nvs_sim_state *st = (struct nvs_sim_state *)client;
+
+	if (period_us)
+		*period_us = st->period_us;
+	if (timeout_us)
+		*timeout_us = st->timeout_us;
+	return 0;
+}
+
+static int nvs_sim_nvs_read(void *client, int snsr_id, char *buf)
+{
+	struct nvs_sim_state *st = (struct nvs_sim_state *)client;
+	ssize_t t;
+
+	t = snprintf(buf, PAGE_SIZE, "period_us=%u\n", st->period_us);
+	t += snprintf(buf + t, PAGE_SIZE - t, "watermark=%u fifo=%u\n",
+		      st->wm, st->fifo_n);
+	t += snprintf(buf + t, PAGE_SIZE - t, "stall_us=%u\n", st->stall_us);
+	t += snprintf(buf + t, PAGE_SIZE - t, "samples=%llu\n", st->seq);
+	t += snprintf(buf + t, PAGE_SIZE - t, "drains=%llu\n", st->drains);
+	t += snprintf(buf + t, PAGE_SIZE - t, "lost=%llu\n", st->lost);
+	return t;
+}
+
+static ssize_t nvs_sim_stall_us_show(struct device *dev,
+				     struct device_attribute *attr, char *buf)
+{
+	struct nvs_sim_state *st = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", st->stall_us);
+}
+
+static ssize_t nvs_sim_stall_us_store(struct device *dev,
+				      struct device_attribute *attr,
+				      const char *buf, size_t count)
+{
+	struct nvs_sim_state *st = dev_get_drvdata(dev);
+	unsigned int stall_us;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &stall_us);
+	if (ret)
+		return -EINVAL;
+
+	st->stall_us = stall_us;
+	return count;
+}
+
+static DEVICE_ATTR(stall_us, S_IRUGO | S_IWUSR | S_IWGRP,
+		   nvs_sim_stall_us_show, nvs_sim_stall_us_store);
+
+static struct sensor_cfg nvs_sim_cfg_dflt = {
+	.name			= "accelerometer",
+	.ch_n			= NVS_SIM_AXIS_N,
+	.ch_sz			= -2,
+	.part			= "nvs_sim",
+	.vendor			= "NVIDIA",
+	.version		= 1,
+	.max_range		= {
+		.ival		= 19,
+		.fval		= 613300,
+	},
+	.resolution		= {
+		.ival		= 0,
+		.fval		= 598550,
+	},
+	.scale			= {
+		.ival		= 0,
+		.fval		= 598550,
+	},
+	.delay_us_min		= NVS_SIM_DELAY_US_MIN,
+	.delay_us_max		= 1000000,
+	.float_significance	= NVS_FLOAT_NANO,
+};
+
+static struct nvs_fn_dev nvs_sim_fn_dev = {
+	.enable			= nvs_sim_enable,
+	.batch			= nvs_sim_batch,
+	.batch_read		= nvs_sim_batch_read,
+	.nvs_read		= nvs_sim_nvs_read,
+};
+
+static int nvs_sim_probe(struct platform_device *pdev)
+{
+	struct nvs_sim_state *st;
+	int ret;
+
+	st = devm_kzalloc(&pdev->dev, sizeof(*st), GFP_KERNEL);
+	if (!st)
+		return -ENOMEM;
+
+	st->dev = &pdev->dev;
+	st->fifo_n = fifo_size ? fifo_size : 1;
+	st->fifo = devm_kcalloc(&pdev->dev, st->fifo_n * NVS_SIM_AXIS_N,
+				sizeof(*st->fifo), GFP_KERNEL);
+	if (!st->fifo)
+		return -ENOMEM;
+
+	memcpy(&st->cfg, &nvs_sim_cfg_dflt, sizeof(st->cfg));
+	st->cfg.fifo_max_evnt_cnt = st->fifo_n;
+	st->cfg.fifo_rsrv_evnt_cnt = st->fifo_n;
+	st->period_us = NVS_SIM_DELAY_US_DFLT;
+	nvs_sim_wm(st);
+	mutex_init(&st->lock);
+	hrtimer_init(&st->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	st->timer.function = nvs_sim_timer;
+	INIT_WORK(&st->work, nvs_sim_work);
+	platform_set_drvdata(pdev, st);
+	if (pdev->dev.of_node) {
+		ret = nvs_of_dt(pdev->dev.of_node, &st->cfg, NULL);
+		if (ret == -ENODEV)
+			return ret;
+	}
+
+	nvs_sim_fn_dev.sts = &st->sts;
+	nvs_sim_fn_dev.errs = &st->errs;
+	st->nvs = nvs_iio();
+	if (!st->nvs || !st->nvs->handler_batch)
+		return -ENODEV;
+
+	ret = st->nvs->probe(&st->nvs_st, st, &pdev->dev,
+			     &nvs_sim_fn_dev, &st->cfg);
+	if (ret)
+		return ret;
+
+	ret = device_create_file(&pdev->dev, &dev_attr_stall_us);
+	if (ret) {
+		st->nvs->remove(st->nvs_st);
+		return ret;
+	}
+
+	dev_info(&pdev->dev, "%s fifo=%u\n", __func__, st->fifo_n);
+	return 0;
+}
+
+static int nvs_sim_remove(struct platform_device *pdev)
+{
+	struct nvs_sim_state *st = platform_get_drvdata(pdev);
+
+	device_remove_file(&pdev->dev, &dev_attr_stall_us);
+	mutex_lock(&st->lock);
+	st->enabled = 0;
+	mutex_unlock(&st->lock);
+	nvs_sim_stop(st);
+	st->nvs->remove(st->nvs_st);
+	return 0;
+}
+
+static const struct of_device_id nvs_sim_of_match[] = {
+	{ .compatible = "nvidia,nvs-sim", },
+	{}
+};
+
+MODULE_DEVICE_TABLE(of, nvs_sim_of_match);
+
+static struct platform_driver nvs_sim_driver = {
+	.driver				= {
+		.name			= NVS_SIM_NAME,
+		.of_match_table		= of_match_ptr(nvs_sim_of_match),
+	},
+	.probe				= nvs_sim_probe,
+	.remove				= nvs_sim_remove,
+};
+
+static struct platform_device *nvs_sim_pdev;
+
+static int __init nvs_sim_init(void)
+{
+	int ret;
+
+	ret = platform_driver_register(&nvs_sim_driver);
+	if (ret || !sim_dev)
+		return ret;
+
+	nvs_sim_pdev = platform_device_register_simple(NVS_SIM_NAME, -1,
+						       NULL, 0);
+	if (IS_ERR(nvs_sim_pdev)) {
+		platform_driver_unregister(&nvs_sim_driver);
+		return PTR_ERR(nvs_sim_pdev);
+	}
+
+	return 0;
+}
+
+static void __exit nvs_sim_exit(void)
+{
+	if (nvs_sim_pdev)
+		platform_device_unregister(nvs_sim_pdev);
+	platform_driver_unregister(&nvs_sim_driver);
+}
+
+module_init(nvs_sim_init);
+module_exit(nvs_sim_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("NVidia NVS simulated FIFO sensor driver");
+MODULE_AUTHOR("NVIDIA Corporation");
@@ -184,6 +184,9 @@
 #define BMI_HW_ACC			(0)
 #define BMI_HW_GYR			(1)
 #define BMI_HW_N			(2)
+#define BMI_FRAME_N			(6)
+/* frames staged per sensor before pushing them with handler_batch */
+#define BMI_BATCH_N			(64)
 
 enum BMI_INF {
 	BMI_INF_VER = 0,
@@ -463,7 +466,7 @@ static struct bmi_hw bmi_hws[] = {
 		.rr			= bmi_rr_acc,
 		.rr_0n			= ARRAY_SIZE(bmi_rr_acc) - 1,
 		.buf_i			= (BMI_REG_DATA_14 - BMI_REG_DATA_0),
-		.fifo_push_n		= 6,
+		.fifo_push_n		= BMI_FRAME_N,
 		.fifo_hdr_mask		= 0x04,
 		.fn_enable		= &bmi_acc_enable,
 		.fn_batch		= &bmi_acc_batch,
@@ -481,7 +484,7 @@ static struct bmi_hw bmi_hws[] = {
 		.rr			= bmi_rr_gyr,
 		.rr_0n			= ARRAY_SIZE(bmi_rr_gyr) - 1,
 		.buf_i			= (BMI_REG_DATA_8 - BMI_REG_DATA_0),
-		.fifo_push_n		= 6,
+		.fifo_push_n		= BMI_FRAME_N,
 		.fifo_hdr_mask		= 0x08,
 		.fn_enable		= &bmi_gyr_enable,
 		.fn_batch		= &bmi_gyr_batch,
@@ -497,7 +500,11 @@ struct bmi_snsr {
 	unsigned int period_us;
 	unsigned int timeout_us;
 	unsigned int usr_cfg;
+	unsigned int batch_n;		/* staged frame count */
+	unsigned int batch_lost;	/* frames skipped before the batch */
+	s64 batch_ts;			/* timestamp of newest staged frame */
 	bool flush;
+	u8 batch[BMI_BATCH_N * BMI_FRAME_N]; /* staged FIFO frames */
 };
 
 struct bmi_state {
@@ -1097,14 +1104,72 @@ static void bmi_push_flush(struct bmi_state *st)
 	}
 }
 
+static void bmi_batch_push(struct bmi_state *st, unsigned int i)
+{
+	struct bmi_snsr *snsr = &st->snsrs[i];
+
+	if (!snsr->batch_n)
+		return;
+
+	st->nvs->handler_batch(snsr->nvs_st, snsr->batch, snsr->batch_n,
+			       snsr->batch_ts, snsr->batch_lost);
+	snsr->batch_n = 0;
+	snsr->batch_lost = 0;
+}
+
+static void bmi_batch_flush(struct bmi_state *st)
+{
+	unsigned int i;
+
+	if (!st->nvs->handler_batch)
+		return;
+
+	for (i = 0; i < st->hw_n; i++)
+		bmi_batch_push(st, i);
+}
+
+static void bmi_batch_lost(struct bmi_state *st, unsigned int n)
+{
+	unsigned int i;
+
+	if (!st->nvs->handler_batch)
+		return;
+
+	for (i = 0; i < st->hw_n; i++) {
+		if (st->enabled & (1 << i)) {
+			/* the skipped frames are older than the next batch */
+			bmi_batch_push(st, i);
+			st->snsrs[i].batch_lost += n;
+		}
+	}
+}
+
+static void bmi_batch_add(struct bmi_state *st, unsigned int i,
+			  unsigned int hw, s64 ts)
+{
+	struct bmi_snsr *snsr = &st->snsrs[i];
+
+	if (snsr->batch_n >= BMI_BATCH_N)
+		bmi_batch_push(st, i);
+	memcpy(&snsr->batch[snsr->batch_n * BMI_FRAME_N],
+	       &st->buf[st->buf_i], bmi_hws[hw].fifo_push_n);
+	snsr->batch_n++;
+	snsr->batch_ts = ts;
+}
+
 static int bmi_push(struct bmi_state *st, s64 ts, unsigned int hw)
 {
 	unsigned int i;
 	unsigned int n;
 
 	i = st->hw2ids[hw];
-	if (ts > 0)
-		st->nvs->handler(st->snsrs[i].nvs_st, &st->buf[st->buf_i], ts);
+	if (ts > 0) {
+		if (st->nvs->handler_batch)
+			bmi_batch_add(st, i, hw, ts);
+		else
+			st->nvs->handler(st->snsrs[i].nvs_st,
+					 &st->buf[st->buf_i], ts);
+	}
 	if (st->sts & BMI_STS_SPEW_FIFO) {
 		for (n = 0; n < bmi_hws[hw].fifo_push_n; n++) {
 			dev_info(&st->i2c->dev,
@@ -1236,6 +1301,7 @@ static int bmi_frame_control(struct bmi_state *st, u16 buf_n)
 		if (st->lost_frame_n < i)
 			/* rollover */
 			st->lost_frame_n = -1;
+		bmi_batch_lost(st, n);
 		/* update timestamp to include lost frames */
 		if (st->ts_odr)
 			ns = st->ts_odr;
@@ -1343,7 +1409,7 @@ static int bmi_frame_control(struct bmi_state *st, u16 buf_n)
 	return -1;
 }
 
-static int bmi_read(struct bmi_state *st)
+static int bmi_read_fifo(struct bmi_state *st)
 {
 	u8 hdr;
 	u16 buf_n;
@@ -1408,6 +1474,16 @@ static int bmi_read(struct bmi_state *st)
 	return 0;
 }
 
+static int bmi_read(struct bmi_state *st)
+{
+	int ret;
+
+	ret = bmi_read_fifo(st);
+	/* one handler_batch call per sensor for the whole drain */
+	bmi_batch_flush(st);
+	return ret;
+}
+
 static irqreturn_t bmi_irq_thread(int irq, void *dev_id)
 {
 	struct bmi_state *st = (struct bmi_state *)dev_id;
@@ -1537,6 +1613,8 @@ static int bmi_enable(void *client, int snsr_id, int enable)
 
 	if (enable) {
 		enable = st->enabled | (1 << snsr_id);
+		/* don't report frames skipped while the sensor was off */
+		st->snsrs[snsr_id].batch_lost = 0;
 		ret = bmi_pm(st, true);
 		if (ret < 0)
 			return ret;
@@ -47,6 +47,7 @@
 #include "vivid-vbi-out.h"
 #include "vivid-osd.h"
 #include "vivid-ctrls.h"
+#include "vivid-fast-cap.h"
 
 #define VIVID_MODULE_NAME "tegra-vivid"
 
@@ -156,6 +157,15 @@ static bool no_error_inj;
 module_param(no_error_inj, bool, 0444);
 MODULE_PARM_DESC(no_error_inj, " if set disable the error injecting controls");
 
+static bool fast_cap[VIVID_MAX_DEVS];
+module_param_array(fast_cap, bool, NULL, 0444);
+MODULE_PARM_DESC(fast_cap, " if set, capture buffers are filled from pre-rendered frames by\n"
+			   "\t\t    a worker pool shared by all instances, for load testing");
+
+static unsigned fast_cap_workers;
+module_param(fast_cap_workers, uint, 0444);
+MODULE_PARM_DESC(fast_cap_workers, " maximum number of concurrent fast capture workers, 0 is the workqueue default");
+
 static struct vivid_dev *vivid_devs[VIVID_MAX_DEVS];
 
 const struct v4l2_rect vivid_min_rect = {
@@ -649,6 +659,7 @@ static void vivid_dev_release(struct v4l2_device *v4l2_dev)
 	vfree(dev->bitmap_cap);
 	vfree(dev->bitmap_out);
 	tpg_free(&dev->tpg);
+	vivid_fast_cap_free(dev);
 	kfree(dev->query_dv_timings_qmenu);
 	kfree(dev);
 }
@@ -719,6 +730,9 @@ static int vivid_create_instance(struct platform_device *pdev, int inst)
 
 	/* start detecting feature set */
 
+	dev->fast_cap = fast_cap[inst];
+	init_waitqueue_head(&dev->fast_wait);
+
 	/* do we use single- or multi-planar? */
 	dev->multiplanar = multiplanar[inst] > 1;
 	v4l2_info(&dev->v4l2_dev, "using %splanar format API\n",
@@ -1358,6 +1372,17 @@ static int vivid_probe(struct platform_device *pdev)
 
 	n_devs = clamp_t(unsigned, n_devs, 1, VIVID_MAX_DEVS);
 
+	for (i = 0; i < n_devs; i++) {
+		if (!fast_cap[i])
+			continue;
+		ret = vivid_fast_cap_init(fast_cap_workers);
+		if (ret) {
+			pr_err("vivid: could not create fast capture workqueue\n");
+			return ret;
+		}
+		break;
+	}
+
 	for (i = 0; i < n_devs; i++) {
 		ret = vivid_create_instance(pdev, i);
 		if (ret) {
@@ -1370,6 +1395,7 @@ static int vivid_probe(struct platform_device *pdev)
 
 	if (ret < 0) {
 		pr_err("vivid: error %d while loading driver\n", ret);
+		vivid_fast_cap_exit();
 		return ret;
 	}
 
@@ -1434,6 +1460,7 @@ static int vivid_remove(struct platform_device *pdev)
 		v4l2_device_put(&dev->v4l2_dev);
 		vivid_devs[i] = NULL;
 	}
+	vivid_fast_cap_exit();
 	return 0;
 }
 
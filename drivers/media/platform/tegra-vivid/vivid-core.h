@@ -21,6 +21,8 @@
 #define _VIVID_CORE_H_
 
 #include <linux/fb.h>
+#include <linux/workqueue.h>
+#include <linux/wait.h>
 #include <linux/version.h>
 #include <media/videobuf2-v4l2.h>
 #include <media/v4l2-device.h>
@@ -58,6 +60,8 @@
 /* The maximum image width/height are set to 4K DMT */
 #define MAX_WIDTH  4096
 #define MAX_HEIGHT 2160
+/* The number of pre-rendered frames cycled through in fast capture mode */
+#define VIVID_FAST_CAP_TILES 4
 /* The minimum image width/height */
 #define MIN_WIDTH  16
 #define MIN_HEIGHT 16
@@ -103,6 +107,11 @@ struct vivid_buffer {
 	/* common v4l buffer stuff -- must be first */
 	struct vb2_v4l2_buffer vb;
 	struct list_head	list;
+
+	/* fast capture mode */
+	struct work_struct	fast_work;
+	unsigned		fast_tile;
+	bool			fast_error;
 };
 
 enum vivid_input {
@@ -411,6 +420,19 @@ struct vivid_dev {
 	u32				embedded_data_height;
 	u32				fmt_out_metadata_height;
 
+	/* fast capture mode, see vivid-fast-cap.c */
+	bool				fast_cap;
+	void				*fast_tiles[VIVID_FAST_CAP_TILES][TPG_MAX_PLANES];
+	unsigned			fast_tile_size[TPG_MAX_PLANES];
+	unsigned			fast_tile_idx;
+	enum tpg_pattern		fast_tile_pattern;
+	atomic_t			fast_pending;
+	wait_queue_head_t		fast_wait;
+	u64				fast_start_ns;
+	atomic64_t			fast_frames;
+	atomic64_t			fast_bytes;
+	atomic64_t			fast_fill_ns;
+
 	/* added for NV sensor emulation */
 	struct sensor_properties	sensor_props;
 
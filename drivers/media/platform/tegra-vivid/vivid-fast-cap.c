@@ -0,0 +1,257 @@
+/*
+ * vivid-fast-cap.c - multi-stream fast video capture support functions.
+ *
+ * Copyright (c) 2019, NVIDIA CORPORATION, All rights reserved.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * In fast capture mode the per-device capture thread only keeps time and
+ * hands buffers over to a workqueue shared by all instances. A small set of
+ * test pattern frames is rendered once when streaming starts, and each
+ * capture buffer is filled with a plain memcpy() of the next frame in that
+ * set. This allows many instances to stream at high resolution and frame
+ * rate, so the capture pipeline behind vivid can be load tested with a
+ * realistic aggregate bandwidth.
+ *
+ * The OSD text, video looping and the capture overlay are not supported in
+ * this mode.
+ */
+
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#include <linux/wait.h>
+#include <linux/math64.h>
+
+#include "vivid-core.h"
+#include "vivid-fast-cap.h"
+
+static struct workqueue_struct *vivid_fast_wq;
+
+int vivid_fast_cap_init(unsigned max_workers)
+{
+	vivid_fast_wq = alloc_workqueue("vivid-fast-cap",
+			WQ_UNBOUND | WQ_HIGHPRI | WQ_FREEZABLE, max_workers);
+	if (!vivid_fast_wq)
+		return -ENOMEM;
+	return 0;
+}
+
+void vivid_fast_cap_exit(void)
+{
+	if (vivid_fast_wq) {
+		destroy_workqueue(vivid_fast_wq);
+		vivid_fast_wq = NULL;
+	}
+}
+
+/*
+ * Size of the data copied into vb2 plane b. If all planes share a single
+ * buffer they are stored back to back, just like plane_vaddr() expects.
+ */
+static unsigned vivid_fast_cap_chunk_size(const struct tpg_data *tpg,
+					  unsigned b)
+{
+	unsigned size = 0;
+	unsigned p;
+
+	if (tpg_g_buffers(tpg) > 1)
+		return tpg_calc_plane_size(tpg, b);
+	if (b)
+		return 0;
+	for (p = 0; p < tpg_g_planes(tpg); p++)
+		size += tpg_calc_plane_size(tpg, p);
+	return size;
+}
+
+void vivid_fast_cap_free(struct vivid_dev *dev)
+{
+	unsigned t, b;
+
+	for (b = 0; b < TPG_MAX_PLANES; b++) {
+		for (t = 0; t < VIVID_FAST_CAP_TILES; t++) {
+			vfree(dev->fast_tiles[t][b]);
+			dev->fast_tiles[t][b] = NULL;
+		}
+		dev->fast_tile_size[b] = 0;
+	}
+}
+
+static int vivid_fast_cap_render(struct vivid_dev *dev)
+{
+	struct tpg_data *tpg = &dev->tpg;
+	v4l2_std_id std = vivid_is_sdtv_cap(dev) ? dev->std_cap : 0;
+	unsigned t, b, p;
+
+	for (b = 0; b < TPG_MAX_PLANES; b++) {
+		unsigned size = vivid_fast_cap_chunk_size(tpg, b);
+
+		if (size == dev->fast_tile_size[b])
+			continue;
+		for (t = 0; t < VIVID_FAST_CAP_TILES; t++) {
+			vfree(dev->fast_tiles[t][b]);
+			dev->fast_tiles[t][b] = NULL;
+		}
+		dev->fast_tile_size[b] = 0;
+		if (!size)
+			continue;
+		for (t = 0; t < VIVID_FAST_CAP_TILES; t++) {
+			dev->fast_tiles[t][b] = vzalloc(size);
+			if (!dev->fast_tiles[t][b])
+				goto nomem;
+		}
+		dev->fast_tile_size[b] = size;
+	}
+
+	tpg_s_field(tpg, dev->field_cap == V4L2_FIELD_ALTERNATE ?
+		    V4L2_FIELD_TOP : dev->field_cap, false);
+	tpg_s_perc_fill_blank(tpg, false);
+
+	for (t = 0; t < VIVID_FAST_CAP_TILES; t++) {
+		u8 *vbuf = dev->fast_tiles[t][0];
+
+		for (p = 0; p < tpg_g_planes(tpg); p++) {
+			if (tpg_g_buffers(tpg) > 1)
+				vbuf = dev->fast_tiles[t][p];
+			if (!dev->fmt_cap->is_metadata[p])
+				tpg_fill_plane_buffer(tpg, std, p, vbuf);
+			if (tpg_g_buffers(tpg) == 1)
+				vbuf += tpg_calc_plane_size(tpg, p);
+		}
+		tpg_update_mv_count(tpg, dev->field_cap == V4L2_FIELD_NONE ||
+					 dev->field_cap == V4L2_FIELD_ALTERNATE);
+	}
+	dev->fast_tile_pattern = tpg->pattern;
+	return 0;
+
+nomem:
+	vivid_fast_cap_free(dev);
+	return -ENOMEM;
+}
+
+static void vivid_fast_cap_work(struct work_struct *work)
+{
+	struct vivid_buffer *buf =
+		container_of(work, struct vivid_buffer, fast_work);
+	struct vb2_buffer *vb = &buf->vb.vb2_buf;
+	struct vivid_dev *dev = vb2_get_drv_priv(vb->vb2_queue);
+	u64 start = ktime_get_ns();
+	unsigned long bytes = 0;
+	unsigned b;
+
+	for (b = 0; b < vb->num_planes && b < TPG_MAX_PLANES; b++) {
+		const void *tile = dev->fast_tiles[buf->fast_tile][b];
+		unsigned long size;
+
+		if (!tile)
+			continue;
+		size = min_t(unsigned long, dev->fast_tile_size[b],
+			     vb2_plane_size(vb, b));
+		memcpy(vb2_plane_vaddr(vb, b), tile, size);
+		bytes += size;
+	}
+
+	vivid_get_timestamp(&buf->vb);
+	vivid_wrap_time_offset(&buf->vb, dev->time_wrap_offset);
+
+	atomic64_inc(&dev->fast_frames);
+	atomic64_add(bytes, &dev->fast_bytes);
+	atomic64_add(ktime_get_ns() - start, &dev->fast_fill_ns);
+
+	vb2_buffer_done(vb, buf->fast_error ?
+			VB2_BUF_STATE_ERROR : VB2_BUF_STATE_DONE);
+
+	if (atomic_dec_and_test(&dev->fast_pending))
+		wake_up(&dev->fast_wait);
+}
+
+static void vivid_fast_cap_wait_idle(struct vivid_dev *dev)
+{
+	wait_event(dev->fast_wait, atomic_read(&dev->fast_pending) == 0);
+}
+
+/*
+ * Called from the capture thread with dev->mutex held. Ownership of buf
+ * passes to the shared workqueue, which completes it.
+ */
+void vivid_fast_cap_queue(struct vivid_dev *dev, struct vivid_buffer *buf)
+{
+	bool is_60hz = vivid_is_sdtv_cap(dev) &&
+		       (dev->std_cap & V4L2_STD_525_60);
+
+	/* The test pattern control may be changed while streaming */
+	if (dev->fast_tile_pattern != dev->tpg.pattern) {
+		vivid_fast_cap_wait_idle(dev);
+		if (vivid_fast_cap_render(dev)) {
+			vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_ERROR);
+			return;
+		}
+	}
+
+	buf->vb.sequence = dev->vid_cap_seq_count;
+	if (dev->field_cap == V4L2_FIELD_ALTERNATE) {
+		buf->vb.field = ((dev->vid_cap_seq_count & 1) ^ is_60hz) ?
+			V4L2_FIELD_BOTTOM : V4L2_FIELD_TOP;
+		buf->vb.sequence /= 2;
+	} else {
+		buf->vb.field = dev->field_cap;
+	}
+
+	buf->fast_tile = dev->fast_tile_idx++ % VIVID_FAST_CAP_TILES;
+	buf->fast_error = dev->dqbuf_error;
+	dev->must_blank[buf->vb.vb2_buf.index] = false;
+
+	atomic_inc(&dev->fast_pending);
+	INIT_WORK(&buf->fast_work, vivid_fast_cap_work);
+	queue_work(vivid_fast_wq, &buf->fast_work);
+}
+
+int vivid_fast_cap_start(struct vivid_dev *dev)
+{
+	if (!vivid_fast_wq)
+		return -ENODEV;
+
+	atomic64_set(&dev->fast_frames, 0);
+	atomic64_set(&dev->fast_bytes, 0);
+	atomic64_set(&dev->fast_fill_ns, 0);
+	dev->fast_tile_idx = 0;
+	dev->fast_start_ns = ktime_get_ns();
+
+	return vivid_fast_cap_render(dev);
+}
+
+/*
+ * Wait until the workqueue has returned all buffers of this device and
+ * report the throughput of the stream that just ended.
+ */
+void vivid_fast_cap_stop(struct vivid_dev *dev)
+{
+	u64 frames, bytes, fill_ns, elapsed_ms;
+
+	vivid_fast_cap_wait_idle(dev);
+
+	frames = atomic64_read(&dev->fast_frames);
+	bytes = atomic64_read(&dev->fast_bytes);
+	fill_ns = atomic64_read(&dev->fast_fill_ns);
+	elapsed_ms = div_u64(ktime_get_ns() - dev->fast_start_ns,
+			     NSEC_PER_MSEC);
+	if (!frames || !elapsed_ms)
+		return;
+
+	v4l2_info(&dev->v4l2_dev,
+		"fast capture: %llu frames, %llu MiB in %llu ms (%llu MiB/s), %llu ns fill per frame\n",
+		frames, bytes >> 20, elapsed_ms,
+		div64_u64((bytes >> 20) * MSEC_PER_SEC, elapsed_ms),
+		div64_u64(fill_ns, frames));
+}
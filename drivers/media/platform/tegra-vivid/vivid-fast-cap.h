@@ -0,0 +1,28 @@
+/*
+ * vivid-fast-cap.h - multi-stream fast video capture support functions.
+ *
+ * Copyright (c) 2019, NVIDIA CORPORATION, All rights reserved.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef _VIVID_FAST_CAP_H_
+#define _VIVID_FAST_CAP_H_
+
+int vivid_fast_cap_init(unsigned max_workers);
+void vivid_fast_cap_exit(void);
+
+int vivid_fast_cap_start(struct vivid_dev *dev);
+void vivid_fast_cap_stop(struct vivid_dev *dev);
+void vivid_fast_cap_queue(struct vivid_dev *dev, struct vivid_buffer *buf);
+void vivid_fast_cap_free(struct vivid_dev *dev);
+
+#endif
@@ -51,6 +51,7 @@
 #include "vivid-ctrls.h"
 #include "vivid-kthread-cap.h"
 #include "vivid-kthread-out.h"
+#include "vivid-fast-cap.h"
 
 static inline v4l2_std_id vivid_get_std_cap(const struct vivid_dev *dev)
 {
@@ -740,6 +741,12 @@ static void vivid_thread_vid_cap_tick(struct vivid_dev *dev, int dropped_bufs)
 	if (!vid_cap_buf && !vbi_cap_buf)
 		goto update_mv;
 
+	if (vid_cap_buf && dev->fast_cap) {
+		/* The shared workqueue fills and returns the buffer */
+		vivid_fast_cap_queue(dev, vid_cap_buf);
+		vid_cap_buf = NULL;
+	}
+
 	if (vid_cap_buf) {
 		/* Fill buffer */
 		vivid_fillbuff(dev, vid_cap_buf);
@@ -907,6 +914,15 @@ int vivid_start_generating_vid_cap(struct vivid_dev *dev, bool *pstreaming)
 {
 	dprintk(dev, 1, "%s\n", __func__);
 
+	if (dev->fast_cap && pstreaming == &dev->vid_cap_streaming) {
+		int err = vivid_fast_cap_start(dev);
+
+		if (err) {
+			v4l2_err(&dev->v4l2_dev, "fast capture setup failed\n");
+			return err;
+		}
+	}
+
 	if (dev->kthread_vid_cap) {
 		u32 seq_count = dev->cap_seq_count + dev->seq_wrap * 128;
 
@@ -947,6 +963,10 @@ void vivid_stop_generating_vid_cap(struct vivid_dev *dev, bool *pstreaming)
 
 	*pstreaming = false;
 	if (pstreaming == &dev->vid_cap_streaming) {
+		/* Wait for buffers still owned by the fast capture workers */
+		if (dev->fast_cap)
+			vivid_fast_cap_stop(dev);
+
 		/* Release all active buffers */
 		while (!list_empty(&dev->vid_cap_active)) {
 			struct vivid_buffer *buf;
@@ -63,6 +63,15 @@
 /* This module automatically handles one-shot sensors by disabling the sensor
  * after an event.
  */
+/* Drivers with a hardware FIFO can hand over the whole drained FIFO with
+ * handler_batch instead of calling handler per sample.  Only the timestamp of
+ * the newest sample is needed; the older sample timestamps are spread evenly
+ * between the previous push and that timestamp, falling back to the batch
+ * period when the device was idle or the spacing looks implausible.
+ * Batch statistics (FIFO overflows, IIO buffer drops, sample latency) are
+ * read with the NVS_INFO_BATCH nvs attribute and cleared with
+ * NVS_INFO_BATCH_CLR.
+ */
 
 #include <linux/init.h>
 #include <linux/module.h>
@@ -75,6 +84,7 @@
 #include <linux/slab.h>
 #include <linux/of.h>
 #include <linux/string.h>
+#include <linux/math64.h>
 #include <linux/iio/iio.h>
 #include <linux/iio/sysfs.h>
 #include <linux/iio/buffer.h>
@@ -86,7 +96,7 @@
 #include <linux/iio/buffer_impl.h>
 #endif
 
-#define NVS_IIO_DRIVER_VERSION		(223)
+#define NVS_IIO_DRIVER_VERSION		(224)
 
 enum NVS_ATTR {
 	NVS_ATTR_ENABLE,
@@ -113,6 +123,8 @@ enum NVS_DBG {
 	NVS_INFO_DBG_DATA,
 	NVS_INFO_DBG_BUF,
 	NVS_INFO_DBG_IRQ,
+	NVS_INFO_BATCH,
+	NVS_INFO_BATCH_CLR,
 	NVS_INFO_LIMIT_MAX,
 	NVS_INFO_DBG_KEY = 0x131071D,
 };
@@ -175,6 +187,20 @@ struct nvs_iio_channel {
 	int i;
 };
 
+struct nvs_batch_stats {
+	u64 batches;			/* handler_batch calls */
+	u64 samples;			/* samples received in batches */
+	u64 lost;			/* samples dropped by the device FIFO */
+	u64 drops;			/* samples the IIO buffer refused */
+	u64 lat_sum;			/* sum of oldest sample latency (ns) */
+	s64 lat_max;			/* max oldest sample latency (ns) */
+	s64 push_max;			/* max time to push one batch (ns) */
+	s64 period;			/* last reconstructed period (ns) */
+	unsigned int overflows;		/* batches that reported lost samples */
+	unsigned int full;		/* batches >= fifo_max_evnt_cnt */
+	unsigned int n_max;		/* largest batch */
+};
+
 struct nvs_state {
 	void *client;
 	struct device *dev;
@@ -206,6 +232,7 @@ struct nvs_state {
 	s64 ts_diff;
 	s64 ts;
 	u8 *buf;
+	struct nvs_batch_stats batch;
 };
 
 struct nvs_iio_ch {
@@ -735,6 +762,134 @@ static int nvs_handler(void *handle, void *buffer, s64 ts)
 	return ret;
 }
 
+/* bytes per sample in the data passed by the device to the handlers */
+static unsigned int nvs_buf_stride(struct iio_dev *indio_dev)
+{
+	struct nvs_state *st = iio_priv(indio_dev);
+	unsigned int stride = 0;
+	unsigned int i;
+
+	for (i = 0; i < indio_dev->num_channels - 1; i++) {
+		if (st->ch[i].i >= 0)
+			stride += st->ch[i].n;
+	}
+	return stride;
+}
+
+static s64 nvs_batch_period(struct nvs_state *st, unsigned int n, s64 ts,
+			    unsigned int lost)
+{
+	s64 nominal = (s64)st->batch_period_us * 1000;
+	s64 period;
+
+	if (st->first_push || ts <= st->ts)
+		return nominal;
+
+	/* the span since the last push also covers the lost samples */
+	period = div_s64(ts - st->ts, n + lost);
+	if (nominal && (period < (nominal >> 1) || period > (nominal << 1))) {
+		/* device was idle or the timestamps jitter too much */
+		period = nominal;
+		if (ts - period * (n - 1) <= st->ts)
+			/* never reorder behind the previous push */
+			period = div_s64(ts - st->ts, n);
+	}
+	return period;
+}
+
+static int nvs_buf_push_batch(struct iio_dev *indio_dev, unsigned char *data,
+			      unsigned int n, s64 ts, unsigned int lost)
+{
+	struct nvs_state *st = iio_priv(indio_dev);
+	struct nvs_batch_stats *bs = &st->batch;
+	unsigned int stride;
+	unsigned int i;
+	s64 period;
+	s64 ts_first;
+	s64 ts_i;
+	s64 t_start;
+	s64 t;
+
+	if (!data || !n)
+		return 0;
+
+	t_start = nvs_timestamp();
+	if (!ts)
+		ts = t_start;
+	period = nvs_batch_period(st, n, ts, lost);
+	stride = nvs_buf_stride(indio_dev);
+	ts_first = ts - period * (n - 1);
+	ts_i = ts_first;
+	for (i = 0; i < n; i++) {
+		if (nvs_buf_push(indio_dev, &data[stride * i], ts_i) < 0)
+			bs->drops++;
+		ts_i += period;
+	}
+
+	t = nvs_timestamp();
+	bs->batches++;
+	bs->samples += n;
+	bs->period = period;
+	if (n > bs->n_max)
+		bs->n_max = n;
+	if (st->cfg->fifo_max_evnt_cnt && n >= st->cfg->fifo_max_evnt_cnt)
+		bs->full++;
+	if (lost) {
+		bs->lost += lost;
+		bs->overflows++;
+		if (*st->fn_dev->sts & NVS_STS_SPEW_MSG)
+			dev_info(st->dev, "%s %s FIFO overflow lost=%u\n",
+				 __func__, st->cfg->name, lost);
+	}
+	if (t - ts_first > 0) {
+		bs->lat_sum += t - ts_first;
+		if (t - ts_first > bs->lat_max)
+			bs->lat_max = t - ts_first;
+	}
+	if (t - t_start > bs->push_max)
+		bs->push_max = t - t_start;
+	return stride * n;
+}
+
+static int nvs_handler_batch(void *handle, void *buffer, unsigned int n,
+			     s64 ts, unsigned int lost)
+{
+	struct iio_dev *indio_dev = (struct iio_dev *)handle;
+	int ret = 0;
+
+	if (indio_dev)
+		ret = nvs_buf_push_batch(indio_dev, buffer, n, ts, lost);
+	return ret;
+}
+
+static ssize_t nvs_dbg_batch(struct iio_dev *indio_dev, char *buf)
+{
+	struct nvs_state *st = iio_priv(indio_dev);
+	struct nvs_batch_stats *bs = &st->batch;
+	u64 lat_avg = 0;
+	ssize_t t;
+
+	if (bs->batches)
+		lat_avg = div64_u64(bs->lat_sum, bs->batches);
+	t = snprintf(buf, PAGE_SIZE, "batches=%llu\n", bs->batches);
+	t += snprintf(buf + t, PAGE_SIZE - t, "samples=%llu\n", bs->samples);
+	t += snprintf(buf + t, PAGE_SIZE - t, "batch_max=%u (fifo_max=%u)\n",
+		      bs->n_max, st->cfg->fifo_max_evnt_cnt);
+	t += snprintf(buf + t, PAGE_SIZE - t, "fifo_full=%u\n", bs->full);
+	t += snprintf(buf + t, PAGE_SIZE - t, "overflows=%u lost=%llu\n",
+		      bs->overflows, bs->lost);
+	t += snprintf(buf + t, PAGE_SIZE - t, "buffer_drops=%llu\n",
+		      bs->drops);
+	t += snprintf(buf + t, PAGE_SIZE - t, "period_ns=%lld\n", bs->period);
+	t += snprintf(buf + t, PAGE_SIZE - t, "latency_avg_ns=%llu\n",
+		      lat_avg);
+	t += snprintf(buf + t, PAGE_SIZE - t, "latency_max_ns=%lld\n",
+		      bs->lat_max);
+	t += snprintf(buf + t, PAGE_SIZE - t, "push_max_ns=%lld\n",
+		      bs->push_max);
+	return t;
+}
+
 static int nvs_enable(struct iio_dev *indio_dev, bool en)
 {
 	struct nvs_state *st = iio_priv(indio_dev);
@@ -1004,6 +1159,13 @@ static ssize_t nvs_info_store(struct device *dev,
 		*st->fn_dev->sts ^= NVS_STS_SPEW_IRQ;
 		break;
 
+	case NVS_INFO_BATCH:
+		break;
+
+	case NVS_INFO_BATCH_CLR:
+		memset(&st->batch, 0, sizeof(st->batch));
+		break;
+
 	case NVS_INFO_DBG_KEY:
 		break;
 
@@ -1092,6 +1254,12 @@ static ssize_t nvs_info_show(struct device *dev,
 		return snprintf(buf, PAGE_SIZE, "IRQ spew=%x\n",
 				!!(*st->fn_dev->sts & NVS_STS_SPEW_IRQ));
 
+	case NVS_INFO_BATCH:
+		return nvs_dbg_batch(indio_dev, buf);
+
+	case NVS_INFO_BATCH_CLR:
+		return snprintf(buf, PAGE_SIZE, "batch statistics cleared\n");
+
 	default:
 		if (dbg < NVS_INFO_LIMIT_MAX)
 			break;
@@ -2013,6 +2181,7 @@ static struct nvs_fn_if nvs_fn_if_iio = {
 	.suspend			= nvs_suspend,
 	.resume				= nvs_resume,
 	.handler			= nvs_handler,
+	.handler_batch			= nvs_handler_batch,
 };
 
 struct nvs_fn_if *nvs_iio(void)
@@ -27,6 +27,11 @@
 #include <linux/circ_buf.h>
 #include <linux/uaccess.h>
 #include <linux/version.h>
+#include <linux/poll.h>
+#include <linux/cpu.h>
+#include <linux/irq_work.h>
+#include <linux/workqueue.h>
+#include <linux/rcupdate.h>
 
 #include <linux/tegra_profiler.h>
 
@@ -34,16 +39,38 @@
 #include "quadd.h"
 #include "version.h"
 
+#define QUADD_RB_FLUSH_PERIOD_MS	20
+
+/*
+ * A ring buffer is attached to one CPU and written only by that CPU with
+ * interrupts disabled, so the producer side needs no locking. Samples for
+ * another CPU are written from that CPU (see put_sample()).
+ *
+ * Attached ring buffers are published through comm_cpu_context::rb with
+ * RCU-sched; the producer runs with interrupts disabled, so a detached ring
+ * buffer can be freed after synchronize_sched().
+ */
 struct quadd_ring_buffer {
 	struct quadd_ring_buffer_hdr *rb_hdr;
 	char *buf;
 
+	/*
+	 * pos_write is the private write position of the producer and
+	 * pos_commit is the position published to user space through
+	 * rb_hdr->pos_write. The header is updated only once commit_size
+	 * bytes are pending.
+	 */
+	size_t size;
+	size_t pos_write;
+	size_t pos_commit;
+
+	size_t commit_size;
+	size_t wakeup_mark;
+
 	size_t max_fill_count;
-	size_t nr_skipped_samples;
+	u64 nr_skipped_samples;
 
 	struct quadd_mmap_area *mmap;
-
-	raw_spinlock_t lock;
 };
 
 struct quadd_comm_ctx {
@@ -57,17 +84,29 @@ struct quadd_comm_ctx {
 
 	int params_ok;
 
+	unsigned int rb_commit_size;
+	unsigned int rb_wakeup_percent;
+
+	wait_queue_head_t rb_wait;
+	struct delayed_work rb_flush_work;
+
 	struct miscdevice *misc_dev;
 };
 
 struct comm_cpu_context {
-	struct quadd_ring_buffer rb;
+	struct quadd_ring_buffer __rcu *rb;
+	struct irq_work wakeup_work;
 	int params_ok;
 };
 
 static struct quadd_comm_ctx comm_ctx;
 static DEFINE_PER_CPU(struct comm_cpu_context, cpu_ctx);
 
+static void rb_wakeup(struct irq_work *work)
+{
+	wake_up_interruptible(&comm_ctx.rb_wait);
+}
+
 static void
 rb_write(struct quadd_ring_buffer_hdr *rb_hdr,
 	 char *buf, const void *data, size_t length)
@@ -94,8 +133,41 @@ rb_write(struct quadd_ring_buffer_hdr *rb_hdr,
 	rb_hdr->pos_write = head;
 }
 
+/*
+ * Publish the data written so far to user space and wake up the reader if
+ * the fill level has crossed the wakeup watermark.
+ */
+static void
+rb_commit(struct comm_cpu_context *cc, struct quadd_ring_buffer *rb,
+	  bool force_wakeup)
+{
+	size_t pos_read, fill_old, fill;
+	struct quadd_ring_buffer_hdr *rb_hdr = rb->rb_hdr;
+
+	if (rb->pos_commit != rb->pos_write) {
+		pos_read = READ_ONCE(rb_hdr->pos_read) & (rb->size - 1);
+
+		fill_old = CIRC_CNT(rb->pos_commit, pos_read, rb->size);
+		fill = CIRC_CNT(rb->pos_write, pos_read, rb->size);
+
+		/* Use smp_store_release() to update circle buffer write
+		 * pointers to ensure the data is stored before we update
+		 * write pointer.
+		 */
+		smp_store_release(&rb_hdr->pos_write, rb->pos_write);
+		WRITE_ONCE(rb->pos_commit, rb->pos_write);
+
+		if (rb->wakeup_mark && fill_old < rb->wakeup_mark &&
+		    fill >= rb->wakeup_mark)
+			force_wakeup = true;
+	}
+
+	if (force_wakeup && rb->wakeup_mark)
+		irq_work_queue(&cc->wakeup_work);
+}
+
 static ssize_t
-write_sample(struct quadd_ring_buffer *rb,
+write_sample(struct comm_cpu_context *cc, struct quadd_ring_buffer *rb,
 	     struct quadd_record_data *sample,
 	     const struct quadd_iovec *vec, int vec_count)
 {
@@ -103,9 +175,6 @@ write_sample(struct quadd_ring_buffer *rb,
 	size_t len = 0, c;
 	struct quadd_ring_buffer_hdr hdr, *rb_hdr = rb->rb_hdr;
 
-	if (!rb_hdr)
-		return -EIO;
-
 	if (vec) {
 		for (i = 0; i < vec_count; i++)
 			len += vec[i].len;
@@ -114,14 +183,15 @@ write_sample(struct quadd_ring_buffer *rb,
 	sample->extra_size = len;
 	len += sizeof(*sample);
 
-	hdr.size = rb_hdr->size;
-	hdr.pos_write = rb_hdr->pos_write;
-	hdr.pos_read = READ_ONCE(rb_hdr->pos_read);
+	hdr.size = rb->size;
+	hdr.pos_write = rb->pos_write;
+	hdr.pos_read = READ_ONCE(rb_hdr->pos_read) & (rb->size - 1);
 
 	c = CIRC_SPACE(hdr.pos_write, hdr.pos_read, hdr.size);
 	if (len > c) {
 		pr_err_once("[cpu: %d] warning: buffer has been overflowed\n",
 			    smp_processor_id());
+		rb_commit(cc, rb, true);
 		return -ENOSPC;
 	}
 
@@ -132,46 +202,104 @@ write_sample(struct quadd_ring_buffer *rb,
 			rb_write(&hdr, rb->buf, vec[i].base, vec[i].len);
 	}
 
+	WRITE_ONCE(rb->pos_write, hdr.pos_write);
+
 	c = CIRC_CNT(hdr.pos_write, hdr.pos_read, hdr.size);
 	if (c > rb->max_fill_count) {
 		rb->max_fill_count = c;
 		rb_hdr->max_fill_count = c;
 	}
 
-	/* Use smp_store_release() to update circle buffer write pointers to
-	 * ensure the data is stored before we update write pointer.
-	 */
-	smp_store_release(&rb_hdr->pos_write, hdr.pos_write);
+	if (CIRC_CNT(rb->pos_write, rb->pos_commit, rb->size) >=
+	    rb->commit_size)
+		rb_commit(cc, rb, false);
 
 	return len;
 }
 
+/*
+ * Must be called with interrupts disabled, on the CPU that owns cc or
+ * for an offline CPU.
+ */
+static ssize_t
+put_sample_cpu(struct comm_cpu_context *cc,
+	       struct quadd_record_data *data,
+	       const struct quadd_iovec *vec, int vec_count)
+{
+	ssize_t err;
+	struct quadd_ring_buffer *rb;
+
+	rb = rcu_dereference_sched(cc->rb);
+	if (!rb)
+		return -EIO;
+
+	err = write_sample(cc, rb, data, vec, vec_count);
+	if (err < 0) {
+		pr_err_once("%s: error: write sample\n", __func__);
+		rb->nr_skipped_samples++;
+		rb->rb_hdr->skipped_samples++;
+	}
+
+	return err;
+}
+
+struct put_sample_args {
+	struct comm_cpu_context *cc;
+	struct quadd_record_data *data;
+	struct quadd_iovec *vec;
+	int vec_count;
+	ssize_t err;
+};
+
+static void put_sample_remote(void *info)
+{
+	struct put_sample_args *args = info;
+
+	args->err = put_sample_cpu(args->cc, args->data, args->vec,
+				   args->vec_count);
+}
+
+/*
+ * Run func on cpu_id with interrupts disabled. Offline CPUs do not
+ * produce samples, so their ring buffers are handled in place.
+ */
+static void
+call_on_cpu(int cpu_id, smp_call_func_t func, void *info)
+{
+	unsigned long flags;
+
+	if (cpu_online(cpu_id) &&
+	    !smp_call_function_single(cpu_id, func, info, 1))
+		return;
+
+	local_irq_save(flags);
+	func(info);
+	local_irq_restore(flags);
+}
+
 static size_t get_data_size(void)
 {
 	int cpu_id;
-	unsigned long flags;
-	size_t size = 0, tail;
-	struct comm_cpu_context *cc;
+	size_t size = 0;
 	struct quadd_ring_buffer *rb;
 	struct quadd_ring_buffer_hdr *rb_hdr;
 
-	for_each_possible_cpu(cpu_id) {
-		cc = &per_cpu(cpu_ctx, cpu_id);
-
-		rb = &cc->rb;
+	raw_spin_lock(&comm_ctx.ctx->mmaps_lock);
 
-		rb_hdr = rb->rb_hdr;
-		if (!rb_hdr)
+	for_each_possible_cpu(cpu_id) {
+		rb = rcu_dereference_protected(per_cpu(cpu_ctx, cpu_id).rb,
+			lockdep_is_held(&comm_ctx.ctx->mmaps_lock));
+		if (!rb)
 			continue;
 
-		raw_spin_lock_irqsave(&rb->lock, flags);
-
-		tail = READ_ONCE(rb_hdr->pos_read);
-		size += CIRC_CNT(rb_hdr->pos_write, tail, rb_hdr->size);
-
-		raw_spin_unlock_irqrestore(&rb->lock, flags);
+		rb_hdr = rb->rb_hdr;
+		size += CIRC_CNT(READ_ONCE(rb_hdr->pos_write),
+				 READ_ONCE(rb_hdr->pos_read) & (rb->size - 1),
+				 rb->size);
 	}
 
+	raw_spin_unlock(&comm_ctx.ctx->mmaps_lock);
+
 	return size;
 }
 
@@ -180,35 +308,76 @@ put_sample(struct quadd_record_data *data,
 	   struct quadd_iovec *vec,
 	   int vec_count, int cpu_id)
 {
-	ssize_t err = 0;
+	ssize_t err;
 	unsigned long flags;
-	struct comm_cpu_context *cc;
-	struct quadd_ring_buffer *rb;
-	struct quadd_ring_buffer_hdr *rb_hdr;
+	struct put_sample_args args;
 
 	if (!atomic_read(&comm_ctx.active))
 		return -EIO;
 
-	cc = cpu_id < 0 ? this_cpu_ptr(&cpu_ctx) :
-		&per_cpu(cpu_ctx, cpu_id);
+	local_irq_save(flags);
+	if (cpu_id < 0 || cpu_id == smp_processor_id()) {
+		err = put_sample_cpu(this_cpu_ptr(&cpu_ctx), data, vec,
+				     vec_count);
+		local_irq_restore(flags);
+		return err;
+	}
+	local_irq_restore(flags);
 
-	rb = &cc->rb;
+	/* Keep a single producer per ring buffer */
+	if (WARN_ON_ONCE(irqs_disabled() || !cpu_possible(cpu_id)))
+		return -EINVAL;
 
-	raw_spin_lock_irqsave(&rb->lock, flags);
+	args.cc = &per_cpu(cpu_ctx, cpu_id);
+	args.data = data;
+	args.vec = vec;
+	args.vec_count = vec_count;
+	args.err = -EIO;
 
-	err = write_sample(rb, data, vec, vec_count);
-	if (err < 0) {
-		pr_err_once("%s: error: write sample\n", __func__);
-		rb->nr_skipped_samples++;
+	call_on_cpu(cpu_id, put_sample_remote, &args);
 
-		rb_hdr = rb->rb_hdr;
-		if (rb_hdr)
-			rb_hdr->skipped_samples++;
-	}
+	return args.err;
+}
+
+static void rb_flush(void *info)
+{
+	struct comm_cpu_context *cc = info;
+	struct quadd_ring_buffer *rb;
 
-	raw_spin_unlock_irqrestore(&rb->lock, flags);
+	rb = rcu_dereference_sched(cc->rb);
+	if (rb)
+		rb_commit(cc, rb, false);
+}
 
-	return err;
+/*
+ * With batched commits the tail of a ring buffer would stay unpublished
+ * once its CPU stops producing samples, so push it out periodically.
+ * CPUs without pending data are not disturbed.
+ */
+static void rb_flush_work(struct work_struct *work)
+{
+	int cpu_id;
+	bool pending;
+	struct quadd_ring_buffer *rb;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu_id) {
+		rcu_read_lock_sched();
+		rb = rcu_dereference_sched(per_cpu(cpu_ctx, cpu_id).rb);
+		pending = rb && READ_ONCE(rb->pos_commit) !=
+			READ_ONCE(rb->pos_write);
+		rcu_read_unlock_sched();
+
+		if (pending)
+			smp_call_function_single(cpu_id, rb_flush,
+						 &per_cpu(cpu_ctx, cpu_id), 1);
+	}
+	put_online_cpus();
+
+	if (atomic_read(&comm_ctx.active))
+		queue_delayed_work(system_power_efficient_wq,
+				   &comm_ctx.rb_flush_work,
+				   msecs_to_jiffies(QUADD_RB_FLUSH_PERIOD_MS));
 }
 
 static void comm_reset(void)
@@ -284,15 +453,31 @@ static int device_release(struct inode *inode, struct file *file)
 	return 0;
 }
 
+static void rb_set_marks(struct quadd_ring_buffer *rb)
+{
+	rb->commit_size = min_t(size_t, comm_ctx.rb_commit_size,
+				rb->size / 4);
+	rb->wakeup_mark = rb->size / 100 * comm_ctx.rb_wakeup_percent;
+}
+
+static void rb_update_marks(void *info)
+{
+	struct comm_cpu_context *cc = info;
+	struct quadd_ring_buffer *rb;
+
+	rb = rcu_dereference_sched(cc->rb);
+	if (rb)
+		rb_set_marks(rb);
+}
+
 static int
 init_mmap_hdr(struct quadd_mmap_rb_info *mmap_rb,
-	      struct quadd_mmap_area *mmap)
+	      struct quadd_mmap_area *mmap,
+	      struct quadd_ring_buffer *rb)
 {
 	unsigned int cpu_id;
 	size_t size;
-	unsigned long flags;
 	struct vm_area_struct *vma;
-	struct quadd_ring_buffer *rb;
 	struct quadd_ring_buffer_hdr *rb_hdr;
 	struct quadd_mmap_header *mmap_hdr;
 	struct comm_cpu_context *cc;
@@ -307,7 +492,8 @@ init_mmap_hdr(struct quadd_mmap_rb_info *mmap_rb,
 
 	cc = &per_cpu(cpu_ctx, cpu_id);
 
-	rb = &cc->rb;
+	if (rcu_access_pointer(cc->rb))
+		return -EBUSY;
 
 	vma = mmap->mmap_vma;
 	size = vma->vm_end - vma->vm_start;
@@ -317,13 +503,16 @@ init_mmap_hdr(struct quadd_mmap_rb_info *mmap_rb,
 
 	size -= PAGE_SIZE;
 
-	raw_spin_lock_irqsave(&rb->lock, flags);
-
 	mmap->rb = rb;
 
 	rb->mmap = mmap;
 	rb->buf = (char *)mmap->data + PAGE_SIZE;
 
+	rb->size = size;
+	rb->pos_write = 0;
+	rb->pos_commit = 0;
+	rb_set_marks(rb);
+
 	rb->max_fill_count = 0;
 	rb->nr_skipped_samples = 0;
 
@@ -346,7 +535,7 @@ init_mmap_hdr(struct quadd_mmap_rb_info *mmap_rb,
 
 	rb_hdr->state = QUADD_RB_STATE_ACTIVE;
 
-	raw_spin_unlock_irqrestore(&rb->lock, flags);
+	rcu_assign_pointer(cc->rb, rb);
 
 	pr_debug("[cpu: %d] init_mmap_hdr: vma: %#lx - %#lx, data: %p - %p\n",
 		 cpu_id,
@@ -356,43 +545,144 @@ init_mmap_hdr(struct quadd_mmap_rb_info *mmap_rb,
 	return 0;
 }
 
+static void rb_stop_cpu(void *info)
+{
+	struct comm_cpu_context *cc = info;
+	struct quadd_ring_buffer *rb;
+
+	rb = rcu_dereference_sched(cc->rb);
+	if (!rb)
+		return;
+
+	rb_commit(cc, rb, true);
+	rb->rb_hdr->state = QUADD_RB_STATE_STOPPED;
+}
+
 static void rb_stop(void)
 {
 	int cpu_id;
 	struct quadd_ring_buffer *rb;
-	struct quadd_ring_buffer_hdr *rb_hdr;
-	struct comm_cpu_context *cc;
 
-	for_each_possible_cpu(cpu_id) {
-		cc = &per_cpu(cpu_ctx, cpu_id);
+	cancel_delayed_work_sync(&comm_ctx.rb_flush_work);
 
-		rb = &cc->rb;
-		rb_hdr = rb->rb_hdr;
+	get_online_cpus();
+	for_each_possible_cpu(cpu_id)
+		call_on_cpu(cpu_id, rb_stop_cpu, &per_cpu(cpu_ctx, cpu_id));
+	put_online_cpus();
+
+	raw_spin_lock(&comm_ctx.ctx->mmaps_lock);
 
-		if (!rb_hdr)
+	for_each_possible_cpu(cpu_id) {
+		rb = rcu_dereference_protected(per_cpu(cpu_ctx, cpu_id).rb,
+			lockdep_is_held(&comm_ctx.ctx->mmaps_lock));
+		if (!rb)
 			continue;
 
-		pr_info("[%d] skipped samples/max filling: %zu/%zu\n",
+		pr_info("[%d] skipped samples/max filling: %llu/%zu\n",
 			cpu_id, rb->nr_skipped_samples, rb->max_fill_count);
-
-		rb_hdr->state = QUADD_RB_STATE_STOPPED;
 	}
+
+	raw_spin_unlock(&comm_ctx.ctx->mmaps_lock);
 }
 
+static void rb_start(void)
+{
+	int cpu_id;
+
+	get_online_cpus();
+	for_each_possible_cpu(cpu_id)
+		call_on_cpu(cpu_id, rb_update_marks, &per_cpu(cpu_ctx, cpu_id));
+	put_online_cpus();
+
+	if (comm_ctx.rb_commit_size > 0)
+		queue_delayed_work(system_power_efficient_wq,
+				   &comm_ctx.rb_flush_work,
+				   msecs_to_jiffies(QUADD_RB_FLUSH_PERIOD_MS));
+}
+
+/*
+ * Detach the ring buffer from its CPU. The caller frees it after
+ * synchronize_sched().
+ */
 static void rb_reset(struct quadd_ring_buffer *rb)
 {
-	unsigned long flags;
+	int cpu_id;
+	struct comm_cpu_context *cc;
 
 	if (!rb)
 		return;
 
-	raw_spin_lock_irqsave(&rb->lock, flags);
+	for_each_possible_cpu(cpu_id) {
+		cc = &per_cpu(cpu_ctx, cpu_id);
 
-	rb->mmap = NULL;
-	rb->buf = NULL;
-	rb->rb_hdr = NULL;
+		if (rcu_access_pointer(cc->rb) == rb) {
+			RCU_INIT_POINTER(cc->rb, NULL);
+			break;
+		}
+	}
+}
 
-	raw_spin_unlock_irqrestore(&rb->lock, flags);
+static void
+rb_get_state(struct quadd_module_state *state)
+{
+	int cpu_id;
+	u32 max_fill = 0;
+	struct quadd_ring_buffer *rb;
+
+	raw_spin_lock(&comm_ctx.ctx->mmaps_lock);
+
+	for_each_possible_cpu(cpu_id) {
+		rb = rcu_dereference_protected(per_cpu(cpu_ctx, cpu_id).rb,
+			lockdep_is_held(&comm_ctx.ctx->mmaps_lock));
+		if (!rb)
+			continue;
+
+		max_fill = max_t(u32, max_fill, rb->max_fill_count);
+
+		if (cpu_id < QUADD_MOD_STATE_NR_RB_LOST)
+			state->reserved[QUADD_MOD_STATE_IDX_RB_LOST + cpu_id] =
+				min_t(u64, rb->nr_skipped_samples, U32_MAX);
+	}
+
+	raw_spin_unlock(&comm_ctx.ctx->mmaps_lock);
+
+	state->reserved[QUADD_MOD_STATE_IDX_RB_MAX_FILL_COUNT] = max_fill;
+}
+
+static unsigned int
+device_poll(struct file *file, poll_table *wait)
+{
+	int cpu_id;
+	unsigned int mask = 0;
+	size_t fill;
+	struct quadd_ring_buffer *rb;
+	struct quadd_ring_buffer_hdr *rb_hdr;
+
+	poll_wait(file, &comm_ctx.rb_wait, wait);
+
+	raw_spin_lock(&comm_ctx.ctx->mmaps_lock);
+
+	for_each_possible_cpu(cpu_id) {
+		rb = rcu_dereference_protected(per_cpu(cpu_ctx, cpu_id).rb,
+			lockdep_is_held(&comm_ctx.ctx->mmaps_lock));
+		if (!rb)
+			continue;
+
+		rb_hdr = rb->rb_hdr;
+		fill = CIRC_CNT(READ_ONCE(rb_hdr->pos_write),
+				READ_ONCE(rb_hdr->pos_read) & (rb->size - 1),
+				rb->size);
+
+		if (fill && (fill >= rb->wakeup_mark ||
+			     READ_ONCE(rb_hdr->state) != QUADD_RB_STATE_ACTIVE)) {
+			mask |= POLLIN | POLLRDNORM;
+			break;
+		}
+	}
+
+	raw_spin_unlock(&comm_ctx.ctx->mmaps_lock);
+
+	return mask;
 }
 
 static int
@@ -451,6 +741,7 @@ device_ioctl(struct file *file,
 	struct quadd_module_version versions;
 	struct quadd_sections extabs;
 	struct quadd_mmap_rb_info mmap_rb;
+	struct quadd_ring_buffer *rb;
 
 	mutex_lock(&comm_ctx.io_mutex);
 
@@ -556,6 +847,11 @@ device_ioctl(struct file *file,
 			goto error_out;
 		}
 
+		comm_ctx.rb_commit_size =
+			user_params->reserved[QUADD_PARAM_IDX_RB_COMMIT_SIZE];
+		comm_ctx.rb_wakeup_percent = min_t(u32, 100,
+			user_params->reserved[QUADD_PARAM_IDX_RB_WAKEUP_PERCENT]);
+
 		comm_ctx.params_ok = 1;
 
 		pr_info("setup success: freq/mafreq: %u/%u, backtrace: %d, pid: %d\n",
@@ -638,7 +934,7 @@ device_ioctl(struct file *file,
 
 		state.buffer_size = 0;
 		state.buffer_fill_size = get_data_size();
-		state.reserved[QUADD_MOD_STATE_IDX_RB_MAX_FILL_COUNT] = 0;
+		rb_get_state(&state);
 
 		if (copy_to_user((void __user *)ioctl_param, &state,
 				 sizeof(struct quadd_module_state))) {
@@ -650,10 +946,12 @@ device_ioctl(struct file *file,
 
 	case IOCTL_START:
 		if (!atomic_cmpxchg(&comm_ctx.active, 0, 1)) {
+			rb_start();
 			err = comm_ctx.control->start();
 			if (err) {
 				pr_err("error: start failed\n");
 				atomic_set(&comm_ctx.active, 0);
+				rb_stop();
 				goto error_out;
 			}
 			pr_info("Start profiling: success\n");
@@ -732,6 +1030,12 @@ device_ioctl(struct file *file,
 			goto error_out;
 		}
 
+		rb = kzalloc(sizeof(*rb), GFP_KERNEL);
+		if (!rb) {
+			err = -ENOMEM;
+			goto error_out;
+		}
+
 		raw_spin_lock(&comm_ctx.ctx->mmaps_lock);
 
 		mmap = find_mmap_by_vma((unsigned long)mmap_rb.vm_start);
@@ -740,6 +1044,7 @@ device_ioctl(struct file *file,
 			       (unsigned long)mmap_rb.vm_start);
 			err = -ENXIO;
 			raw_spin_unlock(&comm_ctx.ctx->mmaps_lock);
+			kfree(rb);
 			goto error_out;
 		}
 
@@ -748,15 +1053,17 @@ device_ioctl(struct file *file,
 			       mmap->type, mmap->mmap_vma->vm_start);
 			err = -ENXIO;
 			raw_spin_unlock(&comm_ctx.ctx->mmaps_lock);
+			kfree(rb);
 			goto error_out;
 		}
 
 		mmap->type = QUADD_MMAP_TYPE_RB;
 
-		err = init_mmap_hdr(&mmap_rb, mmap);
+		err = init_mmap_hdr(&mmap_rb, mmap, rb);
 		raw_spin_unlock(&comm_ctx.ctx->mmaps_lock);
 		if (err) {
 			pr_err("set_mmap_rb: error: init_mmap_hdr\n");
+			kfree(rb);
 			goto error_out;
 		}
 
@@ -796,6 +1103,7 @@ static void mmap_open(struct vm_area_struct *vma)
 static void mmap_close(struct vm_area_struct *vma)
 {
 	struct quadd_mmap_area *mmap;
+	struct quadd_ring_buffer *rb = NULL;
 
 	raw_spin_lock(&comm_ctx.ctx->mmaps_lock);
 
@@ -812,8 +1120,10 @@ static void mmap_close(struct vm_area_struct *vma)
 
 	if (mmap->type == QUADD_MMAP_TYPE_EXTABS)
 		comm_ctx.control->delete_mmap(mmap);
-	else if (mmap->type == QUADD_MMAP_TYPE_RB)
-		rb_reset(mmap->rb);
+	else if (mmap->type == QUADD_MMAP_TYPE_RB) {
+		rb = mmap->rb;
+		rb_reset(rb);
+	}
 	else
 		pr_warn("warning: mmap area is uninitialized\n");
 
@@ -822,6 +1132,12 @@ static void mmap_close(struct vm_area_struct *vma)
 out:
 	raw_spin_unlock(&comm_ctx.ctx->mmaps_lock);
 
+	if (rb) {
+		/* wait for the producer to leave the ring buffer */
+		synchronize_sched();
+		kfree(rb);
+	}
+
 	if (mmap) {
 		vfree(mmap->data);
 		kfree(mmap);
@@ -935,6 +1251,7 @@ static const struct file_operations qm_fops = {
 	.unlocked_ioctl	= device_ioctl,
 	.compat_ioctl	= device_ioctl,
 	.mmap		= device_mmap,
+	.poll		= device_poll,
 };
 
 static int comm_init(void)
@@ -966,18 +1283,14 @@ static int comm_init(void)
 	INIT_LIST_HEAD(&comm_ctx.ctx->mmap_areas);
 	raw_spin_lock_init(&comm_ctx.ctx->mmaps_lock);
 
+	init_waitqueue_head(&comm_ctx.rb_wait);
+	INIT_DELAYED_WORK(&comm_ctx.rb_flush_work, rb_flush_work);
+
 	for_each_possible_cpu(cpu_id) {
 		struct comm_cpu_context *cc = &per_cpu(cpu_ctx, cpu_id);
-		struct quadd_ring_buffer *rb = &cc->rb;
 
-		rb->mmap = NULL;
-		rb->buf = NULL;
-		rb->rb_hdr = NULL;
-
-		rb->max_fill_count = 0;
-		rb->nr_skipped_samples = 0;
-
-		raw_spin_lock_init(&rb->lock);
+		RCU_INIT_POINTER(cc->rb, NULL);
+		init_irq_work(&cc->wakeup_work, rb_wakeup);
 	}
 
 	reset_params_ok_flag();
@@ -1006,4 +1319,6 @@ void quadd_comm_exit(void)
 	mutex_lock(&comm_ctx.io_mutex);
 	unregister();
 	mutex_unlock(&comm_ctx.io_mutex);
+
+	cancel_delayed_work_sync(&comm_ctx.rb_flush_work);
 }
@@ -1,7 +1,7 @@
 /*
  * drivers/misc/tegra-profiler/dwarf_unwind.c
  *
- * Copyright (c) 2015-2018, NVIDIA CORPORATION.  All rights reserved.
+ * Copyright (c) 2015-2019, NVIDIA CORPORATION.  All rights reserved.
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms and conditions of the GNU General Public License,
@@ -21,6 +21,9 @@
 #include <linux/slab.h>
 #include <linux/uaccess.h>
 #include <linux/err.h>
+#include <linux/hash.h>
+#include <linux/ktime.h>
+#include <linux/vmalloc.h>
 
 #include <asm/unaligned.h>
 
@@ -124,17 +127,41 @@ struct stackframe {
 	int is_sched;
 };
 
+/*
+ * Register rules computed for a recently unwound PC. The rules only depend
+ * on the unwind tables, so they can be reused as long as the mmap area with
+ * the tables is alive (see cache_gen).
+ */
+struct dw_rules_cache_entry {
+	unsigned long pc;
+	unsigned long vm_start;
+	struct quadd_mmap_area *mmap;
+
+	unsigned int gen;
+	int mode;
+	int is_eh;
+
+	struct regs_state rs;
+};
+
+#define DW_RULES_CACHE_BITS	5
+#define DW_RULES_CACHE_SIZE	(1 << DW_RULES_CACHE_BITS)
+
 struct dwarf_cpu_context {
 	struct regs_state rs_stack[DW_MAX_RS_STACK_DEPTH];
 	int depth;
 
 	struct stackframe sf;
 	int dw_ptr_size;
+
+	struct dw_rules_cache_entry *rules_cache;
 };
 
 struct quadd_dwarf_context {
 	struct dwarf_cpu_context __percpu *cpu_ctx;
 	atomic_t started;
+
+	atomic_t cache_gen;
 };
 
 struct dw_cie {
@@ -181,6 +208,37 @@ struct eh_sec_data {
 	unsigned char *data;
 };
 
+enum {
+	DW_CACHE_ENTRY_EMPTY,
+	DW_CACHE_ENTRY_BUSY,
+	DW_CACHE_ENTRY_VALID,
+};
+
+#define DW_CIE_CACHE_SIZE	8
+
+struct dw_cie_cache_entry {
+	atomic_t state;
+	struct dw_cie cie;
+};
+
+struct dw_fde_index {
+	struct dw_fde_table *bst;
+	unsigned long nr_entries;
+};
+
+/*
+ * Per mmap area cache of the data decoded from the unwind sections:
+ * the location of the .eh_frame_hdr/.debug_frame_hdr search tables and
+ * the CIEs. Neither depends on the address the file is mapped at (except
+ * the CIE personality routine, which is not used for unwinding). Both
+ * arrays are indexed by is_eh. Entries are filled from the sampling context
+ * and are never modified after they become valid.
+ */
+struct quadd_dwarf_cache {
+	struct dw_fde_index fde_idx[2];
+	struct dw_cie_cache_entry cie[2][DW_CIE_CACHE_SIZE];
+};
+
 static struct quadd_dwarf_context ctx;
 
 static inline int regnum_sp(int mode)
@@ -1438,6 +1496,72 @@ decode_fde_entry(struct ex_region_info *ri,
 	return 0;
 }
 
+static int
+cie_cache_get(struct ex_region_info *ri,
+	      unsigned long offset,
+	      struct dw_cie *cie,
+	      int is_eh)
+{
+	int i;
+	struct dw_cie_cache_entry *entry;
+	struct quadd_dwarf_cache *cache = ri->mmap->fi.dw_cache;
+
+	if (!cache)
+		return 0;
+
+	for (i = 0; i < DW_CIE_CACHE_SIZE; i++) {
+		entry = &cache->cie[is_eh][i];
+
+		switch (atomic_read(&entry->state)) {
+		case DW_CACHE_ENTRY_EMPTY:
+			/* slots are taken in order */
+			return 0;
+
+		case DW_CACHE_ENTRY_VALID:
+			smp_rmb();
+			if (entry->cie.offset == offset) {
+				*cie = entry->cie;
+				return 1;
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static void
+cie_cache_put(struct ex_region_info *ri,
+	      const struct dw_cie *cie,
+	      int is_eh)
+{
+	int i;
+	struct dw_cie_cache_entry *entry;
+	struct quadd_dwarf_cache *cache = ri->mmap->fi.dw_cache;
+
+	if (!cache)
+		return;
+
+	for (i = 0; i < DW_CIE_CACHE_SIZE; i++) {
+		entry = &cache->cie[is_eh][i];
+
+		if (atomic_cmpxchg(&entry->state, DW_CACHE_ENTRY_EMPTY,
+				   DW_CACHE_ENTRY_BUSY) != DW_CACHE_ENTRY_EMPTY)
+			continue;
+
+		entry->cie = *cie;
+		smp_wmb();
+		atomic_set(&entry->state, DW_CACHE_ENTRY_VALID);
+
+		return;
+	}
+
+	pr_debug("%s: cie cache is full\n", __func__);
+}
+
 static const struct dw_fde_table *
 dwarf_bst_find_idx(unsigned long data_base,
 		   struct dw_fde_table *fde_table,
@@ -1548,6 +1672,43 @@ dwarf_get_bs_table(struct ex_region_info *ri,
 	return bst;
 }
 
+/*
+ * The search table from the frame header is already a sorted array of
+ * 8-byte entries, so it is searched in place and only the result of
+ * parsing the header is cached.
+ */
+static struct dw_fde_table *
+dwarf_get_fde_index(struct ex_region_info *ri,
+		    void *data,
+		    unsigned long length,
+		    unsigned long data_base,
+		    unsigned long *nr_entries,
+		    int is_eh)
+{
+	struct dw_fde_table *bst;
+	struct dw_fde_index *idx = NULL;
+	struct quadd_dwarf_cache *cache = ri->mmap->fi.dw_cache;
+
+	if (cache) {
+		idx = &cache->fde_idx[is_eh];
+
+		bst = smp_load_acquire(&idx->bst);
+		if (bst) {
+			*nr_entries = idx->nr_entries;
+			return bst;
+		}
+	}
+
+	bst = dwarf_get_bs_table(ri, data, length, data_base,
+				 nr_entries, is_eh);
+	if (bst && idx) {
+		idx->nr_entries = *nr_entries;
+		smp_store_release(&idx->bst, bst);
+	}
+
+	return bst;
+}
+
 static long
 dwarf_decode_fde_cie(struct ex_region_info *ri,
 		     unsigned char *fde_p,
@@ -1559,7 +1720,7 @@ dwarf_decode_fde_cie(struct ex_region_info *ri,
 	int secid;
 	long err;
 	unsigned char *cie_p;
-	unsigned long cie_pointer, length;
+	unsigned long cie_pointer, cie_offset, length;
 	unsigned char *frame_start;
 	unsigned long frame_len, addr;
 	struct extab_info *ti;
@@ -1602,26 +1763,31 @@ dwarf_decode_fde_cie(struct ex_region_info *ri,
 
 	cie_p = is_eh ? (unsigned char *)p - cie_pointer :
 		frame_start + cie_pointer;
+	cie_offset = cie_p - frame_start;
 
-	length = read_mmap_data_u32(ri, (u32 *)cie_p,
-				    secid, &err);
-	if (err)
-		return err;
+	if (!cie_cache_get(ri, cie_offset, cie, is_eh)) {
+		length = read_mmap_data_u32(ri, (u32 *)cie_p,
+					    secid, &err);
+		if (err)
+			return err;
 
-	if (length == 0xffffffff) {
-		pr_warn_once("warning: 64-bit frame is not supported\n");
-		return -QUADD_URC_UNHANDLED_INSTRUCTION;
-	}
+		if (length == 0xffffffff) {
+			pr_warn_once("warning: 64-bit frame is not supported\n");
+			return -QUADD_URC_UNHANDLED_INSTRUCTION;
+		}
 
-	cie->offset = cie_p - frame_start;
-	cie->length = length + sizeof(u32);
+		cie->offset = cie_offset;
+		cie->length = length + sizeof(u32);
 
-	pr_debug("CIE: cie_p: %p, offset: %#lx, len: %#lx\n",
-		 cie_p, cie->offset, cie->length);
+		pr_debug("CIE: cie_p: %p, offset: %#lx, len: %#lx\n",
+			 cie_p, cie->offset, cie->length);
 
-	err = decode_cie_entry(ri, cie, cie_p, cie->length, is_eh);
-	if (err < 0)
-		return err;
+		err = decode_cie_entry(ri, cie, cie_p, cie->length, is_eh);
+		if (err < 0)
+			return err;
+
+		cie_cache_put(ri, cie, is_eh);
+	}
 
 	fde->cie = cie;
 
@@ -1655,8 +1821,8 @@ dwarf_find_fde(struct ex_region_info *ri,
 	ti = &ri->mmap->fi.ex_sec[secid_hdr];
 	data_base = get_ex_sec_address(ri, ti, secid_hdr);
 
-	bst = dwarf_get_bs_table(ri, data, length, data_base,
-				 &fde_count, is_eh);
+	bst = dwarf_get_fde_index(ri, data, length, data_base,
+				  &fde_count, is_eh);
 	if (!bst || fde_count == 0) {
 		pr_warn_once("warning: bs_table\n");
 		return NULL;
@@ -1830,17 +1996,60 @@ static long def_cfa(struct stackframe *sf, struct regs_state *rs)
 	return 0;
 }
 
+static struct dw_rules_cache_entry *
+rules_cache_lookup(struct ex_region_info *ri, unsigned long pc, int mode)
+{
+	struct dw_rules_cache_entry *entry;
+	struct dwarf_cpu_context *cpu_ctx = this_cpu_ptr(ctx.cpu_ctx);
+
+	if (!cpu_ctx->rules_cache || !ri->mmap->fi.dw_cache)
+		return NULL;
+
+	entry = &cpu_ctx->rules_cache[hash_long(pc, DW_RULES_CACHE_BITS)];
+
+	if (entry->pc != pc ||
+	    entry->mmap != ri->mmap ||
+	    entry->vm_start != ri->vm_start ||
+	    entry->mode != mode ||
+	    entry->gen != atomic_read(&ctx.cache_gen))
+		return NULL;
+
+	return entry;
+}
+
+static void
+rules_cache_store(struct ex_region_info *ri,
+		  unsigned long pc,
+		  int mode,
+		  int is_eh,
+		  const struct regs_state *rs)
+{
+	struct dw_rules_cache_entry *entry;
+	struct dwarf_cpu_context *cpu_ctx = this_cpu_ptr(ctx.cpu_ctx);
+
+	if (!cpu_ctx->rules_cache || !ri->mmap->fi.dw_cache)
+		return;
+
+	entry = &cpu_ctx->rules_cache[hash_long(pc, DW_RULES_CACHE_BITS)];
+
+	entry->pc = pc;
+	entry->mmap = ri->mmap;
+	entry->vm_start = ri->vm_start;
+	entry->gen = atomic_read(&ctx.cache_gen);
+	entry->mode = mode;
+	entry->is_eh = is_eh;
+
+	memcpy(&entry->rs, rs, sizeof(*rs));
+}
+
 static long
-unwind_frame(struct ex_region_info *ri,
-	     struct stackframe *sf,
-	     struct vm_area_struct *vma_sp,
-	     int is_eh,
-	     struct task_struct *task)
+dwarf_eval_rules(struct ex_region_info *ri,
+		 struct stackframe *sf,
+		 int is_eh,
+		 struct task_struct *task)
 {
-	int i, num_regs;
 	long err;
 	unsigned char *insn_end;
-	unsigned long addr, return_addr, val, user_reg_size;
 	struct dw_fde fde;
 	struct dw_cie cie;
 	unsigned long pc = sf->pc;
@@ -1879,6 +2088,56 @@ unwind_frame(struct ex_region_info *ri,
 			return err;
 	}
 
+	return 0;
+}
+
+/*
+ * Fill sf->rs with the register rules for sf->pc, reusing the rules
+ * computed for the same PC by a previous sample if possible.
+ */
+static long
+unwind_frame_rules(struct ex_region_info *ri,
+		   struct stackframe *sf,
+		   int is_eh,
+		   struct task_struct *task)
+{
+	long err;
+	unsigned long pc = sf->pc;
+	struct dw_rules_cache_entry *entry;
+
+	entry = rules_cache_lookup(ri, pc, sf->mode);
+	if (entry && entry->is_eh == is_eh) {
+		memcpy(&sf->rs, &entry->rs, sizeof(sf->rs));
+		return 0;
+	}
+
+	err = dwarf_eval_rules(ri, sf, is_eh, task);
+	if (err < 0)
+		return err;
+
+	rules_cache_store(ri, pc, sf->mode, is_eh, &sf->rs);
+
+	return 0;
+}
+
+static long
+unwind_frame(struct ex_region_info *ri,
+	     struct stackframe *sf,
+	     struct vm_area_struct *vma_sp,
+	     int is_eh,
+	     struct task_struct *task)
+{
+	int i, num_regs;
+	long err;
+	unsigned long addr, return_addr, val, user_reg_size;
+	unsigned long pc = sf->pc;
+	struct regs_state *rs = &sf->rs;
+	int mode = sf->mode;
+
+	err = unwind_frame_rules(ri, sf, is_eh, task);
+	if (err < 0)
+		return err;
+
 	pr_debug("mode: %s\n", (mode == DW_MODE_ARM32) ? "arm32" : "arm64");
 	pr_debug("initial cfa: %#lx\n", sf->cfa);
 
@@ -1994,6 +2253,7 @@ unwind_backtrace(struct quadd_callchain *cc,
 		long sp, err;
 		int nr_added, is_stack_ok;
 		int __is_eh, __is_debug;
+		struct dw_rules_cache_entry *rc;
 		struct vm_area_struct *vma_pc;
 		unsigned long addr, where = sf->pc;
 		struct mm_struct *mm = task->mm;
@@ -2034,21 +2294,28 @@ unwind_backtrace(struct quadd_callchain *cc,
 			prev_ri = ri = &ri_new;
 		}
 
-		if (!is_fde_entry_exist(ri, sf->pc, &__is_eh,
-					&__is_debug, task)) {
-			pr_debug("eh/debug fde entries are not existed\n");
-			cc->urc_dwarf = QUADD_URC_IDX_NOT_FOUND;
-			break;
-		}
-		pr_debug("is_eh: %d, is_debug: %d\n", __is_eh, __is_debug);
-
-		if (is_eh) {
-			if (!__is_eh)
-				is_eh = 0;
+		rc = rules_cache_lookup(ri, sf->pc, mode);
+		if (rc) {
+			is_eh = rc->is_eh;
+			__is_eh = is_eh;
+			__is_debug = !is_eh;
 		} else {
-			if (!__is_debug)
-				is_eh = 1;
+			if (!is_fde_entry_exist(ri, sf->pc, &__is_eh,
+						&__is_debug, task)) {
+				pr_debug("eh/debug fde entries are not existed\n");
+				cc->urc_dwarf = QUADD_URC_IDX_NOT_FOUND;
+				break;
+			}
+
+			if (is_eh) {
+				if (!__is_eh)
+					is_eh = 0;
+			} else {
+				if (!__is_debug)
+					is_eh = 1;
+			}
 		}
+		pr_debug("is_eh: %d, is_debug: %d\n", __is_eh, __is_debug);
 
 		err = unwind_frame(ri, sf, vma_sp, is_eh, task);
 		if (err < 0) {
@@ -2230,14 +2497,56 @@ quadd_get_user_cc_dwarf(struct quadd_event_context *event_ctx,
 	return cc->nr;
 }
 
+void quadd_dwarf_cache_alloc(struct quadd_mmap_area *mmap)
+{
+	if (!mmap->fi.dw_cache)
+		mmap->fi.dw_cache = kzalloc(sizeof(*mmap->fi.dw_cache),
+					    GFP_ATOMIC);
+}
+
+void quadd_dwarf_cache_free(struct quadd_mmap_area *mmap)
+{
+	/* cached register rules may point to the tables of this area */
+	atomic_inc(&ctx.cache_gen);
+
+	kfree(mmap->fi.dw_cache);
+	mmap->fi.dw_cache = NULL;
+}
+
+static void free_cpu_contexts(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		kfree(per_cpu_ptr(ctx.cpu_ctx, cpu)->rules_cache);
+
+	free_percpu(ctx.cpu_ctx);
+}
+
 int quadd_dwarf_unwind_start(void)
 {
+	int cpu;
+	struct dwarf_cpu_context *cpu_ctx;
+
 	if (!atomic_cmpxchg(&ctx.started, 0, 1)) {
 		ctx.cpu_ctx = alloc_percpu(struct dwarf_cpu_context);
 		if (!ctx.cpu_ctx) {
 			atomic_set(&ctx.started, 0);
 			return -ENOMEM;
 		}
+
+		for_each_possible_cpu(cpu) {
+			cpu_ctx = per_cpu_ptr(ctx.cpu_ctx, cpu);
+			cpu_ctx->rules_cache =
+				kzalloc_node(DW_RULES_CACHE_SIZE *
+					     sizeof(*cpu_ctx->rules_cache),
+					     GFP_KERNEL, cpu_to_node(cpu));
+			if (!cpu_ctx->rules_cache) {
+				free_cpu_contexts();
+				atomic_set(&ctx.started, 0);
+				return -ENOMEM;
+			}
+		}
 	}
 
 	return 0;
@@ -2246,11 +2555,260 @@ int quadd_dwarf_unwind_start(void)
 void quadd_dwarf_unwind_stop(void)
 {
 	if (atomic_cmpxchg(&ctx.started, 1, 0))
-		free_percpu(ctx.cpu_ctx);
+		free_cpu_contexts();
+}
+
+#ifdef CONFIG_TEGRA_PROFILER_DWARF_SELFTEST
+
+/*
+ * Synthetic aarch64 .eh_frame_hdr/.eh_frame pair: one CIE (CFA = sp) and
+ * one FDE per function with a typical "stp x29, x30, [sp, #-16]!" prologue.
+ * The register values are not read from a user stack here, so the test
+ * covers the table lookup and the CFA program evaluation of every frame.
+ */
+#define DW_SELFTEST_NR_FUNCS	1024
+#define DW_SELFTEST_FUNC_SIZE	64
+#define DW_SELFTEST_NR_HOT	16
+#define DW_SELFTEST_NR_FRAMES	4096
+
+#define DW_SELFTEST_VM_START	0x400000UL
+#define DW_SELFTEST_SEC_ADDR	0x1000UL
+#define DW_SELFTEST_TEXT	0x100000UL
+#define DW_SELFTEST_SP		0x7ff000UL
+
+#define DW_SELFTEST_HDR_LEN	12
+#define DW_SELFTEST_CIE_LEN	20
+#define DW_SELFTEST_FDE_LEN	24
+
+static unsigned char *selftest_put_u32(unsigned char *p, u32 val)
+{
+	put_unaligned(val, (u32 *)p);
+	return p + sizeof(u32);
 }
 
+static int
+dwarf_selftest_build(struct quadd_mmap_area *mmap, struct ex_region_info *ri)
+{
+	int i;
+	struct extab_info *ti;
+	struct dw_fde_table *bst;
+	unsigned char *p, *hdr, *frame;
+	unsigned long hdr_len, frame_len, frame_off;
+	unsigned long hdr_addr, frame_addr, func_addr, fde_addr;
+
+	hdr_len = DW_SELFTEST_HDR_LEN +
+		  DW_SELFTEST_NR_FUNCS * sizeof(struct dw_fde_table);
+	frame_off = ALIGN(hdr_len, 16);
+	frame_len = DW_SELFTEST_CIE_LEN +
+		    DW_SELFTEST_NR_FUNCS * DW_SELFTEST_FDE_LEN + sizeof(u32);
+
+	mmap->data = vzalloc(frame_off + frame_len);
+	if (!mmap->data)
+		return -ENOMEM;
+
+	mmap->type = QUADD_MMAP_TYPE_EXTABS;
+	atomic_set(&mmap->state, QUADD_MMAP_STATE_ACTIVE);
+	atomic_set(&mmap->ref_count, 0);
+	raw_spin_lock_init(&mmap->state_lock);
+
+	ti = &mmap->fi.ex_sec[QUADD_SEC_TYPE_EH_FRAME_HDR];
+	ti->addr = DW_SELFTEST_SEC_ADDR;
+	ti->length = hdr_len;
+	ti->mmap_offset = 0;
+
+	ti = &mmap->fi.ex_sec[QUADD_SEC_TYPE_EH_FRAME];
+	ti->addr = DW_SELFTEST_SEC_ADDR + frame_off;
+	ti->length = frame_len;
+	ti->mmap_offset = frame_off;
+
+	ri->vm_start = DW_SELFTEST_VM_START;
+	ri->vm_end = DW_SELFTEST_VM_START + DW_SELFTEST_TEXT +
+		     DW_SELFTEST_NR_FUNCS * DW_SELFTEST_FUNC_SIZE;
+	ri->mmap = mmap;
+	ri->file_hash = 0;
+
+	hdr_addr = ri->vm_start + DW_SELFTEST_SEC_ADDR;
+	frame_addr = hdr_addr + frame_off;
+
+	hdr = mmap->data;
+	hdr[0] = 1;
+	hdr[1] = DW_EH_PE_pcrel | DW_EH_PE_sdata4;
+	hdr[2] = DW_EH_PE_udata4;
+	hdr[3] = DW_EH_PE_datarel | DW_EH_PE_sdata4;
+	selftest_put_u32(hdr + 4, frame_addr - (hdr_addr + 4));
+	selftest_put_u32(hdr + 8, DW_SELFTEST_NR_FUNCS);
+	bst = (struct dw_fde_table *)(hdr + DW_SELFTEST_HDR_LEN);
+
+	frame = mmap->data + frame_off;
+	p = frame;
+
+	/* CIE: "zR", code align: 4, data align: -8, return address: x30 */
+	p = selftest_put_u32(p, DW_SELFTEST_CIE_LEN - sizeof(u32));
+	p = selftest_put_u32(p, 0);
+	*p++ = 1;
+	*p++ = 'z';
+	*p++ = 'R';
+	*p++ = '\0';
+	*p++ = 4;
+	*p++ = 0x78;
+	*p++ = ARM64_LR;
+	*p++ = 1;
+	*p++ = DW_EH_PE_pcrel | DW_EH_PE_sdata4;
+	*p++ = DW_CFA_def_cfa;
+	*p++ = ARM64_SP;
+	*p++ = 0;
+
+	for (i = 0; i < DW_SELFTEST_NR_FUNCS; i++) {
+		func_addr = ri->vm_start + DW_SELFTEST_TEXT +
+			    i * DW_SELFTEST_FUNC_SIZE;
+		fde_addr = frame_addr + (p - frame);
+
+		bst[i].initial_loc = func_addr - hdr_addr;
+		bst[i].fde = fde_addr - hdr_addr;
+
+		p = selftest_put_u32(p, DW_SELFTEST_FDE_LEN - sizeof(u32));
+		p = selftest_put_u32(p, p - frame);
+		p = selftest_put_u32(p, func_addr - (fde_addr + 8));
+		p = selftest_put_u32(p, DW_SELFTEST_FUNC_SIZE);
+		*p++ = 0;
+
+		/* cfa = sp + 16, x29 at cfa - 16, x30 at cfa - 8 */
+		*p++ = DW_CFA_advance_loc | 1;
+		*p++ = DW_CFA_def_cfa_offset;
+		*p++ = 16;
+		*p++ = DW_CFA_offset | ARM64_FP;
+		*p++ = 2;
+		*p++ = DW_CFA_offset | ARM64_LR;
+		*p++ = 1;
+	}
+
+	return 0;
+}
+
+static long
+dwarf_selftest_frame(struct ex_region_info *ri,
+		     struct stackframe *sf,
+		     unsigned long pc)
+{
+	long err;
+	int is_eh, is_debug;
+	struct regs_state *rs = &sf->rs;
+
+	sf->pc = pc;
+	sf->cfa = 0;
+	sf->vregs[ARM64_SP] = DW_SELFTEST_SP;
+
+	if (!rules_cache_lookup(ri, pc, sf->mode) &&
+	    !is_fde_entry_exist(ri, pc, &is_eh, &is_debug, current))
+		return -QUADD_URC_IDX_NOT_FOUND;
+
+	err = unwind_frame_rules(ri, sf, 1, current);
+	if (err < 0)
+		return err;
+
+	err = def_cfa(sf, rs);
+	if (err < 0)
+		return err;
+
+	if (sf->cfa != DW_SELFTEST_SP + 16 ||
+	    rs->reg[ARM64_FP].where != DW_WHERE_CFAREL ||
+	    rs->reg[ARM64_FP].loc.offset != -16 ||
+	    rs->reg[ARM64_LR].where != DW_WHERE_CFAREL ||
+	    rs->reg[ARM64_LR].loc.offset != -8)
+		return -QUADD_URC_FAILURE;
+
+	return 0;
+}
+
+static int dwarf_selftest_run(struct ex_region_info *ri, u64 *ns)
+{
+	u64 start;
+	int i, errors = 0;
+	unsigned long func, pc;
+	struct stackframe *sf;
+	struct dwarf_cpu_context *cpu_ctx;
+
+	preempt_disable();
+
+	cpu_ctx = this_cpu_ptr(ctx.cpu_ctx);
+	cpu_ctx->dw_ptr_size = sizeof(u64);
+
+	sf = &cpu_ctx->sf;
+	sf->mode = DW_MODE_ARM64;
+	/* keep the tail info of the synthetic tables untouched */
+	sf->is_sched = 1;
+
+	start = ktime_get_ns();
+
+	for (i = 0; i < DW_SELFTEST_NR_FRAMES; i++) {
+		func = (i % DW_SELFTEST_NR_HOT) *
+		       (DW_SELFTEST_NR_FUNCS / DW_SELFTEST_NR_HOT);
+		pc = ri->vm_start + DW_SELFTEST_TEXT +
+		     func * DW_SELFTEST_FUNC_SIZE + 16;
+
+		if (dwarf_selftest_frame(ri, sf, pc) < 0)
+			errors++;
+	}
+
+	*ns = div_u64(ktime_get_ns() - start, DW_SELFTEST_NR_FRAMES);
+
+	preempt_enable();
+
+	return errors;
+}
+
+static void dwarf_unwind_selftest(void)
+{
+	int errors;
+	u64 ns, ns_cached = 0;
+	struct ex_region_info ri;
+	struct quadd_mmap_area *mmap;
+
+	mmap = kzalloc(sizeof(*mmap), GFP_KERNEL);
+	if (!mmap)
+		return;
+
+	if (dwarf_selftest_build(mmap, &ri) < 0)
+		goto out_free;
+
+	if (quadd_dwarf_unwind_start() < 0)
+		goto out_free;
+
+	errors = dwarf_selftest_run(&ri, &ns);
+
+	quadd_dwarf_cache_alloc(mmap);
+	if (mmap->fi.dw_cache) {
+		/* the first pass fills the caches */
+		errors += dwarf_selftest_run(&ri, &ns_cached);
+		errors += dwarf_selftest_run(&ri, &ns_cached);
+	}
+
+	quadd_dwarf_cache_free(mmap);
+	quadd_dwarf_unwind_stop();
+
+	pr_info("dwarf self-test %s: %d frames, %llu ns/frame, cached: %llu ns/frame\n",
+		errors ? "failed" : "passed", DW_SELFTEST_NR_FRAMES,
+		ns, ns_cached);
+
+out_free:
+	vfree(mmap->data);
+	kfree(mmap);
+}
+
+#else
+
+static inline void dwarf_unwind_selftest(void)
+{
+}
+
+#endif	/* CONFIG_TEGRA_PROFILER_DWARF_SELFTEST */
+
 int quadd_dwarf_unwind_init(void)
 {
 	atomic_set(&ctx.started, 0);
+	atomic_set(&ctx.cache_gen, 0);
+
+	dwarf_unwind_selftest();
+
 	return 0;
 }
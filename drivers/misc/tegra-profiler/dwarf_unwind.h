@@ -1,7 +1,7 @@
 /*
  * drivers/misc/tegra-profiler/dwarf_unwind.h
  *
- * Copyright (c) 2015-2017, NVIDIA CORPORATION.  All rights reserved.
+ * Copyright (c) 2015-2019, NVIDIA CORPORATION.  All rights reserved.
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms and conditions of the GNU General Public License,
@@ -19,6 +19,7 @@
 
 struct quadd_callchain;
 struct quadd_event_context;
+struct quadd_mmap_area;
 
 int
 quadd_is_ex_entry_exist_dwarf(struct quadd_event_context *event_ctx,
@@ -28,6 +29,9 @@ unsigned int
 quadd_get_user_cc_dwarf(struct quadd_event_context *event_ctx,
 			struct quadd_callchain *cc);
 
+void quadd_dwarf_cache_alloc(struct quadd_mmap_area *mmap);
+void quadd_dwarf_cache_free(struct quadd_mmap_area *mmap);
+
 int quadd_dwarf_unwind_start(void);
 void quadd_dwarf_unwind_stop(void);
 int quadd_dwarf_unwind_init(void);
@@ -796,6 +796,9 @@ int quadd_unwind_set_extab(struct quadd_sections *extabs,
 			ti->length = si->length;
 			ti->mmap_offset = si->mmap_offset;
 		}
+
+		/* the unwinder works without its caches, so ignore errors */
+		quadd_dwarf_cache_alloc(mmap);
 	}
 
 	ri_entry.vm_start = extabs->vm_start;
@@ -892,6 +895,7 @@ static void mmap_wait_for_close(struct quadd_mmap_area *mmap)
 void quadd_unwind_clean_mmap(struct quadd_mmap_area *mmap)
 {
 	mmap_wait_for_close(mmap);
+	quadd_dwarf_cache_free(mmap);
 	clean_mmap(mmap);
 }
 
@@ -1,7 +1,7 @@
 /*
  * drivers/misc/tegra-profiler/eh_unwind.h
  *
- * Copyright (c) 2015-2018, NVIDIA CORPORATION.  All rights reserved.
+ * Copyright (c) 2015-2019, NVIDIA CORPORATION.  All rights reserved.
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms and conditions of the GNU General Public License,
@@ -24,6 +24,7 @@ struct quadd_ctx;
 struct task_struct;
 struct quadd_mmap_area;
 struct quadd_event_context;
+struct quadd_dwarf_cache;
 
 struct extab_info {
 	unsigned long addr;
@@ -39,6 +40,8 @@ struct file_ex_region_info {
 	struct extab_info ex_sec[QUADD_SEC_TYPE_MAX];
 	u32 file_hash;
 
+	struct quadd_dwarf_cache *dw_cache;
+
 	unsigned int is_shared:1;
 };
 
@@ -185,11 +185,15 @@ quadd_put_sample_this_cpu(struct quadd_record_data *data,
 	__put_sample(data, vec, vec_count, -1);
 }
 
+/*
+ * Samples which are not bound to a CPU go to the ring buffer of the
+ * current CPU, so that each ring buffer has a single producer.
+ */
 void
 quadd_put_sample(struct quadd_record_data *data,
 		 struct quadd_iovec *vec, int vec_count)
 {
-	__put_sample(data, vec, vec_count, 0);
+	__put_sample(data, vec, vec_count, -1);
 }
 
 static void put_header(int cpuid)
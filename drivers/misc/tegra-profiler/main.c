@@ -576,6 +576,7 @@ get_capabilities(struct quadd_comm_cap *cap)
 	extra |= QUADD_COMM_CAP_EXTRA_UNW_ENTRY_TYPE;
 	extra |= QUADD_COMM_CAP_EXTRA_RB_MMAP_OP;
 	extra |= QUADD_COMM_CAP_EXTRA_CPU_MASK;
+	extra |= QUADD_COMM_CAP_EXTRA_RB_POLL;
 
 	if (ctx.hrt->tc) {
 		extra |= QUADD_COMM_CAP_EXTRA_ARCH_TIMER;
@@ -24,6 +24,8 @@
 #include <linux/list.h>
 #include <linux/of_device.h>
 #include <linux/of_gpio.h>
+#include <linux/mm.h>
+#include <linux/math64.h>
 #include <asm/arch_timer.h>
 #include <linux/platform/tegra/ptp-notifier.h>
 #include <uapi/linux/nvpps_ioctl.h>
@@ -38,6 +40,13 @@
 #define MAX_NVPPS_SOURCES	1
 #define NVPPS_DEF_MODE 		NVPPS_MODE_GPIO
 
+/* drift estimate: EWMA weight 1/8, kept in ppb << 8 */
+#define NVPPS_DRIFT_SHIFT	3
+#define NVPPS_DRIFT_FRAC	8
+/* intervals outside these bounds are a PTP step or bogus, not drift */
+#define NVPPS_DRIFT_MAX_PPB	1000000
+#define NVPPS_DRIFT_MAX_NS	(10ULL * NSEC_PER_SEC)
+
 /* statics */
 static struct class	*s_nvpps_class;
 static dev_t 		s_nvpps_devt;
@@ -62,8 +71,15 @@ struct nvpps_device_data {
 	u64			phc;
 	u64			irq_latency;
 	u64 			tsc_res_ns;
+	u32			tsc_freq;
 	raw_spinlock_t		lock;
 
+	/* event history and drift estimate, also mapped to user space */
+	struct nvpps_history_page	*hist;
+	s64			drift_ppb_q;
+	u64			last_tsc_ns;
+	u64			last_phc;
+
 	u32			evt_mode;
 	u32			tsc_mode;
 
@@ -154,6 +170,84 @@ static inline u64 get_systime(struct nvpps_device_data *pdev_data, u64 *tsc)
 
 
 
+static inline u64 nvpps_tsc_to_ns(struct nvpps_device_data *pdev_data, u64 tsc)
+{
+	/* split to avoid overflowing the multiply */
+	return div_u64(tsc, pdev_data->tsc_freq) * NSEC_PER_SEC +
+		div_u64((tsc % pdev_data->tsc_freq) * NSEC_PER_SEC,
+			pdev_data->tsc_freq);
+}
+
+
+/*
+ * Fold the interval since the previous event into the PTP/TSC drift
+ * estimate. Called with pdev_data->lock held.
+ */
+static void nvpps_update_drift(struct nvpps_device_data *pdev_data,
+				u64 tsc_ns, u64 phc)
+{
+	struct nvpps_drift	*drift = &pdev_data->hist->drift;
+	s64			d_tsc, d_err, ppb;
+
+	if (phc && pdev_data->last_phc) {
+		d_tsc = tsc_ns - pdev_data->last_tsc_ns;
+		d_err = (phc - pdev_data->last_phc) - d_tsc;
+		/* bound the error before scaling it, a PTP step can be huge */
+		if ((d_tsc > 0) && (d_tsc <= NVPPS_DRIFT_MAX_NS) &&
+			(abs(d_err) <= div_s64(d_tsc * NVPPS_DRIFT_MAX_PPB, NSEC_PER_SEC))) {
+			ppb = div64_s64(d_err * NSEC_PER_SEC, d_tsc);
+			ppb *= (1 << NVPPS_DRIFT_FRAC);
+			if (drift->nsamples == 0) {
+				pdev_data->drift_ppb_q = ppb;
+			} else {
+				pdev_data->drift_ppb_q +=
+					(ppb - pdev_data->drift_ppb_q) /
+					(1 << NVPPS_DRIFT_SHIFT);
+			}
+			drift->nsamples++;
+			drift->ppb = pdev_data->drift_ppb_q /
+					(1 << NVPPS_DRIFT_FRAC);
+		}
+	}
+
+	pdev_data->last_tsc_ns = tsc_ns;
+	pdev_data->last_phc = phc;
+	if (phc) {
+		drift->tsc_ref_ns = tsc_ns;
+		drift->ptp_ref = phc;
+		drift->evt_nb = pdev_data->pps_event_id;
+	}
+}
+
+
+/*
+ * Record the event into the history page. Called with pdev_data->lock held.
+ */
+static void nvpps_record_event(struct nvpps_device_data *pdev_data)
+{
+	struct nvpps_history_page	*hist = pdev_data->hist;
+	struct nvpps_ts_sample		*sample;
+
+	hist->lock++;
+	smp_wmb();
+
+	sample = &hist->samples[pdev_data->pps_event_id % NVPPS_HISTORY_LEN];
+	sample->seq = pdev_data->pps_event_id;
+	sample->tsc = pdev_data->tsc;
+	sample->ptp = pdev_data->phc;
+	sample->irq_latency = pdev_data->irq_latency;
+	hist->evt_nb = pdev_data->pps_event_id;
+	if (hist->count < NVPPS_HISTORY_LEN) {
+		hist->count++;
+	}
+	nvpps_update_drift(pdev_data,
+		nvpps_tsc_to_ns(pdev_data, pdev_data->tsc), pdev_data->phc);
+
+	smp_wmb();
+	hist->lock++;
+}
+
+
 /*
  * Report the PPS event
  */
@@ -229,6 +323,7 @@ static void nvpps_get_ts(struct nvpps_device_data *pdev_data, bool in_isr)
 	pdev_data->phc = phc ? phc - irq_latency : phc;
 #endif /* NVPPS_ARM_COUNTER_PROFILING || NVPPS_EQOS_REG_PROFILING */
 	pdev_data->irq_latency = irq_latency;
+	nvpps_record_event(pdev_data);
 	raw_spin_unlock_irqrestore(&pdev_data->lock, flags);
 
 	/*dev_info(pdev_data->dev, "evt(%d) tsc(%llu) phc(%llu)\n", pdev_data->pps_event_id, pdev_data->tsc, pdev_data->phc);*/
@@ -327,6 +422,75 @@ static unsigned int nvpps_poll(struct file *file, poll_table *wait)
 }
 
 
+static int nvpps_get_history(struct nvpps_file_data *pfile_data,
+				struct nvpps_history *req)
+{
+	struct nvpps_device_data	*pdev_data = pfile_data->pdev_data;
+	struct nvpps_history_page	*hist = pdev_data->hist;
+	struct nvpps_ts_sample __user	*usamples;
+	struct nvpps_ts_sample		*samples;
+	unsigned long			flags;
+	u32				oldest, seq, n = 0;
+	int				err = 0;
+
+	usamples = (struct nvpps_ts_sample __user *)(uintptr_t)req->samples;
+	req->count = min_t(u32, req->count, NVPPS_HISTORY_LEN);
+	req->lost = 0;
+
+	samples = kmalloc_array(NVPPS_HISTORY_LEN, sizeof(*samples), GFP_KERNEL);
+	if (!samples) {
+		return -ENOMEM;
+	}
+
+	raw_spin_lock_irqsave(&pdev_data->lock, flags);
+	seq = req->start_seq;
+	oldest = hist->evt_nb - hist->count + 1;
+	if (hist->count && ((s32)(seq - oldest) < 0)) {
+		req->lost = oldest - seq;
+		seq = oldest;
+	}
+	while ((n < req->count) && hist->count &&
+		((s32)(hist->evt_nb - seq) >= 0)) {
+		samples[n++] = hist->samples[seq % NVPPS_HISTORY_LEN];
+		seq++;
+	}
+	if (n) {
+		pfile_data->pps_event_id_rd = seq - 1;
+	}
+	raw_spin_unlock_irqrestore(&pdev_data->lock, flags);
+
+	req->count = n;
+	req->next_seq = seq;
+	if (n && copy_to_user(usamples, samples, n * sizeof(*samples))) {
+		err = -EFAULT;
+	}
+
+	kfree(samples);
+	return err;
+}
+
+
+static int nvpps_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct nvpps_file_data		*pfile_data = (struct nvpps_file_data *)file->private_data;
+	struct nvpps_device_data	*pdev_data = pfile_data->pdev_data;
+
+	if ((vma->vm_end - vma->vm_start) > PAGE_SIZE || vma->vm_pgoff) {
+		return -EINVAL;
+	}
+
+	/* the history is kernel owned, no writable mappings */
+	if (vma->vm_flags & VM_WRITE) {
+		return -EPERM;
+	}
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return remap_pfn_range(vma, vma->vm_start,
+			virt_to_phys(pdev_data->hist) >> PAGE_SHIFT,
+			vma->vm_end - vma->vm_start, vma->vm_page_prot);
+}
+
+
 static int nvpps_fasync(int fd, struct file *file, int on)
 {
 	struct nvpps_file_data		*pfile_data = (struct nvpps_file_data *)file->private_data;
@@ -421,6 +585,43 @@ static long nvpps_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			break;
 		}
 
+		case NVPPS_GETHISTORY: {
+			struct nvpps_history	history;
+
+			dev_dbg(pdev_data->dev, "NVPPS_GETHISTORY\n");
+
+			err = copy_from_user(&history, uarg, sizeof(struct nvpps_history));
+			if (err) {
+				return -EFAULT;
+			}
+			err = nvpps_get_history(pfile_data, &history);
+			if (err) {
+				return err;
+			}
+			err = copy_to_user(uarg, &history, sizeof(struct nvpps_history));
+			if (err) {
+				return -EFAULT;
+			}
+			break;
+		}
+
+		case NVPPS_GETDRIFT: {
+			struct nvpps_drift	drift;
+			unsigned long 		flags;
+
+			dev_dbg(pdev_data->dev, "NVPPS_GETDRIFT\n");
+
+			raw_spin_lock_irqsave(&pdev_data->lock, flags);
+			drift = pdev_data->hist->drift;
+			raw_spin_unlock_irqrestore(&pdev_data->lock, flags);
+
+			err = copy_to_user(uarg, &drift, sizeof(struct nvpps_drift));
+			if (err) {
+				return -EFAULT;
+			}
+			break;
+		}
+
 		default:
 			return -ENOTTY;
 	}
@@ -469,6 +670,7 @@ static const struct file_operations nvpps_fops = {
 	.poll		= nvpps_poll,
 	.fasync		= nvpps_fasync,
 	.unlocked_ioctl	= nvpps_ioctl,
+	.mmap		= nvpps_mmap,
 	.open		= nvpps_open,
 	.release	= nvpps_close,
 };
@@ -486,6 +688,7 @@ static void nvpps_dev_release(struct device *dev)
 	mutex_unlock(&s_nvpps_lock);
 
 	kfree(dev);
+	free_page((unsigned long)pdev_data->hist);
 	kfree(pdev_data);
 }
 
@@ -510,10 +713,17 @@ static int nvpps_probe(struct platform_device *pdev)
 		return -ENOMEM;
 	}
 
+	BUILD_BUG_ON(sizeof(struct nvpps_history_page) > PAGE_SIZE);
+	pdev_data->hist = (struct nvpps_history_page *)get_zeroed_page(GFP_KERNEL);
+	if (!pdev_data->hist) {
+		kfree(pdev_data);
+		return -ENOMEM;
+	}
+
 	err = of_get_gpio(np, 0);
 	if (err < 0) {
 		dev_err(&pdev->dev, "unable to get GPIO from device tree\n");
-		return err;
+		goto error_free;
 	} else {
 		pdev_data->gpio_pin = (unsigned int)err;
 		dev_info(&pdev->dev, "gpio_pin(%d)\n", pdev_data->gpio_pin);
@@ -525,20 +735,22 @@ static int nvpps_probe(struct platform_device *pdev)
 		if (err) {
 			dev_err(&pdev->dev, "failed to request GPIO %u\n",
 				pdev_data->gpio_pin);
-			return err;
+			goto error_free;
 		}
 
 		err = gpio_direction_input(pdev_data->gpio_pin);
 		if (err) {
 			dev_err(&pdev->dev, "failed to set pin direction\n");
-			return -EINVAL;
+			err = -EINVAL;
+			goto error_free;
 		}
 
 		/* IRQ setup */
 		err = gpio_to_irq(pdev_data->gpio_pin);
 		if (err < 0) {
 			dev_err(&pdev->dev, "failed to map GPIO to IRQ: %d\n", err);
-			return -EINVAL;
+			err = -EINVAL;
+			goto error_free;
 		}
 		pdev_data->irq = err;
 		dev_info(&pdev->dev, "gpio_to_irq(%d)\n", pdev_data->irq);
@@ -559,6 +771,8 @@ static int nvpps_probe(struct platform_device *pdev)
 	#define _PICO_SECS (1000000000000ULL)
 	pdev_data->tsc_res_ns = (_PICO_SECS / (u64)arch_timer_get_cntfrq()) / 1000;
 	#undef _PICO_SECS
+	pdev_data->tsc_freq = arch_timer_get_cntfrq();
+	pdev_data->hist->tsc_res_ns = pdev_data->tsc_res_ns;
 	dev_info(&pdev->dev, "tsc_res_ns(%llu)\n", pdev_data->tsc_res_ns);
 
 	/* character device setup */
@@ -566,14 +780,15 @@ static int nvpps_probe(struct platform_device *pdev)
 	s_nvpps_class = class_create(THIS_MODULE, "nvpps");
 	if (IS_ERR(s_nvpps_class)) {
 		dev_err(&pdev->dev, "failed to allocate class\n");
-		return PTR_ERR(s_nvpps_class);
+		err = PTR_ERR(s_nvpps_class);
+		goto error_free;
 	}
 
 	err = alloc_chrdev_region(&s_nvpps_devt, 0, MAX_NVPPS_SOURCES, "nvpps");
 	if (err < 0) {
 		dev_err(&pdev->dev, "failed to allocate char device region\n");
 		class_destroy(s_nvpps_class);
-		return err;
+		goto error_free;
 	}
 #endif /* !NVPPS_NO_DT */
 
@@ -586,7 +801,7 @@ static int nvpps_probe(struct platform_device *pdev)
 			err = -EBUSY;
 		}
 		mutex_unlock(&s_nvpps_lock);
-		return err;
+		goto error_free;
 	}
 	pdev_data->id = err;
 	mutex_unlock(&s_nvpps_lock);
@@ -633,6 +848,10 @@ error_ret:
 	mutex_lock(&s_nvpps_lock);
 	idr_remove(&s_nvpps_idr, pdev_data->id);
 	mutex_unlock(&s_nvpps_lock);
+error_free:
+	/* no device yet, so nvpps_dev_release() won't free these */
+	free_page((unsigned long)pdev_data->hist);
+	kfree(pdev_data);
 	return err;
 }
 
@@ -42,6 +42,21 @@
 /* Allocate 100% extra desc to handle the drift between empty & full buffer */
 #define DMA_DESC_COUNT (2 * RING_COUNT)
 
+/*
+ * RX buffers are order-1 compound pages. Only the first page is mapped for
+ * the host to write the packet into, after RX_HEADROOM. The second page keeps
+ * skb_shared_info out of the host's reach so that the buffer can be passed
+ * to the stack with build_skb() instead of being copied.
+ */
+#define RX_BUF_ORDER 1
+#define RX_BUF_TRUESIZE (PAGE_SIZE << RX_BUF_ORDER)
+#define RX_HEADROOM NET_SKB_PAD
+#define RX_BUF_LEN (PAGE_SIZE - RX_HEADROOM)
+/* Max empty buffers allocated and published to host in one go */
+#define RX_REFILL_BATCH 64
+/* Max packets posted to the DMA write channel per doorbell */
+#define TX_BATCH_MAX 32
+
 enum irq_type {
 	/* No IRQ available in this slot */
 	IRQ_NOT_AVAILABLE = 0,
@@ -191,12 +206,10 @@ struct bar0_amap {
 	dma_addr_t phy;
 };
 
-struct h2ep_empty_list {
-	int size;
+/* Indexed by RX page number within the EP_RX_BUF region */
+struct h2ep_empty_buf {
 	struct page *page;
-	void *virt;
 	dma_addr_t iova;
-	struct list_head list;
 };
 
 #if ENABLE_DMA
@@ -204,8 +217,32 @@ struct dma_desc_cnt {
 	u32 rd_cnt;
 	u32 wr_cnt;
 };
+
+/* Source mapping behind a DMA write desc, released on completion */
+struct tvnet_tx_map {
+	dma_addr_t iova;
+	u32 len;
+	bool page;
+};
+
+/* Packet whose descs are posted but not yet rung/completed */
+struct tvnet_tx_pkt {
+	struct sk_buff *skb;
+	u64 dst_iova;
+	u32 len;
+};
 #endif
 
+struct tvnet_tx_stats {
+	u64 packets;
+	u64 bytes;
+	u64 sg_frags;
+	u64 doorbells;
+	u64 busy;
+	u64 dma_timeouts;
+	u64 dropped;
+};
+
 enum dir_link_state {
 	DIR_LINK_STATE_DOWN,
 	DIR_LINK_STATE_UP,
@@ -242,13 +279,18 @@ struct pci_epf_tvnet {
 	struct mutex link_state_lock;
 	wait_queue_head_t link_state_wq;
 	struct work_struct ctrl_msg_work;
-	struct work_struct h2ep_msg_work;
 	struct work_struct alloc_buf_work;
-	struct list_head h2ep_empty_list;
+	struct napi_struct napi;
+	struct h2ep_empty_buf *h2ep_empty_bufs;
 #if ENABLE_DMA
 	struct dma_desc_cnt desc_cnt;
+	struct tvnet_tx_map tx_maps[DMA_DESC_COUNT];
+	struct tvnet_tx_pkt tx_pkts[TX_BATCH_MAX];
+	int tx_pkt_cnt;
 #endif
-	/* To protect h2ep empty list */
+	/* Updated under netif_tx_lock */
+	struct tvnet_tx_stats tx_stats;
+	/* To protect h2ep empty buffer table, rx_buf_bitmap and ring writes */
 	spinlock_t h2ep_empty_lock;
 	dma_addr_t rx_buf_iova;
 	unsigned long *rx_buf_bitmap;
@@ -558,7 +600,7 @@ static void tvnet_iova_dealloc(struct pci_epf_tvnet *tvnet, dma_addr_t iova)
 	bitmap_release_region(tvnet->rx_buf_bitmap, pageno, 0);
 }
 
-static void tvnet_alloc_empty_buffers(struct pci_epf_tvnet *tvnet)
+static void tvnet_alloc_empty_buffers(struct pci_epf_tvnet *tvnet, gfp_t gfp)
 {
 	struct host_ring_buf *host_ring_buf = &tvnet->host_ring_buf;
 	struct host_own_cnt *host_cnt = host_ring_buf->host_cnt;
@@ -568,75 +610,75 @@ static void tvnet_alloc_empty_buffers(struct pci_epf_tvnet *tvnet)
 	struct device *cdev = epc->dev.parent;
 	struct iommu_domain *domain = iommu_get_domain_for_dev(cdev);
 	struct data_msg *h2ep_empty_msg = ep_ring_buf->h2ep_empty_msgs;
-	struct h2ep_empty_list *h2ep_empty_ptr;
-	int ret = 0;
-
-	while (!tvnet_ivc_full(ep_cnt, host_cnt, H2EP_EMPTY_BUF)) {
-		dma_addr_t iova;
-		struct page *page;
-		void *virt;
-		u32 idx;
-		unsigned long flags;
-
-		iova = tvnet_ivoa_alloc(tvnet);
-		if (iova == DMA_ERROR_CODE) {
-			dev_err(tvnet->fdev, "%s: iova alloc failed\n",
-				__func__);
-			break;
+	struct page *pages[RX_REFILL_BATCH];
+	int count, i, total = 0, ret;
+	u32 avail, wr_cnt;
+
+	do {
+		/* Allocate outside the lock, publish under it */
+		avail = tvnet_ivc_wr_available(ep_cnt, host_cnt,
+					       H2EP_EMPTY_BUF);
+		count = min_t(u32, avail, RX_REFILL_BATCH);
+		for (i = 0; i < count; i++) {
+			pages[i] = alloc_pages(gfp | __GFP_COMP | __GFP_NOWARN,
+					       RX_BUF_ORDER);
+			if (!pages[i])
+				break;
 		}
+		count = i;
+
+		spin_lock_bh(&tvnet->h2ep_empty_lock);
+		/* Another refill may have run in between */
+		avail = tvnet_ivc_wr_available(ep_cnt, host_cnt,
+					       H2EP_EMPTY_BUF);
+		wr_cnt = tvnet_ivc_get_wr_cnt(ep_cnt, host_cnt, H2EP_EMPTY_BUF);
+		for (i = 0; i < count && i < avail; i++) {
+			struct h2ep_empty_buf *buf;
+			dma_addr_t iova;
+			u32 idx;
+
+			iova = tvnet_ivoa_alloc(tvnet);
+			if (iova == DMA_ERROR_CODE)
+				break;
 
-		page = alloc_pages(GFP_KERNEL, 1);
-		if (!page) {
-			dev_err(tvnet->fdev, "%s: alloc_pages() failed\n",
-				__func__);
-			tvnet_iova_dealloc(tvnet, iova);
-			break;
-		}
+			ret = iommu_map(domain, iova, page_to_phys(pages[i]),
+					PAGE_SIZE,
+					IOMMU_CACHE | IOMMU_READ | IOMMU_WRITE);
+			if (ret < 0) {
+				dev_err(tvnet->fdev,
+					"%s: iommu_map(RAM) failed: %d\n",
+					__func__, ret);
+				tvnet_iova_dealloc(tvnet, iova);
+				break;
+			}
 
-		ret = iommu_map(domain, iova, page_to_phys(page), PAGE_SIZE,
-				IOMMU_CACHE | IOMMU_READ | IOMMU_WRITE);
-		if (ret < 0) {
-			dev_err(tvnet->fdev, "%s: iommu_map(RAM) failed: %d\n",
-				__func__, ret);
-			__free_pages(page, 1);
-			tvnet_iova_dealloc(tvnet, iova);
-			break;
-		}
+			buf = &tvnet->h2ep_empty_bufs[(iova - tvnet->rx_buf_iova)
+						      >> PAGE_SHIFT];
+			buf->page = pages[i];
+			buf->iova = iova;
 
-		virt = vmap(&page, 1, VM_MAP, PAGE_KERNEL);
-		if (!virt) {
-			dev_err(tvnet->fdev, "%s: vmap() failed\n", __func__);
-			iommu_unmap(domain, iova, PAGE_SIZE);
-			__free_pages(page, 1);
-			tvnet_iova_dealloc(tvnet, iova);
-			break;
+			idx = (wr_cnt + i) % RING_COUNT;
+			h2ep_empty_msg[idx].u.empty_buffer.pcie_address =
+							iova + RX_HEADROOM;
+			h2ep_empty_msg[idx].u.empty_buffer.buffer_len =
+							RX_BUF_LEN;
 		}
 
-		h2ep_empty_ptr = kmalloc(sizeof(*h2ep_empty_ptr), GFP_KERNEL);
-		if (!h2ep_empty_ptr) {
-			vunmap(virt);
-			iommu_unmap(domain, iova, PAGE_SIZE);
-			__free_pages(page, 1);
-			tvnet_iova_dealloc(tvnet, iova);
-			break;
+		if (i) {
+			/* Make the whole batch visible with one count update */
+			smp_mb();
+			WRITE_ONCE(ep_cnt->h2ep_empty_wr_cnt, wr_cnt + i);
+			total += i;
 		}
+		spin_unlock_bh(&tvnet->h2ep_empty_lock);
 
-		h2ep_empty_ptr->page = page;
-		h2ep_empty_ptr->virt = virt;
-		h2ep_empty_ptr->iova = iova;
-		h2ep_empty_ptr->size = PAGE_SIZE;
-		spin_lock_irqsave(&tvnet->h2ep_empty_lock, flags);
-		list_add_tail(&h2ep_empty_ptr->list, &tvnet->h2ep_empty_list);
-		spin_unlock_irqrestore(&tvnet->h2ep_empty_lock, flags);
-
-		idx = tvnet_ivc_get_wr_cnt(ep_cnt, host_cnt, H2EP_EMPTY_BUF) %
-			RING_COUNT;
-		h2ep_empty_msg[idx].u.empty_buffer.pcie_address = iova;
-		h2ep_empty_msg[idx].u.empty_buffer.buffer_len = PAGE_SIZE;
-		tvnet_ivc_advance_wr(ep_cnt, host_cnt, H2EP_EMPTY_BUF);
-	}
+		ret = i;
+		for (; i < count; i++)
+			__free_pages(pages[i], RX_BUF_ORDER);
+	} while (ret == RX_REFILL_BATCH);
 
-	pci_epc_raise_irq(epc, PCI_EPC_IRQ_MSIX, 0);
+	if (total)
+		pci_epc_raise_irq(epc, PCI_EPC_IRQ_MSIX, 0);
 }
 
 static void tvnet_free_empty_buffers(struct pci_epf_tvnet *tvnet)
@@ -645,22 +687,27 @@ static void tvnet_free_empty_buffers(struct pci_epf_tvnet *tvnet)
 	struct pci_epc *epc = epf->epc;
 	struct device *cdev = epc->dev.parent;
 	struct iommu_domain *domain = iommu_get_domain_for_dev(cdev);
-	struct h2ep_empty_list *h2ep_empty_ptr, *temp;
-	unsigned long flags;
-
-	spin_lock_irqsave(&tvnet->h2ep_empty_lock, flags);
-	list_for_each_entry_safe(h2ep_empty_ptr, temp, &tvnet->h2ep_empty_list,
-				 list) {
-		list_del(&h2ep_empty_ptr->list);
-		vunmap(h2ep_empty_ptr->virt);
-		iommu_unmap(domain, h2ep_empty_ptr->iova, PAGE_SIZE);
-		__free_pages(h2ep_empty_ptr->page, 1);
-		tvnet_iova_dealloc(tvnet, h2ep_empty_ptr->iova);
-		kfree(h2ep_empty_ptr);
+	struct h2ep_empty_buf *buf;
+	int i;
+
+	spin_lock_bh(&tvnet->h2ep_empty_lock);
+	for (i = 0; i < tvnet->rx_num_pages; i++) {
+		buf = &tvnet->h2ep_empty_bufs[i];
+		if (!buf->page)
+			continue;
+
+		iommu_unmap(domain, buf->iova, PAGE_SIZE);
+		__free_pages(buf->page, RX_BUF_ORDER);
+		tvnet_iova_dealloc(tvnet, buf->iova);
+		buf->page = NULL;
 	}
-	spin_unlock_irqrestore(&tvnet->h2ep_empty_lock, flags);
+	spin_unlock_bh(&tvnet->h2ep_empty_lock);
 }
 
+#if ENABLE_DMA
+static int tvnet_tx_flush(struct pci_epf_tvnet *tvnet);
+#endif
+
 static void tvnet_stop_tx_queue(struct pci_epf_tvnet *tvnet)
 {
 	struct net_device *ndev = tvnet->ndev;
@@ -668,17 +715,22 @@ static void tvnet_stop_tx_queue(struct pci_epf_tvnet *tvnet)
 	netif_stop_queue(ndev);
 	/* Get tx lock to make sure that there is no ongoing xmit */
 	netif_tx_lock_bh(ndev);
+#if ENABLE_DMA
+	/* Don't leave a batch behind that no further xmit would ring */
+	tvnet_tx_flush(tvnet);
+#endif
 	netif_tx_unlock_bh(ndev);
 }
 
 static void tvnet_stop_rx_work(struct pci_epf_tvnet *tvnet)
 {
-	cancel_work_sync(&tvnet->alloc_buf_work);
 	/*
 	 * Since the remote system tx queue is stopped, not expecting new
-	 * new interrupts, so no need to cancel data reprime work
+	 * new interrupts, so no need to cancel data reprime work. A NAPI
+	 * poll still in flight finds its buffers gone under h2ep_empty_lock
+	 * and stops refilling once rx_link_state left DIR_LINK_STATE_UP.
 	 */
-	cancel_work_sync(&tvnet->h2ep_msg_work);
+	cancel_work_sync(&tvnet->alloc_buf_work);
 }
 
 static void tvnet_clear_data_msg_counters(struct pci_epf_tvnet *tvnet)
@@ -729,8 +781,10 @@ static void tvnet_user_link_up_req(struct pci_epf_tvnet *tvnet)
 {
 	struct ctrl_msg msg;
 
+	/* Drop buffers a racing refill left behind after the last link down */
+	tvnet_free_empty_buffers(tvnet);
 	tvnet_clear_data_msg_counters(tvnet);
-	tvnet_alloc_empty_buffers(tvnet);
+	tvnet_alloc_empty_buffers(tvnet, GFP_KERNEL);
 	msg.msg_id = CTRL_MSG_LINK_UP;
 	tvnet_write_ctrl_msg(tvnet, &msg);
 	tvnet->rx_link_state = DIR_LINK_STATE_UP;
@@ -785,11 +839,16 @@ static int tvnet_open(struct net_device *ndev)
 		return -ENODEV;
 	}
 
+	napi_enable(&tvnet->napi);
+
 	mutex_lock(&tvnet->link_state_lock);
 	if (tvnet->rx_link_state == DIR_LINK_STATE_DOWN)
 		tvnet_user_link_up_req(tvnet);
 	mutex_unlock(&tvnet->link_state_lock);
 
+	/* Pick up anything the host queued while NAPI was disabled */
+	napi_schedule(&tvnet->napi);
+
 	return 0;
 }
 
@@ -816,8 +875,195 @@ static int tvnet_close(struct net_device *ndev)
 	}
 	mutex_unlock(&tvnet->link_state_lock);
 
+	napi_disable(&tvnet->napi);
+
+	return 0;
+}
+
+#if ENABLE_DMA
+static void tvnet_tx_unmap(struct pci_epf_tvnet *tvnet, u32 from, u32 to)
+{
+	struct device *cdev = tvnet->epf->epc->dev.parent;
+	struct tvnet_tx_map *map;
+
+	for (; from != to; from++) {
+		map = &tvnet->tx_maps[from % DMA_DESC_COUNT];
+		if (map->page)
+			dma_unmap_page(cdev, map->iova, map->len,
+				       DMA_TO_DEVICE);
+		else
+			dma_unmap_single(cdev, map->iova, map->len,
+					 DMA_TO_DEVICE);
+	}
+}
+
+/*
+ * Ring the DMA doorbell once for all posted packets, wait for the last desc
+ * and then hand all of them to host with a single interrupt.
+ * Called with netif_tx_lock held.
+ */
+static int tvnet_tx_flush(struct pci_epf_tvnet *tvnet)
+{
+	struct host_ring_buf *host_ring_buf = &tvnet->host_ring_buf;
+	struct host_own_cnt *host_cnt = host_ring_buf->host_cnt;
+	struct ep_ring_buf *ep_ring_buf = &tvnet->ep_ring_buf;
+	struct ep_own_cnt *ep_cnt = ep_ring_buf->ep_cnt;
+	struct data_msg *ep2h_full_msg = ep_ring_buf->ep2h_full_msgs;
+	struct dma_desc_cnt *desc_cnt = &tvnet->desc_cnt;
+	struct tvnet_dma_desc *ep_dma_virt =
+				(struct tvnet_dma_desc *)tvnet->ep_dma_virt;
+	struct tvnet_tx_stats *stats = &tvnet->tx_stats;
+	struct pci_epc *epc = tvnet->epf->epc;
+	struct net_device *ndev = tvnet->ndev;
+	struct tvnet_tx_pkt *pkt;
+	unsigned long timeout;
+	u32 i, val, wr_idx;
+	int ret = 0;
+
+	if (!tvnet->tx_pkt_cnt)
+		return 0;
+
+	/* Only the last desc of the batch raises done status */
+	ep_dma_virt[(desc_cnt->wr_cnt - 1) % DMA_DESC_COUNT].ctrl_reg.ctrl_d |=
+						DMA_CH_CONTROL1_OFF_WRCH_LIE;
+	/* DMA write should not go out of order wrt CB bit set */
+	smp_mb();
+
+	timeout = jiffies + msecs_to_jiffies(1000);
+	dma_common_wr8(tvnet->dma_base, DMA_WR_DATA_CH, DMA_WRITE_DOORBELL_OFF);
+	stats->doorbells++;
+
+	while (true) {
+		val = dma_common_rd(tvnet->dma_base, DMA_WRITE_INT_STATUS_OFF);
+		if (val == BIT(DMA_WR_DATA_CH)) {
+			dma_common_wr(tvnet->dma_base, val,
+				      DMA_WRITE_INT_CLEAR_OFF);
+			break;
+		}
+		if (time_after(jiffies, timeout)) {
+			dev_err(tvnet->fdev,
+				"dma took more time, reset dma engine\n");
+			dma_common_wr(tvnet->dma_base,
+				      DMA_WRITE_ENGINE_EN_OFF_DISABLE,
+				      DMA_WRITE_ENGINE_EN_OFF);
+			mdelay(1);
+			dma_common_wr(tvnet->dma_base,
+				      DMA_WRITE_ENGINE_EN_OFF_ENABLE,
+				      DMA_WRITE_ENGINE_EN_OFF);
+			stats->dma_timeouts++;
+			ret = -ETIMEDOUT;
+			break;
+		}
+	}
+
+	/* Clear DMA cycle bits of the batch */
+	for (i = desc_cnt->rd_cnt; i != desc_cnt->wr_cnt; i++)
+		ep_dma_virt[i % DMA_DESC_COUNT].ctrl_reg.ctrl_e.cb = 0;
+	smp_mb();
+
+	tvnet_tx_unmap(tvnet, desc_cnt->rd_cnt, desc_cnt->wr_cnt);
+	if (ret)
+		/* Engine was reset, reuse the same descs next time */
+		desc_cnt->wr_cnt = desc_cnt->rd_cnt;
+	else
+		desc_cnt->rd_cnt = desc_cnt->wr_cnt;
+
+	for (i = 0; i < tvnet->tx_pkt_cnt; i++) {
+		pkt = &tvnet->tx_pkts[i];
+		if (ret) {
+			stats->dropped++;
+			ndev->stats.tx_dropped++;
+			dev_kfree_skb_any(pkt->skb);
+			continue;
+		}
+
+		/* Push dst to EP2H full ring */
+		wr_idx = tvnet_ivc_get_wr_cnt(ep_cnt, host_cnt, EP2H_FULL_BUF) %
+			RING_COUNT;
+		ep2h_full_msg[wr_idx].u.full_buffer.packet_size = pkt->len;
+		ep2h_full_msg[wr_idx].u.full_buffer.pcie_address =
+							pkt->dst_iova;
+		tvnet_ivc_advance_wr(ep_cnt, host_cnt, EP2H_FULL_BUF);
+		stats->packets++;
+		stats->bytes += pkt->len;
+		ndev->stats.tx_packets++;
+		ndev->stats.tx_bytes += pkt->len;
+		dev_consume_skb_any(pkt->skb);
+	}
+	tvnet->tx_pkt_cnt = 0;
+
+	/* One interrupt for both consumed EP2H empty and new EP2H full msgs */
+	pci_epc_raise_irq(epc, PCI_EPC_IRQ_MSIX, 0);
+
+	return ret;
+}
+
+/* Post one DMA write desc per skb segment, CB set but LIE left for flush */
+static int tvnet_tx_post(struct pci_epf_tvnet *tvnet, struct sk_buff *skb,
+			 u64 dst_iova)
+{
+	struct device *cdev = tvnet->epf->epc->dev.parent;
+	struct dma_desc_cnt *desc_cnt = &tvnet->desc_cnt;
+	struct tvnet_dma_desc *ep_dma_virt =
+				(struct tvnet_dma_desc *)tvnet->ep_dma_virt;
+	struct skb_shared_info *info = skb_shinfo(skb);
+	struct tvnet_tx_map *map;
+	u32 wr_cnt = desc_cnt->wr_cnt;
+	u32 idx, off = 0;
+	int i;
+
+	if (skb_headlen(skb)) {
+		map = &tvnet->tx_maps[wr_cnt % DMA_DESC_COUNT];
+		map->len = skb_headlen(skb);
+		map->page = false;
+		map->iova = dma_map_single(cdev, skb->data, map->len,
+					   DMA_TO_DEVICE);
+		if (dma_mapping_error(cdev, map->iova))
+			goto unmap;
+		wr_cnt++;
+	}
+
+	for (i = 0; i < info->nr_frags; i++) {
+		const skb_frag_t *frag = &info->frags[i];
+
+		map = &tvnet->tx_maps[wr_cnt % DMA_DESC_COUNT];
+		map->len = skb_frag_size(frag);
+		map->page = true;
+		map->iova = skb_frag_dma_map(cdev, frag, 0, map->len,
+					     DMA_TO_DEVICE);
+		if (dma_mapping_error(cdev, map->iova))
+			goto unmap;
+		wr_cnt++;
+	}
+
+	/* Segments land back to back in the single host buffer */
+	for (i = desc_cnt->wr_cnt; i != wr_cnt; i++) {
+		idx = i % DMA_DESC_COUNT;
+		map = &tvnet->tx_maps[idx];
+		ep_dma_virt[idx].size = map->len;
+		ep_dma_virt[idx].sar_low = lower_32_bits(map->iova);
+		ep_dma_virt[idx].sar_high = upper_32_bits(map->iova);
+		ep_dma_virt[idx].dar_low = lower_32_bits(dst_iova + off);
+		ep_dma_virt[idx].dar_high = upper_32_bits(dst_iova + off);
+		off += map->len;
+	}
+	/* CB bit should be set at the end */
+	smp_mb();
+	for (i = desc_cnt->wr_cnt; i != wr_cnt; i++)
+		ep_dma_virt[i % DMA_DESC_COUNT].ctrl_reg.ctrl_d =
+						DMA_CH_CONTROL1_OFF_WRCH_CB;
+
+	desc_cnt->wr_cnt = wr_cnt;
+
 	return 0;
+
+unmap:
+	dev_err(tvnet->fdev, "%s: dma map failed\n", __func__);
+	tvnet_tx_unmap(tvnet, desc_cnt->wr_cnt, wr_cnt);
+
+	return -ENOMEM;
 }
+#endif
 
 static netdev_tx_t tvnet_start_xmit(struct sk_buff *skb,
 				    struct net_device *ndev)
@@ -828,67 +1074,81 @@ static netdev_tx_t tvnet_start_xmit(struct sk_buff *skb,
 	struct host_own_cnt *host_cnt = host_ring_buf->host_cnt;
 	struct ep_ring_buf *ep_ring_buf = &tvnet->ep_ring_buf;
 	struct ep_own_cnt *ep_cnt = ep_ring_buf->ep_cnt;
-	struct data_msg *ep2h_full_msg = ep_ring_buf->ep2h_full_msgs;
-	struct skb_shared_info *info = skb_shinfo(skb);
 	struct data_msg *ep2h_empty_msg = host_ring_buf->ep2h_empty_msgs;
+	struct tvnet_tx_stats *stats = &tvnet->tx_stats;
 	struct pci_epf *epf = tvnet->epf;
 	struct pci_epc *epc = epf->epc;
-	struct device *cdev = epc->dev.parent;
 #if ENABLE_DMA
 	struct dma_desc_cnt *desc_cnt = &tvnet->desc_cnt;
-	struct tvnet_dma_desc *ep_dma_virt =
-				(struct tvnet_dma_desc *)tvnet->ep_dma_virt;
-	u32 desc_widx, desc_ridx, val, ctrl_d;
-	unsigned long timeout;
+	struct tvnet_tx_pkt *pkt;
+	int pending = tvnet->tx_pkt_cnt;
+#else
+	struct data_msg *ep2h_full_msg = ep_ring_buf->ep2h_full_msgs;
+	u64 dst_masked, dst_off;
+	u32 wr_idx;
+	int ret;
+	int pending = 0;
 #endif
-	dma_addr_t src_iova;
-	u32 rd_idx, wr_idx;
-	u64 dst_masked, dst_off, dst_iova;
-	int ret, dst_len, len;
-
-	/*TODO Not expecting skb frags, remove this after testing */
-	WARN_ON(info->nr_frags);
+	u32 rd_idx;
+	u64 dst_iova;
+	int dst_len, len;
 
 	/* Check if EP2H_EMPTY_BUF available to read */
 	if (!tvnet_ivc_rd_available(ep_cnt, host_cnt, EP2H_EMPTY_BUF)) {
-		pci_epc_raise_irq(epc, PCI_EPC_IRQ_MSIX, 0);
 		dev_dbg(fdev, "%s: No EP2H empty msg, stop tx\n", __func__);
-		netif_stop_queue(ndev);
-		return NETDEV_TX_BUSY;
+		goto busy;
 	}
 
-	/* Check if EP2H_FULL_BUF available to write */
-	if (tvnet_ivc_full(ep_cnt, host_cnt, EP2H_FULL_BUF)) {
-		pci_epc_raise_irq(epc, PCI_EPC_IRQ_MSIX, 0);
+	/* Check if EP2H_FULL_BUF available to write, incl. posted packets */
+	if (tvnet_ivc_wr_available(ep_cnt, host_cnt, EP2H_FULL_BUF) <=
+	    pending) {
 		dev_dbg(fdev, "%s: No EP2H full buf, stop tx\n", __func__);
-		netif_stop_queue(ndev);
-		return NETDEV_TX_BUSY;
+		goto busy;
 	}
 
-#if ENABLE_DMA
-	/* Check if dma desc available */
-	if ((desc_cnt->wr_cnt - desc_cnt->rd_cnt) >= DMA_DESC_COUNT) {
-		dev_dbg(fdev, "%s: dma descs are not available\n", __func__);
-		netif_stop_queue(ndev);
-		return NETDEV_TX_BUSY;
-	}
-#endif
+	/* Host does not verify checksums, resolve partial ones here */
+	if (skb->ip_summed == CHECKSUM_PARTIAL && skb_checksum_help(skb))
+		goto drop;
 
-	len = skb_headlen(skb);
-
-	src_iova = dma_map_single(cdev, skb->data, len, DMA_TO_DEVICE);
-	if (dma_mapping_error(cdev, src_iova)) {
-		dev_err(fdev, "%s: dma_map_single failed\n", __func__);
-		dev_kfree_skb_any(skb);
-		return NETDEV_TX_OK;
-	}
+	len = skb->len;
 
 	/* Get EP2H empty msg */
 	rd_idx = tvnet_ivc_get_rd_cnt(ep_cnt, host_cnt, EP2H_EMPTY_BUF) %
 			RING_COUNT;
 	dst_iova = ep2h_empty_msg[rd_idx].u.empty_buffer.pcie_address;
 	dst_len = ep2h_empty_msg[rd_idx].u.empty_buffer.buffer_len;
+	if (len > dst_len) {
+		dev_err(fdev, "%s: pkt len %d exceeds host buf len %d\n",
+			__func__, len, dst_len);
+		goto drop;
+	}
+
+#if ENABLE_DMA
+	/* Check if dma descs available, ring the posted ones to free them */
+	if ((desc_cnt->wr_cnt - desc_cnt->rd_cnt) +
+	    skb_shinfo(skb)->nr_frags + 1 > DMA_DESC_COUNT)
+		tvnet_tx_flush(tvnet);
+
+	if (tvnet_tx_post(tvnet, skb, dst_iova) < 0)
+		goto drop;
 
+	/*
+	 * Advance read count after all failure cases completed, to avoid
+	 * dangling buffer at host.
+	 */
+	tvnet_ivc_advance_rd(ep_cnt, host_cnt, EP2H_EMPTY_BUF);
+
+	pkt = &tvnet->tx_pkts[tvnet->tx_pkt_cnt++];
+	pkt->skb = skb;
+	pkt->dst_iova = dst_iova;
+	pkt->len = len;
+	stats->sg_frags += skb_shinfo(skb)->nr_frags;
+
+	/* Let the stack hand us more before ringing the doorbell */
+	if (!skb->xmit_more || tvnet->tx_pkt_cnt == TX_BATCH_MAX ||
+	    netif_queue_stopped(ndev))
+		tvnet_tx_flush(tvnet);
+#else
 	/*
 	 * Map host dst mem to local PCIe address range.
 	 * PCIe address range is SZ_64K aligned.
@@ -900,78 +1160,18 @@ static netdev_tx_t tvnet_start_xmit(struct sk_buff *skb,
 			       dst_len);
 	if (ret < 0) {
 		dev_err(fdev, "failed to map dst addr to PCIe addr range\n");
-		dma_unmap_single(cdev, src_iova, len, DMA_TO_DEVICE);
-		dev_kfree_skb_any(skb);
-		return NETDEV_TX_OK;
+		goto drop;
 	}
 
-	/*
-	 * Advance read count after all failure cases completed, to avoid
-	 * dangling buffer at host.
-	 */
 	tvnet_ivc_advance_rd(ep_cnt, host_cnt, EP2H_EMPTY_BUF);
-	/* Raise an interrupt to let host populate EP2H_EMPTY_BUF ring */
-	pci_epc_raise_irq(epc, PCI_EPC_IRQ_MSIX, 0);
-
-#if ENABLE_DMA
-	/* Trigger DMA write from src_iova to dst_iova */
-	desc_widx = desc_cnt->wr_cnt % DMA_DESC_COUNT;
-	ep_dma_virt[desc_widx].size = len;
-	ep_dma_virt[desc_widx].sar_low = lower_32_bits(src_iova);
-	ep_dma_virt[desc_widx].sar_high = upper_32_bits(src_iova);
-	ep_dma_virt[desc_widx].dar_low = lower_32_bits(dst_iova);
-	ep_dma_virt[desc_widx].dar_high = upper_32_bits(dst_iova);
-	/* CB bit should be set at the end */
-	smp_mb();
-	ctrl_d = DMA_CH_CONTROL1_OFF_WRCH_LIE;
-	ctrl_d |= DMA_CH_CONTROL1_OFF_WRCH_CB;
-	ep_dma_virt[desc_widx].ctrl_reg.ctrl_d = ctrl_d;
-
-	/* DMA write should not go out of order wrt CB bit set */
-	smp_mb();
-
-	timeout = jiffies + msecs_to_jiffies(1000);
-	dma_common_wr8(tvnet->dma_base, DMA_WR_DATA_CH, DMA_WRITE_DOORBELL_OFF);
-	desc_cnt->wr_cnt++;
-
-	while (true) {
-		val = dma_common_rd(tvnet->dma_base, DMA_WRITE_INT_STATUS_OFF);
-		if (val == BIT(DMA_WR_DATA_CH)) {
-			dma_common_wr(tvnet->dma_base, val,
-				      DMA_WRITE_INT_CLEAR_OFF);
-			break;
-		}
-		if (time_after(jiffies, timeout)) {
-			dev_err(fdev, "dma took more time, reset dma engine\n");
-			dma_common_wr(tvnet->dma_base,
-				      DMA_WRITE_ENGINE_EN_OFF_DISABLE,
-				      DMA_WRITE_ENGINE_EN_OFF);
-			mdelay(1);
-			dma_common_wr(tvnet->dma_base,
-				      DMA_WRITE_ENGINE_EN_OFF_ENABLE,
-				      DMA_WRITE_ENGINE_EN_OFF);
-			desc_cnt->wr_cnt--;
-			pci_epc_unmap_addr(epc, tvnet->tx_dst_pci_addr);
-			dma_unmap_single(cdev, src_iova, len, DMA_TO_DEVICE);
-			return NETDEV_TX_BUSY;
-		}
-	}
 
-	desc_ridx = tvnet->desc_cnt.rd_cnt % DMA_DESC_COUNT;
-	/* Clear DMA cycle bit and increment rd_cnt */
-	ep_dma_virt[desc_ridx].ctrl_reg.ctrl_e.cb = 0;
-	smp_mb();
-
-	tvnet->desc_cnt.rd_cnt++;
-#else
-	/* Copy skb->data to host dst address, use CPU virt addr */
-	memcpy((void *)(tvnet->tx_dst_va + dst_off), skb->data, len);
+	/* Copy skb data to host dst address, use CPU virt addr */
+	skb_copy_bits(skb, 0, (void *)(tvnet->tx_dst_va + dst_off), len);
 	/*
 	 * tx_dst_va is ioremap_wc() mem, add mb to make sure complete skb->data
 	 * written to dst before adding it to full buffer
 	 */
 	smp_mb();
-#endif
 
 	/* Push dst to EP2H full ring */
 	wr_idx = tvnet_ivc_get_wr_cnt(ep_cnt, host_cnt, EP2H_FULL_BUF) %
@@ -981,14 +1181,96 @@ static netdev_tx_t tvnet_start_xmit(struct sk_buff *skb,
 	tvnet_ivc_advance_wr(ep_cnt, host_cnt, EP2H_FULL_BUF);
 	pci_epc_raise_irq(epc, PCI_EPC_IRQ_MSIX, 0);
 
-	/* Free temp src and skb */
 	pci_epc_unmap_addr(epc, tvnet->tx_dst_pci_addr);
-	dma_unmap_single(cdev, src_iova, len, DMA_TO_DEVICE);
-	dev_kfree_skb_any(skb);
+	stats->packets++;
+	stats->bytes += len;
+	stats->sg_frags += skb_shinfo(skb)->nr_frags;
+	ndev->stats.tx_packets++;
+	ndev->stats.tx_bytes += len;
+	dev_consume_skb_any(skb);
+#endif
+
+	return NETDEV_TX_OK;
 
+busy:
+#if ENABLE_DMA
+	/* Hand over what is posted, the stack will retry this skb */
+	tvnet_tx_flush(tvnet);
+#endif
+	pci_epc_raise_irq(epc, PCI_EPC_IRQ_MSIX, 0);
+	netif_stop_queue(ndev);
+	stats->busy++;
+	return NETDEV_TX_BUSY;
+
+drop:
+#if ENABLE_DMA
+	if (!skb->xmit_more)
+		tvnet_tx_flush(tvnet);
+#endif
+	stats->dropped++;
+	ndev->stats.tx_dropped++;
+	dev_kfree_skb_any(skb);
 	return NETDEV_TX_OK;
 }
 
+static const char tvnet_stats_strings[][ETH_GSTRING_LEN] = {
+	"q0_tx_packets",
+	"q0_tx_bytes",
+	"q0_tx_sg_frags",
+	"q0_tx_doorbells",
+	"q0_tx_busy",
+	"q0_tx_dma_timeouts",
+	"q0_tx_dropped",
+	"q0_rx_packets",
+	"q0_rx_bytes",
+	"q0_rx_dropped",
+	"q0_rx_errors",
+};
+
+#define TVNET_STATS_LEN ARRAY_SIZE(tvnet_stats_strings)
+
+static int tvnet_get_sset_count(struct net_device *ndev, int sset)
+{
+	if (sset == ETH_SS_STATS)
+		return TVNET_STATS_LEN;
+
+	return -EOPNOTSUPP;
+}
+
+static void tvnet_get_strings(struct net_device *ndev, u32 sset, u8 *data)
+{
+	if (sset == ETH_SS_STATS)
+		memcpy(data, tvnet_stats_strings, sizeof(tvnet_stats_strings));
+}
+
+static void tvnet_get_ethtool_stats(struct net_device *ndev,
+				    struct ethtool_stats *estats, u64 *data)
+{
+	struct device *fdev = ndev->dev.parent;
+	struct pci_epf_tvnet *tvnet = dev_get_drvdata(fdev);
+	struct tvnet_tx_stats *stats = &tvnet->tx_stats;
+	int i = 0;
+
+	data[i++] = stats->packets;
+	data[i++] = stats->bytes;
+	data[i++] = stats->sg_frags;
+	data[i++] = stats->doorbells;
+	data[i++] = stats->busy;
+	data[i++] = stats->dma_timeouts;
+	data[i++] = stats->dropped;
+	data[i++] = ndev->stats.rx_packets;
+	data[i++] = ndev->stats.rx_bytes;
+	data[i++] = ndev->stats.rx_dropped;
+	data[i++] = ndev->stats.rx_errors + ndev->stats.rx_length_errors;
+}
+
+static const struct ethtool_ops tvnet_ethtool_ops = {
+	.get_link = ethtool_op_get_link,
+	.get_sset_count = tvnet_get_sset_count,
+	.get_strings = tvnet_get_strings,
+	.get_ethtool_stats = tvnet_get_ethtool_stats,
+};
+
 static const struct net_device_ops tvnet_netdev_ops = {
 	.ndo_open = tvnet_open,
 	.ndo_stop = tvnet_close,
@@ -1016,10 +1298,8 @@ static void process_ctrl_msg(struct work_struct *work)
 	}
 }
 
-static void process_h2ep_msg(struct work_struct *work)
+static int process_h2ep_msg(struct pci_epf_tvnet *tvnet, int budget)
 {
-	struct pci_epf_tvnet *tvnet =
-		container_of(work, struct pci_epf_tvnet, h2ep_msg_work);
 	struct host_ring_buf *host_ring_buf = &tvnet->host_ring_buf;
 	struct host_own_cnt *host_cnt = host_ring_buf->host_cnt;
 	struct ep_ring_buf *ep_ring_buf = &tvnet->ep_ring_buf;
@@ -1028,53 +1308,96 @@ static void process_h2ep_msg(struct work_struct *work)
 	struct pci_epf *epf = tvnet->epf;
 	struct pci_epc *epc = epf->epc;
 	struct device *cdev = epc->dev.parent;
-	struct h2ep_empty_list *h2ep_empty_ptr;
 	struct net_device *ndev = tvnet->ndev;
 	struct iommu_domain *domain = iommu_get_domain_for_dev(cdev);
+	int count = 0;
 
-	while (tvnet_ivc_rd_available(ep_cnt, host_cnt, H2EP_FULL_BUF)) {
+	while (count < budget &&
+	       tvnet_ivc_rd_available(ep_cnt, host_cnt, H2EP_FULL_BUF)) {
+		struct h2ep_empty_buf *buf;
+		struct page *page = NULL;
 		struct sk_buff *skb;
-		int idx, found = 0;
-		u32 len;
 		u64 pcie_address;
-		unsigned long flags;
+		u32 idx, pageno, len;
 
 		/* Read H2EP full msg */
 		idx = tvnet_ivc_get_rd_cnt(ep_cnt, host_cnt, H2EP_FULL_BUF) %
 				RING_COUNT;
 		len = data_msg[idx].u.full_buffer.packet_size;
 		pcie_address = data_msg[idx].u.full_buffer.pcie_address;
-
-		/* Get H2EP msg pointer from saved list */
-		spin_lock_irqsave(&tvnet->h2ep_empty_lock, flags);
-		list_for_each_entry(h2ep_empty_ptr, &tvnet->h2ep_empty_list,
-				    list) {
-			if (h2ep_empty_ptr->iova == pcie_address) {
-				found = 1;
-				break;
+		pageno = (pcie_address - tvnet->rx_buf_iova) >> PAGE_SHIFT;
+
+		/* Take the buffer out of the table, host is done with it */
+		spin_lock(&tvnet->h2ep_empty_lock);
+		if (pageno < tvnet->rx_num_pages) {
+			buf = &tvnet->h2ep_empty_bufs[pageno];
+			page = buf->page;
+			if (page) {
+				iommu_unmap(domain, buf->iova, PAGE_SIZE);
+				tvnet_iova_dealloc(tvnet, buf->iova);
+				buf->page = NULL;
 			}
 		}
-		WARN_ON(!found);
-		list_del(&h2ep_empty_ptr->list);
-		spin_unlock_irqrestore(&tvnet->h2ep_empty_lock, flags);
+		spin_unlock(&tvnet->h2ep_empty_lock);
 
-		/* Advance H2EP full buffer after search in local list */
+		/* Advance H2EP full buffer after lookup in local table */
 		tvnet_ivc_advance_rd(ep_cnt, host_cnt, H2EP_FULL_BUF);
+		count++;
+
+		if (WARN_ON(!page)) {
+			ndev->stats.rx_errors++;
+			continue;
+		}
 
-		/* Alloc new skb and copy data from full buffer */
-		skb = netdev_alloc_skb(ndev, len);
-		memcpy(skb->data, h2ep_empty_ptr->virt, len);
+		if (len > RX_BUF_LEN) {
+			__free_pages(page, RX_BUF_ORDER);
+			ndev->stats.rx_length_errors++;
+			continue;
+		}
+
+		/* Hand the page to the stack as is, no copy */
+		skb = build_skb(page_address(page), RX_BUF_TRUESIZE);
+		if (!skb) {
+			__free_pages(page, RX_BUF_ORDER);
+			ndev->stats.rx_dropped++;
+			continue;
+		}
+
+		skb_reserve(skb, RX_HEADROOM);
 		skb_put(skb, len);
 		skb->protocol = eth_type_trans(skb, ndev);
-		netif_rx(skb);
-
-		/* Free H2EP dst msg */
-		vunmap(h2ep_empty_ptr->virt);
-		iommu_unmap(domain, h2ep_empty_ptr->iova, PAGE_SIZE);
-		__free_pages(h2ep_empty_ptr->page, 1);
-		tvnet_iova_dealloc(tvnet, h2ep_empty_ptr->iova);
-		kfree(h2ep_empty_ptr);
+		ndev->stats.rx_packets++;
+		ndev->stats.rx_bytes += len;
+		napi_gro_receive(&tvnet->napi, skb);
+	}
+
+	return count;
+}
+
+static int tvnet_poll(struct napi_struct *napi, int budget)
+{
+	struct pci_epf_tvnet *tvnet =
+		container_of(napi, struct pci_epf_tvnet, napi);
+	struct host_ring_buf *host_ring_buf = &tvnet->host_ring_buf;
+	struct host_own_cnt *host_cnt = host_ring_buf->host_cnt;
+	struct ep_ring_buf *ep_ring_buf = &tvnet->ep_ring_buf;
+	struct ep_own_cnt *ep_cnt = ep_ring_buf->ep_cnt;
+	int work_done;
+
+	work_done = process_h2ep_msg(tvnet, budget);
+
+	/* Give back what was consumed in this poll in one batch */
+	if (work_done && tvnet->rx_link_state == DIR_LINK_STATE_UP)
+		tvnet_alloc_empty_buffers(tvnet, GFP_ATOMIC);
+
+	if (work_done < budget) {
+		napi_complete_done(napi, work_done);
+		/* Host may have queued more after the ring was found empty */
+		if (tvnet_ivc_rd_available(ep_cnt, host_cnt, H2EP_FULL_BUF))
+			napi_schedule(napi);
 	}
+
+	return work_done;
 }
 
 static void alloc_h2ep_rx_buf(struct work_struct *work)
@@ -1083,7 +1406,7 @@ static void alloc_h2ep_rx_buf(struct work_struct *work)
 		container_of(work, struct pci_epf_tvnet, alloc_buf_work);
 
 	if (tvnet->os_link_state == OS_LINK_STATE_UP)
-		tvnet_alloc_empty_buffers(tvnet);
+		tvnet_alloc_empty_buffers(tvnet, GFP_KERNEL);
 }
 
 #if ENABLE_DMA
@@ -1205,7 +1528,7 @@ static void data_irqsp_callback(void *private_data)
 	struct ep_own_cnt *ep_cnt = ep_ring_buf->ep_cnt;
 
 	if (tvnet_ivc_rd_available(ep_cnt, host_cnt, H2EP_FULL_BUF))
-		schedule_work(&tvnet->h2ep_msg_work);
+		napi_schedule(&tvnet->napi);
 
 	schedule_work(&data_irqsp->reprime_work);
 }
@@ -1646,6 +1969,15 @@ static int pci_epf_tvnet_bind(struct pci_epf *epf)
 		goto free_host_dma;
 	}
 
+	tvnet->h2ep_empty_bufs = devm_kcalloc(fdev, tvnet->rx_num_pages,
+					      sizeof(*tvnet->h2ep_empty_bufs),
+					      GFP_KERNEL);
+	if (!tvnet->h2ep_empty_bufs) {
+		dev_err(fdev, "rx buffer table alloc failed\n");
+		ret = -ENOMEM;
+		goto free_host_dma;
+	}
+
 	/* Allocate PCIe memory for RP's dst address during xmit */
 	tvnet->tx_dst_va = pci_epc_wc_mem_alloc_addr(epc,
 						     &tvnet->tx_dst_pci_addr,
@@ -1668,6 +2000,11 @@ static int pci_epf_tvnet_bind(struct pci_epf *epf)
 	tvnet->ndev = ndev;
 	SET_NETDEV_DEV(ndev, fdev);
 	ndev->netdev_ops = &tvnet_netdev_ops;
+	ndev->ethtool_ops = &tvnet_ethtool_ops;
+	/* Frags are DMA'd directly, GSO segments in software on top of SG */
+	ndev->hw_features = NETIF_F_SG | NETIF_F_HW_CSUM;
+	ndev->features = ndev->hw_features;
+	netif_napi_add(ndev, &tvnet->napi, tvnet_poll, NAPI_POLL_WEIGHT);
 	ret = register_netdev(ndev);
 	if (ret < 0) {
 		dev_err(fdev, "register_netdev() failed: %d\n", ret);
@@ -1682,9 +2019,7 @@ static int pci_epf_tvnet_bind(struct pci_epf *epf)
 	init_waitqueue_head(&tvnet->link_state_wq);
 
 	INIT_WORK(&tvnet->ctrl_msg_work, process_ctrl_msg);
-	INIT_WORK(&tvnet->h2ep_msg_work, process_h2ep_msg);
 	INIT_WORK(&tvnet->alloc_buf_work, alloc_h2ep_rx_buf);
-	INIT_LIST_HEAD(&tvnet->h2ep_empty_list);
 	spin_lock_init(&tvnet->h2ep_empty_lock);
 
 	/* TODO Update it to 64-bit prefetch type */
@@ -1731,6 +2066,7 @@ fail_clear_bar:
 fail_unreg_netdev:
 	unregister_netdev(ndev);
 fail_free_netdev:
+	netif_napi_del(&tvnet->napi);
 	free_netdev(ndev);
 free_pci_mem:
 	pci_epc_mem_free_addr(epc, tvnet->tx_dst_pci_addr, tvnet->tx_dst_va,
@@ -1760,14 +2096,15 @@ static void pci_epf_tvnet_unbind(struct pci_epf *epf)
 	cancel_work_sync(&tvnet->ctrl_irqsp->reprime_work);
 	cancel_work_sync(&tvnet->data_irqsp->reprime_work);
 	cancel_work_sync(&tvnet->alloc_buf_work);
-	cancel_work_sync(&tvnet->h2ep_msg_work);
 	pci_epc_stop(epc);
 	pci_epc_clear_bar(epc, BAR_0);
 	dma_free_coherent(cdev,
 			  ((RING_COUNT + 1) * sizeof(struct tvnet_dma_desc)),
 			  tvnet->ep_dma_virt, tvnet->ep_dma_iova);
 	unregister_netdev(tvnet->ndev);
+	netif_napi_del(&tvnet->napi);
 	free_netdev(tvnet->ndev);
+	tvnet_free_empty_buffers(tvnet);
 	pci_epc_mem_free_addr(epc, tvnet->tx_dst_pci_addr, tvnet->tx_dst_va,
 			      SZ_64K);
 	free_multi_page_bar0_mem(epf, HOST_DMA);
@@ -630,7 +630,7 @@ static irqreturn_t actmon_dev_isr(int irq, void *dev_id)
 static irqreturn_t actmon_dev_fn(int irq, void *dev_id)
 {
 	struct actmon_dev *dev = (struct actmon_dev *)dev_id;
-	unsigned long flags, freq;
+	unsigned long flags, freq, avg_freq;
 
 	spin_lock_irqsave(&dev->lock, flags);
 
@@ -641,6 +641,7 @@ static irqreturn_t actmon_dev_fn(int irq, void *dev_id)
 
 	freq = actmon_dev_avg_freq_get(dev);
 	dev->avg_actv_freq = freq;
+	avg_freq = freq;
 	freq = do_percent(freq, dev->avg_sustain_coef);
 	freq += dev->boost_freq;
 
@@ -652,6 +653,10 @@ static irqreturn_t actmon_dev_fn(int irq, void *dev_id)
 	dev->dev_name, dev->avg_actv_freq, dev->boost_freq, dev->target_freq,
 	dev->cur_freq);
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 9, 0)
+	tegra_bwmgr_predict_sample(TEGRA_BWMGR_PREDICT_SRC_ACTMON,
+			avg_freq * 1000);
+#endif
 	dev->actmon_dev_set_rate(dev, freq);
 
 	return IRQ_HANDLED;
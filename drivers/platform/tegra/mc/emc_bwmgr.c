@@ -21,6 +21,10 @@
 #include <linux/debugfs.h>
 #include <linux/thermal.h>
 #include <linux/version.h>
+#include <linux/rbtree.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/workqueue.h>
 #include <soc/tegra/chip-id.h>
 
 #define CREATE_TRACE_POINTS
@@ -43,6 +47,16 @@ int emc_to_dram_freq_factor;
 #define IS_HANDLE_VALID(x) ((x >= bwmgr.bwmgr_client) && \
 		(x < bwmgr.bwmgr_client + TEGRA_BWMGR_CLIENT_COUNT))
 
+/*
+ * Floors and caps of the clients are kept in value ordered trees, so that
+ * the highest floor and the lowest caps are found without walking all
+ * clients. Clients with the default value are left out of the trees.
+ */
+struct bwmgr_agg_node {
+	struct rb_node rb;
+	unsigned long val;
+};
+
 struct tegra_bwmgr_client {
 	unsigned long bw;
 	unsigned long iso_bw;
@@ -50,8 +64,14 @@ struct tegra_bwmgr_client {
 	unsigned long iso_cap;
 	unsigned long floor;
 	int refcount;
+	struct bwmgr_agg_node cap_node;
+	struct bwmgr_agg_node iso_cap_node;
+	struct bwmgr_agg_node floor_node;
 };
 
+/* Default window in which requests lowering the EMC rate are merged */
+#define BWMGR_COALESCE_WINDOW_US	1000
+
 /* TODO: Manage client state in a dynamic list */
 static struct {
 	struct tegra_bwmgr_client bwmgr_client[TEGRA_BWMGR_CLIENT_COUNT];
@@ -63,8 +83,37 @@ static struct {
 	bool status;
 	struct bwmgr_ops *ops;
 	bool override;
+
+	/* running totals of all clients, see bwmgr_client_set_*() */
+	u64 bw_sum;
+	u64 iso_bw_nvdis_sum;
+	u64 iso_bw_vi_sum;
+	u64 iso_bw_other_sum;
+	u64 iso_client_flags;
+	struct rb_root cap_root;
+	struct rb_root iso_cap_root;
+	struct rb_root floor_root;
+
+	/* last rate passed to clk_set_rate(), 0 if unknown */
+	unsigned long applied_rate;
+	u32 coalesce_us;
+	bool update_pending;
+	ktime_t pending_since;
+	struct delayed_work coalesce_work;
 } bwmgr;
 
+static struct {
+	u64 requests;
+	u64 changes;
+	u64 coalesced;
+	u64 deferred;
+	u64 rate_changes;
+	u64 rate_unchanged;
+	u64 failures;
+	u64 latency_total_us;
+	u64 latency_max_us;
+} bwmgr_stats;
+
 static struct dram_refresh_alrt {
 	unsigned long cur_state;
 	u32 max_cooling_state;
@@ -142,6 +191,7 @@ static const char * const tegra_bwmgr_client_names[] = {
 	"debug",
 	"nvdla0",
 	"nvdla1",
+	"predict",
 	"null",
 };
 
@@ -192,14 +242,108 @@ static inline bool bwmgr_unlock(void)
 	return true;
 }
 
+static void bwmgr_agg_update(struct rb_root *root, struct bwmgr_agg_node *n,
+		unsigned long val, unsigned long def)
+{
+	struct rb_node **p = &root->rb_node;
+	struct rb_node *parent = NULL;
+
+	if (!RB_EMPTY_NODE(&n->rb)) {
+		rb_erase(&n->rb, root);
+		RB_CLEAR_NODE(&n->rb);
+	}
+
+	n->val = val;
+	if (val == def)
+		return;
+
+	while (*p) {
+		parent = *p;
+		if (val < rb_entry(parent, struct bwmgr_agg_node, rb)->val)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&n->rb, parent, p);
+	rb_insert_color(&n->rb, root);
+}
+
+static unsigned long bwmgr_agg_max(struct rb_root *root, unsigned long def)
+{
+	struct rb_node *n = rb_last(root);
+
+	return n ? max(def, rb_entry(n, struct bwmgr_agg_node, rb)->val) : def;
+}
+
+static unsigned long bwmgr_agg_min(struct rb_root *root, unsigned long def)
+{
+	struct rb_node *n = rb_first(root);
+
+	return n ? min(def, rb_entry(n, struct bwmgr_agg_node, rb)->val) : def;
+}
+
+/* bwmgr_client_set_*: call with bwmgr lock held except during init */
+static void bwmgr_client_set_bw(struct tegra_bwmgr_client *handle,
+		unsigned long val)
+{
+	bwmgr.bw_sum += (u64)val - handle->bw;
+	handle->bw = val;
+}
+
+static void bwmgr_client_set_iso_bw(struct tegra_bwmgr_client *handle,
+		unsigned long val)
+{
+	int client = handle - bwmgr.bwmgr_client;
+	u64 *sum;
+
+	if ((client == TEGRA_BWMGR_CLIENT_DISP0) ||
+			(client == TEGRA_BWMGR_CLIENT_DISP1) ||
+			(client == TEGRA_BWMGR_CLIENT_DISP2))
+		sum = &bwmgr.iso_bw_nvdis_sum;
+	else if (client == TEGRA_BWMGR_CLIENT_CAMERA)
+		sum = &bwmgr.iso_bw_vi_sum;
+	else
+		sum = &bwmgr.iso_bw_other_sum;
+
+	*sum += (u64)val - handle->iso_bw;
+	if (val)
+		bwmgr.iso_client_flags |= BIT_ULL(client);
+	else
+		bwmgr.iso_client_flags &= ~BIT_ULL(client);
+	handle->iso_bw = val;
+}
+
+static void bwmgr_client_set_cap(struct tegra_bwmgr_client *handle,
+		unsigned long val)
+{
+	handle->cap = val;
+	bwmgr_agg_update(&bwmgr.cap_root, &handle->cap_node, val,
+			bwmgr.emc_max_rate);
+}
+
+static void bwmgr_client_set_iso_cap(struct tegra_bwmgr_client *handle,
+		unsigned long val)
+{
+	handle->iso_cap = val;
+	bwmgr_agg_update(&bwmgr.iso_cap_root, &handle->iso_cap_node, val,
+			bwmgr.emc_max_rate);
+}
+
+static void bwmgr_client_set_floor(struct tegra_bwmgr_client *handle,
+		unsigned long val)
+{
+	handle->floor = val;
+	bwmgr_agg_update(&bwmgr.floor_root, &handle->floor_node, val, 0);
+}
+
 /* call with bwmgr lock held except during init*/
 static void purge_client(struct tegra_bwmgr_client *handle)
 {
-	handle->bw = 0;
-	handle->iso_bw = 0;
-	handle->cap = bwmgr.emc_max_rate;
-	handle->iso_cap = bwmgr.emc_max_rate;
-	handle->floor = 0;
+	bwmgr_client_set_bw(handle, 0);
+	bwmgr_client_set_iso_bw(handle, 0);
+	bwmgr_client_set_cap(handle, bwmgr.emc_max_rate);
+	bwmgr_client_set_iso_cap(handle, bwmgr.emc_max_rate);
+	bwmgr_client_set_floor(handle, 0);
 	handle->refcount = 0;
 }
 
@@ -215,64 +359,33 @@ static unsigned long tegra_bwmgr_apply_efficiency(
 }
 
 /* call with bwmgr lock held */
-static int bwmgr_update_clk(void)
+static unsigned long bwmgr_calc_rate(void)
 {
-	int i;
-	unsigned long bw = 0;
-	unsigned long iso_bw = 0; // iso_bw_guarantee
-	unsigned long iso_bw_nvdis = 0; //DISP0 + DISP1 + DISP2
-	unsigned long iso_bw_vi = 0; //CAMERA
-	unsigned long iso_bw_other_clients = 0; //Other ISO clients
-	unsigned long non_iso_cap = bwmgr.emc_max_rate;
-	unsigned long iso_cap = bwmgr.emc_max_rate;
-	unsigned long floor = 0;
+	unsigned long max_rate = bwmgr.emc_max_rate;
+	unsigned long bw;
+	unsigned long iso_bw; // iso_bw_guarantee
+	unsigned long iso_bw_nvdis; //DISP0 + DISP1 + DISP2
+	unsigned long iso_bw_vi; //CAMERA
+	unsigned long iso_bw_other_clients; //Other ISO clients
+	unsigned long non_iso_cap;
+	unsigned long iso_cap;
+	unsigned long floor;
 	unsigned long iso_bw_min;
-	u64 iso_client_flags = 0;
-	int ret = 0;
 
 	/* sizeof(iso_client_flags) */
 	BUILD_BUG_ON(TEGRA_BWMGR_CLIENT_COUNT > 64);
-	/* check that lock is held */
-	if (unlikely(bwmgr.task != current)) {
-		pr_err("bwmgr: %s called without lock\n", __func__);
-		return -EINVAL;
-	}
 
-	if (bwmgr.override)
-		return 0;
+	bw = min_t(u64, bwmgr.bw_sum, max_rate);
+	iso_bw_nvdis = min_t(u64, bwmgr.iso_bw_nvdis_sum, max_rate);
+	iso_bw_vi = min_t(u64, bwmgr.iso_bw_vi_sum, max_rate);
+	iso_bw_other_clients = min_t(u64, bwmgr.iso_bw_other_sum, max_rate);
+	iso_bw = min_t(u64, (u64)iso_bw_nvdis + iso_bw_vi +
+			iso_bw_other_clients, max_rate);
 
-	for (i = 0; i < TEGRA_BWMGR_CLIENT_COUNT; i++) {
-		bw += bwmgr.bwmgr_client[i].bw;
-		bw = min(bw, bwmgr.emc_max_rate);
-
-		if (bwmgr.bwmgr_client[i].iso_bw > 0) {
-			iso_client_flags |= BIT(i);
-
-			if ((i == TEGRA_BWMGR_CLIENT_DISP0) ||
-					(i == TEGRA_BWMGR_CLIENT_DISP1) ||
-					(i == TEGRA_BWMGR_CLIENT_DISP2)) {
-				iso_bw_nvdis += bwmgr.bwmgr_client[i].iso_bw;
-				iso_bw_nvdis = min(iso_bw_nvdis,
-							bwmgr.emc_max_rate);
-			} else if (i == TEGRA_BWMGR_CLIENT_CAMERA) {
-				iso_bw_vi += bwmgr.bwmgr_client[i].iso_bw;
-				iso_bw_vi = min(iso_bw_vi, bwmgr.emc_max_rate);
-			} else {
-				iso_bw_other_clients +=
-						bwmgr.bwmgr_client[i].iso_bw;
-				iso_bw_other_clients = min(iso_bw_other_clients,
-							bwmgr.emc_max_rate);
-			}
-
-			iso_bw = iso_bw_nvdis + iso_bw_vi +
-						iso_bw_other_clients;
-			iso_bw = min(iso_bw, bwmgr.emc_max_rate);
-		}
+	non_iso_cap = bwmgr_agg_min(&bwmgr.cap_root, max_rate);
+	iso_cap = bwmgr_agg_min(&bwmgr.iso_cap_root, max_rate);
+	floor = bwmgr_agg_max(&bwmgr.floor_root, 0);
 
-		non_iso_cap = min(non_iso_cap, bwmgr.bwmgr_client[i].cap);
-		iso_cap = min(iso_cap, bwmgr.bwmgr_client[i].iso_cap);
-		floor = max(floor, bwmgr.bwmgr_client[i].floor);
-	}
 	debug_info.bw = bw;
 	debug_info.iso_bw = iso_bw;
 	debug_info.floor = floor;
@@ -280,24 +393,125 @@ static int bwmgr_update_clk(void)
 	debug_info.non_iso_cap = non_iso_cap;
 	bw += iso_bw;
 	bw = tegra_bwmgr_apply_efficiency(
-			bw, iso_bw, bwmgr.emc_max_rate,
-			iso_client_flags, &iso_bw_min,
+			bw, iso_bw, max_rate,
+			bwmgr.iso_client_flags, &iso_bw_min,
 			iso_bw_nvdis, iso_bw_vi);
 	debug_info.total_bw_aftr_eff = bw;
 	debug_info.iso_bw_aftr_eff = iso_bw_min;
-	floor = min(floor, bwmgr.emc_max_rate);
+	floor = min(floor, max_rate);
 	bw = max(bw, floor);
 	bw = min(bw, min(iso_cap, max(non_iso_cap, iso_bw_min)));
 	debug_info.calc_freq = bw;
 	debug_info.req_freq = bw;
 
+	return bw;
+}
+
+/* call with bwmgr lock held */
+static int bwmgr_apply_rate(unsigned long bw, ktime_t since)
+{
+	u64 latency;
+	int ret;
+
+	if (bwmgr.update_pending) {
+		/* the work may already be waiting for the lock */
+		cancel_delayed_work(&bwmgr.coalesce_work);
+		bwmgr.update_pending = false;
+	}
+
+	if (bw == bwmgr.applied_rate) {
+		bwmgr_stats.rate_unchanged++;
+		return 0;
+	}
+
 	ret = clk_set_rate(bwmgr.emc_clk, bw);
-	if (ret)
+	if (ret) {
 		pr_err
 		("bwmgr: clk_set_rate failed for freq %lu Hz with errno %d\n",
 				bw, ret);
+		bwmgr.applied_rate = 0;
+		bwmgr_stats.failures++;
+		return ret;
+	}
 
-	return ret;
+	bwmgr.applied_rate = bw;
+	latency = ktime_us_delta(ktime_get(), since);
+	bwmgr_stats.rate_changes++;
+	bwmgr_stats.latency_total_us += latency;
+	bwmgr_stats.latency_max_us = max(bwmgr_stats.latency_max_us, latency);
+
+	return 0;
+}
+
+/* call with bwmgr lock held */
+static int bwmgr_update_clk(void)
+{
+	/* check that lock is held */
+	if (unlikely(bwmgr.task != current)) {
+		pr_err("bwmgr: %s called without lock\n", __func__);
+		return -EINVAL;
+	}
+
+	if (bwmgr.override)
+		return 0;
+
+	return bwmgr_apply_rate(bwmgr_calc_rate(), ktime_get());
+}
+
+/*
+ * Rate increases are applied right away. A request that keeps or lowers
+ * the rate only arms the coalescing window; the rate is recomputed and set
+ * once when the window expires, or earlier if an increase comes in.
+ *
+ * call with bwmgr lock held
+ */
+static int bwmgr_request_update(ktime_t since)
+{
+	unsigned long bw;
+
+	if (bwmgr.override)
+		return 0;
+
+	bw = bwmgr_calc_rate();
+	if (!bwmgr.coalesce_us || !bwmgr.applied_rate ||
+			bw > bwmgr.applied_rate)
+		return bwmgr_apply_rate(bw, since);
+
+	if (bw == bwmgr.applied_rate && !bwmgr.update_pending) {
+		bwmgr_stats.rate_unchanged++;
+		return 0;
+	}
+
+	if (bwmgr.update_pending) {
+		bwmgr_stats.coalesced++;
+		return 0;
+	}
+
+	bwmgr.update_pending = true;
+	bwmgr.pending_since = since;
+	bwmgr_stats.deferred++;
+	schedule_delayed_work(&bwmgr.coalesce_work,
+			usecs_to_jiffies(bwmgr.coalesce_us));
+
+	return 0;
+}
+
+static void bwmgr_coalesce_work(struct work_struct *work)
+{
+	if (!bwmgr_lock()) {
+		pr_err("bwmgr: %s failed\n", __func__);
+		return;
+	}
+
+	if (bwmgr.update_pending) {
+		bwmgr.update_pending = false;
+		if (!bwmgr.override && !clk_update_disabled)
+			bwmgr_apply_rate(bwmgr_calc_rate(),
+					bwmgr.pending_since);
+	}
+
+	if (!bwmgr_unlock())
+		pr_err("bwmgr: %s failed\n", __func__);
 }
 
 struct tegra_bwmgr_client *tegra_bwmgr_register(
@@ -409,6 +623,7 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 {
 	int ret = 0;
 	bool update_clk = false;
+	ktime_t since = ktime_get();
 
 	if (!bwmgr.emc_clk)
 		return 0;
@@ -449,10 +664,12 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 			val, bwmgr_req_to_name(req));
 #endif /* CONFIG_TRACEPOINTS */
 
+	bwmgr_stats.requests++;
+
 	switch (req) {
 	case TEGRA_BWMGR_SET_EMC_FLOOR:
 		if (handle->floor != val) {
-			handle->floor = val;
+			bwmgr_client_set_floor(handle, val);
 			update_clk = true;
 		}
 		break;
@@ -462,7 +679,7 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 			val = bwmgr.emc_max_rate;
 
 		if (handle->cap != val) {
-			handle->cap = val;
+			bwmgr_client_set_cap(handle, val);
 			update_clk = true;
 		}
 		break;
@@ -472,21 +689,21 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 			val = bwmgr.emc_max_rate;
 
 		if (handle->iso_cap != val) {
-			handle->iso_cap = val;
+			bwmgr_client_set_iso_cap(handle, val);
 			update_clk = true;
 		}
 		break;
 
 	case TEGRA_BWMGR_SET_EMC_SHARED_BW:
 		if (handle->bw != val) {
-			handle->bw = val;
+			bwmgr_client_set_bw(handle, val);
 			update_clk = true;
 		}
 		break;
 
 	case TEGRA_BWMGR_SET_EMC_SHARED_BW_ISO:
 		if (handle->iso_bw != val) {
-			handle->iso_bw = val;
+			bwmgr_client_set_iso_bw(handle, val);
 			update_clk = true;
 		}
 		break;
@@ -502,8 +719,17 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 		return -EINVAL;
 	}
 
-	if (update_clk && !clk_update_disabled)
-		ret = bwmgr_update_clk();
+	if (update_clk) {
+		bwmgr_stats.changes++;
+		if (!clk_update_disabled)
+			ret = bwmgr_request_update(since);
+	}
+
+	if (update_clk && (req == TEGRA_BWMGR_SET_EMC_SHARED_BW ||
+			req == TEGRA_BWMGR_SET_EMC_SHARED_BW_ISO))
+		tegra_bwmgr_predict_sample(TEGRA_BWMGR_PREDICT_SRC_BWMGR,
+				bwmgr.bw_sum + bwmgr.iso_bw_nvdis_sum +
+				bwmgr.iso_bw_vi_sum + bwmgr.iso_bw_other_sum);
 
 	if (!bwmgr_unlock()) {
 		pr_err("bwmgr: %s failed for client %s\n",
@@ -785,6 +1011,8 @@ int __init bwmgr_init(void)
 	struct clk *emc_master_clk;
 
 	mutex_init(&bwmgr.lock);
+	INIT_DELAYED_WORK(&bwmgr.coalesce_work, bwmgr_coalesce_work);
+	bwmgr.coalesce_us = BWMGR_COALESCE_WINDOW_US;
 
 	if (tegra_get_chip_id() == TEGRA210)
 		bwmgr.ops = bwmgr_eff_init_t21x();
@@ -843,8 +1071,15 @@ int __init bwmgr_init(void)
 		}
 	}
 
-	for (i = 0; i < TEGRA_BWMGR_CLIENT_COUNT; i++)
+	of_property_read_u32(dn, "nvidia,bwmgr-coalesce-us",
+			&bwmgr.coalesce_us);
+
+	for (i = 0; i < TEGRA_BWMGR_CLIENT_COUNT; i++) {
+		RB_CLEAR_NODE(&bwmgr.bwmgr_client[i].cap_node.rb);
+		RB_CLEAR_NODE(&bwmgr.bwmgr_client[i].iso_cap_node.rb);
+		RB_CLEAR_NODE(&bwmgr.bwmgr_client[i].floor_node.rb);
 		purge_client(bwmgr.bwmgr_client + i);
+	}
 
 	bwmgr_debugfs_init();
 	pmqos_bwmgr_init();
@@ -863,6 +1098,8 @@ void __exit bwmgr_exit(void)
 {
 	int i;
 
+	cancel_delayed_work_sync(&bwmgr.coalesce_work);
+
 	for (i = 0; i < TEGRA_BWMGR_CLIENT_COUNT; i++)
 		purge_client(bwmgr.bwmgr_client + i);
 
@@ -957,6 +1194,7 @@ static int bwmgr_debugfs_emc_rate_set(void *data, u64 val)
 		bwmgr_update_clk();
 	} else if (bwmgr.emc_clk) {
 		bwmgr.override = true;
+		bwmgr.applied_rate = 0;
 		ret = clk_set_rate(bwmgr.emc_clk, val);
 	}
 
@@ -1134,6 +1372,49 @@ static const struct file_operations fops_bwmgr_clients_info = {
 	.release = single_release,
 };
 
+static int bwmgr_stats_show(struct seq_file *s, void *data)
+{
+	if (!bwmgr_lock()) {
+		pr_err("bwmgr: %s failed\n", __func__);
+		return -EINVAL;
+	}
+	seq_printf(s, "Requests                  : %llu\n", bwmgr_stats.requests);
+	seq_printf(s, "Requests changing a client: %llu\n", bwmgr_stats.changes);
+	seq_printf(s, "Deferred updates          : %llu\n", bwmgr_stats.deferred);
+	seq_printf(s, "Coalesced requests        : %llu\n",
+			bwmgr_stats.coalesced);
+	seq_printf(s, "EMC rate changes          : %llu\n",
+			bwmgr_stats.rate_changes);
+	seq_printf(s, "EMC rate unchanged        : %llu\n",
+			bwmgr_stats.rate_unchanged);
+	seq_printf(s, "EMC rate change failures  : %llu\n",
+			bwmgr_stats.failures);
+	seq_printf(s, "Request to apply latency  : %llu avg, %llu max (us)\n",
+			bwmgr_stats.rate_changes ?
+			div64_u64(bwmgr_stats.latency_total_us,
+				bwmgr_stats.rate_changes) : 0,
+			bwmgr_stats.latency_max_us);
+	seq_printf(s, "Coalescing window         : %u (us)\n",
+			bwmgr.coalesce_us);
+	if (!bwmgr_unlock()) {
+		pr_err("bwmgr: %s failed\n", __func__);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int bwmgr_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bwmgr_stats_show, inode->i_private);
+}
+
+static const struct file_operations fops_bwmgr_stats = {
+	.open = bwmgr_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static void bwmgr_debugfs_init(void)
 {
 	bwmgr_debugfs_client_handle =
@@ -1183,6 +1464,12 @@ static void bwmgr_debugfs_init(void)
 		debugfs_node_dram_channels = debugfs_create_file(
 			"num_dram_channels", S_IRUSR, debugfs_dir, NULL,
 			 &fops_debugfs_dram_channels);
+		debugfs_create_u32(
+			"coalesce_window_us", S_IRUSR | S_IWUSR, debugfs_dir,
+			&bwmgr.coalesce_us);
+		debugfs_create_file(
+			"bwmgr_stats", S_IRUGO, debugfs_dir, NULL,
+			&fops_bwmgr_stats);
 	} else
 		pr_err("bwmgr: error creating bwmgr debugfs dir.\n");
 
@@ -0,0 +1,859 @@
+/**
+ * Copyright (c) 2019, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+/*
+ * Predictive EMC governor.
+ *
+ * Actmon and bwmgr clients only raise the EMC rate after the demand has
+ * shown up, so every burst starts at the old rate. Frame driven workloads
+ * (display, camera, video) produce their bursts at a fixed period though.
+ * This governor tracks the demand reported by actmon and by the bwmgr
+ * clients, detects burst onsets, estimates their period and, once the
+ * period is stable, raises an EMC floor lead_us ahead of the next expected
+ * onset. The floor is dropped again lead_us + hold_us after it was raised,
+ * by which time the reactive paths have caught up.
+ *
+ * Recorded traces (see the trace node) can be written to replay_trace and
+ * run through the same predictor by reading replay, which compares EMC
+ * starvation and rate integral against the purely reactive behaviour.
+ */
+
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
+#include <linux/sort.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/platform/tegra/emc_bwmgr.h>
+
+#define PREDICT_ONSETS			16
+#define PREDICT_MAX_MULTIPLE		3
+#define PREDICT_TRACE_LEN		4096
+#define PREDICT_REPLAY_MAX		65536
+#define PREDICT_REPLAY_MAX_STEPS	20000000ULL
+
+#define PREDICT_DEFAULT_LEAD_US		2000
+#define PREDICT_DEFAULT_HOLD_US		4000
+#define PREDICT_DEFAULT_THRESHOLD_PCT	20
+#define PREDICT_DEFAULT_TOLERANCE_PCT	10
+#define PREDICT_DEFAULT_MIN_PERIOD_US	4000
+#define PREDICT_DEFAULT_MAX_PERIOD_US	200000
+#define PREDICT_DEFAULT_REACT_US	4000
+#define PREDICT_DEFAULT_STEP_US		100
+
+struct bwmgr_predict_params {
+	u32 lead_us;
+	u32 hold_us;
+	u32 threshold_pct; /* onset level above idle, in % of max rate */
+	u32 tolerance_pct; /* allowed period jitter */
+	u32 min_period_us;
+	u32 max_period_us;
+	unsigned long max_rate;
+};
+
+enum bwmgr_predict_state {
+	PREDICT_IDLE,
+	PREDICT_ARMED, /* waiting for raise_at */
+	PREDICT_RAISED, /* floor held until drop_at */
+};
+
+struct bwmgr_predictor {
+	const struct bwmgr_predict_params *params;
+
+	unsigned long level[TEGRA_BWMGR_PREDICT_SRC_COUNT];
+	unsigned long idle_level;
+	unsigned long burst_level;
+	unsigned long burst_peak;
+	bool in_burst;
+
+	/* burst onset history in ns, onset_head is the next slot */
+	u64 onset[PREDICT_ONSETS];
+	unsigned int onset_head;
+	unsigned int onset_count;
+	u64 period;
+	bool locked;
+
+	enum bwmgr_predict_state state;
+	u64 raise_at;
+	u64 raised_at;
+	u64 drop_at;
+	bool window_hit;
+	unsigned long floor;
+
+	u64 onsets;
+	u64 raises;
+	u64 hits;
+	u64 late;
+	u64 missed;
+	u64 wasted;
+	u64 lead_total_ns;
+};
+
+struct bwmgr_predict_sample {
+	u64 t_us;
+	u32 src;
+	u32 rate_khz;
+};
+
+static struct {
+	struct bwmgr_predict_params params;
+	struct bwmgr_predictor pred;
+	bool enabled;
+	bool ready;
+	spinlock_t lock;
+	struct hrtimer timer;
+	struct work_struct work;
+	struct tegra_bwmgr_client *handle;
+	unsigned long applied_floor;
+
+	struct bwmgr_predict_sample *trace;
+	unsigned int trace_head;
+	u64 trace_count;
+
+	struct mutex replay_lock;
+	struct bwmgr_predict_sample *replay;
+	unsigned int replay_count;
+	char replay_line[64];
+	unsigned int replay_line_len;
+	u32 replay_react_us;
+	u32 replay_step_us;
+} predict;
+
+static u64 predictor_last_onset(struct bwmgr_predictor *p)
+{
+	return p->onset[(p->onset_head + PREDICT_ONSETS - 1) % PREDICT_ONSETS];
+}
+
+static int predictor_cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a;
+	u32 y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Estimate the burst period from the onset history. Intervals that are a
+ * small multiple of the median count as matches, so the odd skipped frame
+ * does not break the lock. The period is the average over all matches.
+ */
+static void predictor_estimate(struct bwmgr_predictor *p)
+{
+	u32 iv[PREDICT_ONSETS - 1];
+	u32 sorted[PREDICT_ONSETS - 1];
+	unsigned int n = 0, matched = 0, total_k = 0;
+	unsigned int i, k, cur, prev;
+	u64 total = 0;
+	u32 median, slack, expect;
+
+	for (i = 1; i < p->onset_count; i++) {
+		cur = (p->onset_head + PREDICT_ONSETS - i) % PREDICT_ONSETS;
+		prev = (cur + PREDICT_ONSETS - 1) % PREDICT_ONSETS;
+		iv[n++] = div_u64(p->onset[cur] - p->onset[prev], 1000);
+	}
+
+	p->locked = false;
+	p->period = 0;
+	if (n < 3)
+		return;
+
+	memcpy(sorted, iv, n * sizeof(*iv));
+	sort(sorted, n, sizeof(*sorted), predictor_cmp_u32, NULL);
+	median = sorted[n / 2];
+	if (!median)
+		return;
+
+	for (i = 0; i < n; i++) {
+		k = DIV_ROUND_CLOSEST(iv[i], median);
+		if (k < 1 || k > PREDICT_MAX_MULTIPLE)
+			continue;
+
+		expect = median * k;
+		slack = div_u64((u64)expect * p->params->tolerance_pct, 100);
+		if (abs((s64)iv[i] - expect) > slack)
+			continue;
+
+		matched++;
+		total_k += k;
+		total += iv[i];
+	}
+
+	if (matched * 4 < n * 3)
+		return;
+
+	p->locked = true;
+	p->period = div_u64(total * 1000, total_k);
+}
+
+/* Pick the next raise time from the last onset and the period. */
+static void predictor_schedule(struct bwmgr_predictor *p, u64 now)
+{
+	u64 lead = (u64)p->params->lead_us * 1000;
+	u64 last = predictor_last_onset(p);
+	u64 next;
+
+	if (p->locked && now - last > PREDICT_MAX_MULTIPLE * p->period)
+		p->locked = false;
+
+	if (!p->locked) {
+		if (p->state == PREDICT_ARMED)
+			p->state = PREDICT_IDLE;
+		return;
+	}
+
+	next = last + p->period;
+	if (next < lead || next - lead <= now) {
+		next += (div64_u64(now + lead - next, p->period) + 1) *
+			p->period;
+	}
+
+	p->raise_at = next - lead;
+	if (p->state == PREDICT_IDLE)
+		p->state = PREDICT_ARMED;
+}
+
+static void predictor_onset(struct bwmgr_predictor *p, u64 now)
+{
+	u64 min_period = (u64)p->params->min_period_us * 1000;
+	u64 max_period = (u64)p->params->max_period_us * 1000;
+	u64 last = predictor_last_onset(p);
+
+	/* a burst that re-crosses the threshold is not a new frame */
+	if (p->onset_count && now - last < min_period)
+		return;
+
+	if (p->onset_count && now - last > max_period)
+		p->onset_count = 0;
+
+	p->onsets++;
+	switch (p->state) {
+	case PREDICT_RAISED:
+		p->hits++;
+		p->window_hit = true;
+		p->lead_total_ns += now - p->raised_at;
+		break;
+	case PREDICT_ARMED:
+		p->late++;
+		break;
+	default:
+		if (p->locked)
+			p->missed++;
+		break;
+	}
+
+	p->onset[p->onset_head] = now;
+	p->onset_head = (p->onset_head + 1) % PREDICT_ONSETS;
+	if (p->onset_count < PREDICT_ONSETS)
+		p->onset_count++;
+
+	predictor_estimate(p);
+	predictor_schedule(p, now);
+}
+
+static void predictor_feed(struct bwmgr_predictor *p,
+		enum tegra_bwmgr_predict_src src, unsigned long rate, u64 now)
+{
+	unsigned long level = 0, on, off;
+	int i;
+
+	p->level[src] = rate;
+	for (i = 0; i < TEGRA_BWMGR_PREDICT_SRC_COUNT; i++)
+		level = max(level, p->level[i]);
+
+	on = p->idle_level +
+		p->params->max_rate / 100 * p->params->threshold_pct;
+	off = p->idle_level +
+		p->params->max_rate / 200 * p->params->threshold_pct;
+
+	/* let the baseline follow even if tracking started inside a burst */
+	if (level < on)
+		p->idle_level = (p->idle_level * 7 + level) / 8;
+
+	if (!p->in_burst) {
+		if (level >= on) {
+			p->in_burst = true;
+			p->burst_peak = level;
+			predictor_onset(p, now);
+		}
+		return;
+	}
+
+	p->burst_peak = max(p->burst_peak, level);
+	if (level < off) {
+		p->in_burst = false;
+		if (p->burst_level)
+			p->burst_level = (p->burst_level * 3 + p->burst_peak) / 4;
+		else
+			p->burst_level = p->burst_peak;
+	}
+}
+
+/* Advance the floor state machine. Returns the next event time or 0. */
+static u64 predictor_tick(struct bwmgr_predictor *p, u64 now)
+{
+	u64 window = ((u64)p->params->lead_us + p->params->hold_us) * 1000;
+
+	if (p->state == PREDICT_ARMED && now >= p->raise_at) {
+		p->state = PREDICT_RAISED;
+		p->raised_at = now;
+		p->drop_at = p->raise_at + window;
+		p->window_hit = false;
+		p->floor = p->burst_level ? p->burst_level : p->burst_peak;
+		p->raises++;
+	}
+
+	if (p->state == PREDICT_RAISED && now >= p->drop_at) {
+		if (!p->window_hit)
+			p->wasted++;
+		p->floor = 0;
+		p->state = PREDICT_IDLE;
+		predictor_schedule(p, now);
+	}
+
+	if (p->state == PREDICT_ARMED)
+		return p->raise_at;
+	if (p->state == PREDICT_RAISED)
+		return p->drop_at;
+	return 0;
+}
+
+static void predictor_init(struct bwmgr_predictor *p,
+		const struct bwmgr_predict_params *params)
+{
+	memset(p, 0, sizeof(*p));
+	p->params = params;
+}
+
+static enum hrtimer_restart bwmgr_predict_timer_fn(struct hrtimer *timer)
+{
+	enum hrtimer_restart ret = HRTIMER_NORESTART;
+	unsigned long flags;
+	u64 next = 0;
+
+	spin_lock_irqsave(&predict.lock, flags);
+	if (predict.enabled) {
+		next = predictor_tick(&predict.pred, ktime_get_ns());
+	} else {
+		predict.pred.state = PREDICT_IDLE;
+		predict.pred.floor = 0;
+	}
+
+	if (next) {
+		hrtimer_set_expires(timer, ns_to_ktime(next));
+		ret = HRTIMER_RESTART;
+	}
+	spin_unlock_irqrestore(&predict.lock, flags);
+
+	queue_work(system_highpri_wq, &predict.work);
+
+	return ret;
+}
+
+static void bwmgr_predict_work(struct work_struct *work)
+{
+	unsigned long flags, floor;
+	int ret;
+
+	spin_lock_irqsave(&predict.lock, flags);
+	floor = predict.pred.floor;
+	spin_unlock_irqrestore(&predict.lock, flags);
+
+	if (floor == predict.applied_floor)
+		return;
+
+	ret = tegra_bwmgr_set_emc(predict.handle, floor,
+			TEGRA_BWMGR_SET_EMC_FLOOR);
+	if (ret) {
+		pr_err("bwmgr_predict: failed to set floor %lu Hz: %d\n",
+				floor, ret);
+		return;
+	}
+
+	predict.applied_floor = floor;
+}
+
+void tegra_bwmgr_predict_sample(enum tegra_bwmgr_predict_src src,
+		unsigned long rate)
+{
+	struct bwmgr_predict_sample *s;
+	enum bwmgr_predict_state state;
+	unsigned long flags;
+	u64 raise_at;
+	u64 now;
+
+	if (!smp_load_acquire(&predict.ready) || src >= TEGRA_BWMGR_PREDICT_SRC_COUNT)
+		return;
+
+	now = ktime_get_ns();
+
+	spin_lock_irqsave(&predict.lock, flags);
+
+	if (predict.trace) {
+		s = &predict.trace[predict.trace_head];
+		s->t_us = div_u64(now, 1000);
+		s->src = src;
+		s->rate_khz = rate / 1000;
+		predict.trace_head = (predict.trace_head + 1) %
+			PREDICT_TRACE_LEN;
+		predict.trace_count++;
+	}
+
+	if (predict.enabled) {
+		state = predict.pred.state;
+		raise_at = predict.pred.raise_at;
+		predictor_feed(&predict.pred, src, rate, now);
+		if (predict.pred.state == PREDICT_ARMED &&
+				(state != PREDICT_ARMED ||
+				 raise_at != predict.pred.raise_at))
+			hrtimer_start(&predict.timer,
+					ns_to_ktime(predict.pred.raise_at),
+					HRTIMER_MODE_ABS);
+	}
+
+	spin_unlock_irqrestore(&predict.lock, flags);
+}
+EXPORT_SYMBOL_GPL(tegra_bwmgr_predict_sample);
+
+#ifdef CONFIG_DEBUG_FS
+static int bwmgr_predict_status_show(struct seq_file *s, void *data)
+{
+	static const char * const state_names[] = {
+		"idle", "armed", "raised",
+	};
+	struct bwmgr_predictor p;
+	unsigned long flags;
+	bool enabled;
+
+	spin_lock_irqsave(&predict.lock, flags);
+	p = predict.pred;
+	enabled = predict.enabled;
+	spin_unlock_irqrestore(&predict.lock, flags);
+
+	seq_printf(s, "enabled:        %d\n", enabled);
+	seq_printf(s, "state:          %s\n", state_names[p.state]);
+	seq_printf(s, "locked:         %d\n", p.locked);
+	seq_printf(s, "period_us:      %llu\n", div_u64(p.period, 1000));
+	seq_printf(s, "idle_khz:       %lu\n", p.idle_level / 1000);
+	seq_printf(s, "burst_khz:      %lu\n", p.burst_level / 1000);
+	seq_printf(s, "floor_khz:      %lu\n", p.floor / 1000);
+	seq_printf(s, "onsets:         %llu\n", p.onsets);
+	seq_printf(s, "raises:         %llu\n", p.raises);
+	seq_printf(s, "hits:           %llu\n", p.hits);
+	seq_printf(s, "late:           %llu\n", p.late);
+	seq_printf(s, "missed:         %llu\n", p.missed);
+	seq_printf(s, "wasted:         %llu\n", p.wasted);
+	seq_printf(s, "avg_lead_us:    %llu\n", p.hits ?
+			div64_u64(p.lead_total_ns, p.hits * 1000) : 0);
+
+	return 0;
+}
+
+static int bwmgr_predict_status_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bwmgr_predict_status_show, inode->i_private);
+}
+
+static const struct file_operations fops_bwmgr_predict_status = {
+	.open = bwmgr_predict_status_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* one "<time_us> <src> <rate_khz>" line per sample, oldest first */
+static int bwmgr_predict_trace_show(struct seq_file *s, void *data)
+{
+	struct bwmgr_predict_sample *snap;
+	unsigned int i, n, first;
+	unsigned long flags;
+
+	if (!predict.trace)
+		return -ENOMEM;
+
+	snap = vmalloc(PREDICT_TRACE_LEN * sizeof(*snap));
+	if (!snap)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&predict.lock, flags);
+	n = min_t(u64, predict.trace_count, PREDICT_TRACE_LEN);
+	first = (predict.trace_head + PREDICT_TRACE_LEN - n) %
+		PREDICT_TRACE_LEN;
+	for (i = 0; i < n; i++)
+		snap[i] = predict.trace[(first + i) % PREDICT_TRACE_LEN];
+	spin_unlock_irqrestore(&predict.lock, flags);
+
+	for (i = 0; i < n; i++)
+		seq_printf(s, "%llu %u %u\n", snap[i].t_us, snap[i].src,
+				snap[i].rate_khz);
+
+	vfree(snap);
+
+	return 0;
+}
+
+static int bwmgr_predict_trace_open(struct inode *inode, struct file *file)
+{
+	return single_open_size(file, bwmgr_predict_trace_show,
+			inode->i_private, PREDICT_TRACE_LEN * 32);
+}
+
+static const struct file_operations fops_bwmgr_predict_trace = {
+	.open = bwmgr_predict_trace_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* call with replay_lock held */
+static int bwmgr_predict_replay_parse(const char *line)
+{
+	struct bwmgr_predict_sample *s;
+	unsigned long long t_us;
+	unsigned int src, rate_khz;
+
+	line = skip_spaces(line);
+	if (!*line || *line == '#')
+		return 0;
+
+	if (sscanf(line, "%llu %u %u", &t_us, &src, &rate_khz) != 3 ||
+			src >= TEGRA_BWMGR_PREDICT_SRC_COUNT)
+		return -EINVAL;
+
+	if (predict.replay_count &&
+			t_us < predict.replay[predict.replay_count - 1].t_us)
+		return -EINVAL;
+
+	if (predict.replay_count >= PREDICT_REPLAY_MAX)
+		return -ENOSPC;
+
+	s = &predict.replay[predict.replay_count++];
+	s->t_us = t_us;
+	s->src = src;
+	s->rate_khz = rate_khz;
+
+	return 0;
+}
+
+static int bwmgr_predict_replay_trace_open(struct inode *inode,
+		struct file *file)
+{
+	mutex_lock(&predict.replay_lock);
+	if (file->f_flags & O_TRUNC)
+		predict.replay_count = 0;
+	predict.replay_line_len = 0;
+	mutex_unlock(&predict.replay_lock);
+
+	return nonseekable_open(inode, file);
+}
+
+static ssize_t bwmgr_predict_replay_trace_write(struct file *file,
+		const char __user *user_buf, size_t count, loff_t *ppos)
+{
+	char buf[256 + sizeof(predict.replay_line)];
+	size_t done = 0, len, chunk;
+	char *line, *nl;
+	int ret = 0;
+
+	mutex_lock(&predict.replay_lock);
+
+	if (!predict.replay) {
+		predict.replay = vmalloc(PREDICT_REPLAY_MAX *
+				sizeof(*predict.replay));
+		if (!predict.replay) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	while (done < count) {
+		len = predict.replay_line_len;
+		memcpy(buf, predict.replay_line, len);
+		chunk = min(count - done, sizeof(buf) - len - 1);
+		if (copy_from_user(buf + len, user_buf + done, chunk)) {
+			ret = -EFAULT;
+			goto out;
+		}
+		done += chunk;
+		len += chunk;
+		buf[len] = '\0';
+
+		line = buf;
+		while ((nl = strchr(line, '\n'))) {
+			*nl = '\0';
+			ret = bwmgr_predict_replay_parse(line);
+			if (ret)
+				goto out;
+			line = nl + 1;
+		}
+
+		len = buf + len - line;
+		if (len >= sizeof(predict.replay_line)) {
+			ret = -EINVAL;
+			goto out;
+		}
+		memcpy(predict.replay_line, line, len);
+		predict.replay_line_len = len;
+	}
+
+out:
+	if (ret)
+		predict.replay_line_len = 0;
+	mutex_unlock(&predict.replay_lock);
+
+	return ret ? ret : count;
+}
+
+static int bwmgr_predict_replay_trace_release(struct inode *inode,
+		struct file *file)
+{
+	mutex_lock(&predict.replay_lock);
+	if (predict.replay_line_len) {
+		predict.replay_line[predict.replay_line_len] = '\0';
+		if (bwmgr_predict_replay_parse(predict.replay_line))
+			pr_err("bwmgr_predict: bad replay sample \"%s\"\n",
+					predict.replay_line);
+		predict.replay_line_len = 0;
+	}
+	mutex_unlock(&predict.replay_lock);
+
+	return 0;
+}
+
+static const struct file_operations fops_bwmgr_predict_replay_trace = {
+	.open = bwmgr_predict_replay_trace_open,
+	.write = bwmgr_predict_replay_trace_write,
+	.release = bwmgr_predict_replay_trace_release,
+	.llseek = no_llseek,
+};
+
+struct bwmgr_predict_replay_model {
+	u64 rate_integral; /* kHz * us */
+	u64 deficit_integral; /* kHz * us */
+	u64 starved_us;
+};
+
+static void bwmgr_predict_replay_account(
+		struct bwmgr_predict_replay_model *m, unsigned long rate,
+		unsigned long demand, u32 step_us)
+{
+	m->rate_integral += (u64)(rate / 1000) * step_us;
+	if (rate < demand) {
+		m->deficit_integral += (u64)((demand - rate) / 1000) * step_us;
+		m->starved_us += step_us;
+	}
+}
+
+static void bwmgr_predict_replay_report(struct seq_file *s, const char *name,
+		struct bwmgr_predict_replay_model *m)
+{
+	seq_printf(s, "%-10s rate_integral %llu MHz*ms, starved %llu us, deficit %llu MHz*ms\n",
+			name, div_u64(m->rate_integral, 1000000),
+			m->starved_us, div_u64(m->deficit_integral, 1000000));
+}
+
+/*
+ * Run the recorded trace through a private predictor. The reactive model
+ * follows the demand react_us late, the predictive one additionally holds
+ * the predicted floor.
+ */
+static int bwmgr_predict_replay_show(struct seq_file *s, void *data)
+{
+	unsigned long demand[TEGRA_BWMGR_PREDICT_SRC_COUNT] = { 0 };
+	unsigned long react[TEGRA_BWMGR_PREDICT_SRC_COUNT] = { 0 };
+	struct bwmgr_predict_replay_model reactive = { 0 };
+	struct bwmgr_predict_replay_model predictive = { 0 };
+	struct bwmgr_predict_params params;
+	struct bwmgr_predictor p;
+	struct bwmgr_predict_sample *smp;
+	unsigned int i_now = 0, i_react = 0, n, i;
+	unsigned long want, got;
+	u64 t, t_end, react_us, steps = 0;
+	u32 step_us;
+	int ret = 0;
+
+	mutex_lock(&predict.replay_lock);
+
+	n = predict.replay_count;
+	smp = predict.replay;
+	if (n < 2) {
+		seq_puts(s, "no trace, write samples to replay_trace\n");
+		goto out;
+	}
+
+	params = predict.params;
+	predictor_init(&p, &params);
+	react_us = predict.replay_react_us;
+	step_us = max_t(u32, predict.replay_step_us, 1);
+	t_end = smp[n - 1].t_us + react_us;
+
+	if (div64_u64(t_end - smp[0].t_us, step_us) >
+			PREDICT_REPLAY_MAX_STEPS) {
+		ret = -E2BIG;
+		goto out;
+	}
+
+	for (t = smp[0].t_us; t <= t_end; t += step_us) {
+		predictor_tick(&p, t * 1000);
+
+		for (; i_now < n && smp[i_now].t_us <= t; i_now++) {
+			demand[smp[i_now].src] =
+				(unsigned long)smp[i_now].rate_khz * 1000;
+			predictor_feed(&p, smp[i_now].src,
+					demand[smp[i_now].src],
+					smp[i_now].t_us * 1000);
+		}
+
+		for (; i_react < n && smp[i_react].t_us + react_us <= t;
+				i_react++)
+			react[smp[i_react].src] =
+				(unsigned long)smp[i_react].rate_khz * 1000;
+
+		want = 0;
+		got = 0;
+		for (i = 0; i < TEGRA_BWMGR_PREDICT_SRC_COUNT; i++) {
+			want = max(want, demand[i]);
+			got = max(got, react[i]);
+		}
+
+		bwmgr_predict_replay_account(&reactive, got, want, step_us);
+		bwmgr_predict_replay_account(&predictive, max(got, p.floor),
+				want, step_us);
+
+		if (!(++steps % 4096))
+			cond_resched();
+	}
+
+	seq_printf(s, "samples %u, duration %llu us, step %u us, react %llu us\n",
+			n, smp[n - 1].t_us - smp[0].t_us, step_us, react_us);
+	seq_printf(s, "onsets %llu, locked %d, period %llu us\n",
+			p.onsets, p.locked, div_u64(p.period, 1000));
+	seq_printf(s, "raises %llu, hits %llu, late %llu, missed %llu, wasted %llu, avg_lead %llu us\n",
+			p.raises, p.hits, p.late, p.missed, p.wasted,
+			p.hits ? div64_u64(p.lead_total_ns, p.hits * 1000) : 0);
+	bwmgr_predict_replay_report(s, "reactive", &reactive);
+	bwmgr_predict_replay_report(s, "predictive", &predictive);
+
+out:
+	mutex_unlock(&predict.replay_lock);
+
+	return ret;
+}
+
+static int bwmgr_predict_replay_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bwmgr_predict_replay_show, inode->i_private);
+}
+
+static const struct file_operations fops_bwmgr_predict_replay = {
+	.open = bwmgr_predict_replay_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void bwmgr_predict_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("tegra_bwmgr_predict", NULL);
+	if (!dir) {
+		pr_err("bwmgr_predict: error creating debugfs dir.\n");
+		return;
+	}
+
+	debugfs_create_bool("enable", S_IRUSR | S_IWUSR, dir,
+			&predict.enabled);
+	debugfs_create_u32("lead_us", S_IRUSR | S_IWUSR, dir,
+			&predict.params.lead_us);
+	debugfs_create_u32("hold_us", S_IRUSR | S_IWUSR, dir,
+			&predict.params.hold_us);
+	debugfs_create_u32("threshold_pct", S_IRUSR | S_IWUSR, dir,
+			&predict.params.threshold_pct);
+	debugfs_create_u32("tolerance_pct", S_IRUSR | S_IWUSR, dir,
+			&predict.params.tolerance_pct);
+	debugfs_create_u32("min_period_us", S_IRUSR | S_IWUSR, dir,
+			&predict.params.min_period_us);
+	debugfs_create_u32("max_period_us", S_IRUSR | S_IWUSR, dir,
+			&predict.params.max_period_us);
+	debugfs_create_file("status", S_IRUGO, dir, NULL,
+			&fops_bwmgr_predict_status);
+	debugfs_create_file("trace", S_IRUSR, dir, NULL,
+			&fops_bwmgr_predict_trace);
+	debugfs_create_u32("replay_react_us", S_IRUSR | S_IWUSR, dir,
+			&predict.replay_react_us);
+	debugfs_create_u32("replay_step_us", S_IRUSR | S_IWUSR, dir,
+			&predict.replay_step_us);
+	debugfs_create_file("replay_trace", S_IWUSR, dir, NULL,
+			&fops_bwmgr_predict_replay_trace);
+	debugfs_create_file("replay", S_IRUSR, dir, NULL,
+			&fops_bwmgr_predict_replay);
+}
+#else
+static void bwmgr_predict_debugfs_init(void) {};
+#endif /* CONFIG_DEBUG_FS */
+
+static int __init bwmgr_predict_init(void)
+{
+	struct bwmgr_predict_params *params = &predict.params;
+
+	params->max_rate = tegra_bwmgr_get_max_emc_rate();
+	if (!params->max_rate) {
+		pr_info("bwmgr_predict: no EMC rate, governor disabled\n");
+		return 0;
+	}
+
+	predict.handle = tegra_bwmgr_register(TEGRA_BWMGR_CLIENT_PREDICT);
+	if (IS_ERR_OR_NULL(predict.handle)) {
+		pr_err("bwmgr_predict: could not register bwmgr client\n");
+		return -ENODEV;
+	}
+
+	params->lead_us = PREDICT_DEFAULT_LEAD_US;
+	params->hold_us = PREDICT_DEFAULT_HOLD_US;
+	params->threshold_pct = PREDICT_DEFAULT_THRESHOLD_PCT;
+	params->tolerance_pct = PREDICT_DEFAULT_TOLERANCE_PCT;
+	params->min_period_us = PREDICT_DEFAULT_MIN_PERIOD_US;
+	params->max_period_us = PREDICT_DEFAULT_MAX_PERIOD_US;
+	predict.replay_react_us = PREDICT_DEFAULT_REACT_US;
+	predict.replay_step_us = PREDICT_DEFAULT_STEP_US;
+
+	predictor_init(&predict.pred, params);
+	spin_lock_init(&predict.lock);
+	mutex_init(&predict.replay_lock);
+	hrtimer_init(&predict.timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	predict.timer.function = bwmgr_predict_timer_fn;
+	INIT_WORK(&predict.work, bwmgr_predict_work);
+
+	/* the trace is only a debug aid, run without it if need be */
+	predict.trace = kcalloc(PREDICT_TRACE_LEN, sizeof(*predict.trace),
+			GFP_KERNEL);
+
+	bwmgr_predict_debugfs_init();
+
+	predict.enabled = true;
+	smp_store_release(&predict.ready, true);
+
+	return 0;
+}
+late_initcall(bwmgr_predict_init);
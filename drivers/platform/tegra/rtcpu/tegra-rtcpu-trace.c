@@ -23,19 +23,27 @@
 #include <linux/ioport.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
+#include <linux/log2.h>
+#include <linux/miscdevice.h>
+#include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_address.h>
 #include <linux/of_reserved_mem.h>
 #include <linux/printk.h>
+#include <linux/poll.h>
 #include <linux/seq_buf.h>
 #include <linux/slab.h>
 #include <linux/tegra-camera-rtcpu.h>
 #include <linux/tegra-rtcpu-trace.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
 #include <linux/workqueue.h>
 #include <linux/platform_device.h>
 #include <linux/nvhost.h>
 #include <asm/cacheflush.h>
+#include <uapi/linux/tegra_rtcpu_trace.h>
 
 #ifdef CONFIG_EVENTLIB
 #include <linux/keventlib.h>
@@ -50,7 +58,10 @@
 #define NV(p) "nvidia," #p
 
 #define WORK_INTERVAL_DEFAULT		100
+#define WORK_INTERVAL_MIN_DEFAULT	5
 #define EXCEPTION_STR_LENGTH		2048
+#define STREAM_ENTRIES_DEFAULT		4096
+#define STREAM_ENTRIES_MIN		64
 
 /*
  * Private driver data structure
@@ -86,10 +97,22 @@ struct tegra_rtcpu_trace {
 	/* worker */
 	struct delayed_work work;
 	unsigned long work_interval_jiffies;
+	unsigned long work_interval_min;
+	unsigned long work_interval_max;
+	u64 work_last_n_events;
 
 	/* statistics */
 	u32 n_exceptions;
 	u64 n_events;
+	u32 max_fill_percent;
+
+	/* raw event stream */
+	struct miscdevice stream;
+	bool stream_registered;
+	struct list_head readers;
+	u32 stream_entries;
+	u64 n_stream_dropped;
+	bool decode_events;
 
 	/* copy of the latest exception and event */
 	char last_exception_str[EXCEPTION_STR_LENGTH];
@@ -1011,6 +1034,286 @@ static void rtcpu_trace_event(struct tegra_rtcpu_trace *tracer,
 	}
 }
 
+/*
+ * Raw event stream
+ */
+
+struct rtcpu_trace_reader {
+	struct list_head list;
+	struct tegra_rtcpu_trace *tracer;
+
+	/* ring shared with user space */
+	void *buf;
+	size_t buf_size;
+	struct rtcpu_trace_stream_header *hdr;
+	struct camrtc_event_struct *entries;
+	u32 entry_count;
+	u32 head;
+
+	struct mutex read_lock;
+	wait_queue_head_t waitq;
+	bool detached;
+};
+
+/* Serializes reader release against tegra_rtcpu_trace_destroy() */
+static DEFINE_MUTEX(rtcpu_trace_stream_lock);
+
+static void rtcpu_trace_stream_write(struct rtcpu_trace_reader *rd,
+	const struct camrtc_event_struct *events, u32 count)
+{
+	struct rtcpu_trace_stream_header *hdr = rd->hdr;
+	u32 used, space, idx, chunk;
+
+	used = rd->head - smp_load_acquire(&hdr->tail);
+	space = used < rd->entry_count ? rd->entry_count - used : 0;
+
+	if (count > space) {
+		hdr->dropped += count - space;
+		rd->tracer->n_stream_dropped += count - space;
+		count = space;
+	}
+
+	while (count > 0) {
+		idx = rd->head & (rd->entry_count - 1);
+		chunk = min(count, rd->entry_count - idx);
+
+		memcpy(&rd->entries[idx], events,
+			chunk * CAMRTC_TRACE_EVENT_SIZE);
+
+		events += chunk;
+		rd->head += chunk;
+		count -= chunk;
+	}
+
+	smp_store_release(&hdr->head, rd->head);
+}
+
+/*
+ * Copy the new events to every reader in bulk, without decoding them.
+ * Called with tracer->lock held.
+ */
+static void rtcpu_trace_stream_events(struct tegra_rtcpu_trace *tracer,
+	u32 old_next, u32 new_next)
+{
+	struct rtcpu_trace_reader *rd;
+
+	list_for_each_entry(rd, &tracer->readers, list) {
+		if (new_next > old_next) {
+			rtcpu_trace_stream_write(rd, &tracer->events[old_next],
+				new_next - old_next);
+		} else {
+			rtcpu_trace_stream_write(rd, &tracer->events[old_next],
+				tracer->event_entries - old_next);
+			rtcpu_trace_stream_write(rd, tracer->events, new_next);
+		}
+
+		wake_up_interruptible(&rd->waitq);
+	}
+}
+
+static int rtcpu_trace_stream_open(struct inode *inode, struct file *file)
+{
+	struct miscdevice *misc = file->private_data;
+	struct tegra_rtcpu_trace *tracer =
+		container_of(misc, struct tegra_rtcpu_trace, stream);
+	struct rtcpu_trace_reader *rd;
+
+	rd = kzalloc(sizeof(*rd), GFP_KERNEL);
+	if (rd == NULL)
+		return -ENOMEM;
+
+	rd->entry_count = tracer->stream_entries;
+	rd->buf_size = PAGE_SIZE +
+		(size_t)rd->entry_count * CAMRTC_TRACE_EVENT_SIZE;
+	rd->buf = vmalloc_user(rd->buf_size);
+	if (rd->buf == NULL) {
+		kfree(rd);
+		return -ENOMEM;
+	}
+
+	rd->hdr = rd->buf;
+	rd->hdr->version = RTCPU_TRACE_STREAM_VERSION;
+	rd->hdr->entry_size = CAMRTC_TRACE_EVENT_SIZE;
+	rd->hdr->entry_count = rd->entry_count;
+	rd->hdr->data_offset = PAGE_SIZE;
+	rd->entries = rd->buf + PAGE_SIZE;
+
+	rd->tracer = tracer;
+	mutex_init(&rd->read_lock);
+	init_waitqueue_head(&rd->waitq);
+
+	mutex_lock(&tracer->lock);
+	list_add_tail(&rd->list, &tracer->readers);
+	mutex_unlock(&tracer->lock);
+
+	file->private_data = rd;
+
+	return nonseekable_open(inode, file);
+}
+
+static int rtcpu_trace_stream_release(struct inode *inode, struct file *file)
+{
+	struct rtcpu_trace_reader *rd = file->private_data;
+
+	mutex_lock(&rtcpu_trace_stream_lock);
+	if (!rd->detached) {
+		mutex_lock(&rd->tracer->lock);
+		list_del(&rd->list);
+		mutex_unlock(&rd->tracer->lock);
+	}
+	mutex_unlock(&rtcpu_trace_stream_lock);
+
+	vfree(rd->buf);
+	kfree(rd);
+
+	return 0;
+}
+
+static bool rtcpu_trace_stream_ready(struct rtcpu_trace_reader *rd)
+{
+	return smp_load_acquire(&rd->hdr->head) != READ_ONCE(rd->hdr->tail) ||
+		READ_ONCE(rd->detached);
+}
+
+static ssize_t rtcpu_trace_stream_read(struct file *file, char __user *buf,
+	size_t count, loff_t *ppos)
+{
+	struct rtcpu_trace_reader *rd = file->private_data;
+	struct rtcpu_trace_stream_header *hdr = rd->hdr;
+	u32 head, tail, n, idx, chunk;
+	size_t done = 0;
+	ssize_t ret = 0;
+
+	if (count < CAMRTC_TRACE_EVENT_SIZE)
+		return -EINVAL;
+
+	mutex_lock(&rd->read_lock);
+
+	while (!rtcpu_trace_stream_ready(rd)) {
+		mutex_unlock(&rd->read_lock);
+
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+
+		ret = wait_event_interruptible(rd->waitq,
+				rtcpu_trace_stream_ready(rd));
+		if (ret)
+			return ret;
+
+		mutex_lock(&rd->read_lock);
+	}
+
+	head = smp_load_acquire(&hdr->head);
+	tail = READ_ONCE(hdr->tail);
+
+	n = min_t(size_t, head - tail, count / CAMRTC_TRACE_EVENT_SIZE);
+	n = min(n, rd->entry_count);
+
+	while (n > 0) {
+		idx = tail & (rd->entry_count - 1);
+		chunk = min(n, rd->entry_count - idx);
+
+		if (copy_to_user(buf + done, &rd->entries[idx],
+				chunk * CAMRTC_TRACE_EVENT_SIZE)) {
+			ret = -EFAULT;
+			break;
+		}
+
+		done += chunk * CAMRTC_TRACE_EVENT_SIZE;
+		tail += chunk;
+		n -= chunk;
+	}
+
+	smp_store_release(&hdr->tail, tail);
+
+	mutex_unlock(&rd->read_lock);
+
+	return done > 0 ? done : ret;
+}
+
+static unsigned int rtcpu_trace_stream_poll(struct file *file,
+	struct poll_table_struct *wait)
+{
+	struct rtcpu_trace_reader *rd = file->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(file, &rd->waitq, wait);
+
+	if (smp_load_acquire(&rd->hdr->head) != READ_ONCE(rd->hdr->tail))
+		mask |= POLLIN | POLLRDNORM;
+	if (READ_ONCE(rd->detached))
+		mask |= POLLHUP;
+
+	return mask;
+}
+
+static int rtcpu_trace_stream_mmap(struct file *file,
+	struct vm_area_struct *vma)
+{
+	struct rtcpu_trace_reader *rd = file->private_data;
+
+	return remap_vmalloc_range(vma, rd->buf, vma->vm_pgoff);
+}
+
+static const struct file_operations rtcpu_trace_stream_fops = {
+	.owner = THIS_MODULE,
+	.open = rtcpu_trace_stream_open,
+	.release = rtcpu_trace_stream_release,
+	.read = rtcpu_trace_stream_read,
+	.poll = rtcpu_trace_stream_poll,
+	.mmap = rtcpu_trace_stream_mmap,
+	.llseek = no_llseek,
+};
+
+static void rtcpu_trace_stream_init(struct tegra_rtcpu_trace *tracer)
+{
+	u32 entries = STREAM_ENTRIES_DEFAULT;
+	int ret;
+
+	INIT_LIST_HEAD(&tracer->readers);
+
+	of_property_read_u32(tracer->of_node, NV(stream-entries), &entries);
+	tracer->stream_entries = roundup_pow_of_two(
+		max_t(u32, entries, STREAM_ENTRIES_MIN));
+
+	tracer->stream.minor = MISC_DYNAMIC_MINOR;
+	tracer->stream.name = "rtcpu-trace";
+	tracer->stream.fops = &rtcpu_trace_stream_fops;
+	tracer->stream.parent = tracer->dev;
+
+	ret = misc_register(&tracer->stream);
+	if (ret) {
+		dev_warn(tracer->dev, "raw trace stream not available: %d\n",
+			ret);
+		return;
+	}
+
+	tracer->stream_registered = true;
+}
+
+static void rtcpu_trace_stream_deinit(struct tegra_rtcpu_trace *tracer)
+{
+	struct rtcpu_trace_reader *rd, *tmp;
+
+	if (!tracer->stream_registered)
+		return;
+
+	/* no new readers after this */
+	misc_deregister(&tracer->stream);
+
+	mutex_lock(&rtcpu_trace_stream_lock);
+	mutex_lock(&tracer->lock);
+
+	list_for_each_entry_safe(rd, tmp, &tracer->readers, list) {
+		list_del(&rd->list);
+		WRITE_ONCE(rd->detached, true);
+		wake_up_interruptible(&rd->waitq);
+	}
+
+	mutex_unlock(&tracer->lock);
+	mutex_unlock(&rtcpu_trace_stream_lock);
+}
+
 static inline void rtcpu_trace_events(struct tegra_rtcpu_trace *tracer)
 {
 	const struct camrtc_trace_memory_header *header = tracer->trace_memory;
@@ -1035,11 +1338,14 @@ static inline void rtcpu_trace_events(struct tegra_rtcpu_trace *tracer)
 				CAMRTC_TRACE_EVENT_SIZE,
 				tracer->event_entries);
 
+	rtcpu_trace_stream_events(tracer, old_next, new_next);
+
 	/* pull events */
 	while (old_next != new_next) {
 		event = &tracer->events[old_next];
 		last_event = event;
-		rtcpu_trace_event(tracer, event);
+		if (likely(tracer->decode_events))
+			rtcpu_trace_event(tracer, event);
 		tracer->n_events++;
 
 		if (++old_next == tracer->event_entries)
@@ -1069,6 +1375,31 @@ void tegra_rtcpu_trace_flush(struct tegra_rtcpu_trace *tracer)
 }
 EXPORT_SYMBOL(tegra_rtcpu_trace_flush);
 
+/*
+ * Poll faster while the RTCPU fills more than half of its event buffer
+ * between two polls, and back off again once less than an eighth is used.
+ */
+static void rtcpu_trace_adapt_interval(struct tegra_rtcpu_trace *tracer)
+{
+	u64 n_new = tracer->n_events - tracer->work_last_n_events;
+	u32 fill;
+
+	tracer->work_last_n_events = tracer->n_events;
+
+	fill = min_t(u64, div_u64(n_new * 100, tracer->event_entries), 100);
+	if (fill > tracer->max_fill_percent)
+		tracer->max_fill_percent = fill;
+
+	if (n_new * 2 > tracer->event_entries)
+		tracer->work_interval_jiffies = max(
+			tracer->work_interval_jiffies / 2,
+			tracer->work_interval_min);
+	else if (n_new * 8 < tracer->event_entries)
+		tracer->work_interval_jiffies = min(
+			tracer->work_interval_jiffies * 2,
+			tracer->work_interval_max);
+}
+
 static void rtcpu_trace_worker(struct work_struct *work)
 {
 	struct tegra_rtcpu_trace *tracer;
@@ -1077,6 +1408,10 @@ static void rtcpu_trace_worker(struct work_struct *work)
 
 	tegra_rtcpu_trace_flush(tracer);
 
+	mutex_lock(&tracer->lock);
+	rtcpu_trace_adapt_interval(tracer);
+	mutex_unlock(&tracer->lock);
+
 	/* reschedule */
 	schedule_delayed_work(&tracer->work, tracer->work_interval_jiffies);
 }
@@ -1103,6 +1438,11 @@ static int rtcpu_trace_debugfs_stats_read(
 
 	seq_printf(file, "Exceptions: %u\nEvents: %llu\n",
 			tracer->n_exceptions, tracer->n_events);
+	seq_printf(file, "Interval: %u ms\nMax fill: %u%%\n",
+			jiffies_to_msecs(tracer->work_interval_jiffies),
+			tracer->max_fill_percent);
+	seq_printf(file, "Stream dropped: %llu\n",
+			tracer->n_stream_dropped);
 
 	return 0;
 }
@@ -1198,6 +1538,11 @@ static void rtcpu_trace_debugfs_init(struct tegra_rtcpu_trace *tracer)
 	if (IS_ERR_OR_NULL(entry))
 		goto failed_create;
 
+	entry = debugfs_create_bool("decode_events", S_IRUGO | S_IWUSR,
+	    tracer->debugfs_root, &tracer->decode_events);
+	if (IS_ERR_OR_NULL(entry))
+		goto failed_create;
+
 	return;
 
 failed_create:
@@ -1212,7 +1557,7 @@ struct tegra_rtcpu_trace *tegra_rtcpu_trace_create(struct device *dev,
 	struct camrtc_device_group *camera_devices)
 {
 	struct tegra_rtcpu_trace *tracer;
-	u32 param;
+	u32 param, min_param;
 	int ret;
 
 	tracer = kzalloc(sizeof(*tracer), GFP_KERNEL);
@@ -1220,6 +1565,7 @@ struct tegra_rtcpu_trace *tegra_rtcpu_trace_create(struct device *dev,
 		return NULL;
 
 	tracer->dev = dev;
+	tracer->decode_events = true;
 	mutex_init(&tracer->lock);
 
 	/* Get the trace memory */
@@ -1257,6 +1603,8 @@ struct tegra_rtcpu_trace *tegra_rtcpu_trace_create(struct device *dev,
 	/* Worker */
 	param = WORK_INTERVAL_DEFAULT;
 	of_property_read_u32(tracer->of_node, NV(interval-ms), &param);
+	min_param = WORK_INTERVAL_MIN_DEFAULT;
+	of_property_read_u32(tracer->of_node, NV(min-interval-ms), &min_param);
 
 	tracer->enable_printk = of_property_read_bool(tracer->of_node,
 						NV(enable-printk));
@@ -1266,7 +1614,13 @@ struct tegra_rtcpu_trace *tegra_rtcpu_trace_create(struct device *dev,
 				&tracer->log_prefix);
 
 	INIT_DELAYED_WORK(&tracer->work, rtcpu_trace_worker);
-	tracer->work_interval_jiffies = msecs_to_jiffies(param);
+	tracer->work_interval_max = max(msecs_to_jiffies(param), 1UL);
+	tracer->work_interval_min = clamp(msecs_to_jiffies(min_param), 1UL,
+					tracer->work_interval_max);
+	tracer->work_interval_jiffies = tracer->work_interval_max;
+
+	/* Raw event stream */
+	rtcpu_trace_stream_init(tracer);
 
 	/* Done with initialization */
 	schedule_delayed_work(&tracer->work, 0);
@@ -1298,6 +1652,7 @@ void tegra_rtcpu_trace_destroy(struct tegra_rtcpu_trace *tracer)
 	platform_device_put(tracer->isp_platform_device);
 	platform_device_put(tracer->vi_platform_device);
 	of_node_put(tracer->of_node);
+	rtcpu_trace_stream_deinit(tracer);
 	cancel_delayed_work_sync(&tracer->work);
 	flush_delayed_work(&tracer->work);
 	rtcpu_trace_debugfs_deinit(tracer);
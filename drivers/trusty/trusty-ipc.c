@@ -30,10 +30,15 @@
 #endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0) */
 #include <linux/compat.h>
 #include <linux/uio.h>
+#include <linux/mm.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <linux/virtio.h>
 #include <linux/virtio_ids.h>
 #include <linux/virtio_config.h>
+#include <linux/virtio_ring.h>
 
 #include <linux/trusty/trusty.h>
 #include <linux/trusty/trusty_ipc.h>
@@ -61,6 +66,62 @@
 					     compat_uptr_t)
 #endif
 
+/*
+ * Per channel pool of message buffers that user space mmaps and fills in
+ * place. Buffer i is at offset i * buf_sz of the mapping with the payload
+ * at data_off. The message header stays in kernel memory in front of the
+ * mapped payload pages, so user space can't change src/dst under a queued
+ * message. Buffers start out owned by user space; SEND hands one to
+ * the secure world and it comes back as a SENT completion, RELEASE lends
+ * one to the kernel for receiving and it comes back as a RECV completion.
+ * Messages arriving while no buffer is lent are still delivered by read().
+ */
+#define TIPC_POOL_MAX_BUFS		32
+
+#define TIPC_POOL_OP_SEND		1
+#define TIPC_POOL_OP_RELEASE		2
+#define TIPC_POOL_OP_SENT		3
+#define TIPC_POOL_OP_RECV		4
+
+struct tipc_pool_setup {
+	u32 buf_cnt;	/* in */
+	u32 buf_sz;	/* out */
+	u32 data_off;	/* out */
+	u32 reserved;
+};
+
+struct tipc_pool_desc {
+	u32 idx;
+	u32 len;
+	u32 op;
+	u32 reserved;
+};
+
+struct tipc_pool_ring {
+	u32 cnt;	/* in: descs available, out: descs processed */
+	u32 reserved;
+	u64 descs;	/* struct tipc_pool_desc __user * */
+};
+
+struct tipc_pool_stats {
+	u64 sent;
+	u64 received;
+	u64 rx_fallback;
+	u64 rtt_cnt;
+	u64 rtt_min_ns;
+	u64 rtt_max_ns;
+	u64 rtt_sum_ns;
+};
+
+#define TIPC_IOC_POOL_SETUP		_IOWR(TIPC_IOC_MAGIC, 0x81, \
+					      struct tipc_pool_setup)
+#define TIPC_IOC_POOL_SUBMIT		_IOWR(TIPC_IOC_MAGIC, 0x82, \
+					      struct tipc_pool_ring)
+#define TIPC_IOC_POOL_COMPLETE		_IOWR(TIPC_IOC_MAGIC, 0x83, \
+					      struct tipc_pool_ring)
+#define TIPC_IOC_POOL_STATS		_IOR(TIPC_IOC_MAGIC, 0x84, \
+					     struct tipc_pool_stats)
+
 struct tipc_virtio_dev;
 
 struct tipc_dev_config {
@@ -136,6 +197,13 @@ struct tipc_virtio_dev {
 	enum tipc_device_state state;
 	struct tipc_cdev_node cdev_node;
 	char   cdev_name[MAX_DEV_NAME_LEN];
+	/* messages vs. notifications actually sent to the other side */
+	atomic64_t tx_msgs;
+	atomic64_t tx_kicks;
+	atomic64_t rx_msgs;
+	atomic64_t rx_kicks;
+	atomic_t tx_kick_req; /* writers waiting for a txvq kick */
+	struct dentry *debugfs;
 };
 
 enum tipc_chan_state {
@@ -161,6 +229,7 @@ struct tipc_chan {
 
 static struct class *tipc_class;
 static unsigned int tipc_major;
+static struct dentry *tipc_debugfs_root;
 
 struct virtio_device *default_vdev;
 
@@ -360,25 +429,63 @@ static struct tipc_msg_buf *vds_get_txbuf(struct tipc_virtio_dev *vds,
 	return mb;
 }
 
+static void __vds_kick_txq(struct tipc_virtio_dev *vds)
+{
+	bool need_notify = false;
+
+	mutex_lock(&vds->lock);
+	if (vds->state == VDS_ONLINE)
+		need_notify = virtqueue_kick_prepare(vds->txvq);
+	mutex_unlock(&vds->lock);
+
+	if (need_notify) {
+		atomic64_inc(&vds->tx_kicks);
+		virtqueue_notify(vds->txvq);
+	}
+}
+
+/*
+ * Notify the other side about everything added to txvq since the last
+ * kick. With VIRTIO_RING_F_EVENT_IDX negotiated the ring core skips the
+ * notification while the other side is still draining older buffers.
+ *
+ * Writers that queue while another writer is kicking don't kick
+ * themselves: the active kicker goes round again and one notification
+ * covers all of their buffers.
+ */
+static void vds_kick_txq(struct tipc_virtio_dev *vds)
+{
+	int req;
+
+	if (atomic_inc_return(&vds->tx_kick_req) > 1)
+		return;
+
+	do {
+		req = atomic_read(&vds->tx_kick_req);
+		__vds_kick_txq(vds);
+	} while (atomic_sub_return(req, &vds->tx_kick_req));
+}
+
 static int vds_queue_txbuf(struct tipc_virtio_dev *vds,
-			   struct tipc_msg_buf *mb)
+			   struct tipc_msg_buf *mb, bool kick)
 {
 	int err;
 	struct scatterlist sg;
-	bool need_notify = false;
 
 	mutex_lock(&vds->lock);
 	if (vds->state == VDS_ONLINE) {
 		sg_init_one(&sg, mb->buf_va, mb->wpos);
 		err = virtqueue_add_outbuf(vds->txvq, &sg, 1, mb, GFP_KERNEL);
-		need_notify = virtqueue_kick_prepare(vds->txvq);
 	} else {
 		err = -ENODEV;
 	}
 	mutex_unlock(&vds->lock);
 
-	if (need_notify)
-		virtqueue_notify(vds->txvq);
+	if (!err)
+		atomic64_inc(&vds->tx_msgs);
+
+	if (kick)
+		vds_kick_txq(vds);
 
 	return err;
 }
@@ -556,18 +663,15 @@ void tipc_chan_put_txbuf(struct tipc_chan *chan, struct tipc_msg_buf *mb)
 }
 EXPORT_SYMBOL(tipc_chan_put_txbuf);
 
-int tipc_chan_queue_msg(struct tipc_chan *chan, struct tipc_msg_buf *mb)
+static int _chan_queue_msg(struct tipc_chan *chan, struct tipc_msg_buf *mb)
 {
 	int err;
 
-	if (!is_trusty_dev_enabled())
-		return -ENODEV;
-
 	mutex_lock(&chan->lock);
 	switch (chan->state) {
 	case TIPC_CONNECTED:
 		fill_msg_hdr(mb, chan->local, chan->remote);
-		err = vds_queue_txbuf(chan->vds, mb);
+		err = vds_queue_txbuf(chan->vds, mb, false);
 		if (err) {
 			/* this should never happen */
 			pr_err("%s: failed to queue tx buffer (%d)\n",
@@ -589,6 +693,20 @@ int tipc_chan_queue_msg(struct tipc_chan *chan, struct tipc_msg_buf *mb)
 	mutex_unlock(&chan->lock);
 	return err;
 }
+
+int tipc_chan_queue_msg(struct tipc_chan *chan, struct tipc_msg_buf *mb)
+{
+	int err;
+
+	if (!is_trusty_dev_enabled())
+		return -ENODEV;
+
+	/* kick outside chan->lock so concurrent writers share the kick */
+	err = _chan_queue_msg(chan, mb);
+	if (!err)
+		vds_kick_txq(chan->vds);
+	return err;
+}
 EXPORT_SYMBOL(tipc_chan_queue_msg);
 
 
@@ -624,7 +742,7 @@ int tipc_chan_connect(struct tipc_chan *chan, const char *name)
 		strcpy(chan->srv_name, body->name);
 
 		fill_msg_hdr(txbuf, chan->local, TIPC_CTRL_ADDR);
-		err = vds_queue_txbuf(chan->vds, txbuf);
+		err = vds_queue_txbuf(chan->vds, txbuf, true);
 		if (err) {
 			/* this should never happen */
 			pr_err("%s: failed to queue tx buffer (%d)\n",
@@ -690,7 +808,7 @@ int tipc_chan_shutdown(struct tipc_chan *chan)
 		body->target = chan->remote;
 
 		fill_msg_hdr(txbuf, chan->local, TIPC_CTRL_ADDR);
-		err = vds_queue_txbuf(chan->vds, txbuf);
+		err = vds_queue_txbuf(chan->vds, txbuf, true);
 		if (err) {
 			/* this should never happen */
 			pr_err("%s: failed to queue tx buffer (%d)\n",
@@ -730,8 +848,184 @@ struct tipc_dn_chan {
 	wait_queue_head_t readq;
 	struct completion reply_comp;
 	struct list_head rx_msg_queue;
+	struct tipc_pool *pool;
 };
 
+enum tipc_pool_buf_state {
+	TIPC_POOL_BUF_USER = 0,
+	TIPC_POOL_BUF_TX,
+	TIPC_POOL_BUF_RX,
+};
+
+struct tipc_pool {
+	struct kref refcount; /* one per in-flight tx buffer plus owner */
+	struct mutex lock; /* protects buffer states and completions */
+	wait_queue_head_t compq;
+	u32 buf_cnt;
+	size_t buf_sz; /* mapped payload size, page aligned */
+	size_t msg_sz; /* payload limit */
+	struct tipc_msg_buf *bufs[TIPC_POOL_MAX_BUFS];
+	u8 state[TIPC_POOL_MAX_BUFS];
+	struct tipc_pool_desc comp[TIPC_POOL_MAX_BUFS];
+	u32 comp_head;
+	u32 comp_tail;
+	bool req_pending;
+	ktime_t req_ts;
+	struct tipc_pool_stats stats;
+};
+
+/*
+ * A pool buffer is one kernel page holding the message header at its end,
+ * followed by the payload pages that get mapped to user space. mb->buf_va
+ * points at the header, so header and payload still go out as one message.
+ */
+#define TIPC_POOL_HDR_OFF	(PAGE_SIZE - sizeof(struct tipc_msg_hdr))
+
+static struct tipc_msg_buf *pool_alloc_buf(size_t sz)
+{
+	struct tipc_msg_buf *mb;
+	void *va;
+
+	mb = kzalloc(sizeof(struct tipc_msg_buf), GFP_KERNEL);
+	if (!mb)
+		return NULL;
+
+	va = _alloc_shareable_mem(PAGE_SIZE + sz, &mb->buf_pa, GFP_KERNEL);
+	if (!va) {
+		kfree(mb);
+		return NULL;
+	}
+
+	mb->buf_va = (u8 *)va + TIPC_POOL_HDR_OFF;
+	mb->buf_sz = sizeof(struct tipc_msg_hdr) + sz;
+
+	return mb;
+}
+
+static void pool_free_buf(struct tipc_msg_buf *mb, size_t sz)
+{
+	_free_shareable_mem(PAGE_SIZE + sz,
+			    (u8 *)mb->buf_va - TIPC_POOL_HDR_OFF, mb->buf_pa);
+	kfree(mb);
+}
+
+static void _free_pool(struct kref *kref)
+{
+	struct tipc_pool *pool = container_of(kref, struct tipc_pool, refcount);
+	u32 i;
+
+	for (i = 0; i < pool->buf_cnt; i++)
+		pool_free_buf(pool->bufs[i], pool->buf_sz);
+	kfree(pool);
+}
+
+static struct tipc_pool *pool_create(u32 buf_cnt, size_t buf_sz)
+{
+	struct tipc_pool *pool;
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		return ERR_PTR(-ENOMEM);
+
+	kref_init(&pool->refcount);
+	mutex_init(&pool->lock);
+	init_waitqueue_head(&pool->compq);
+	/* whole pages, so every payload can be mapped to user space */
+	pool->msg_sz = buf_sz - sizeof(struct tipc_msg_hdr);
+	pool->buf_sz = PAGE_ALIGN(pool->msg_sz);
+	pool->stats.rtt_min_ns = U64_MAX;
+
+	for (pool->buf_cnt = 0; pool->buf_cnt < buf_cnt; pool->buf_cnt++) {
+		struct tipc_msg_buf *mb = pool_alloc_buf(pool->buf_sz);
+
+		if (!mb) {
+			kref_put(&pool->refcount, _free_pool);
+			return ERR_PTR(-ENOMEM);
+		}
+		mb->pool = pool;
+		mb->pool_idx = pool->buf_cnt;
+		pool->bufs[pool->buf_cnt] = mb;
+	}
+
+	return pool;
+}
+
+static void _pool_complete_locked(struct tipc_pool *pool, u32 idx,
+				  u32 len, u32 op)
+{
+	struct tipc_pool_desc *d;
+
+	/*
+	 * Only reachable if user space resubmits buffers without reaping
+	 * their completions; the oldest one is dropped then.
+	 */
+	if (pool->comp_head - pool->comp_tail == TIPC_POOL_MAX_BUFS)
+		pool->comp_tail++;
+
+	d = &pool->comp[pool->comp_head++ % TIPC_POOL_MAX_BUFS];
+	d->idx = idx;
+	d->len = len;
+	d->op = op;
+	d->reserved = 0;
+	pool->state[idx] = TIPC_POOL_BUF_USER;
+	wake_up_interruptible(&pool->compq);
+}
+
+/* called when the secure world is done with a pool tx buffer */
+static void pool_tx_done(struct tipc_msg_buf *mb)
+{
+	struct tipc_pool *pool = mb->pool;
+
+	mutex_lock(&pool->lock);
+	_pool_complete_locked(pool, mb->pool_idx, 0, TIPC_POOL_OP_SENT);
+	mutex_unlock(&pool->lock);
+
+	kref_put(&pool->refcount, _free_pool);
+}
+
+/*
+ * Place an incoming message into a lent pool buffer. Returns false if no
+ * buffer is available and the message has to take the read() path.
+ */
+static bool pool_rx(struct tipc_pool *pool, struct tipc_msg_buf *rxbuf)
+{
+	size_t len = mb_avail_data(rxbuf);
+	struct tipc_msg_buf *mb;
+	ktime_t rtt;
+	u32 i;
+
+	mutex_lock(&pool->lock);
+	for (i = 0; i < pool->buf_cnt; i++)
+		if (pool->state[i] == TIPC_POOL_BUF_RX)
+			break;
+
+	if (i == pool->buf_cnt || len > pool->msg_sz) {
+		pool->stats.rx_fallback++;
+		mutex_unlock(&pool->lock);
+		return false;
+	}
+
+	mb = pool->bufs[i];
+	memcpy((u8 *)mb->buf_va + sizeof(struct tipc_msg_hdr),
+	       mb_get_data(rxbuf, len), len);
+	_pool_complete_locked(pool, i, len, TIPC_POOL_OP_RECV);
+	pool->stats.received++;
+
+	if (pool->req_pending) {
+		rtt = ktime_sub(ktime_get(), pool->req_ts);
+		pool->stats.rtt_cnt++;
+		pool->stats.rtt_sum_ns += ktime_to_ns(rtt);
+		pool->stats.rtt_min_ns = min_t(u64, pool->stats.rtt_min_ns,
+					       ktime_to_ns(rtt));
+		pool->stats.rtt_max_ns = max_t(u64, pool->stats.rtt_max_ns,
+					       ktime_to_ns(rtt));
+		pool->req_pending = false;
+	}
+	mutex_unlock(&pool->lock);
+
+	return true;
+}
+
 static int dn_wait_for_reply(struct tipc_dn_chan *dn, int timeout)
 {
 	int ret;
@@ -769,7 +1063,10 @@ struct tipc_msg_buf *dn_handle_msg(void *data, struct tipc_msg_buf *rxbuf)
 	struct tipc_msg_buf *newbuf = rxbuf;
 
 	mutex_lock(&dn->lock);
-	if (dn->state == TIPC_CONNECTED) {
+	if (dn->state == TIPC_CONNECTED && dn->pool &&
+	    pool_rx(dn->pool, rxbuf)) {
+		/* data was copied out, rxbuf goes straight back to vq */
+	} else if (dn->state == TIPC_CONNECTED) {
 		/* get new buffer */
 		newbuf = tipc_chan_get_rxbuf(dn->chan);
 		if (newbuf) {
@@ -811,6 +1108,8 @@ static void dn_disconnected(struct tipc_dn_chan *dn)
 
 	/* wakeup all readers */
 	wake_up_interruptible_all(&dn->readq);
+	if (dn->pool)
+		wake_up_interruptible_all(&dn->pool->compq);
 
 	mutex_unlock(&dn->lock);
 }
@@ -827,6 +1126,8 @@ static void dn_shutdown(struct tipc_dn_chan *dn)
 
 	/* wakeup all readers */
 	wake_up_interruptible_all(&dn->readq);
+	if (dn->pool)
+		wake_up_interruptible_all(&dn->pool->compq);
 
 	mutex_unlock(&dn->lock);
 }
@@ -952,6 +1253,224 @@ static int dn_connect_ioctl(struct tipc_dn_chan *dn, char __user *usr_name)
 	return dn_wait_for_reply(dn, REPLY_TIMEOUT);
 }
 
+static int dn_pool_setup_ioctl(struct tipc_dn_chan *dn,
+			       struct tipc_pool_setup __user *usr_req)
+{
+	struct tipc_pool_setup req;
+	struct tipc_pool *pool;
+	int ret = 0;
+
+	if (copy_from_user(&req, usr_req, sizeof(req)))
+		return -EFAULT;
+
+	if (!req.buf_cnt || req.buf_cnt > TIPC_POOL_MAX_BUFS)
+		return -EINVAL;
+
+	pool = pool_create(req.buf_cnt, dn->chan->vds->msg_buf_max_sz);
+	if (IS_ERR(pool))
+		return PTR_ERR(pool);
+
+	mutex_lock(&dn->lock);
+	if (dn->pool)
+		ret = -EBUSY;
+	else
+		dn->pool = pool;
+	mutex_unlock(&dn->lock);
+
+	if (ret) {
+		kref_put(&pool->refcount, _free_pool);
+		return ret;
+	}
+
+	req.buf_sz = pool->buf_sz;
+	req.data_off = 0;
+	if (copy_to_user(usr_req, &req, sizeof(req)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int dn_pool_submit_one(struct tipc_dn_chan *dn, struct tipc_pool *pool,
+			      struct tipc_pool_desc *d)
+{
+	struct tipc_msg_buf *mb;
+	int ret;
+
+	if (d->idx >= pool->buf_cnt)
+		return -EINVAL;
+
+	mutex_lock(&pool->lock);
+	if (pool->state[d->idx] != TIPC_POOL_BUF_USER) {
+		mutex_unlock(&pool->lock);
+		return -EBUSY;
+	}
+
+	mb = pool->bufs[d->idx];
+	switch (d->op) {
+	case TIPC_POOL_OP_RELEASE:
+		pool->state[d->idx] = TIPC_POOL_BUF_RX;
+		mutex_unlock(&pool->lock);
+		return 0;
+
+	case TIPC_POOL_OP_SEND:
+		if (d->len > pool->msg_sz) {
+			mutex_unlock(&pool->lock);
+			return -EMSGSIZE;
+		}
+		pool->state[d->idx] = TIPC_POOL_BUF_TX;
+		if (!pool->req_pending) {
+			pool->req_pending = true;
+			pool->req_ts = ktime_get();
+		}
+		pool->stats.sent++;
+		kref_get(&pool->refcount);
+		break;
+
+	default:
+		mutex_unlock(&pool->lock);
+		return -EINVAL;
+	}
+	mutex_unlock(&pool->lock);
+
+	/* the header is filled in front of the user data */
+	mb_reset(mb);
+	mb_put_data(mb, sizeof(struct tipc_msg_hdr) + d->len);
+
+	/* the caller kicks once for the whole submission */
+	ret = _chan_queue_msg(dn->chan, mb);
+	if (ret) {
+		mutex_lock(&pool->lock);
+		pool->state[d->idx] = TIPC_POOL_BUF_USER;
+		pool->stats.sent--;
+		mutex_unlock(&pool->lock);
+		kref_put(&pool->refcount, _free_pool);
+	}
+
+	return ret;
+}
+
+static int dn_pool_submit_ioctl(struct tipc_dn_chan *dn,
+				struct tipc_pool_ring __user *usr_req)
+{
+	struct tipc_pool_desc __user *udescs;
+	struct tipc_pool_ring req;
+	struct tipc_pool_desc d;
+	int ret = 0;
+	u32 i;
+
+	if (!dn->pool)
+		return -ENXIO;
+
+	if (copy_from_user(&req, usr_req, sizeof(req)))
+		return -EFAULT;
+
+	udescs = (struct tipc_pool_desc __user *)(uintptr_t)req.descs;
+	for (i = 0; i < req.cnt; i++) {
+		if (copy_from_user(&d, &udescs[i], sizeof(d))) {
+			ret = -EFAULT;
+			break;
+		}
+		ret = dn_pool_submit_one(dn, dn->pool, &d);
+		if (ret)
+			break;
+	}
+
+	/* one notification for all messages of this submission */
+	if (i)
+		vds_kick_txq(dn->chan->vds);
+
+	/* report partial progress, fail only if nothing was taken */
+	if (i && put_user(i, &usr_req->cnt))
+		return -EFAULT;
+
+	return i ? 0 : ret;
+}
+
+static inline bool _got_comp(struct tipc_dn_chan *dn)
+{
+	if (dn->state != TIPC_CONNECTED)
+		return true;
+
+	return dn->pool->comp_head != dn->pool->comp_tail;
+}
+
+static int dn_pool_complete_ioctl(struct tipc_dn_chan *dn, bool nonblock,
+				  struct tipc_pool_ring __user *usr_req)
+{
+	struct tipc_pool_desc comp[TIPC_POOL_MAX_BUFS];
+	struct tipc_pool *pool = dn->pool;
+	struct tipc_pool_ring req;
+	u32 n = 0;
+
+	if (!pool)
+		return -ENXIO;
+
+	if (copy_from_user(&req, usr_req, sizeof(req)))
+		return -EFAULT;
+
+	if (!nonblock && wait_event_interruptible(pool->compq, _got_comp(dn)))
+		return -ERESTARTSYS;
+
+	mutex_lock(&pool->lock);
+	while (n < req.cnt && n < TIPC_POOL_MAX_BUFS &&
+	       pool->comp_tail != pool->comp_head)
+		comp[n++] = pool->comp[pool->comp_tail++ % TIPC_POOL_MAX_BUFS];
+	mutex_unlock(&pool->lock);
+
+	if (!n)
+		return dn->state == TIPC_CONNECTED ? -EAGAIN : -ENOTCONN;
+
+	if (copy_to_user((void __user *)(uintptr_t)req.descs, comp,
+			 n * sizeof(comp[0])))
+		return -EFAULT;
+
+	if (put_user(n, &usr_req->cnt))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int dn_pool_stats_ioctl(struct tipc_dn_chan *dn,
+			       struct tipc_pool_stats __user *usr_stats)
+{
+	struct tipc_pool_stats stats;
+
+	if (!dn->pool)
+		return -ENXIO;
+
+	mutex_lock(&dn->pool->lock);
+	stats = dn->pool->stats;
+	mutex_unlock(&dn->pool->lock);
+
+	if (!stats.rtt_cnt)
+		stats.rtt_min_ns = 0;
+
+	if (copy_to_user(usr_stats, &stats, sizeof(stats)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int dn_pool_ioctl(struct file *filp, unsigned int cmd,
+			 void __user *user_req)
+{
+	struct tipc_dn_chan *dn = filp->private_data;
+
+	switch (cmd) {
+	case TIPC_IOC_POOL_SETUP:
+		return dn_pool_setup_ioctl(dn, user_req);
+	case TIPC_IOC_POOL_SUBMIT:
+		return dn_pool_submit_ioctl(dn, user_req);
+	case TIPC_IOC_POOL_COMPLETE:
+		return dn_pool_complete_ioctl(dn, filp->f_flags & O_NONBLOCK,
+					      user_req);
+	case TIPC_IOC_POOL_STATS:
+		return dn_pool_stats_ioctl(dn, user_req);
+	default:
+		return -ENOIOCTLCMD;
+	}
+}
+
 static long tipc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
 	int ret;
@@ -964,6 +1483,12 @@ static long tipc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	case TIPC_IOC_CONNECT:
 		ret = dn_connect_ioctl(dn, (char __user *)arg);
 		break;
+	case TIPC_IOC_POOL_SETUP:
+	case TIPC_IOC_POOL_SUBMIT:
+	case TIPC_IOC_POOL_COMPLETE:
+	case TIPC_IOC_POOL_STATS:
+		ret = dn_pool_ioctl(filp, cmd, (void __user *)arg);
+		break;
 	default:
 		pr_warn("%s: Unhandled ioctl cmd: 0x%x\n",
 			__func__, cmd);
@@ -987,6 +1512,12 @@ static long tipc_compat_ioctl(struct file *filp,
 	case TIPC_IOC_CONNECT_COMPAT:
 		ret = dn_connect_ioctl(dn, user_req);
 		break;
+	case TIPC_IOC_POOL_SETUP:
+	case TIPC_IOC_POOL_SUBMIT:
+	case TIPC_IOC_POOL_COMPLETE:
+	case TIPC_IOC_POOL_STATS:
+		ret = dn_pool_ioctl(filp, cmd, user_req);
+		break;
 	default:
 		pr_warn("%s: Unhandled ioctl cmd: 0x%x\n",
 			__func__, cmd);
@@ -1131,15 +1662,58 @@ static unsigned int tipc_poll(struct file *filp, poll_table *wait)
 }
 
 
+static int tipc_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct tipc_dn_chan *dn = filp->private_data;
+	struct tipc_pool *pool = dn->pool;
+	unsigned long addr = vma->vm_start;
+	u32 i;
+	int ret;
+
+	if (!pool)
+		return -ENXIO;
+
+	if (vma->vm_pgoff ||
+	    vma->vm_end - vma->vm_start > pool->buf_cnt * pool->buf_sz)
+		return -EINVAL;
+
+	/*
+	 * buffers are only physically contiguous one at a time, and only
+	 * their payload pages are mapped, never the header page
+	 */
+	for (i = 0; addr < vma->vm_end; i++, addr += pool->buf_sz) {
+		ret = remap_pfn_range(vma, addr,
+				virt_to_phys((u8 *)pool->bufs[i]->buf_va +
+					     sizeof(struct tipc_msg_hdr)) >>
+					PAGE_SHIFT,
+				min_t(unsigned long, pool->buf_sz,
+				      vma->vm_end - addr),
+				vma->vm_page_prot);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
 static int tipc_release(struct inode *inode, struct file *filp)
 {
 	struct tipc_dn_chan *dn = filp->private_data;
+	struct tipc_pool *pool;
 
 	dn_shutdown(dn);
 
 	/* free all pending buffers */
 	_free_msg_buf_list(&dn->rx_msg_queue);
 
+	/* in-flight tx buffers keep the pool alive until they complete */
+	mutex_lock(&dn->lock);
+	pool = dn->pool;
+	dn->pool = NULL;
+	mutex_unlock(&dn->lock);
+	if (pool)
+		kref_put(&pool->refcount, _free_pool);
+
 	/* shutdown channel  */
 	tipc_chan_shutdown(dn->chan);
 
@@ -1159,6 +1733,7 @@ static const struct file_operations tipc_fops = {
 	.read_iter	= tipc_read_iter,
 	.write_iter	= tipc_write_iter,
 	.poll		= tipc_poll,
+	.mmap		= tipc_mmap,
 	.owner		= THIS_MODULE,
 };
 
@@ -1176,8 +1751,12 @@ static void _cleanup_vq(struct virtqueue *vq)
 {
 	struct tipc_msg_buf *mb;
 
-	while ((mb = virtqueue_detach_unused_buf(vq)) != NULL)
-		_free_msg_buf(mb);
+	while ((mb = virtqueue_detach_unused_buf(vq)) != NULL) {
+		if (mb->pool)
+			pool_tx_done(mb);
+		else
+			_free_msg_buf(mb);
+	}
 }
 
 static int _create_cdev_node(struct device *parent,
@@ -1510,33 +2089,76 @@ static void _rxvq_cb(struct virtqueue *rxvq)
 			break;
 		msg_cnt++;
 	}
+	atomic64_add(msg_cnt, &vds->rx_msgs);
 
 	/* tell the other size that we added rx buffers */
-	if (msg_cnt)
-		virtqueue_kick(rxvq);
+	if (msg_cnt && virtqueue_kick_prepare(rxvq)) {
+		atomic64_inc(&vds->rx_kicks);
+		virtqueue_notify(rxvq);
+	}
 }
 
 static void _txvq_cb(struct virtqueue *txvq)
 {
 	unsigned int len;
-	struct tipc_msg_buf *mb;
+	struct tipc_msg_buf *mb, *tmp;
 	bool need_wakeup = false;
 	struct tipc_virtio_dev *vds = txvq->vdev->priv;
+	LIST_HEAD(pool_done);
 
 	dev_dbg(&txvq->vdev->dev, "%s\n", __func__);
 
 	/* detach all buffers */
 	mutex_lock(&vds->lock);
-	while ((mb = virtqueue_get_buf(txvq, &len)) != NULL)
-		need_wakeup |= _put_txbuf_locked(vds, mb);
+	while ((mb = virtqueue_get_buf(txvq, &len)) != NULL) {
+		if (mb->pool)
+			list_add_tail(&mb->node, &pool_done);
+		else
+			need_wakeup |= _put_txbuf_locked(vds, mb);
+	}
 	mutex_unlock(&vds->lock);
 
+	/* pool buffers go back to their owner, outside of vds->lock */
+	list_for_each_entry_safe(mb, tmp, &pool_done, node) {
+		list_del(&mb->node);
+		pool_tx_done(mb);
+	}
+
 	if (need_wakeup) {
 		/* wake up potential senders waiting for a tx buffer */
 		wake_up_interruptible_all(&vds->sendq);
 	}
 }
 
+static int tipc_stats_show(struct seq_file *s, void *data)
+{
+	struct tipc_virtio_dev *vds = s->private;
+
+	seq_printf(s, "event_idx: %d\n",
+		   virtio_has_feature(vds->vdev, VIRTIO_RING_F_EVENT_IDX));
+	seq_printf(s, "tx_msgs: %lld\n",
+		   (long long)atomic64_read(&vds->tx_msgs));
+	seq_printf(s, "tx_kicks: %lld\n",
+		   (long long)atomic64_read(&vds->tx_kicks));
+	seq_printf(s, "rx_msgs: %lld\n",
+		   (long long)atomic64_read(&vds->rx_msgs));
+	seq_printf(s, "rx_kicks: %lld\n",
+		   (long long)atomic64_read(&vds->rx_kicks));
+	return 0;
+}
+
+static int tipc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tipc_stats_show, inode->i_private);
+}
+
+static const struct file_operations tipc_stats_fops = {
+	.open		= tipc_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int tipc_virtio_probe(struct virtio_device *vdev)
 {
 	int err, i;
@@ -1611,6 +2233,11 @@ static int tipc_virtio_probe(struct virtio_device *vdev)
 	vdev->priv = vds;
 	vds->state = VDS_OFFLINE;
 
+	if (!IS_ERR_OR_NULL(tipc_debugfs_root))
+		vds->debugfs = debugfs_create_file(dev_name(&vdev->dev), 0444,
+						   tipc_debugfs_root, vds,
+						   &tipc_stats_fops);
+
 	dev_dbg(&vdev->dev, "%s: done\n", __func__);
 	return 0;
 
@@ -1625,6 +2252,8 @@ static void tipc_virtio_remove(struct virtio_device *vdev)
 {
 	struct tipc_virtio_dev *vds = vdev->priv;
 
+	debugfs_remove(vds->debugfs);
+
 	_go_offline(vds);
 
 	mutex_lock(&vds->lock);
@@ -1679,6 +2308,7 @@ static int __init tipc_init(void)
 	}
 
 	tipc_major = MAJOR(dev);
+	tipc_debugfs_root = debugfs_create_dir(KBUILD_MODNAME, NULL);
 	tipc_class = class_create(THIS_MODULE, KBUILD_MODNAME);
 	if (IS_ERR(tipc_class)) {
 		ret = PTR_ERR(tipc_class);
@@ -1698,6 +2328,7 @@ err_register_virtio_drv:
 	class_destroy(tipc_class);
 
 err_class_create:
+	debugfs_remove_recursive(tipc_debugfs_root);
 	unregister_chrdev_region(dev, MAX_DEVICES);
 	return ret;
 }
@@ -1706,6 +2337,7 @@ static void __exit tipc_exit(void)
 {
 	unregister_virtio_driver(&virtio_tipc_driver);
 	class_destroy(tipc_class);
+	debugfs_remove_recursive(tipc_debugfs_root);
 	unregister_chrdev_region(MKDEV(tipc_major, 0), MAX_DEVICES);
 }
 
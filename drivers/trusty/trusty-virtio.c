@@ -50,6 +50,8 @@
 #include <linux/kthread.h>
 
 #include <linux/atomic.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <soc/tegra/virt/syscalls.h>
 #include "trusty-workitem.h"
@@ -69,6 +71,7 @@ struct trusty_ctx {
 	struct mutex		mlock; /* protects vdev_list */
 	struct workqueue_struct	*kick_wq;
 	struct workqueue_struct	*check_wq;
+	struct dentry		*debugfs;
 #ifdef CONFIG_TEGRA_VIRTUALIZATION
 	struct task_struct	*vq_poll;
 #endif
@@ -82,6 +85,8 @@ struct trusty_vring {
 	uint			elem_num;
 	u32			notifyid;
 	atomic_t		needs_kick;
+	atomic64_t		notifies; /* notify requests from the ring */
+	atomic64_t		kicks; /* kicks passed on to the secure side */
 	struct fw_rsc_vdev_vring *vr_descr;
 	struct virtqueue	*vq;
 	struct trusty_vdev	*tvdev;
@@ -172,6 +177,7 @@ static void kick_vq(struct trusty_ctx *tctx,
 	dev_dbg(tctx->dev, "%s: vdev_id=%d: vq_id=%d\n",
 		__func__, tvdev->notifyid, tvr->notifyid);
 
+	atomic64_inc(&tvr->kicks);
 	ret = trusty_std_call32(tctx->dev->parent, SMC_SC_VDEV_KICK_VQ,
 				tvdev->notifyid, tvr->notifyid, 0);
 	if (ret) {
@@ -204,11 +210,16 @@ static bool trusty_virtio_notify(struct virtqueue *vq)
 	struct trusty_ctx *tctx = tvdev->tctx;
 	u32 api_ver = trusty_get_api_version(tctx->dev->parent);
 
+	atomic64_inc(&tvr->notifies);
+
 	if (api_ver < TRUSTY_API_VERSION_SMP_NOP) {
+		/* notifies arriving before the work runs share one kick */
 		atomic_set(&tvr->needs_kick, 1);
 		schedule_workitem(tctx->kick_wq, &tctx->kick_vqs);
 	} else {
-		trusty_enqueue_nop(tctx->dev->parent, &tvr->kick_nop);
+		/* a nop that is still queued is not queued again */
+		if (trusty_enqueue_nop(tctx->dev->parent, &tvr->kick_nop))
+			atomic64_inc(&tvr->kicks);
 	}
 
 	return true;
@@ -739,6 +750,43 @@ err_load_descr:
 	return ret;
 }
 
+static int trusty_virtio_stats_show(struct seq_file *s, void *data)
+{
+	uint i;
+	struct trusty_vdev *tvdev;
+	struct trusty_ctx *tctx = s->private;
+
+	mutex_lock(&tctx->mlock);
+	list_for_each_entry(tvdev, &tctx->vdev_list, node) {
+		seq_printf(s, "vdev %u: event_idx %d\n", tvdev->notifyid,
+			   virtio_has_feature(&tvdev->vdev,
+					      VIRTIO_RING_F_EVENT_IDX));
+		for (i = 0; i < tvdev->vring_num; i++) {
+			struct trusty_vring *tvr = &tvdev->vrings[i];
+
+			seq_printf(s, "  vq %u: notifies %lld kicks %lld\n",
+				   tvr->notifyid,
+				   (long long)atomic64_read(&tvr->notifies),
+				   (long long)atomic64_read(&tvr->kicks));
+		}
+	}
+	mutex_unlock(&tctx->mlock);
+
+	return 0;
+}
+
+static int trusty_virtio_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, trusty_virtio_stats_show, inode->i_private);
+}
+
+static const struct file_operations trusty_virtio_stats_fops = {
+	.open		= trusty_virtio_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int trusty_virtio_probe(struct platform_device *pdev)
 {
 	int ret;
@@ -789,6 +837,11 @@ static int trusty_virtio_probe(struct platform_device *pdev)
 		goto err_add_devices;
 	}
 
+	tctx->debugfs = debugfs_create_dir(dev_name(&pdev->dev), NULL);
+	if (!IS_ERR_OR_NULL(tctx->debugfs))
+		debugfs_create_file("vq_stats", 0444, tctx->debugfs, tctx,
+				    &trusty_virtio_stats_fops);
+
 	dev_info(&pdev->dev, "initializing done\n");
 	return 0;
 
@@ -817,6 +870,8 @@ static int trusty_virtio_remove(struct platform_device *pdev)
 
 	dev_err(&pdev->dev, "removing\n");
 
+	debugfs_remove_recursive(tctx->debugfs);
+
 #ifdef CONFIG_TEGRA_VIRTUALIZATION
 	/* stop the vq polling thread */
 	if (tctx->vq_poll) {
@@ -496,8 +496,13 @@ static void nop_work_func(workitem_t *work)
 	dev_dbg(s->dev, "%s: done\n", __func__);
 }
 
-void trusty_enqueue_nop(struct device *dev, struct trusty_nop *nop)
+/*
+ * Returns true if nop was added to the queue, false if it was still
+ * queued from an earlier call (or nop is NULL).
+ */
+bool trusty_enqueue_nop(struct device *dev, struct trusty_nop *nop)
 {
+	bool queued = false;
 	unsigned long flags;
 	struct trusty_work *tw;
 	struct trusty_state *s = platform_get_drvdata(to_platform_device(dev));
@@ -513,8 +518,10 @@ void trusty_enqueue_nop(struct device *dev, struct trusty_nop *nop)
 		WARN_ON(s->api_version < TRUSTY_API_VERSION_SMP_NOP);
 
 		spin_lock_irqsave(&s->nop_lock, flags);
-		if (list_empty(&nop->node))
+		if (list_empty(&nop->node)) {
 			list_add_tail(&nop->node, &s->nop_queue);
+			queued = true;
+		}
 		spin_unlock_irqrestore(&s->nop_lock, flags);
 	}
 	schedule_workitem(s->nop_wq, &tw->work);
@@ -524,6 +531,7 @@ void trusty_enqueue_nop(struct device *dev, struct trusty_nop *nop)
 #else
 	preempt_enable();
 #endif
+	return queued;
 }
 EXPORT_SYMBOL(trusty_enqueue_nop);
 
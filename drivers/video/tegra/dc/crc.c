@@ -20,6 +20,7 @@
 #include <linux/slab.h>
 #include <linux/mutex.h>
 #include <linux/string.h>
+#include <linux/hashtable.h>
 
 #include "dc.h"
 #include "dc_priv_defs.h"
@@ -189,6 +190,8 @@ void tegra_dc_crc_deinit(struct tegra_dc *dc)
 
 	kfree(dc->flip_buf.data);
 	kfree(dc->crc_buf.data);
+	kfree(dc->crc_idx_nodes);
+	hash_init(dc->crc_idx);
 
 	dc->flip_buf.size = 0;
 	dc->flip_buf.head = 0;
@@ -232,7 +235,15 @@ static long tegra_dc_crc_init(struct tegra_dc *dc)
 				   sizeof(struct tegra_dc_crc_buf_ele),
 				   GFP_KERNEL);
 	if (!dc->crc_buf.data)
-		return -ENOMEM;
+		goto free_flip_buf;
+
+	dc->crc_idx_nodes = kcalloc(TEGRA_DC_CRC_BUF_CAPACITY * DC_N_WINDOWS,
+				    sizeof(struct tegra_dc_crc_idx_node),
+				    GFP_KERNEL);
+	if (!dc->crc_idx_nodes)
+		goto free_crc_buf;
+
+	hash_init(dc->crc_idx);
 
 	mutex_init(&dc->flip_buf.lock);
 	mutex_init(&dc->crc_buf.lock);
@@ -240,6 +251,54 @@ static long tegra_dc_crc_init(struct tegra_dc *dc)
 	dc->crc_initialized = true;
 
 	return 0;
+
+free_crc_buf:
+	kfree(dc->crc_buf.data);
+	dc->crc_buf.data = NULL;
+free_flip_buf:
+	kfree(dc->flip_buf.data);
+	dc->flip_buf.data = NULL;
+	return -ENOMEM;
+}
+
+static inline struct tegra_dc_crc_idx_node *_crc_idx_node(struct tegra_dc *dc,
+							  u16 slot, int iter)
+{
+	return &dc->crc_idx_nodes[slot * DC_N_WINDOWS + iter];
+}
+
+/* Buffer @crc_ele at the head of the CRC buffer and index it by the IDs of
+ * its matching flips. Called with crc_buf.lock held
+ */
+static void tegra_dc_crc_buf_add(struct tegra_dc *dc,
+				 struct tegra_dc_crc_buf_ele *crc_ele)
+{
+	struct tegra_dc_ring_buf *buf = &dc->crc_buf;
+	struct tegra_dc_crc_idx_node *node;
+	u16 slot = buf->head;
+	int iter;
+
+	/* The slot at head is either unused or holds the least recently
+	 * buffered element that is about to be dropped. Either way, none of
+	 * its flips can be looked up any more
+	 */
+	for (iter = 0; iter < DC_N_WINDOWS; iter++) {
+		node = _crc_idx_node(dc, slot, iter);
+		if (hash_hashed(&node->node))
+			hash_del(&node->node);
+	}
+
+	tegra_dc_ring_buf_add(buf, crc_ele, NULL);
+
+	for (iter = 0; iter < DC_N_WINDOWS; iter++) {
+		if (!crc_ele->matching_flips[iter].valid)
+			break;
+
+		node = _crc_idx_node(dc, slot, iter);
+		node->flip_id = crc_ele->matching_flips[iter].id;
+		node->slot = slot;
+		hash_add(dc->crc_idx, &node->node, node->flip_id);
+	}
 }
 
 static int tegra_dc_crc_t21x_rg_en_dis(struct tegra_dc *dc,
@@ -471,11 +530,6 @@ done:
 	return ret;
 }
 
-static inline u16 prev_idx(struct tegra_dc_ring_buf *buf, u16 idx)
-{
-	return idx ? idx - 1 : buf->capacity - 1;
-}
-
 static bool _is_flip_out_of_bounds(struct tegra_dc *dc, u64 flip_id)
 {
 	u64 lrm; /* Least recently matched flip */
@@ -503,33 +557,21 @@ static bool _is_flip_out_of_bounds(struct tegra_dc *dc, u64 flip_id)
 	return false;
 }
 
-/* Scan the CRC buffer from @start_idx (inclusive) to @end_idx (exclusive)
- * to find the element matched with @flip_id
+/* Look up the element matched with @flip_id in the CRC buffer. On success,
+ * @crc_ele points to the element in the buffer, so the caller must hold
+ * crc_buf.lock for as long as it uses it
  */
-static int _scan_crc_buf(struct tegra_dc *dc, u16 start_idx, u16 end_idx,
-			 u64 flip_id, struct tegra_dc_crc_buf_ele *crc_ele)
+static int _lookup_crc_buf(struct tegra_dc *dc, u64 flip_id,
+			   struct tegra_dc_crc_buf_ele **crc_ele)
 {
-	u16 peek_idx = start_idx;
-	struct tegra_dc_ring_buf *buf = &dc->crc_buf;
-	struct tegra_dc_crc_buf_ele *crc_iter = NULL;
-	int iter, ret;
-
-	while (peek_idx != end_idx) {
-		ret = tegra_dc_ring_buf_peek(buf, peek_idx, (char **)&crc_iter);
-		if (ret)
-			return ret;
-
-		for (iter = 0; iter < DC_N_WINDOWS; iter++) {
-			if (!crc_iter->matching_flips[iter].valid)
-				break;
+	struct tegra_dc_crc_idx_node *node;
 
-			if (crc_iter->matching_flips[iter].id == flip_id) {
-				memcpy(crc_ele, crc_iter, sizeof(*crc_iter));
-				return 0;
-			}
-		}
+	hash_for_each_possible(dc->crc_idx, node, node, flip_id) {
+		if (node->flip_id != flip_id)
+			continue;
 
-		peek_idx = prev_idx(buf, peek_idx);
+		return tegra_dc_ring_buf_peek(&dc->crc_buf, node->slot,
+					      (char **)crc_ele);
 	}
 
 	return -EAGAIN;
@@ -558,9 +600,9 @@ static int tegra_dc_crc_wait_till_frame_end(struct tegra_dc *dc)
 static int _find_crc_in_buf(struct tegra_dc *dc, u64 flip_id,
 			    struct tegra_dc_crc_buf_ele *crc_ele)
 {
-	int ret = 0, ret_loop = -EAGAIN;
-	u16 start_idx, end_idx;
+	int ret = 0;
 	struct tegra_dc_ring_buf *buf = &dc->crc_buf;
+	struct tegra_dc_crc_buf_ele *crc_iter = NULL;
 
 	if (flip_id == U64_MAX) {
 		/* Overwrite flip_id with most recently queued flip. If no
@@ -579,17 +621,7 @@ static int _find_crc_in_buf(struct tegra_dc *dc, u64 flip_id,
 	/* At this point, we are committed to return a CRC value to the user,
 	 * even if one is yet to be generated in the imminent future
 	 */
-	end_idx = prev_idx(buf, buf->tail);
-	start_idx = prev_idx(buf, buf->head);
-
-	while (ret_loop == -EAGAIN) {
-		ret_loop = _scan_crc_buf(dc, start_idx, end_idx, flip_id,
-					 crc_ele);
-		if (!ret_loop || ret_loop != -EAGAIN) {
-			ret = ret_loop;
-			goto done;
-		}
-
+	while ((ret = _lookup_crc_buf(dc, flip_id, &crc_iter)) == -EAGAIN) {
 		/* Control reaching here implies the flip being requested is yet
 		 * to be matched at a certain frame end interrupt, hence wait on
 		 * the event
@@ -602,12 +634,11 @@ static int _find_crc_in_buf(struct tegra_dc *dc, u64 flip_id,
 			return ret;
 
 		mutex_lock(&buf->lock);
-
-		end_idx = prev_idx(buf, start_idx);
-		start_idx = prev_idx(buf, buf->head);
 	}
 
-done:
+	if (!ret)
+		memcpy(crc_ele, crc_iter, sizeof(*crc_iter));
+
 	mutex_unlock(&buf->lock);
 	return ret;
 }
@@ -643,36 +674,23 @@ static int tegra_dc_crc_t21x_collect(struct tegra_dc *dc,
 	return valids ? 0 : -EINVAL;
 }
 
-long tegra_dc_crc_get(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg)
+/* Fill @num_conf CRC configurations with the CRCs held by @crc_ele */
+static long _fill_crc_confs(struct tegra_dc_ext_crc_conf *conf, u8 num_conf,
+			    struct tegra_dc_crc_buf_ele *crc_ele)
 {
-	int ret = 0;
-	struct tegra_dc_ext_crc_conf *conf =
-				(struct tegra_dc_ext_crc_conf *)arg->conf;
-	struct tegra_dc_crc_buf_ele crc_ele;
+	long ret = 0;
 	u8 id, iter;
 
-	if (!dc->enabled)
-		return -ENODEV;
-
-	if (!dc->crc_initialized)
-		return -EPERM;
-
-	WARN_ON(dc->crc_ref_cnt.legacy);
-
-	ret = _find_crc_in_buf(dc, arg->flip_id, &crc_ele);
-	if (ret)
-		return ret;
-
-	for (iter = 0; iter < arg->num_conf; iter++) {
+	for (iter = 0; iter < num_conf; iter++) {
 		switch (conf[iter].type) {
 		case TEGRA_DC_EXT_CRC_TYPE_RG:
-			conf[iter].crc.valid = crc_ele.rg.valid;
-			conf[iter].crc.val = crc_ele.rg.crc;
+			conf[iter].crc.valid = crc_ele->rg.valid;
+			conf[iter].crc.val = crc_ele->rg.crc;
 			break;
 		case TEGRA_DC_EXT_CRC_TYPE_COMP:
 			if (tegra_dc_is_nvdisplay()) {
-				conf[iter].crc.valid = crc_ele.comp.valid;
-				conf[iter].crc.val = crc_ele.comp.crc;
+				conf[iter].crc.valid = crc_ele->comp.valid;
+				conf[iter].crc.val = crc_ele->comp.crc;
 			} else {
 				conf[iter].crc.valid = false;
 				conf[iter].crc.val = 0;
@@ -680,11 +698,15 @@ long tegra_dc_crc_get(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg)
 			}
 			break;
 		case TEGRA_DC_EXT_CRC_TYPE_RG_REGIONAL:
-			if (tegra_dc_is_nvdisplay()) {
-				id = conf[iter].region.id;
+			id = conf[iter].region.id;
+			if (id >= TEGRA_DC_MAX_CRC_REGIONS) {
+				conf[iter].crc.valid = false;
+				conf[iter].crc.val = 0;
+				ret = -EINVAL;
+			} else if (tegra_dc_is_nvdisplay()) {
 				conf[iter].crc.valid =
-						crc_ele.regional[id].valid;
-				conf[iter].crc.val = crc_ele.regional[id].crc;
+						crc_ele->regional[id].valid;
+				conf[iter].crc.val = crc_ele->regional[id].crc;
 			} else {
 				conf[iter].crc.valid = false;
 				conf[iter].crc.val = 0;
@@ -692,8 +714,8 @@ long tegra_dc_crc_get(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg)
 			}
 			break;
 		case TEGRA_DC_EXT_CRC_TYPE_OR:
-			conf[iter].crc.valid = crc_ele.sor.valid;
-			conf[iter].crc.val = crc_ele.sor.crc;
+			conf[iter].crc.valid = crc_ele->sor.valid;
+			conf[iter].crc.val = crc_ele->sor.crc;
 			break;
 		default:
 			ret = -ENOTSUPP;
@@ -703,6 +725,109 @@ long tegra_dc_crc_get(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg)
 	return ret;
 }
 
+long tegra_dc_crc_get(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg)
+{
+	int ret = 0;
+	struct tegra_dc_ext_crc_conf *conf =
+				(struct tegra_dc_ext_crc_conf *)arg->conf;
+	struct tegra_dc_crc_buf_ele crc_ele;
+
+	if (!dc->enabled)
+		return -ENODEV;
+
+	if (!dc->crc_initialized)
+		return -EPERM;
+
+	WARN_ON(dc->crc_ref_cnt.legacy);
+
+	ret = _find_crc_in_buf(dc, arg->flip_id, &crc_ele);
+	if (ret)
+		return ret;
+
+	return _fill_crc_confs(conf, arg->num_conf, &crc_ele);
+}
+
+/* A flip is retired once it has left the flip buffer, either matched with a
+ * frame or skipped. Flips leave the buffer in the order they were queued
+ */
+static bool _is_flip_retired(struct tegra_dc *dc, u64 flip_id)
+{
+	struct tegra_dc_flip_buf_ele *flip_ele = NULL;
+	bool retired;
+
+	mutex_lock(&dc->flip_buf.lock);
+	retired = tegra_dc_ring_buf_peek(&dc->flip_buf, dc->flip_buf.tail,
+					 (char **)&flip_ele) ||
+		  flip_ele->id > flip_id;
+	mutex_unlock(&dc->flip_buf.lock);
+
+	return retired;
+}
+
+/* Retrieve the CRCs of @arg->num_flips flips in one call. Only the most
+ * recent of the flips is waited for: once it is retired, so is every earlier
+ * flip, and all of them are looked up under a single hold of crc_buf.lock.
+ * The confs of flips that have no CRCs in the buffer (skipped, cursor or
+ * dropped flips) are marked invalid rather than failing the whole batch
+ */
+long tegra_dc_crc_get_batch(struct tegra_dc *dc,
+			    struct tegra_dc_ext_crc_batch_arg *arg,
+			    u64 *flip_ids)
+{
+	long ret = 0, ret_fill;
+	struct tegra_dc_ext_crc_conf *conf =
+				(struct tegra_dc_ext_crc_conf *)arg->conf;
+	struct tegra_dc_crc_buf_ele crc_ele, *crc_iter = NULL;
+	u64 mrq = atomic64_read(&dc->flip_stats.flips_queued);
+	u64 max_id = 0;
+	u16 iter;
+
+	if (!dc->enabled)
+		return -ENODEV;
+
+	if (!dc->crc_initialized)
+		return -EPERM;
+
+	WARN_ON(dc->crc_ref_cnt.legacy);
+
+	for (iter = 0; iter < arg->num_flips; iter++) {
+		if (flip_ids[iter] == U64_MAX)
+			flip_ids[iter] = mrq;
+		if (flip_ids[iter] <= mrq)
+			max_id = max(max_id, flip_ids[iter]);
+	}
+
+	if (!max_id)
+		return -ENODATA;
+
+	while (!_is_flip_retired(dc, max_id)) {
+		reinit_completion(&dc->crc_complete);
+
+		ret = tegra_dc_crc_wait_till_frame_end(dc); /* Blocking call */
+		if (ret)
+			return ret;
+	}
+
+	memset(&crc_ele, 0, sizeof(crc_ele));
+
+	mutex_lock(&dc->crc_buf.lock);
+
+	for (iter = 0; iter < arg->num_flips; iter++) {
+		if (!flip_ids[iter] ||
+		    _lookup_crc_buf(dc, flip_ids[iter], &crc_iter))
+			crc_iter = &crc_ele;
+
+		ret_fill = _fill_crc_confs(conf + iter * arg->num_conf,
+					   arg->num_conf, crc_iter);
+		if (ret_fill)
+			ret = ret_fill;
+	}
+
+	mutex_unlock(&dc->crc_buf.lock);
+
+	return ret;
+}
+
 int tegra_dc_crc_process(struct tegra_dc *dc)
 {
 	int ret = 0, matched = 0;
@@ -750,7 +875,7 @@ int tegra_dc_crc_process(struct tegra_dc *dc)
 	/* Enqueue CRC element in the CRC ring buffer */
 	if (matched) {
 		mutex_lock(&dc->crc_buf.lock);
-		tegra_dc_ring_buf_add(&dc->crc_buf, &crc_ele, NULL);
+		tegra_dc_crc_buf_add(dc, &crc_ele);
 		mutex_unlock(&dc->crc_buf.lock);
 	}
 
@@ -0,0 +1,381 @@
+/*
+ * crc_ref.c: Software reference composition and CRCs for tegradc EXT device
+ *
+ * Copyright (c) 2019, NVIDIA CORPORATION, All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/sort.h>
+#include <linux/crc32.h>
+#include <linux/dma-buf.h>
+
+#include "dc.h"
+#include "dc_priv_defs.h"
+#include "dc_priv.h"
+#include <uapi/video/tegra_dc_ext.h>
+
+/* The reference compositor models the nvdisplay window blender for the
+ * configurations that can be checked without the scaler and the color
+ * pipeline: unscaled, non-inverted, pitch linear 32bpp RGB surfaces with
+ * 8 bits per component. The frame is composed a line at a time into a single
+ * line buffer and each requested CRC is accumulated over its span of the
+ * line, so the working set stays a line no matter the raster size. The CRCs
+ * use the kernel crc32_le(), which is the arch accelerated implementation on
+ * CPUs that have one.
+ */
+#define CRC_REF_MAX_WIDTH	8192
+
+struct crc_ref_win {
+	struct tegra_dc_ext_crc_ref_win *attr;
+	struct dma_buf *buf;
+	void *vaddr;
+	bool swap_rb;	/* A8B8G8R8: R and B are swapped relative to A8R8G8B8 */
+	bool opaque;	/* X8R8G8B8/X8B8G8R8: the alpha byte is ignored */
+};
+
+struct crc_ref_ctx {
+	struct crc_ref_win wins[TEGRA_DC_EXT_N_WINDOWS];
+	u8 num_wins;
+	u16 width;
+	u16 height;
+	u32 *line;
+};
+
+/* x * y / 255, rounded to nearest, for 8-bit x and y */
+static inline u32 crc_ref_mul(u32 x, u32 y)
+{
+	u32 t = x * y + 128;
+
+	return (t + (t >> 8)) >> 8;
+}
+
+/* Blend one A8R8G8B8 source pixel over a destination pixel the way the
+ * nvdisplay blender is programmed by tegra_nvdisp_blend(), with K1 being the
+ * window's global alpha
+ */
+static u32 crc_ref_blend(u32 dst, u32 src, u32 blend, u32 k1)
+{
+	u32 sa = src >> 24, a, out = 0;
+	u32 s, d, c;
+	int shift;
+
+	if (blend == TEGRA_DC_EXT_BLEND_NONE)
+		return src;
+
+	a = crc_ref_mul(k1, sa);
+
+	for (shift = 0; shift < 24; shift += 8) {
+		s = (src >> shift) & 0xff;
+		d = (dst >> shift) & 0xff;
+
+		switch (blend) {
+		case TEGRA_DC_EXT_BLEND_COVERAGE:
+			c = crc_ref_mul(s, a) + crc_ref_mul(d, 255 - a);
+			break;
+		case TEGRA_DC_EXT_BLEND_PREMULT:
+			c = crc_ref_mul(s, k1) + crc_ref_mul(d, 255 - a);
+			break;
+		case TEGRA_DC_EXT_BLEND_ADD:
+		default:
+			c = s + d;
+			break;
+		}
+
+		out |= min_t(u32, c, 0xff) << shift;
+	}
+
+	return out;
+}
+
+static void crc_ref_compose_win(struct crc_ref_ctx *ctx,
+				struct crc_ref_win *win, u16 line_y)
+{
+	struct tegra_dc_ext_crc_ref_win *attr = win->attr;
+	u32 *dst = ctx->line + attr->out_x;
+	const u32 *src;
+	u32 px, k1 = attr->global_alpha;
+	u16 i;
+
+	if (line_y < attr->out_y || line_y >= attr->out_y + attr->out_h)
+		return;
+
+	src = win->vaddr + attr->offset +
+		(size_t)(attr->y + line_y - attr->out_y) * attr->stride +
+		(size_t)attr->x * 4;
+
+	if (attr->blend == TEGRA_DC_EXT_BLEND_NONE && !win->swap_rb) {
+		memcpy(dst, src, attr->out_w * 4);
+		return;
+	}
+
+	if (attr->blend == TEGRA_DC_EXT_BLEND_ADD)
+		k1 = 0xff;
+
+	for (i = 0; i < attr->out_w; i++) {
+		px = src[i];
+		if (win->swap_rb)
+			px = (px & 0xff00ff00) | ((px >> 16) & 0xff) |
+				((px & 0xff) << 16);
+		if (win->opaque)
+			px |= 0xff000000;
+
+		dst[i] = crc_ref_blend(dst[i], px, attr->blend, k1);
+	}
+}
+
+static int crc_ref_cmp_depth(const void *a, const void *b)
+{
+	const struct crc_ref_win *wa = a, *wb = b;
+
+	/* Back to front: the highest depth is composed first */
+	return (int)wb->attr->z - (int)wa->attr->z;
+}
+
+static int crc_ref_check_win(struct crc_ref_ctx *ctx, struct crc_ref_win *win)
+{
+	struct tegra_dc_ext_crc_ref_win *attr = win->attr;
+	u64 end;
+
+	if (tegra_dc_fmt_byteorder(attr->pixformat))
+		return -ENOTSUPP;
+
+	switch (tegra_dc_fmt(attr->pixformat)) {
+	case TEGRA_DC_EXT_FMT_T_A8R8G8B8:
+		break;
+	case TEGRA_DC_EXT_FMT_T_A8B8G8R8:
+		win->swap_rb = true;
+		break;
+	case TEGRA_DC_EXT_FMT_T_X8R8G8B8:
+		win->opaque = true;
+		break;
+	case TEGRA_DC_EXT_FMT_T_X8B8G8R8:
+		win->swap_rb = true;
+		win->opaque = true;
+		break;
+	default:
+		return -ENOTSUPP;
+	}
+
+	if (attr->blend > TEGRA_DC_EXT_BLEND_ADD)
+		return -EINVAL;
+
+	if (!attr->out_w || !attr->out_h ||
+	    attr->out_x + attr->out_w > ctx->width ||
+	    attr->out_y + attr->out_h > ctx->height)
+		return -EINVAL;
+
+	if ((attr->offset | attr->stride) & 3 ||
+	    attr->stride < ((u32)attr->x + attr->out_w) * 4)
+		return -EINVAL;
+
+	end = (u64)attr->offset +
+		(u64)(attr->y + attr->out_h - 1) * attr->stride +
+		((u64)attr->x + attr->out_w) * 4;
+	if (end > win->buf->size)
+		return -EINVAL;
+
+	return 0;
+}
+
+static void crc_ref_put_wins(struct crc_ref_ctx *ctx)
+{
+	struct crc_ref_win *win;
+	u8 i;
+
+	for (i = 0; i < ctx->num_wins; i++) {
+		win = &ctx->wins[i];
+
+		if (win->vaddr) {
+			dma_buf_vunmap(win->buf, win->vaddr);
+			dma_buf_end_cpu_access(win->buf, 0, win->buf->size,
+					       DMA_FROM_DEVICE);
+		}
+
+		dma_buf_put(win->buf);
+	}
+
+	ctx->num_wins = 0;
+}
+
+static int crc_ref_get_wins(struct crc_ref_ctx *ctx,
+			    struct tegra_dc_ext_crc_ref_win *attrs, u8 num_wins)
+{
+	struct crc_ref_win *win;
+	int ret;
+	u8 i;
+
+	for (i = 0; i < num_wins; i++) {
+		win = &ctx->wins[i];
+		memset(win, 0, sizeof(*win));
+		win->attr = &attrs[i];
+
+		win->buf = dma_buf_get(attrs[i].buff_id);
+		if (IS_ERR(win->buf)) {
+			ret = -EBADF;
+			goto fail;
+		}
+		ctx->num_wins++;
+
+		ret = crc_ref_check_win(ctx, win);
+		if (ret)
+			goto fail;
+
+		ret = dma_buf_begin_cpu_access(win->buf, 0, win->buf->size,
+					       DMA_FROM_DEVICE);
+		if (ret)
+			goto fail;
+
+		win->vaddr = dma_buf_vmap(win->buf);
+		if (!win->vaddr) {
+			dma_buf_end_cpu_access(win->buf, 0, win->buf->size,
+					       DMA_FROM_DEVICE);
+			ret = -ENOMEM;
+			goto fail;
+		}
+	}
+
+	sort(ctx->wins, ctx->num_wins, sizeof(ctx->wins[0]),
+	     crc_ref_cmp_depth, NULL);
+
+	return 0;
+
+fail:
+	crc_ref_put_wins(ctx);
+	return ret;
+}
+
+/* Check the confs and seed the CRC of each one that will be computed */
+static int crc_ref_init_confs(struct crc_ref_ctx *ctx,
+			      struct tegra_dc_ext_crc_conf *conf, u8 num_conf)
+{
+	struct tegra_dc_ext_crc_region *region;
+	u8 iter;
+
+	for (iter = 0; iter < num_conf; iter++) {
+		conf[iter].crc.valid = false;
+		conf[iter].crc.val = ~0;
+
+		switch (conf[iter].type) {
+		case TEGRA_DC_EXT_CRC_TYPE_RG:
+		case TEGRA_DC_EXT_CRC_TYPE_COMP:
+			break;
+		case TEGRA_DC_EXT_CRC_TYPE_RG_REGIONAL:
+			region = &conf[iter].region;
+			if (region->id >= TEGRA_DC_EXT_MAX_REGIONS ||
+			    !region->w || !region->h ||
+			    region->x + region->w > ctx->width ||
+			    region->y + region->h > ctx->height)
+				return -EINVAL;
+			break;
+		default:
+			return -ENOTSUPP;
+		}
+	}
+
+	return 0;
+}
+
+static void crc_ref_update_confs(struct crc_ref_ctx *ctx,
+				 struct tegra_dc_ext_crc_conf *conf,
+				 u8 num_conf, u16 line_y)
+{
+	struct tegra_dc_ext_crc_region *region;
+	u8 iter;
+
+	for (iter = 0; iter < num_conf; iter++) {
+		if (conf[iter].type != TEGRA_DC_EXT_CRC_TYPE_RG_REGIONAL) {
+			conf[iter].crc.val = crc32_le(conf[iter].crc.val,
+						      (u8 *)ctx->line,
+						      ctx->width * 4);
+			continue;
+		}
+
+		region = &conf[iter].region;
+		if (line_y < region->y || line_y >= region->y + region->h)
+			continue;
+
+		conf[iter].crc.val = crc32_le(conf[iter].crc.val,
+					      (u8 *)(ctx->line + region->x),
+					      region->w * 4);
+	}
+}
+
+long tegra_dc_crc_ref_get(struct tegra_dc *dc,
+			  struct tegra_dc_ext_crc_ref_arg *arg)
+{
+	struct tegra_dc_ext_crc_conf *conf =
+				(struct tegra_dc_ext_crc_conf *)arg->conf;
+	struct tegra_dc_ext_crc_ref_win *attrs =
+				(struct tegra_dc_ext_crc_ref_win *)arg->wins;
+	struct crc_ref_ctx *ctx;
+	u16 line_y, x;
+	u8 i;
+	long ret;
+
+	if (arg->num_wins > TEGRA_DC_EXT_N_WINDOWS)
+		return -EINVAL;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+
+	ctx->width = arg->width ? arg->width : dc->mode.h_active;
+	ctx->height = arg->height ? arg->height : dc->mode.v_active;
+	if (!ctx->width || !ctx->height || ctx->width > CRC_REF_MAX_WIDTH) {
+		ret = -EINVAL;
+		goto free_ctx;
+	}
+
+	ret = crc_ref_init_confs(ctx, conf, arg->num_conf);
+	if (ret)
+		goto free_ctx;
+
+	ctx->line = kmalloc_array(ctx->width, sizeof(u32), GFP_KERNEL);
+	if (!ctx->line) {
+		ret = -ENOMEM;
+		goto free_ctx;
+	}
+
+	ret = crc_ref_get_wins(ctx, attrs, arg->num_wins);
+	if (ret)
+		goto free_line;
+
+	for (line_y = 0; line_y < ctx->height; line_y++) {
+		for (x = 0; x < ctx->width; x++)
+			ctx->line[x] = arg->background;
+
+		for (i = 0; i < ctx->num_wins; i++)
+			crc_ref_compose_win(ctx, &ctx->wins[i], line_y);
+
+		/* Only the color components reach the output */
+		for (x = 0; x < ctx->width; x++)
+			ctx->line[x] &= 0x00ffffff;
+
+		crc_ref_update_confs(ctx, conf, arg->num_conf, line_y);
+		cond_resched();
+	}
+
+	for (i = 0; i < arg->num_conf; i++) {
+		conf[i].crc.val = ~conf[i].crc.val;
+		conf[i].crc.valid = true;
+	}
+
+	crc_ref_put_wins(ctx);
+free_line:
+	kfree(ctx->line);
+free_ctx:
+	kfree(ctx);
+	return ret;
+}
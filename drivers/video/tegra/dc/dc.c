@@ -34,6 +34,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/workqueue.h>
 #include <linux/ktime.h>
+#include <linux/math64.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
 #include <linux/backlight.h>
@@ -2823,6 +2824,8 @@ static const struct file_operations dbg_hw_index_ops = {
 static int dbg_flip_stats_show(struct seq_file *m, void *unused)
 {
 	struct tegra_dc *dc = m->private;
+	s64 cmpltd;
+	int i;
 
 	if (WARN_ON(!dc || !dc->out))
 		return -EINVAL;
@@ -2834,6 +2837,22 @@ static int dbg_flip_stats_show(struct seq_file *m, void *unused)
 	seq_printf(m, "Flips completed: %ld\n",
 		atomic64_read(&dc->flip_stats.flips_cmpltd));
 
+	cmpltd = atomic64_read(&dc->flip_stats.flips_cmpltd);
+	seq_printf(m, "Flip to scanout latency: avg %lld us, max %ld us\n",
+		cmpltd ? div64_s64(atomic64_read(&dc->flip_stats.lat_sum_us),
+				   cmpltd) : 0,
+		atomic64_read(&dc->flip_stats.lat_max_us));
+	for (i = 0; i < TEGRA_DC_FLIP_LAT_BUCKETS; i++) {
+		u32 hi = 1 << (i + TEGRA_DC_FLIP_LAT_MIN_SHIFT);
+
+		if (i == TEGRA_DC_FLIP_LAT_BUCKETS - 1)
+			seq_printf(m, "  >= %6u us: %ld\n", hi >> 1,
+				atomic64_read(&dc->flip_stats.lat_hist[i]));
+		else
+			seq_printf(m, "  <  %6u us: %ld\n", hi,
+				atomic64_read(&dc->flip_stats.lat_hist[i]));
+	}
+
 	return 0;
 }
 
@@ -6734,6 +6753,10 @@ static int tegra_dc_probe(struct platform_device *ndev)
 	atomic64_set(&dc->flip_stats.flips_queued, 0);
 	atomic64_set(&dc->flip_stats.flips_skipped, 0);
 	atomic64_set(&dc->flip_stats.flips_cmpltd, 0);
+	atomic64_set(&dc->flip_stats.lat_sum_us, 0);
+	atomic64_set(&dc->flip_stats.lat_max_us, 0);
+	for (i = 0; i < TEGRA_DC_FLIP_LAT_BUCKETS; i++)
+		atomic64_set(&dc->flip_stats.lat_hist[i], 0);
 
 	tegra_dc_create_debugfs(dc);
 
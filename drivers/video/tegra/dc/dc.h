@@ -1201,5 +1201,18 @@ long tegra_dc_crc_enable(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg);
 long tegra_dc_crc_disable(struct tegra_dc *dc,
 			  struct tegra_dc_ext_crc_arg *arg);
 long tegra_dc_crc_get(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg);
+long tegra_dc_crc_get_batch(struct tegra_dc *dc,
+			    struct tegra_dc_ext_crc_batch_arg *arg,
+			    u64 *flip_ids);
+#ifdef CONFIG_TEGRA_DC_CRC_REF
+long tegra_dc_crc_ref_get(struct tegra_dc *dc,
+			  struct tegra_dc_ext_crc_ref_arg *arg);
+#else
+static inline long tegra_dc_crc_ref_get(struct tegra_dc *dc,
+					struct tegra_dc_ext_crc_ref_arg *arg)
+{
+	return -ENOTSUPP;
+}
+#endif
 
 #endif
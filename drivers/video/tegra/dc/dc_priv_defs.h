@@ -25,6 +25,7 @@
 #include <linux/fb.h>
 #include <linux/clk.h>
 #include <linux/completion.h>
+#include <linux/hashtable.h>
 #ifdef CONFIG_SWITCH
 #include <linux/switch.h>
 #endif
@@ -253,10 +254,21 @@ struct tegra_dc_topology {
 	int conn_inst;	/* SOR/DSI instance number. */
 };
 
+/*
+ * Flip-to-scanout latency buckets. Bucket 0 counts flips latched within
+ * 64us of being queued, bucket n those within [64us << (n - 1), 64us << n),
+ * the last bucket everything slower.
+ */
+#define TEGRA_DC_FLIP_LAT_BUCKETS	16
+#define TEGRA_DC_FLIP_LAT_MIN_SHIFT	6
+
 struct tegra_dc_flip_stats {
 	atomic64_t flips_skipped;
 	atomic64_t flips_queued;
 	atomic64_t flips_cmpltd;
+	atomic64_t lat_sum_us;
+	atomic64_t lat_max_us;
+	atomic64_t lat_hist[TEGRA_DC_FLIP_LAT_BUCKETS];
 };
 
 /*
@@ -371,6 +383,25 @@ struct tegra_dc_ring_buf {
 	struct mutex lock;
 };
 
+/* log2 of the number of buckets in the flip ID -> CRC index */
+#define TEGRA_DC_CRC_IDX_BITS	10
+
+/*
+ * tegra_dc_crc_idx_node - Entry of the index mapping a matched flip ID to
+ *                         the CRC buffer element that holds its CRCs
+ * @node     - Linkage in tegra_dc.crc_idx, hashed on @flip_id
+ * @flip_id  - One of the matching_flips of the element at @slot
+ * @slot     - Array index of the element in tegra_dc.crc_buf
+ *
+ * The nodes are preallocated, DC_N_WINDOWS per CRC buffer slot, and are
+ * protected by crc_buf.lock together with the buffer itself
+ */
+struct tegra_dc_crc_idx_node {
+	struct hlist_node node;
+	u64 flip_id;
+	u16 slot;
+};
+
 /*
  * tegra_dc_crc_ref_count - Reference counts for various CRC features
  *                ### Note ###
@@ -663,6 +694,8 @@ struct tegra_dc {
 
 	struct tegra_dc_ring_buf flip_buf; /* Buffer to save flip requests */
 	struct tegra_dc_ring_buf crc_buf; /* Buffer to save HW generated CRCs */
+	DECLARE_HASHTABLE(crc_idx, TEGRA_DC_CRC_IDX_BITS); /* flip ID -> CRC */
+	struct tegra_dc_crc_idx_node *crc_idx_nodes;
 	struct tegra_dc_crc_ref_cnt crc_ref_cnt;
 	bool crc_initialized;
 	struct tegra_dc_latency_measurement_data msrmnt_info;
@@ -22,6 +22,7 @@
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <linux/workqueue.h>
 #include <linux/export.h>
 #include <linux/delay.h>
@@ -29,6 +30,7 @@
 #include <linux/version.h>
 #include <linux/string.h>
 #include <linux/nospec.h>
+#include <linux/ktime.h>
 #include <linux/version.h>
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0)
 #include <linux/types.h>
@@ -54,6 +56,8 @@
 
 #define TEGRA_DC_TS_MAX_DELAY_US 1000000
 #define TEGRA_DC_TS_SLACK_US 2000
+/* flips in flight per head before falling back to kzalloc() */
+#define TEGRA_DC_EXT_FLIP_POOL_N 8
 
 /* Compatibility for kthread refactoring */
 #if LINUX_VERSION_CODE < KERNEL_VERSION(4, 9, 0)
@@ -120,7 +124,9 @@ struct tegra_dc_ext_flip_win {
 
 struct tegra_dc_ext_flip_data {
 	struct tegra_dc_ext		*ext;
+	struct tegra_dc_ext_win		*worker_win;
 	struct kthread_work		work;
+	ktime_t				queue_time;
 	struct tegra_dc_ext_flip_win	win[DC_N_WINDOWS];
 	struct list_head		timestamp_node;
 	int act_window_num;
@@ -143,6 +149,8 @@ struct tegra_dc_ext_flip_data {
 	struct tegra_dc_flip_buf_ele *flip_buf_ele;
 	bool background_color_update_needed;
 	u32 background_color;
+	struct list_head pool_node;
+	bool pooled; /* owned by ext->flip_pool, not kmalloc'ed */
 };
 
 struct tegra_dc_ext_scanline_data {
@@ -1016,6 +1024,109 @@ static void tegra_dc_ext_store_latency_msrmnt_info(struct tegra_dc *dc,
 	mutex_unlock(&dc->msrmnt_info.lock);
 }
 
+/*
+ * Advance the window syncpoints of a flip. This signals the release
+ * fences of the buffers it replaced, so it is done as soon as the new
+ * surfaces have been latched by the hardware.
+ */
+static void tegra_dc_ext_flip_release(struct tegra_dc *dc,
+				      struct tegra_dc_ext_flip_data *data)
+{
+	int i;
+
+	for (i = 0; i < data->act_window_num; i++) {
+		struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
+		int index = flip_win->attr.index;
+
+		if (index < 0 || !test_bit(index, &dc->valid_windows))
+			continue;
+
+		tegra_dc_incr_syncpt_min(dc, index, flip_win->syncpt_max);
+	}
+}
+
+static void tegra_dc_ext_flip_latency(struct tegra_dc *dc,
+				      struct tegra_dc_ext_flip_data *data)
+{
+	struct tegra_dc_flip_stats *stats = &dc->flip_stats;
+	s64 us = ktime_us_delta(ktime_get(), data->queue_time);
+	s64 max;
+	int bucket;
+
+	if (us < 0)
+		us = 0;
+
+	bucket = fls64(us >> TEGRA_DC_FLIP_LAT_MIN_SHIFT);
+	if (bucket >= TEGRA_DC_FLIP_LAT_BUCKETS)
+		bucket = TEGRA_DC_FLIP_LAT_BUCKETS - 1;
+
+	atomic64_inc(&stats->lat_hist[bucket]);
+	atomic64_add(us, &stats->lat_sum_us);
+
+	max = atomic64_read(&stats->lat_max_us);
+	while (us > max) {
+		s64 old = atomic64_cmpxchg(&stats->lat_max_us, max, us);
+
+		if (old == max)
+			break;
+		max = old;
+	}
+}
+
+static struct tegra_dc_ext_flip_data *tegra_dc_ext_flip_data_get(
+	struct tegra_dc_ext *ext)
+{
+	struct tegra_dc_ext_flip_data *data = NULL;
+
+	spin_lock(&ext->flip_pool_lock);
+	if (!list_empty(&ext->flip_pool_free)) {
+		data = list_first_entry(&ext->flip_pool_free,
+					struct tegra_dc_ext_flip_data,
+					pool_node);
+		list_del(&data->pool_node);
+	}
+	spin_unlock(&ext->flip_pool_lock);
+
+	if (!data)
+		/* more flips in flight than the pool holds */
+		return kzalloc(sizeof(*data), GFP_KERNEL);
+
+	memset(data, 0, sizeof(*data));
+	data->pooled = true;
+	return data;
+}
+
+static void tegra_dc_ext_flip_data_put(struct tegra_dc_ext *ext,
+				       struct tegra_dc_ext_flip_data *data)
+{
+	if (!data->pooled) {
+		kfree(data);
+		return;
+	}
+
+	spin_lock(&ext->flip_pool_lock);
+	list_add(&data->pool_node, &ext->flip_pool_free);
+	spin_unlock(&ext->flip_pool_lock);
+}
+
+static void tegra_dc_ext_flip_pool_init(struct tegra_dc_ext *ext)
+{
+	int i;
+
+	spin_lock_init(&ext->flip_pool_lock);
+	INIT_LIST_HEAD(&ext->flip_pool_free);
+
+	/* without a pool every flip is allocated on its own */
+	ext->flip_pool = kcalloc(TEGRA_DC_EXT_FLIP_POOL_N,
+				 sizeof(*ext->flip_pool), GFP_KERNEL);
+	if (!ext->flip_pool)
+		return;
+
+	for (i = 0; i < TEGRA_DC_EXT_FLIP_POOL_N; i++)
+		list_add_tail(&ext->flip_pool[i].pool_node,
+			      &ext->flip_pool_free);
+}
+
 static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 {
 	struct tegra_dc_ext_flip_data *data =
@@ -1032,6 +1143,7 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 	bool skip_flip = true;
 	bool wait_for_vblank = false;
 	bool lock_flip = false;
+	bool released = false;
 	bool show_background =
 		tegra_dc_ext_should_show_background(data, win_num);
 	struct tegra_dc_flip_buf_ele *flip_ele = data->flip_buf_ele;
@@ -1039,9 +1151,8 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 	if (flip_ele)
 		flip_ele->state = TEGRA_DC_FLIP_STATE_DEQUEUED;
 
-	blank_win = kzalloc(sizeof(*blank_win), GFP_KERNEL);
-	if (!blank_win)
-		dev_err(&ext->dc->ndev->dev, "Failed to allocate blank_win.\n");
+	blank_win = &data->worker_win->blank_win;
+	memset(blank_win, 0, sizeof(*blank_win));
 
 	tegra_dc_scrncapt_disp_pause_lock(dc);
 
@@ -1188,7 +1299,7 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 		/* Hijack first disabled, scaling capable window to host
 		 * the background pattern.
 		 */
-		if (blank_win && !ext_win->enabled && show_background &&
+		if (!ext_win->enabled && show_background &&
 			tegra_dc_feature_has_scaling(ext->dc, win->idx)) {
 			tegra_dc_ext_get_background(ext, blank_win);
 			blank_win->idx = win->idx;
@@ -1251,6 +1362,14 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 		/* TODO: implement swapinterval here */
 		tegra_dc_sync_windows(wins, nr_win);
 
+		/*
+		 * The new surfaces are latched, so the old ones can be handed
+		 * back before the bandwidth and IMP bookkeeping below.
+		 */
+		tegra_dc_ext_flip_release(dc, data);
+		released = true;
+		tegra_dc_ext_flip_latency(dc, data);
+
 		if (flip_ele)
 			flip_ele->state = TEGRA_DC_FLIP_STATE_FLIPPED;
 
@@ -1282,17 +1401,8 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 	tegra_dc_scrncapt_disp_pause_unlock(dc);
 
 	if (!skip_flip) {
-		for (i = 0; i < win_num; i++) {
-			struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
-			int index = flip_win->attr.index;
-
-			if (index < 0 ||
-				!test_bit(index, &dc->valid_windows))
-				continue;
-
-			tegra_dc_incr_syncpt_min(dc, index,
-					flip_win->syncpt_max);
-		}
+		if (!released)
+			tegra_dc_ext_flip_release(dc, data);
 		atomic64_inc(&dc->flip_stats.flips_cmpltd);
 	} else {
 		atomic64_inc(&dc->flip_stats.flips_skipped);
@@ -1304,8 +1414,7 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 	/* now DC has submitted buffer for display, try to release fbmem */
 	tegra_fb_release_fbmem(ext->dc->fb);
 #endif
-	kfree(data);
-	kfree(blank_win);
+	tegra_dc_ext_flip_data_put(ext, data);
 }
 
 static int lock_windows_for_flip(struct tegra_dc_ext_user *user,
@@ -1891,13 +2000,14 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 	if (ret)
 		return ret;
 
-	data = kzalloc(sizeof(*data), GFP_KERNEL);
+	data = tegra_dc_ext_flip_data_get(ext);
 	if (!data)
 		return -ENOMEM;
 
 	kthread_init_work(&data->work, &tegra_dc_ext_flip_worker);
 	data->ext = ext;
 	data->act_window_num = win_num;
+	data->queue_time = ktime_get();
 
 	if (dirty_rect) {
 		memcpy(data->dirty_rect, dirty_rect, sizeof(data->dirty_rect));
@@ -2021,27 +2131,34 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 #endif
 	data->flags = flip_flags;
 
-	flip_id_local = atomic64_inc_return
-			(&user->ext->dc->flip_stats.flips_queued);
-	if (flip_id)
-		*flip_id = flip_id_local;
-
-	/* Insert the flip in the flip queue if CRC is enabled */
+	/* Insert the flip in the flip queue if CRC is enabled. The flip ID is
+	 * taken under flip_buf.lock so that IDs enter the queue in order and
+	 * a flip is never counted as queued before it can be found there
+	 */
 	if (atomic_read(&ext->dc->crc_ref_cnt.global)) {
 		struct tegra_dc_flip_buf_ele flip_buf_ele;
 		struct tegra_dc_flip_buf_ele *in_q_ptr = NULL;
 
-		flip_buf_ele.id = flip_id_local;
 		flip_buf_ele.state = TEGRA_DC_FLIP_STATE_QUEUED;
 
 		mutex_lock(&ext->dc->flip_buf.lock);
+		flip_id_local = atomic64_inc_return
+				(&ext->dc->flip_stats.flips_queued);
+		flip_buf_ele.id = flip_id_local;
 		tegra_dc_ring_buf_add(&ext->dc->flip_buf, &flip_buf_ele,
 					    (char **)&in_q_ptr);
 		mutex_unlock(&ext->dc->flip_buf.lock);
 
 		data->flip_buf_ele = in_q_ptr;
+	} else {
+		flip_id_local = atomic64_inc_return
+				(&ext->dc->flip_stats.flips_queued);
 	}
 
+	if (flip_id)
+		*flip_id = flip_id_local;
+
+	data->worker_win = &ext->win[work_index];
 	kthread_queue_work(&ext->win[work_index].flip_worker, &data->work);
 
 	unlock_windows_for_flip(user, win, win_num);
@@ -2072,7 +2189,7 @@ fail_pin:
 	if (data->imp_dirty)
 		tegra_dc_release_common_channel(ext->dc);
 
-	kfree(data);
+	tegra_dc_ext_flip_data_put(ext, data);
 
 	return ret;
 }
@@ -2765,6 +2882,43 @@ static int tegra_dc_copy_crc_confs_from_user(struct tegra_dc_ext_crc_arg *args)
 	return 0;
 }
 
+static int tegra_dc_crc_sanitize_batch_args(
+				struct tegra_dc_ext_crc_batch_arg *args)
+{
+	if (memcmp(args->magic, "TCRC", 4))
+		return -EINVAL;
+
+	if (args->version >= TEGRA_DC_CRC_ARG_VERSION_MAX)
+		return -ENOTSUPP;
+
+	if (args->num_conf >
+		TEGRA_DC_EXT_CRC_TYPE_MAX - 1 + TEGRA_DC_EXT_MAX_REGIONS)
+		return -EINVAL;
+
+	if (!args->num_flips || args->num_flips > TEGRA_DC_EXT_CRC_MAX_BATCH)
+		return -EINVAL;
+
+	return 0;
+}
+
+static int tegra_dc_crc_sanitize_ref_args(struct tegra_dc_ext_crc_ref_arg *args)
+{
+	if (memcmp(args->magic, "TCRC", 4))
+		return -EINVAL;
+
+	if (args->version >= TEGRA_DC_CRC_ARG_VERSION_MAX)
+		return -ENOTSUPP;
+
+	if (args->num_conf >
+		TEGRA_DC_EXT_CRC_TYPE_MAX - 1 + TEGRA_DC_EXT_MAX_REGIONS)
+		return -EINVAL;
+
+	if (args->num_wins > TEGRA_DC_EXT_N_WINDOWS)
+		return -EINVAL;
+
+	return 0;
+}
+
 static int tegra_dc_copy_flip_id_to_user(struct tegra_dc_ext_flip_4 *args,
 	struct tegra_dc_ext_flip_user_data *user_data,
 	int nr_user_data,
@@ -3565,6 +3719,118 @@ free_and_ret:
 		return ret;
 	}
 
+	case TEGRA_DC_EXT_CRC_GET_BATCH:
+	{
+		struct tegra_dc_ext_crc_batch_arg args;
+		struct tegra_dc_ext_crc_conf *conf;
+		struct tegra_dc_ext_crc_conf __user *user_conf;
+		u64 *flip_ids;
+		struct tegra_dc *dc = user->ext->dc;
+		size_t sz;
+
+		if (copy_from_user(&args, user_arg, sizeof(args)))
+			return -EFAULT;
+
+		ret = tegra_dc_crc_sanitize_batch_args(&args);
+		if (ret)
+			return ret;
+
+		flip_ids = kcalloc(args.num_flips, sizeof(*flip_ids),
+				   GFP_KERNEL);
+		if (!flip_ids)
+			return -ENOMEM;
+
+		if (copy_from_user(flip_ids, (void __user *)args.flip_ids,
+				   args.num_flips * sizeof(*flip_ids))) {
+			kfree(flip_ids);
+			return -EFAULT;
+		}
+
+		sz = args.num_flips * args.num_conf * sizeof(*conf);
+		conf = vzalloc(sz);
+		if (!conf) {
+			kfree(flip_ids);
+			return -ENOMEM;
+		}
+
+		user_conf = (struct tegra_dc_ext_crc_conf *)args.conf;
+
+		if (copy_from_user(conf, user_conf, sz)) {
+			ret = -EFAULT;
+			goto free_batch;
+		}
+
+		args.conf = (__u64)conf;
+
+		ret = tegra_dc_crc_get_batch(dc, &args, flip_ids);
+		if (ret)
+			goto free_batch;
+
+		if (copy_to_user(user_conf, conf, sz))
+			ret = -EFAULT;
+
+free_batch:
+		vfree(conf);
+		kfree(flip_ids);
+		return ret;
+	}
+
+	case TEGRA_DC_EXT_CRC_REF_GET:
+	{
+		struct tegra_dc_ext_crc_ref_arg args;
+		struct tegra_dc_ext_crc_ref_win *wins;
+		struct tegra_dc_ext_crc_conf *conf;
+		struct tegra_dc_ext_crc_conf __user *user_conf;
+		struct tegra_dc *dc = user->ext->dc;
+		size_t sz;
+
+		if (copy_from_user(&args, user_arg, sizeof(args)))
+			return -EFAULT;
+
+		ret = tegra_dc_crc_sanitize_ref_args(&args);
+		if (ret)
+			return ret;
+
+		wins = kcalloc(args.num_wins, sizeof(*wins), GFP_KERNEL);
+		if (!wins)
+			return -ENOMEM;
+
+		if (copy_from_user(wins, (void __user *)args.wins,
+				   args.num_wins * sizeof(*wins))) {
+			kfree(wins);
+			return -EFAULT;
+		}
+
+		sz = args.num_conf * sizeof(*conf);
+		conf = kzalloc(sz, GFP_KERNEL);
+		if (!conf) {
+			kfree(wins);
+			return -ENOMEM;
+		}
+
+		user_conf = (struct tegra_dc_ext_crc_conf *)args.conf;
+
+		if (copy_from_user(conf, user_conf, sz)) {
+			ret = -EFAULT;
+			goto free_ref;
+		}
+
+		args.conf = (__u64)conf;
+		args.wins = (__u64)wins;
+
+		ret = tegra_dc_crc_ref_get(dc, &args);
+		if (ret)
+			goto free_ref;
+
+		if (copy_to_user(user_conf, conf, sz))
+			ret = -EFAULT;
+
+free_ref:
+		kfree(conf);
+		kfree(wins);
+		return ret;
+	}
+
 	default:
 		return -EINVAL;
 	}
@@ -3738,6 +4004,8 @@ struct tegra_dc_ext *tegra_dc_ext_register(struct platform_device *ndev,
 
 	ext->dc = dc;
 
+	tegra_dc_ext_flip_pool_init(ext);
+
 	ret = tegra_dc_ext_setup_windows(ext);
 	if (ret)
 		goto cleanup_device;
@@ -3761,6 +4029,7 @@ struct tegra_dc_ext *tegra_dc_ext_register(struct platform_device *ndev,
 	return ext;
 
 cleanup_device:
+	kfree(ext->flip_pool);
 	device_del(ext->dev);
 
 cleanup_cdev:
@@ -3795,6 +4064,7 @@ void tegra_dc_ext_unregister(struct tegra_dc_ext *ext)
 	device_del(ext->dev);
 	cdev_del(&ext->cdev);
 
+	kfree(ext->flip_pool);
 	kfree(ext);
 
 	head_count--;
@@ -25,6 +25,7 @@
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/poll.h>
+#include <linux/spinlock.h>
 #include <uapi/video/tegra_dc_ext.h>
 
 #include "../dc.h"
@@ -71,8 +72,16 @@ struct tegra_dc_ext_win {
 	struct list_head	timestamp_queue;
 
 	bool			enabled;
+
+	/*
+	 * Background window for the flips run by flip_worker; preallocated
+	 * so that the worker does not allocate on every flip.
+	 */
+	struct tegra_dc_win	blank_win;
 };
 
+struct tegra_dc_ext_flip_data;
+
 struct tegra_dc_ext {
 	struct tegra_dc			*dc;
 
@@ -98,6 +107,11 @@ struct tegra_dc_ext {
 	/* scanline work */
 	struct kthread_worker	scanline_worker;
 	struct task_struct	*scanline_task;
+
+	/* preallocated flip data, handed out by the FLIP ioctls */
+	struct tegra_dc_ext_flip_data	*flip_pool;
+	struct list_head		flip_pool_free;
+	spinlock_t			flip_pool_lock;
 };
 
 #define TEGRA_DC_EXT_EVENT_MASK_ALL		\
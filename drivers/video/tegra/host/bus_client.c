@@ -28,6 +28,7 @@
 #include <linux/export.h>
 #include <linux/firmware.h>
 #include <linux/dma-mapping.h>
+#include <linux/sizes.h>
 #include <soc/tegra/chip-id.h>
 #include <linux/anon_inodes.h>
 #include <linux/crc32.h>
@@ -251,6 +252,13 @@ struct nvhost_channel_userctx {
 	struct dma_buf *error_notifier_ref;
 	u64 error_notifier_offset;
 
+	/* usermode submit gather buffer and the syncpoint it increments */
+	void *usermode_gather;
+	dma_addr_t usermode_iova;
+	size_t usermode_size;
+	u32 usermode_syncpt;
+	u32 usermode_fence;
+
 	/* lock to protect this structure from concurrent ioctl usage */
 	struct mutex ioctl_lock;
 
@@ -258,6 +266,39 @@ struct nvhost_channel_userctx {
 	struct list_head node;
 };
 
+/* limits of the usermode submit doorbell */
+#define NVHOST_USERMODE_MAX_GATHER_SIZE		SZ_1M
+#define NVHOST_USERMODE_MAX_GATHER_WORDS	0x3fff
+#define NVHOST_USERMODE_MAX_INCRS		U16_MAX
+
+static void nvhost_usermode_release(struct nvhost_channel_userctx *priv)
+{
+	struct nvhost_master *host = nvhost_get_host(priv->pdev);
+	u32 timeout = priv->timeout ? priv->timeout * 2 : 1000;
+	int err;
+
+	if (!priv->usermode_gather)
+		return;
+
+	/*
+	 * The engine may still be fetching from the buffer. Timed out jobs
+	 * are completed by the channel recovery, so this wait is bounded.
+	 */
+	err = nvhost_syncpt_wait_timeout(&host->syncpt, priv->usermode_syncpt,
+			priv->usermode_fence, msecs_to_jiffies(timeout),
+			NULL, NULL, false);
+	if (err) {
+		nvhost_warn(&priv->pdev->dev,
+			"usermode gather still busy, leaking %zu bytes",
+			priv->usermode_size);
+	} else {
+		dma_free_coherent(&host->dev->dev, priv->usermode_size,
+				priv->usermode_gather, priv->usermode_iova);
+	}
+
+	priv->usermode_gather = NULL;
+}
+
 static int nvhost_channelrelease(struct inode *inode, struct file *filp)
 {
 	struct nvhost_channel_userctx *priv = filp->private_data;
@@ -282,6 +323,8 @@ static int nvhost_channelrelease(struct inode *inode, struct file *filp)
 	if (pdata->support_abort_on_close)
 		nvhost_channel_abort(pdata, (void *)priv);
 
+	nvhost_usermode_release(priv);
+
 	/* Clear the identifier */
 	if ((pdata->resource_policy == RESOURCE_PER_CHANNEL_INSTANCE) ||
 			(pdata->resource_policy == RESOURCE_PER_DEVICE &&
@@ -789,6 +832,7 @@ static int nvhost_ioctl_channel_submit(struct nvhost_channel_userctx *ctx,
 	struct nvhost_waitchk __user *waitchks =
 		(struct nvhost_waitchk __user *)(uintptr_t)args->waitchks;
 	struct nvhost_device_data *pdata = platform_get_drvdata(ctx->pdev);
+	ktime_t start = ktime_get();
 
 	int err;
 
@@ -876,6 +920,8 @@ static int nvhost_ioctl_channel_submit(struct nvhost_channel_userctx *ctx,
 	if (err)
 		goto put_job;
 
+	nvhost_channel_account_submit(ctx->ch, NVHOST_SUBMIT_PATH_IOCTL, start);
+
 	nvhost_job_put(job);
 
 	return 0;
@@ -1199,6 +1245,175 @@ static int nvhost_ioctl_channel_set_syncpoint_name(
 	return -EINVAL;
 }
 
+static int nvhost_ioctl_channel_usermode_setup(
+		struct nvhost_channel_userctx *ctx,
+		struct nvhost_usermode_setup_args *args)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(ctx->pdev);
+	struct nvhost_master *host = nvhost_get_host(ctx->pdev);
+	size_t size = PAGE_ALIGN(args->gather_size);
+	u32 id;
+
+	/* virtual engines only see gathers through the server */
+	if (nvhost_dev_is_virtual(ctx->pdev))
+		return -EOPNOTSUPP;
+
+	if (ctx->usermode_gather)
+		return -EBUSY;
+
+	if (!size || size > NVHOST_USERMODE_MAX_GATHER_SIZE) {
+		nvhost_err(&ctx->pdev->dev, "invalid gather size %u",
+			   args->gather_size);
+		return -EINVAL;
+	}
+
+	/* the first syncpoint of the context is handed to the client */
+	if (pdata->resource_policy == RESOURCE_PER_CHANNEL_INSTANCE)
+		id = nvhost_ioctl_channel_get_syncpt_instance(ctx, pdata, 0);
+	else
+		id = nvhost_ioctl_channel_get_syncpt_channel(ctx->ch, pdata, 0);
+	if (!id)
+		return -EAGAIN;
+
+	/* gathers are fetched by host1x, so map the buffer there */
+	ctx->usermode_gather = dma_alloc_coherent(&host->dev->dev, size,
+			&ctx->usermode_iova, GFP_KERNEL);
+	if (!ctx->usermode_gather) {
+		nvhost_err(&ctx->pdev->dev, "failed to allocate gather");
+		return -ENOMEM;
+	}
+
+	ctx->usermode_size = size;
+	ctx->usermode_syncpt = id;
+	ctx->usermode_fence = nvhost_syncpt_read_max(&host->syncpt, id);
+
+	args->gather_size = size;
+	args->syncpt_id = id;
+	args->gather_iova = ctx->usermode_iova;
+
+	return 0;
+}
+
+/*
+ * Doorbell for usermode gathers: nothing is copied, pinned or patched, only
+ * the gather range and the increment count are checked. What the gather
+ * itself may do is limited by the channel gather filter, as for any other
+ * job.
+ */
+static int nvhost_ioctl_channel_usermode_submit(
+		struct nvhost_channel_userctx *ctx,
+		struct nvhost_usermode_submit_args *args)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(ctx->pdev);
+	ktime_t start = ktime_get();
+	struct nvhost_job *job;
+	int err;
+
+	if (!ctx->usermode_gather)
+		return -EINVAL;
+
+	if (!args->words || args->words > NVHOST_USERMODE_MAX_GATHER_WORDS ||
+	    (args->offset & 3) ||
+	    (u64)args->offset + args->words * sizeof(u32) >
+			ctx->usermode_size) {
+		nvhost_err(&ctx->pdev->dev,
+			   "invalid gather offset=%u words=%u",
+			   args->offset, args->words);
+		return -EINVAL;
+	}
+
+	if (!args->syncpt_incrs ||
+	    args->syncpt_incrs > NVHOST_USERMODE_MAX_INCRS) {
+		nvhost_err(&ctx->pdev->dev, "invalid syncpt_incrs=%u",
+			   args->syncpt_incrs);
+		return -EINVAL;
+	}
+
+	job = nvhost_job_alloc(ctx->ch, 1, 0, 0, 1);
+	if (!job)
+		return -ENOMEM;
+
+	job->num_syncpts = 1;
+	job->clientid = ctx->clientid;
+	job->client_managed_syncpt =
+		(pdata->resource_policy == RESOURCE_PER_CHANNEL_INSTANCE) ?
+		ctx->client_managed_syncpt : ctx->ch->client_managed_syncpt;
+
+	/* copy error notifier settings for this job */
+	if (ctx->error_notifier_ref) {
+		get_dma_buf(ctx->error_notifier_ref);
+		job->error_notifier_ref = ctx->error_notifier_ref;
+		job->error_notifier_offset = ctx->error_notifier_offset;
+	}
+
+	job->sp[0].id = ctx->usermode_syncpt;
+	job->sp[0].incrs = args->syncpt_incrs;
+
+	/* no dma_buf behind the gather, the address is already final */
+	nvhost_job_add_gather(job, 0, args->words, args->offset, 0, -1);
+	job->gathers[0].mem_base = ctx->usermode_iova;
+
+	job->timeout = ctx->timeout;
+	job->timeout_debug_dump = ctx->timeout_debug_dump;
+
+	err = nvhost_channel_submit(job);
+	if (err) {
+		nvhost_job_put(job);
+		return err;
+	}
+
+	args->fence = get_job_fence(job, 0);
+	ctx->usermode_fence = job->sp[0].fence;
+
+	nvhost_channel_account_submit(ctx->ch, NVHOST_SUBMIT_PATH_USERMODE,
+				      start);
+
+	nvhost_job_put(job);
+
+	return 0;
+}
+
+static int nvhost_ioctl_channel_map_for_submit(
+		struct nvhost_channel_userctx *priv)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(priv->pdev);
+	void *identifier;
+	int err;
+
+	if (pdata->resource_policy == RESOURCE_PER_DEVICE &&
+	    !pdata->exclusive)
+		identifier = (void *)pdata;
+	else
+		identifier = (void *)priv;
+
+	/* first, get a channel */
+	err = nvhost_channel_map(pdata, &priv->ch, identifier);
+	if (err)
+		return err;
+
+	/* ..then, synchronize syncpoint information.
+	 *
+	 * This information is updated only in this ioctl and
+	 * channel destruction. We already hold channel
+	 * reference and this ioctl is serialized => no-one is
+	 * modifying the syncpoint field concurrently.
+	 *
+	 * Synchronization is not destructing anything
+	 * in the structure; We can only allocate new
+	 * syncpoints, and hence old ones cannot be released
+	 * by following operation. If some syncpoint is stored
+	 * into the channel structure, it remains there. */
+
+	if (pdata->resource_policy == RESOURCE_PER_CHANNEL_INSTANCE) {
+		memcpy(priv->ch->syncpts, priv->syncpts,
+		       sizeof(priv->syncpts));
+		priv->ch->client_managed_syncpt =
+			priv->client_managed_syncpt;
+	}
+
+	return 0;
+}
+
 static long nvhost_channelctl(struct file *filp,
 	unsigned int cmd, unsigned long arg)
 {
@@ -1498,41 +1713,10 @@ static long nvhost_channelctl(struct file *filp,
 	}
 	case NVHOST_IOCTL_CHANNEL_SUBMIT:
 	{
-		struct nvhost_device_data *pdata =
-			platform_get_drvdata(priv->pdev);
-		void *identifier;
-
-		if (pdata->resource_policy == RESOURCE_PER_DEVICE &&
-		    !pdata->exclusive)
-			identifier = (void *)pdata;
-		else
-			identifier = (void *)priv;
-
-		/* first, get a channel */
-		err = nvhost_channel_map(pdata, &priv->ch, identifier);
+		err = nvhost_ioctl_channel_map_for_submit(priv);
 		if (err)
 			break;
 
-		/* ..then, synchronize syncpoint information.
-		 *
-		 * This information is updated only in this ioctl and
-		 * channel destruction. We already hold channel
-		 * reference and this ioctl is serialized => no-one is
-		 * modifying the syncpoint field concurrently.
-		 *
-		 * Synchronization is not destructing anything
-		 * in the structure; We can only allocate new
-		 * syncpoints, and hence old ones cannot be released
-		 * by following operation. If some syncpoint is stored
-		 * into the channel structure, it remains there. */
-
-		if (pdata->resource_policy == RESOURCE_PER_CHANNEL_INSTANCE) {
-			memcpy(priv->ch->syncpts, priv->syncpts,
-			       sizeof(priv->syncpts));
-			priv->ch->client_managed_syncpt =
-				priv->client_managed_syncpt;
-		}
-
 		/* submit work */
 		err = nvhost_ioctl_channel_submit(priv, (void *)buf);
 
@@ -1541,6 +1725,23 @@ static long nvhost_channelctl(struct file *filp,
 
 		break;
 	}
+	case NVHOST_IOCTL_CHANNEL_USERMODE_SETUP:
+		err = nvhost_ioctl_channel_usermode_setup(priv,
+			(struct nvhost_usermode_setup_args *)buf);
+		break;
+	case NVHOST_IOCTL_CHANNEL_USERMODE_SUBMIT:
+	{
+		err = nvhost_ioctl_channel_map_for_submit(priv);
+		if (err)
+			break;
+
+		err = nvhost_ioctl_channel_usermode_submit(priv,
+			(struct nvhost_usermode_submit_args *)buf);
+
+		nvhost_putchannel(priv->ch, 1);
+
+		break;
+	}
 	case NVHOST_IOCTL_CHANNEL_SET_ERROR_NOTIFIER:
 		err = nvhost_init_error_notifier(priv,
 			(struct nvhost_set_error_notifier *)buf);
@@ -1585,10 +1786,36 @@ static long nvhost_channelctl(struct file *filp,
 	return err;
 }
 
+/* maps the usermode gather buffer */
+static int nvhost_channelmmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct nvhost_channel_userctx *priv = filp->private_data;
+	size_t size = vma->vm_end - vma->vm_start;
+	struct nvhost_master *host;
+	int err;
+
+	mutex_lock(&priv->ioctl_lock);
+
+	if (!priv->usermode_gather || vma->vm_pgoff ||
+	    size > priv->usermode_size) {
+		err = -EINVAL;
+		goto unlock;
+	}
+
+	host = nvhost_get_host(priv->pdev);
+	err = dma_mmap_coherent(&host->dev->dev, vma, priv->usermode_gather,
+				priv->usermode_iova, size);
+
+unlock:
+	mutex_unlock(&priv->ioctl_lock);
+	return err;
+}
+
 static const struct file_operations nvhost_channelops = {
 	.owner = THIS_MODULE,
 	.release = nvhost_channelrelease,
 	.open = nvhost_channelopen,
+	.mmap = nvhost_channelmmap,
 #ifdef CONFIG_COMPAT
 	.compat_ioctl = nvhost_channelctl,
 #endif
@@ -97,6 +97,8 @@ struct nvhost_debug_ops {
 struct nvhost_syncpt_ops {
 	void (*reset)(struct nvhost_syncpt *, u32 id);
 	u32 (*update_min)(struct nvhost_syncpt *, u32 id);
+	/* optional, refreshes every syncpt in [pts_base, pts_limit) at once */
+	void (*update_min_all)(struct nvhost_syncpt *);
 	void (*cpu_incr)(struct nvhost_syncpt *, u32 id);
 	const char * (*name)(struct nvhost_syncpt *, u32 id);
 	int (*mutex_try_lock)(struct nvhost_syncpt *,
@@ -23,6 +23,7 @@
 #include <linux/nvhost.h>
 
 #include <linux/io.h>
+#include <linux/math64.h>
 
 #include "dev.h"
 #include "debug.h"
@@ -49,13 +50,19 @@ void nvhost_debug_output(struct output *o, const char* fmt, ...)
 static void show_syncpts(struct nvhost_master *m, struct output *o)
 {
 	int i;
+	bool refreshed = false;
 
 	nvhost_debug_output(o, "---- syncpts ----\n");
 	mutex_lock(&m->syncpt.syncpt_mutex);
+	if (nvhost_get_chip_ops()->syncpt.update_min_all) {
+		nvhost_get_chip_ops()->syncpt.update_min_all(&m->syncpt);
+		refreshed = true;
+	}
 	for (i = nvhost_syncpt_pts_base(&m->syncpt);
 			i < nvhost_syncpt_pts_limit(&m->syncpt); i++) {
 		u32 max = nvhost_syncpt_read_max(&m->syncpt, i);
-		u32 min = nvhost_syncpt_update_min(&m->syncpt, i);
+		u32 min = refreshed ? nvhost_syncpt_read_min(&m->syncpt, i) :
+				nvhost_syncpt_update_min(&m->syncpt, i);
 		u32 refs = nvhost_syncpt_read_ref(&m->syncpt, i);
 		if ((!min && !max) || (refs == 0 && min == max))
 			continue;
@@ -79,6 +86,38 @@ void nvhost_syncpt_debug(struct nvhost_syncpt *sp)
 }
 
 #ifdef CONFIG_DEBUG_FS
+static void show_channel_submit_stats(struct nvhost_channel *ch,
+				      struct output *o)
+{
+	struct nvhost_cdma_stats *st = &ch->cdma.stats;
+	u64 avg = 0;
+	int path;
+
+	if (st->batched_jobs)
+		avg = div64_u64(st->submit_lat_sum_us, st->batched_jobs);
+
+	nvhost_debug_output(o,
+			"submit: %llu jobs in %llu batches (max %u), latency avg %llu us max %u us\n",
+			st->batched_jobs, st->batches, st->max_batch,
+			avg, st->submit_lat_max_us);
+	nvhost_debug_output(o, "push buffer: %llu stalls, %llu us\n",
+			st->pb_stalls, st->pb_stall_us);
+
+	for (path = 0; path < NVHOST_SUBMIT_PATH_NUM; path++) {
+		s64 count = atomic64_read(&ch->submit_count[path]);
+		s64 ns = atomic64_read(&ch->submit_ns[path]);
+
+		if (!count)
+			continue;
+
+		nvhost_debug_output(o,
+				"%s submits: %lld, avg %lld ns in kernel\n",
+				path == NVHOST_SUBMIT_PATH_USERMODE ?
+					"usermode" : "ioctl",
+				count, div64_s64(ns, count));
+	}
+}
+
 static int show_channels(struct platform_device *pdev, void *data,
 			 int locked_id, bool fifo)
 {
@@ -120,6 +159,7 @@ static int show_channels(struct platform_device *pdev, void *data,
 				m, ch, o, ch->chid);
 		nvhost_get_chip_ops()->debug.show_channel_cdma(
 			m, ch, o, ch->chid);
+		show_channel_submit_stats(ch, o);
 
 		if (ch->chid != locked_id)
 			up_write(&ch->cdma.lock);
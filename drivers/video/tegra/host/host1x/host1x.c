@@ -664,11 +664,20 @@ static long nvhost_ctrlctl(struct file *filp,
 	return err;
 }
 
+/* maps the shadow syncpoint value table */
+static int nvhost_ctrlmmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct nvhost_ctrl_userctx *priv = filp->private_data;
+
+	return nvhost_syncpt_mmap_shadow(&priv->dev->syncpt, vma);
+}
+
 static const struct file_operations nvhost_ctrlops = {
 	.owner = THIS_MODULE,
 	.release = nvhost_ctrlrelease,
 	.open = nvhost_ctrlopen,
 	.unlocked_ioctl = nvhost_ctrlctl,
+	.mmap = nvhost_ctrlmmap,
 #ifdef CONFIG_COMPAT
 	.compat_ioctl = nvhost_ctrlctl,
 #endif
@@ -1032,6 +1041,7 @@ int nvhost_update_characteristics(struct platform_device *dev)
 			NVHOST_CHARACTERISTICS_RESOURCE_PER_CHANNEL_INSTANCE;
 
 	host->nvhost_char.flags |= NVHOST_CHARACTERISTICS_SUPPORT_PREFENCES;
+	host->nvhost_char.flags |= NVHOST_CHARACTERISTICS_SYNCPT_SHADOW;
 
 	host->nvhost_char.num_mlocks = host->info.nb_mlocks;
 	host->nvhost_char.num_syncpts = host->info.nb_pts;
@@ -264,7 +264,14 @@ static void cdma_kick(struct nvhost_cdma *cdma)
 	u32 put;
 	struct nvhost_channel *ch = cdma_to_channel(cdma);
 
-	put = nvhost_push_buffer_putptr(&cdma->push_buffer);
+	/*
+	 * A kick from the middle of a batch has a partially pushed job at
+	 * the end of the push buffer; only hand over the jobs before it.
+	 */
+	if (cdma->batching)
+		put = cdma->first_get;
+	else
+		put = nvhost_push_buffer_putptr(&cdma->push_buffer);
 
 	if (put != cdma->last_put) {
 		wmb();
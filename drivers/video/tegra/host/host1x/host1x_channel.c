@@ -260,7 +260,7 @@ static void submit_work(struct nvhost_job *job)
 		op1 = nvhost_opcode_gather(g->words);
 		op2 = job->gathers[i].mem_base + g->offset;
 
-		if (nvhost_debug_trace_cmdbuf)
+		if (nvhost_debug_trace_cmdbuf && g->buf)
 			cpuva = dma_buf_vmap(g->buf);
 		nvhost_cdma_push_gather(&job->ch->cdma,
 				cpuva,
@@ -282,48 +282,26 @@ static void submit_work(struct nvhost_job *job)
 		lock_device(job, false);
 }
 
-static int host1x_channel_submit(struct nvhost_job *job)
+struct host1x_submit {
+	struct nvhost_cdma_submit base;
+	void **completed_waiters;
+	u32 prev_max;
+};
+
+/*
+ * Push one staged job into the push buffer. Called by the channel's current
+ * submitter with submitlock held; DMAPUT is written once the batch is done.
+ */
+static int host1x_channel_push(struct nvhost_cdma_submit *submit)
 {
+	struct host1x_submit *hs =
+		container_of(submit, struct host1x_submit, base);
+	struct nvhost_job *job = submit->job;
 	struct nvhost_channel *ch = job->ch;
 	struct nvhost_syncpt *sp = &nvhost_get_host(job->ch->dev)->syncpt;
-	u32 prev_max = 0;
 	int err, i;
-	void *completed_waiters[job->num_syncpts];
-
-	memset(completed_waiters, 0, sizeof(void *) * job->num_syncpts);
 
-	/* Turn on the client module and host1x */
 	for (i = 0; i < job->num_syncpts; ++i) {
-		err = nvhost_module_busy(ch->dev);
-		if (err) {
-			nvhost_module_idle_mult(ch->dev, i);
-			nvhost_putchannel(ch, i);
-			return err;
-		}
-
-		nvhost_getchannel(ch);
-	}
-
-	/* before error checks, return current max */
-	prev_max = job->sp->fence = nvhost_syncpt_read_max(sp, job->sp->id);
-
-	/* get submit lock */
-	err = mutex_lock_interruptible(&ch->submitlock);
-	if (err) {
-		nvhost_module_idle_mult(ch->dev, job->num_syncpts);
-		nvhost_putchannel(ch, job->num_syncpts);
-		goto error;
-	}
-
-	for (i = 0; i < job->num_syncpts; ++i) {
-		completed_waiters[i] = nvhost_intr_alloc_waiter();
-		if (!completed_waiters[i]) {
-			nvhost_module_idle_mult(ch->dev, job->num_syncpts);
-			nvhost_putchannel(ch, job->num_syncpts);
-			mutex_unlock(&ch->submitlock);
-			err = -ENOMEM;
-			goto error;
-		}
 		if (nvhost_intr_has_pending_jobs(
 			&nvhost_get_host(ch->dev)->intr, job->sp[i].id, ch))
 			dev_warn(&ch->dev->dev,
@@ -336,8 +314,7 @@ static int host1x_channel_submit(struct nvhost_job *job)
 	if (err) {
 		nvhost_module_idle_mult(ch->dev, job->num_syncpts);
 		nvhost_putchannel(ch, job->num_syncpts);
-		mutex_unlock(&ch->submitlock);
-		goto error;
+		return err;
 	}
 
 	/* determine fences for all syncpoints */
@@ -374,7 +351,7 @@ static int host1x_channel_submit(struct nvhost_job *job)
 	/* end CDMA submit & stash pinned hMems into sync queue */
 	nvhost_cdma_end(&ch->cdma, job);
 
-	trace_nvhost_channel_submitted(ch->dev->name, prev_max,
+	trace_nvhost_channel_submitted(ch->dev->name, hs->prev_max,
 		job->sp->fence);
 
 	for (i = 0; i < job->num_syncpts; ++i) {
@@ -382,12 +359,56 @@ static int host1x_channel_submit(struct nvhost_job *job)
 		err = nvhost_intr_add_action(&nvhost_get_host(ch->dev)->intr,
 			job->sp[i].id, job->sp[i].fence,
 			NVHOST_INTR_ACTION_SUBMIT_COMPLETE, ch,
-			completed_waiters[i],
+			hs->completed_waiters[i],
 			NULL);
 		WARN(err, "Failed to set submit complete interrupt");
 	}
 
-	mutex_unlock(&ch->submitlock);
+	return 0;
+}
+
+static int host1x_channel_submit(struct nvhost_job *job)
+{
+	struct nvhost_channel *ch = job->ch;
+	struct nvhost_syncpt *sp = &nvhost_get_host(job->ch->dev)->syncpt;
+	struct host1x_submit hs;
+	int err, i;
+	void *completed_waiters[job->num_syncpts];
+
+	memset(completed_waiters, 0, sizeof(void *) * job->num_syncpts);
+
+	/* Turn on the client module and host1x */
+	for (i = 0; i < job->num_syncpts; ++i) {
+		err = nvhost_module_busy(ch->dev);
+		if (err) {
+			nvhost_module_idle_mult(ch->dev, i);
+			nvhost_putchannel(ch, i);
+			return err;
+		}
+
+		nvhost_getchannel(ch);
+	}
+
+	/* before error checks, return current max */
+	hs.prev_max = job->sp->fence = nvhost_syncpt_read_max(sp, job->sp->id);
+
+	for (i = 0; i < job->num_syncpts; ++i) {
+		completed_waiters[i] = nvhost_intr_alloc_waiter();
+		if (!completed_waiters[i]) {
+			nvhost_module_idle_mult(ch->dev, job->num_syncpts);
+			nvhost_putchannel(ch, job->num_syncpts);
+			err = -ENOMEM;
+			goto error;
+		}
+	}
+
+	/* stage the job; it is pushed by whoever holds submitlock next */
+	hs.base.job = job;
+	hs.base.push = host1x_channel_push;
+	hs.completed_waiters = completed_waiters;
+	err = nvhost_cdma_submit_staged(&ch->cdma, &hs.base);
+	if (err)
+		goto error;
 
 	return 0;
 
@@ -92,7 +92,17 @@ static void show_channel_gathers(struct output *o, struct nvhost_cdma *cdma)
 
 	for (i = 0; i < job->num_gathers; i++) {
 		struct nvhost_job_gather *g = &job->gathers[i];
-		u32 *mapped = dma_buf_vmap(g->buf);
+		u32 *mapped;
+
+		/* usermode gathers have no dma_buf behind them */
+		if (!g->buf) {
+			nvhost_debug_output(o,
+				"    GATHER at %08llx+%04x, %u words (usermode)\n",
+				(u64)g->mem_base, g->offset, g->words);
+			continue;
+		}
+
+		mapped = dma_buf_vmap(g->buf);
 		if (!mapped) {
 			nvhost_debug_output(o, "[could not mmap]\n");
 			continue;
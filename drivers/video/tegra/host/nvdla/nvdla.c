@@ -216,6 +216,9 @@ int nvdla_send_cmd(struct platform_device *pdev,
 	uint32_t method_data = cmd_data->method_data;
 	bool wait = cmd_data->wait;
 
+	if (nvdla_emu_active(nvdla_dev))
+		return nvdla_emu_send_cmd(pdev, cmd_data);
+
 	mutex_lock(&nvdla_dev->cmd_lock);
 
 	/*
@@ -611,6 +614,16 @@ int nvhost_nvdla_finalize_poweron(struct platform_device *pdev)
 
 	nvdla_dbg_fn(pdev, "");
 
+	/* the emulated engine needs neither falcon nor firmware */
+	if (nvdla_emu_enabled(nvdla_dev) &&
+	    nvdla_dev->submit_mode == NVDLA_SUBMIT_MODE_MMIO) {
+		nvdla_emu_set_active(nvdla_dev, true);
+		nvdla_dev->fw_version = dla_version();
+		nvdla_dev->is_gos_enabled = false;
+		nvdla_dev->is_gos_fetched = true;
+		return 0;
+	}
+
 	ret = nvhost_flcn_finalize_poweron(pdev);
 	if (ret) {
 		nvdla_dbg_err(pdev, "failed to poweron\n");
@@ -671,9 +684,16 @@ fail:
 int nvhost_nvdla_prepare_poweroff(struct platform_device *pdev)
 {
 	int ret;
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvdla_device *nvdla_dev = pdata->private_data;
 
 	nvdla_dbg_fn(pdev, "");
 
+	if (nvdla_emu_active(nvdla_dev)) {
+		nvdla_emu_set_active(nvdla_dev, false);
+		return 0;
+	}
+
 	ret = nvhost_flcn_prepare_poweroff(pdev);
 	if (ret) {
 		nvdla_dbg_err(pdev, "failed to poweroff\n");
@@ -789,9 +809,15 @@ static int nvdla_probe(struct platform_device *pdev)
 	if (err)
 		goto err_alloc_cmd_mem;
 
+	err = nvdla_emu_init(pdev);
+	if (err)
+		goto err_emu_init;
+
 	nvdla_dbg_info(pdev, "pdata:%p initialized\n", pdata);
 
 	return 0;
+err_emu_init:
+	nvdla_free_cmd_memory(pdev);
 err_alloc_cmd_mem:
 err_mss_init:
 	nvhost_queue_deinit(nvdla_dev->pool);
@@ -816,6 +842,7 @@ static int __exit nvdla_remove(struct platform_device *pdev)
 
 	nvhost_queue_deinit(nvdla_dev->pool);
 	nvhost_client_device_release(pdev);
+	nvdla_emu_deinit(pdev);
 
 	nvdla_free_gcov_region(pdev, false);
 
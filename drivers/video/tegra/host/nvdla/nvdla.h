@@ -211,6 +211,7 @@ struct nvdla_device {
 	u32 *gcov_dump_va;
 	u32 quirks;
 	struct work_struct reset_work;
+	struct nvdla_emu *emu;
 };
 
 /**
@@ -404,4 +405,44 @@ void task_free(struct kref *ref);
 int nvdla_get_postfences(struct nvhost_queue *queue, void *in_task);
 int nvdla_send_gos_region(struct platform_device *pdev);
 
+#ifdef CONFIG_TEGRA_NVDLA_EMULATOR
+int nvdla_emu_init(struct platform_device *pdev);
+void nvdla_emu_deinit(struct platform_device *pdev);
+bool nvdla_emu_enabled(struct nvdla_device *nvdla_dev);
+bool nvdla_emu_active(struct nvdla_device *nvdla_dev);
+void nvdla_emu_set_active(struct nvdla_device *nvdla_dev, bool active);
+int nvdla_emu_send_cmd(struct platform_device *pdev,
+		       struct nvdla_cmd_data *cmd_data);
+int nvdla_emu_submit_task(struct platform_device *pdev,
+			  struct nvhost_queue *queue,
+			  struct nvdla_task *task);
+#else
+static inline int nvdla_emu_init(struct platform_device *pdev)
+{
+	return 0;
+}
+static inline void nvdla_emu_deinit(struct platform_device *pdev) { }
+static inline bool nvdla_emu_enabled(struct nvdla_device *nvdla_dev)
+{
+	return false;
+}
+static inline bool nvdla_emu_active(struct nvdla_device *nvdla_dev)
+{
+	return false;
+}
+static inline void nvdla_emu_set_active(struct nvdla_device *nvdla_dev,
+					bool active) { }
+static inline int nvdla_emu_send_cmd(struct platform_device *pdev,
+				     struct nvdla_cmd_data *cmd_data)
+{
+	return -ENODEV;
+}
+static inline int nvdla_emu_submit_task(struct platform_device *pdev,
+					struct nvhost_queue *queue,
+					struct nvdla_task *task)
+{
+	return -ENODEV;
+}
+#endif
+
 #endif /* End of __NVHOST_NVDLA_H__ */
@@ -0,0 +1,525 @@
+/*
+ * NVDLA software engine emulator
+ *
+ * Copyright (c) 2019, NVIDIA Corporation.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Stands in for the falcon firmware so that the whole kernel submission
+ * path (pinning, descriptor and action list building, fence handling and
+ * queue update callbacks) can be exercised and measured without an engine.
+ *
+ * Tasks are executed one at a time in submission order. Each one takes
+ * task_us plus per_address_ns for every entry in its address list. Before
+ * a task starts its syncpoint preactions have to be met; when it is done
+ * the status notifiers inside the task descriptor are written and the
+ * syncpoint postactions are signalled with host1x CPU increments.
+ * Semaphores and status notifiers in client buffers are not emulated,
+ * they are only counted.
+ */
+
+#include <linux/platform_device.h>
+#include <linux/slab.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/hrtimer.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/nvhost.h>
+#include <asm/arch_timer.h>
+
+#include "dev.h"
+#include "nvhost_queue.h"
+#include "nvhost_syncpt_unit_interface.h"
+
+#include "nvdla/nvdla.h"
+#include "nvdla/nvdla_debug.h"
+#include "dla_os_interface.h"
+
+#define NVDLA_EMU_DEFAULT_TASK_US		500
+#define NVDLA_EMU_DEFAULT_PER_ADDRESS_NS	100
+#define NVDLA_EMU_WAIT_POLL_US			50
+
+struct nvdla_emu_job {
+	struct list_head list;
+	struct nvhost_queue *queue;
+	struct dla_task_descriptor *task_desc;
+	dma_addr_t task_desc_pa;
+	ktime_t submit_time;
+	ktime_t due;
+	u32 exec_us;
+	bool started;
+};
+
+struct nvdla_emu {
+	struct platform_device *pdev;
+
+	/* protects everything below */
+	struct mutex lock;
+	struct list_head jobs;
+	/* end of the last task the engine executed */
+	ktime_t busy_until;
+
+	struct hrtimer timer;
+	struct work_struct work;
+	struct workqueue_struct *wq;
+
+	/* latency model, settable through debugfs */
+	u32 enable;
+	u32 task_us;
+	u32 per_address_ns;
+
+	bool active;
+
+	/* statistics */
+	u64 submitted;
+	u64 completed;
+	u64 flushed;
+	u64 wait_polls;
+	u64 unsupported;
+	u64 lat_sum_us;
+	u64 lat_max_us;
+	ktime_t first_submit;
+	ktime_t last_complete;
+};
+
+static struct nvdla_emu *nvdla_emu_get(struct platform_device *pdev)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvdla_device *nvdla_dev = pdata->private_data;
+
+	return nvdla_dev->emu;
+}
+
+bool nvdla_emu_enabled(struct nvdla_device *nvdla_dev)
+{
+	return nvdla_dev->emu && READ_ONCE(nvdla_dev->emu->enable);
+}
+
+bool nvdla_emu_active(struct nvdla_device *nvdla_dev)
+{
+	return nvdla_dev->emu && READ_ONCE(nvdla_dev->emu->active);
+}
+
+void nvdla_emu_set_active(struct nvdla_device *nvdla_dev, bool active)
+{
+	if (nvdla_dev->emu)
+		WRITE_ONCE(nvdla_dev->emu->active, active);
+}
+
+/* map an action address back to a syncpoint of the MSS aperture */
+static bool nvdla_emu_syncpt_id(struct nvhost_queue *queue, u64 addr,
+				u32 *id)
+{
+	dma_addr_t base = nvhost_syncpt_address(queue->vm_pdev, 0);
+	dma_addr_t stride = nvhost_syncpt_address(queue->vm_pdev, 1) - base;
+	u64 index;
+
+	if (!stride || addr < base || (addr - base) % stride)
+		return false;
+
+	index = div64_u64(addr - base, stride);
+	if (index >= nvhost_syncpt_nb_pts_ext(queue->pool->pdev))
+		return false;
+
+	*id = index;
+	return true;
+}
+
+static u8 *nvdla_emu_actions(struct nvdla_emu_job *job, u16 list_offset)
+{
+	struct dla_action_list *list;
+
+	list = (struct dla_action_list *)((u8 *)job->task_desc + list_offset);
+
+	return (u8 *)job->task_desc + list->offset;
+}
+
+/* returns true once all syncpoint preactions of the job are met */
+static bool nvdla_emu_preactions_done(struct nvdla_emu *emu,
+				      struct nvdla_emu_job *job)
+{
+	struct platform_device *pdev = emu->pdev;
+	u8 *next = nvdla_emu_actions(job, job->task_desc->preactions);
+	struct dla_action_semaphore *sem;
+	u32 id;
+
+	for (;;) {
+		u8 op = *next++;
+
+		switch (op) {
+		case PREACTION_TERMINATE:
+			return true;
+		case PREACTION_SEM_EQ:
+		case PREACTION_SEM_GE:
+			sem = (struct dla_action_semaphore *)next;
+			next += sizeof(*sem);
+			if (!nvdla_emu_syncpt_id(job->queue, sem->address,
+						 &id)) {
+				emu->unsupported++;
+				break;
+			}
+			if (!nvhost_syncpt_is_expired_ext(pdev, id,
+							  sem->value))
+				return false;
+			break;
+		case PREACTION_GOS_EQ:
+		case PREACTION_GOS_GE:
+			next += sizeof(struct dla_action_gos);
+			emu->unsupported++;
+			break;
+		case PREACTION_TASK_STATUS:
+			next += sizeof(struct dla_action_task_status);
+			emu->unsupported++;
+			break;
+		default:
+			nvdla_dbg_err(pdev, "emu: bad preaction 0x%x", op);
+			return true;
+		}
+	}
+}
+
+static void nvdla_emu_write_status(struct nvdla_emu_job *job,
+				   struct dla_action_task_status *action)
+{
+	struct dla_task_status_notifier *notifier;
+	u64 offset = action->address - job->task_desc_pa;
+
+	notifier = (struct dla_task_status_notifier *)
+			((u8 *)job->task_desc + offset);
+	notifier->timestamp = arch_counter_get_cntvct() << 5;
+	/* read back as the execution time in us by the queue update */
+	notifier->status_engine = job->exec_us;
+	notifier->subframe = 0;
+	notifier->status_task = action->status;
+}
+
+/*
+ * Run the postactions of a job. Syncpoints are incremented last as the
+ * queue update may release the task, and with it the descriptor, as soon
+ * as the task fence is reached.
+ */
+static void nvdla_emu_postactions(struct nvdla_emu *emu,
+				  struct nvdla_emu_job *job)
+{
+	struct platform_device *pdev = emu->pdev;
+	u8 *start = nvdla_emu_actions(job, job->task_desc->postactions);
+	size_t desc_size = job->queue->task_dma_size;
+	u32 incrs[MAX_NUM_NVDLA_POSTFENCES];
+	struct dla_action_task_status *status;
+	struct dla_action_semaphore *sem;
+	int nr_incrs = 0, i;
+	u8 *next = start;
+	bool done = false;
+	u32 id;
+
+	while (!done) {
+		u8 op = *next++;
+
+		switch (op) {
+		case POSTACTION_TERMINATE:
+			done = true;
+			break;
+		case POSTACTION_SEM:
+		case POSTACTION_TS_SEM:
+			sem = (struct dla_action_semaphore *)next;
+			next += sizeof(*sem);
+			if (op == POSTACTION_SEM &&
+			    nr_incrs < ARRAY_SIZE(incrs) &&
+			    nvdla_emu_syncpt_id(job->queue, sem->address,
+						&id))
+				incrs[nr_incrs++] = id;
+			else
+				emu->unsupported++;
+			break;
+		case POSTACTION_GOS:
+			next += sizeof(struct dla_action_gos);
+			emu->unsupported++;
+			break;
+		case POSTACTION_TASK_STATUS:
+			status = (struct dla_action_task_status *)next;
+			next += sizeof(*status);
+			if (status->address >= job->task_desc_pa &&
+			    status->address + sizeof(struct nvhost_notification)
+					<= job->task_desc_pa + desc_size)
+				nvdla_emu_write_status(job, status);
+			else
+				emu->unsupported++;
+			break;
+		default:
+			nvdla_dbg_err(pdev, "emu: bad postaction 0x%x", op);
+			done = true;
+			break;
+		}
+	}
+
+	/* the descriptor must not be touched after this */
+	wmb();
+	for (i = 0; i < nr_incrs; i++)
+		nvhost_syncpt_cpu_incr_ext(pdev, incrs[i]);
+}
+
+static void nvdla_emu_work(struct work_struct *work)
+{
+	struct nvdla_emu *emu = container_of(work, struct nvdla_emu, work);
+	struct nvdla_emu_job *job;
+	ktime_t now, rearm;
+	u64 lat;
+
+	mutex_lock(&emu->lock);
+	while (!list_empty(&emu->jobs)) {
+		job = list_first_entry(&emu->jobs, struct nvdla_emu_job, list);
+		now = ktime_get();
+
+		if (!job->started) {
+			/* the engine stalls on the head of the queue */
+			if (!nvdla_emu_preactions_done(emu, job)) {
+				emu->wait_polls++;
+				rearm = ktime_add_us(now,
+						     NVDLA_EMU_WAIT_POLL_US);
+				goto rearm;
+			}
+
+			job->started = true;
+			job->due = ktime_add_us(ktime_after(now,
+						emu->busy_until) ?
+						now : emu->busy_until,
+						job->exec_us);
+		}
+
+		if (ktime_before(now, job->due)) {
+			rearm = job->due;
+			goto rearm;
+		}
+
+		list_del(&job->list);
+		emu->busy_until = job->due;
+		nvdla_emu_postactions(emu, job);
+
+		lat = ktime_us_delta(now, job->submit_time);
+		emu->completed++;
+		emu->lat_sum_us += lat;
+		if (lat > emu->lat_max_us)
+			emu->lat_max_us = lat;
+		emu->last_complete = now;
+
+		kfree(job);
+	}
+	mutex_unlock(&emu->lock);
+	return;
+
+rearm:
+	mutex_unlock(&emu->lock);
+	hrtimer_start(&emu->timer, rearm, HRTIMER_MODE_ABS);
+}
+
+static enum hrtimer_restart nvdla_emu_timer(struct hrtimer *timer)
+{
+	struct nvdla_emu *emu = container_of(timer, struct nvdla_emu, timer);
+
+	queue_work(emu->wq, &emu->work);
+
+	return HRTIMER_NORESTART;
+}
+
+int nvdla_emu_submit_task(struct platform_device *pdev,
+			  struct nvhost_queue *queue,
+			  struct nvdla_task *task)
+{
+	struct nvdla_emu *emu = nvdla_emu_get(pdev);
+	struct nvdla_emu_job *job;
+	ktime_t now;
+	bool kick;
+
+	job = kzalloc(sizeof(*job), GFP_KERNEL);
+	if (!job)
+		return -ENOMEM;
+
+	job->queue = queue;
+	job->task_desc = task->task_desc;
+	job->task_desc_pa = task->task_desc_pa;
+	job->exec_us = emu->task_us +
+		div_u64((u64)task->num_addresses * emu->per_address_ns, 1000);
+
+	now = ktime_get();
+	job->submit_time = now;
+
+	mutex_lock(&emu->lock);
+	if (!emu->submitted)
+		emu->first_submit = now;
+	emu->submitted++;
+
+	kick = list_empty(&emu->jobs);
+	list_add_tail(&job->list, &emu->jobs);
+	mutex_unlock(&emu->lock);
+
+	if (kick)
+		queue_work(emu->wq, &emu->work);
+
+	return 0;
+}
+
+/* engine commands other than task submission complete immediately */
+int nvdla_emu_send_cmd(struct platform_device *pdev,
+		       struct nvdla_cmd_data *cmd_data)
+{
+	struct nvdla_emu *emu = nvdla_emu_get(pdev);
+	struct nvdla_emu_job *job, *tmp;
+	u32 method_id = cmd_data->method_id & DLA_METHOD_ID_CMD_MASK;
+	LIST_HEAD(flushed);
+
+	if (method_id != DLA_CMD_QUEUE_FLUSH)
+		return 0;
+
+	/* drop the queued tasks; the caller resets the syncpoint */
+	mutex_lock(&emu->lock);
+	list_for_each_entry_safe(job, tmp, &emu->jobs, list) {
+		if (job->queue->id == cmd_data->method_data) {
+			list_move_tail(&job->list, &flushed);
+			emu->flushed++;
+		}
+	}
+	mutex_unlock(&emu->lock);
+
+	list_for_each_entry_safe(job, tmp, &flushed, list)
+		kfree(job);
+
+	return 0;
+}
+
+static int nvdla_emu_stats_show(struct seq_file *s, void *data)
+{
+	struct nvdla_emu *emu = s->private;
+	u64 completed, lat_sum, span_us, depth = 0;
+	struct nvdla_emu_job *job;
+
+	mutex_lock(&emu->lock);
+	list_for_each_entry(job, &emu->jobs, list)
+		depth++;
+
+	seq_printf(s, "active: %d\n", emu->active);
+	seq_printf(s, "submitted: %llu\n", emu->submitted);
+	seq_printf(s, "completed: %llu\n", emu->completed);
+	seq_printf(s, "flushed: %llu\n", emu->flushed);
+	seq_printf(s, "pending: %llu\n", depth);
+	seq_printf(s, "wait_polls: %llu\n", emu->wait_polls);
+	seq_printf(s, "unsupported_actions: %llu\n", emu->unsupported);
+
+	completed = emu->completed;
+	lat_sum = emu->lat_sum_us;
+	span_us = completed ? ktime_us_delta(emu->last_complete,
+					     emu->first_submit) : 0;
+	seq_printf(s, "latency_avg_us: %llu\n",
+		   completed ? div64_u64(lat_sum, completed) : 0);
+	seq_printf(s, "latency_max_us: %llu\n", emu->lat_max_us);
+	seq_printf(s, "tasks_per_sec: %llu\n",
+		   span_us ? div64_u64(completed * USEC_PER_SEC, span_us) : 0);
+	mutex_unlock(&emu->lock);
+
+	return 0;
+}
+
+static int nvdla_emu_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvdla_emu_stats_show, inode->i_private);
+}
+
+/* any write clears the statistics */
+static ssize_t nvdla_emu_stats_write(struct file *file,
+				     const char __user *buf, size_t count,
+				     loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct nvdla_emu *emu = s->private;
+
+	mutex_lock(&emu->lock);
+	emu->submitted = emu->completed = emu->flushed = 0;
+	emu->wait_polls = emu->unsupported = 0;
+	emu->lat_sum_us = emu->lat_max_us = 0;
+	mutex_unlock(&emu->lock);
+
+	return count;
+}
+
+static const struct file_operations nvdla_emu_stats_fops = {
+	.open = nvdla_emu_stats_open,
+	.read = seq_read,
+	.write = nvdla_emu_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+int nvdla_emu_init(struct platform_device *pdev)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvdla_device *nvdla_dev = pdata->private_data;
+	struct nvdla_emu *emu;
+	struct dentry *de;
+
+	emu = devm_kzalloc(&pdev->dev, sizeof(*emu), GFP_KERNEL);
+	if (!emu)
+		return -ENOMEM;
+
+	emu->wq = alloc_ordered_workqueue("%s_emu", WQ_HIGHPRI,
+					  dev_name(&pdev->dev));
+	if (!emu->wq)
+		return -ENOMEM;
+
+	emu->pdev = pdev;
+	emu->task_us = NVDLA_EMU_DEFAULT_TASK_US;
+	emu->per_address_ns = NVDLA_EMU_DEFAULT_PER_ADDRESS_NS;
+	mutex_init(&emu->lock);
+	INIT_LIST_HEAD(&emu->jobs);
+	INIT_WORK(&emu->work, nvdla_emu_work);
+	hrtimer_init(&emu->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	emu->timer.function = nvdla_emu_timer;
+
+	nvdla_dev->emu = emu;
+
+	if (!pdata->debugfs)
+		return 0;
+
+	de = debugfs_create_dir("emulator", pdata->debugfs);
+	if (!de)
+		return 0;
+
+	/* takes effect at the next power on of the engine */
+	debugfs_create_u32("enable", S_IRUGO | S_IWUSR, de, &emu->enable);
+	debugfs_create_u32("task_us", S_IRUGO | S_IWUSR, de, &emu->task_us);
+	debugfs_create_u32("per_address_ns", S_IRUGO | S_IWUSR, de,
+			   &emu->per_address_ns);
+	debugfs_create_file("stats", S_IRUGO | S_IWUSR, de, emu,
+			    &nvdla_emu_stats_fops);
+
+	return 0;
+}
+
+void nvdla_emu_deinit(struct platform_device *pdev)
+{
+	struct nvdla_emu *emu = nvdla_emu_get(pdev);
+	struct nvdla_emu_job *job, *tmp;
+
+	if (!emu)
+		return;
+
+	hrtimer_cancel(&emu->timer);
+	cancel_work_sync(&emu->work);
+	destroy_workqueue(emu->wq);
+
+	list_for_each_entry_safe(job, tmp, &emu->jobs, list) {
+		list_del(&job->list);
+		kfree(job);
+	}
+}
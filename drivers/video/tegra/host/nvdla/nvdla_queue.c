@@ -113,14 +113,6 @@ fail_to_assign_pool:
 	return err;
 }
 
-void nvdla_put_task_mem(struct nvdla_task *task)
-{
-	/* release allocated task desc and task mem */
-	nvhost_queue_free_task_memory(task->queue, task->pool_index);
-
-	task = NULL;
-}
-
 void task_free(struct kref *ref)
 {
 	struct nvdla_task *task = container_of(ref, struct nvdla_task, ref);
@@ -291,6 +283,69 @@ static inline size_t nvdla_profile_status_offset(struct nvdla_task *task)
 	return offset;
 }
 
+/*
+ * Bytes of the task descriptor written by the kernel: the descriptor and
+ * action lists followed by the used part of the address list.
+ */
+static size_t nvdla_task_desc_used(struct nvdla_task *task)
+{
+	u32 num_addresses = min_t(u32, task->num_addresses,
+				  MAX_NUM_NVDLA_BUFFERS_PER_TASK);
+	size_t offset;
+
+	offset = sizeof(struct dla_task_descriptor) +
+		 3 * sizeof(struct dla_action_list) +
+		 nvdla_get_max_preaction_size() +
+		 nvdla_get_max_postaction_size();
+	offset = roundup(offset, 8);
+
+	return offset + num_addresses * sizeof(struct dla_mem_addr);
+}
+
+/*
+ * Clear the task struct without touching the unused tail of the large
+ * per-buffer arrays; entries up to num_addresses are all that a task
+ * ever fills in.
+ */
+static void nvdla_task_clear(struct nvdla_task *task)
+{
+	u32 num_addresses = min_t(u32, task->num_addresses,
+				  NVDLA_MAX_BUFFERS_PER_TASK);
+
+	memset(task->memory_handles, 0,
+	       num_addresses * sizeof(task->memory_handles[0]));
+	memset(task->memory_dmabuf, 0,
+	       num_addresses * sizeof(task->memory_dmabuf[0]));
+
+	memset(task, 0, offsetof(struct nvdla_task, memory_handles));
+	memset(&task->num_prefences, 0,
+	       offsetof(struct nvdla_task, memory_dmabuf) -
+	       offsetof(struct nvdla_task, num_prefences));
+	memset(&task->prefences_sem_dmabuf, 0,
+	       sizeof(*task) -
+	       offsetof(struct nvdla_task, prefences_sem_dmabuf));
+}
+
+void nvdla_put_task_mem(struct nvdla_task *task)
+{
+	struct nvhost_queue *queue = task->queue;
+	int pool_index = task->pool_index;
+	size_t dma_used = nvdla_task_desc_used(task);
+
+	/* the TSP notifier sits past the address list */
+	if (task->task_desc)
+		memset((u8 *)task->task_desc +
+		       nvdla_profile_status_offset(task), 0,
+		       sizeof(struct nvhost_notification));
+
+	nvdla_task_clear(task);
+
+	/* release allocated task desc and task mem */
+	nvhost_queue_free_task_memory_used(queue, pool_index, 0, dma_used);
+
+	task = NULL;
+}
+
 static void nvdla_queue_update(void *priv, int nr_completed)
 {
 	int task_complete;
@@ -1259,7 +1314,10 @@ static int nvdla_queue_submit(struct nvhost_queue *queue, void *in_task)
 		cmd_data.wait = true;
 
 		/* submit task to engine */
-		err = nvdla_send_cmd(pdev, &cmd_data);
+		if (nvdla_emu_active(nvdla_dev))
+			err = nvdla_emu_submit_task(pdev, queue, task);
+		else
+			err = nvdla_send_cmd(pdev, &cmd_data);
 		if (err) {
 			nvdla_dbg_err(pdev, "task[%p] submit failed", task);
 			nvdla_task_syncpt_reset(task->sp, queue->syncpt_id,
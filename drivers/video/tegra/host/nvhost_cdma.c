@@ -188,6 +188,7 @@ unsigned int nvhost_cdma_wait_locked(struct nvhost_cdma *cdma,
 		enum cdma_event event)
 {
 	struct mutex *lock;
+	ktime_t stall_start = ktime_set(0, 0);
 
 	if (event == CDMA_EVENT_SYNC_QUEUE_EMPTY)
 		lock = &cdma->sync_queue_lock;
@@ -237,6 +238,10 @@ unsigned int nvhost_cdma_wait_locked(struct nvhost_cdma *cdma,
 			continue;
 		}
 		cdma->event = event;
+		if (event == CDMA_EVENT_PUSH_BUFFER_SPACE) {
+			cdma->stats.pb_stalls++;
+			stall_start = ktime_get();
+		}
 
 		mutex_unlock(lock);
 		up_read(&cdma->lock);
@@ -246,6 +251,10 @@ unsigned int nvhost_cdma_wait_locked(struct nvhost_cdma *cdma,
 
 		down_read(&cdma->lock);
 		mutex_lock(lock);
+
+		if (event == CDMA_EVENT_PUSH_BUFFER_SPACE)
+			cdma->stats.pb_stall_us +=
+				ktime_us_delta(ktime_get(), stall_start);
 	}
 	return 0;
 }
@@ -522,8 +531,11 @@ int nvhost_cdma_init(struct platform_device *pdev,
 	mutex_init(&cdma->timeout_lock);
 
 	INIT_LIST_HEAD(&cdma->sync_queue);
+	init_llist_head(&cdma->submit_ring);
+	memset(&cdma->stats, 0, sizeof(cdma->stats));
 
 	cdma->event = CDMA_EVENT_NONE;
+	cdma->batching = false;
 	cdma->running = false;
 	cdma->torndown = false;
 	cdma->pdev = pdev;
@@ -623,8 +635,21 @@ void nvhost_cdma_push_gather(struct nvhost_cdma *cdma,
 		trace_write_gather(cdma, cpuva, iova, offset, op1 & 0x1fff);
 
 	if (slots_free == 0) {
-		slots_free = nvhost_cdma_wait_locked(cdma,
-				CDMA_EVENT_PUSH_BUFFER_SPACE);
+		/*
+		 * Jobs pushed earlier in this batch have not been handed to
+		 * the hardware yet; they must be before we can wait for them
+		 * to free up space.
+		 */
+		if (cdma->batching) {
+			mutex_lock(&cdma->push_buffer_lock);
+			slots_free = nvhost_push_buffer_space(pb);
+			mutex_unlock(&cdma->push_buffer_lock);
+			if (!slots_free)
+				cdma_op().kick(cdma);
+		}
+		if (slots_free == 0)
+			slots_free = nvhost_cdma_wait_locked(cdma,
+					CDMA_EVENT_PUSH_BUFFER_SPACE);
 	}
 	cdma->slots_free = slots_free - 1;
 	cdma->slots_used++;
@@ -653,7 +678,9 @@ void nvhost_cdma_end(struct nvhost_cdma *cdma,
 			cdma->slots_used,
 			cdma->first_get);
 
-	cdma_op().kick(cdma);
+	/* the submitter kicks once for the whole batch */
+	if (!cdma->batching)
+		cdma_op().kick(cdma);
 
 	/* start timer on idle -> active transitions */
 	if (was_idle)
@@ -673,3 +700,63 @@ void nvhost_cdma_update(struct nvhost_cdma *cdma)
 	update_cdma_locked(cdma);
 	up_read(&cdma->lock);
 }
+
+/**
+ * Stage a job on the submit ring and make sure it gets pushed
+ * Whoever holds submitlock drains the whole ring, so jobs staged
+ * concurrently by several threads go out with a single DMAPUT write.
+ * submit->push() is called with submitlock held, once per job.
+ */
+int nvhost_cdma_submit_staged(struct nvhost_cdma *cdma,
+		struct nvhost_cdma_submit *submit)
+{
+	struct nvhost_channel *ch = cdma_to_channel(cdma);
+	struct nvhost_cdma_submit *pos, *tmp;
+	struct llist_node *batch;
+	u32 nr_jobs = 0;
+	ktime_t now;
+	s64 lat;
+
+	submit->staged = ktime_get();
+	submit->done = false;
+	llist_add(&submit->node, &cdma->submit_ring);
+
+	mutex_lock(&ch->submitlock);
+
+	/* an earlier submitter already took this job along */
+	if (submit->done) {
+		mutex_unlock(&ch->submitlock);
+		return submit->err;
+	}
+
+	batch = llist_reverse_order(llist_del_all(&cdma->submit_ring));
+
+	cdma->batching = true;
+	llist_for_each_entry(pos, batch, node) {
+		pos->err = pos->push(pos);
+		nr_jobs++;
+	}
+	cdma->batching = false;
+
+	down_read(&cdma->lock);
+	cdma_op().kick(cdma);
+	up_read(&cdma->lock);
+
+	now = ktime_get();
+	cdma->stats.batches++;
+	cdma->stats.batched_jobs += nr_jobs;
+	cdma->stats.max_batch = max(cdma->stats.max_batch, nr_jobs);
+
+	/* other producers may return as soon as their entry is done */
+	llist_for_each_entry_safe(pos, tmp, batch, node) {
+		lat = ktime_us_delta(now, pos->staged);
+		cdma->stats.submit_lat_sum_us += lat;
+		cdma->stats.submit_lat_max_us =
+			max_t(u32, cdma->stats.submit_lat_max_us, lat);
+		pos->done = true;
+	}
+
+	mutex_unlock(&ch->submitlock);
+
+	return submit->err;
+}
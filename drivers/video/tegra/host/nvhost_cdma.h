@@ -26,6 +26,8 @@
 
 #include <linux/nvhost.h>
 #include <linux/list.h>
+#include <linux/llist.h>
+#include <linux/ktime.h>
 
 struct nvhost_syncpt;
 struct nvhost_userctx_timeout;
@@ -78,6 +80,31 @@ struct buffer_timeout {
 	bool allow_dependency;
 };
 
+/*
+ * A job staged for submission. Producers publish it on the cdma submit ring
+ * without taking any lock; whichever thread gets the channel submitlock next
+ * pushes every staged job and writes DMAPUT once for the whole batch. The
+ * entry lives on the producer's stack until done is set.
+ */
+struct nvhost_cdma_submit {
+	struct llist_node node;
+	struct nvhost_job *job;
+	int (*push)(struct nvhost_cdma_submit *submit);
+	ktime_t staged;			/* time the job entered the ring */
+	int err;			/* result of push() */
+	bool done;
+};
+
+struct nvhost_cdma_stats {
+	u64 batches;			/* DMAPUT writes done for batches */
+	u64 batched_jobs;		/* jobs submitted through the ring */
+	u32 max_batch;
+	u64 pb_stalls;			/* waits for push buffer space */
+	u64 pb_stall_us;
+	u64 submit_lat_sum_us;		/* staged -> DMAPUT */
+	u32 submit_lat_max_us;
+};
+
 enum cdma_event {
 	CDMA_EVENT_NONE,		/* not waiting for any event */
 	CDMA_EVENT_SYNC_QUEUE_EMPTY,	/* wait for empty sync queue */
@@ -129,6 +156,14 @@ enum cdma_event {
  * We use this lock to serialize all submits on a channel/CDMA
  * This lock also protects interleaving of CDMA commands in case a channel is
  * shared between multiple users
+ *
+ * 6) nvhost_cdma->submit_ring
+ * type : llist (lock-free)
+ *
+ * Jobs are staged here before the submitter takes submitlock, so producers
+ * only serialize on the push itself. batching and stats are protected by
+ * submitlock, except for the push buffer stall counters which are updated
+ * under push_buffer_lock
  */
 
 struct nvhost_cdma {
@@ -146,6 +181,9 @@ struct nvhost_cdma {
 	struct list_head sync_queue;	/* job queue */
 	struct buffer_timeout timeout;	/* channel's timeout state/wq */
 	struct platform_device *pdev;	/* pointer to host1x device */
+	struct llist_head submit_ring;	/* staged, not yet pushed jobs */
+	bool batching;			/* DMAPUT write deferred to batch end */
+	struct nvhost_cdma_stats stats;
 	bool running;
 	bool torndown;
 };
@@ -172,6 +210,8 @@ void	nvhost_cdma_push_gather(struct nvhost_cdma *cdma,
 void	nvhost_cdma_end(struct nvhost_cdma *cdma,
 		struct nvhost_job *job);
 void	nvhost_cdma_update(struct nvhost_cdma *cdma);
+int	nvhost_cdma_submit_staged(struct nvhost_cdma *cdma,
+		struct nvhost_cdma_submit *submit);
 void	nvhost_cdma_peek(struct nvhost_cdma *cdma,
 		u32 dmaget, int slot, u32 *out);
 unsigned int nvhost_cdma_wait_locked(struct nvhost_cdma *cdma,
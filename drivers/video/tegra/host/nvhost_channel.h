@@ -43,6 +43,13 @@ struct nvhost_channel_ops {
 		struct nvhost_channel *ch);
 };
 
+/* ways a job can enter a channel, for submit cost accounting */
+enum nvhost_submit_path {
+	NVHOST_SUBMIT_PATH_IOCTL,
+	NVHOST_SUBMIT_PATH_USERMODE,
+	NVHOST_SUBMIT_PATH_NUM
+};
+
 struct nvhost_channel {
 	struct nvhost_channel_ops ops;
 	struct kref refcount;
@@ -61,6 +68,10 @@ struct nvhost_channel {
 	u32 syncpts[NVHOST_MODULE_MAX_SYNCPTS];
 	u32 client_managed_syncpt;
 
+	/* kernel time spent in submit, per submit path */
+	atomic64_t submit_count[NVHOST_SUBMIT_PATH_NUM];
+	atomic64_t submit_ns[NVHOST_SUBMIT_PATH_NUM];
+
 	bool cdma_initialized;
 	/* owner identifier */
 	void *identifier;
@@ -68,6 +79,14 @@ struct nvhost_channel {
 
 #define channel_op(ch)		(ch->ops)
 
+static inline void nvhost_channel_account_submit(struct nvhost_channel *ch,
+		enum nvhost_submit_path path, ktime_t start)
+{
+	atomic64_inc(&ch->submit_count[path]);
+	atomic64_add(ktime_to_ns(ktime_sub(ktime_get(), start)),
+		     &ch->submit_ns[path]);
+}
+
 int nvhost_alloc_channels(struct nvhost_master *host);
 int nvhost_channel_remove_identifier(struct nvhost_device_data *pdata,
 			void *identifier);
@@ -43,20 +43,29 @@
  * dma_addr		Physical address of task memory pool
  * va			Virtual address of the task memory pool
  * kmem_addr		Kernel memory for task struct
- * lock			Mutex lock for the array access.
- * alloc_table		Keep track of the index being assigned
- *			and freed for a task
+ * alloc_table		Bitmap of the assigned task slots, updated with
+ *			atomic bit operations
  * max_task_cnt		Maximum task count that can be supported.
+ * next_hint		Slot to start the next free slot search from
+ * in_use		Number of assigned slots
+ * max_in_use		Highest number of slots assigned at once
+ * alloc_cnt		Number of successful slot allocations
+ * alloc_fail_cnt	Number of allocations that found the pool full
  *
  */
 struct nvhost_queue_task_pool {
 	dma_addr_t dma_addr;
 	void *va;
 	void *kmem_addr;
-	struct mutex lock;
 
-	unsigned long alloc_table;
+	unsigned long *alloc_table;
 	unsigned long max_task_cnt;
+	atomic_t next_hint;
+
+	atomic_t in_use;
+	atomic_t max_in_use;
+	atomic64_t alloc_cnt;
+	atomic64_t alloc_fail_cnt;
 };
 
 static DEFINE_DMA_ATTRS(task_dma_attrs);
@@ -70,6 +79,15 @@ static int nvhost_queue_task_pool_alloc(struct platform_device *pdev,
 
 	task_pool = queue->task_pool;
 
+	task_pool->alloc_table = kcalloc(BITS_TO_LONGS(num_tasks),
+					 sizeof(unsigned long), GFP_KERNEL);
+	if (!task_pool->alloc_table) {
+		nvhost_err(&pdev->dev,
+			   "failed to allocate task_pool->alloc_table");
+		err = -ENOMEM;
+		goto err_alloc_table;
+	}
+
 	/* Allocate the kernel memory needed for the task */
 	if (queue->task_kmem_size) {
 		task_pool->kmem_addr = kcalloc(num_tasks,
@@ -94,14 +112,20 @@ static int nvhost_queue_task_pool_alloc(struct platform_device *pdev,
 		goto err_alloc_task_pool;
 	}
 	task_pool->max_task_cnt = num_tasks;
-
-	mutex_init(&task_pool->lock);
+	atomic_set(&task_pool->next_hint, 0);
+	atomic_set(&task_pool->in_use, 0);
+	atomic_set(&task_pool->max_in_use, 0);
+	atomic64_set(&task_pool->alloc_cnt, 0);
+	atomic64_set(&task_pool->alloc_fail_cnt, 0);
 
 	return err;
 
 err_alloc_task_pool:
 	kfree(task_pool->kmem_addr);
 err_alloc_task_kmem:
+	kfree(task_pool->alloc_table);
+	task_pool->alloc_table = NULL;
+err_alloc_table:
 	return err;
 }
 
@@ -117,14 +141,25 @@ static void nvhost_queue_task_free_pool(struct platform_device *pdev,
 			__DMA_ATTR(task_dma_attrs));
 
 	kfree(task_pool->kmem_addr);
+	kfree(task_pool->alloc_table);
+	task_pool->alloc_table = NULL;
 	task_pool->max_task_cnt = 0;
-	task_pool->alloc_table = 0;
 }
 
 static int nvhost_queue_dump(struct nvhost_queue_pool *pool,
 		struct nvhost_queue *queue,
 		struct seq_file *s)
 {
+	struct nvhost_queue_task_pool *task_pool = queue->task_pool;
+
+	if (task_pool && task_pool->max_task_cnt)
+		seq_printf(s, "queue[%u] tasks: depth %d/%lu max %d allocs %lld failed %lld\n",
+			   queue->id, atomic_read(&task_pool->in_use),
+			   task_pool->max_task_cnt,
+			   atomic_read(&task_pool->max_in_use),
+			   (long long)atomic64_read(&task_pool->alloc_cnt),
+			   (long long)atomic64_read(&task_pool->alloc_fail_cnt));
+
 	if (pool->ops && pool->ops->dump)
 		pool->ops->dump(queue, s);
 
@@ -541,31 +576,79 @@ int nvhost_queue_get_task_size(struct nvhost_queue *queue)
 	return 0;
 }
 
+/*
+ * Claim a free slot without taking a lock. The search starts after the
+ * slot handed out last, so that recently freed slots are not reused
+ * right away and concurrent callers spread over the bitmap.
+ */
+static int nvhost_queue_task_pool_get_slot(
+			struct nvhost_queue_task_pool *task_pool)
+{
+	unsigned long max = task_pool->max_task_cnt;
+	unsigned long start = (unsigned int)atomic_read(&task_pool->next_hint);
+	unsigned long index;
+	bool wrapped = false;
+
+	if (start >= max)
+		start = 0;
+
+	index = start;
+	for (;;) {
+		index = find_next_zero_bit(task_pool->alloc_table, max, index);
+		if (index >= max) {
+			if (wrapped || !start)
+				return -1;
+			wrapped = true;
+			index = 0;
+			continue;
+		}
+
+		if (wrapped && index >= start)
+			return -1;
+
+		if (!test_and_set_bit(index, task_pool->alloc_table))
+			break;
+
+		index++;
+	}
+
+	atomic_set(&task_pool->next_hint, index + 1);
+
+	return index;
+}
+
 int nvhost_queue_alloc_task_memory(
 			struct nvhost_queue *queue,
 			struct nvhost_queue_task_mem_info *task_mem_info)
 {
-	int err = 0;
-	int index, hw_offset, sw_offset;
+	int index, hw_offset, sw_offset, in_use, max_in_use;
 	struct platform_device *pdev = queue->pool->pdev;
 	struct nvhost_queue_task_pool *task_pool =
 		(struct nvhost_queue_task_pool *)queue->task_pool;
 
-	mutex_lock(&task_pool->lock);
-
-	index = find_first_zero_bit(&task_pool->alloc_table,
-				    task_pool->max_task_cnt);
+	index = nvhost_queue_task_pool_get_slot(task_pool);
 
 	/* quit if pre-allocated task array is not free */
-	if (index >= task_pool->max_task_cnt) {
+	if (index < 0) {
+		atomic64_inc(&task_pool->alloc_fail_cnt);
 		dev_err(&pdev->dev,
 				"failed to get Task Pool Memory\n");
-		err = -EAGAIN;
-		goto err_alloc_task_mem;
+		return -EAGAIN;
+	}
+
+	atomic64_inc(&task_pool->alloc_cnt);
+	in_use = atomic_inc_return(&task_pool->in_use);
+	max_in_use = atomic_read(&task_pool->max_in_use);
+	while (in_use > max_in_use) {
+		int old = atomic_cmpxchg(&task_pool->max_in_use,
+					 max_in_use, in_use);
+
+		if (old == max_in_use)
+			break;
+		max_in_use = old;
 	}
 
 	/* assign the task array */
-	set_bit(index, &task_pool->alloc_table);
 	hw_offset = index * queue->task_dma_size;
 	sw_offset = index * queue->task_kmem_size;
 	task_mem_info->kmem_addr =
@@ -574,29 +657,35 @@ int nvhost_queue_alloc_task_memory(
 	task_mem_info->dma_addr = task_pool->dma_addr + hw_offset;
 	task_mem_info->pool_index = index;
 
-err_alloc_task_mem:
-	mutex_unlock(&task_pool->lock);
-
-	return err;
+	return 0;
 }
 
-void nvhost_queue_free_task_memory(struct nvhost_queue *queue, int index)
+void nvhost_queue_free_task_memory_used(struct nvhost_queue *queue, int index,
+					size_t kmem_used, size_t dma_used)
 {
 	int hw_offset, sw_offset;
 	u8 *task_kmem, *task_dma_va;
 	struct nvhost_queue_task_pool *task_pool =
 			(struct nvhost_queue_task_pool *)queue->task_pool;
 
-	/* clear task kernel and dma virtual memory contents*/
+	/* clear the task kernel and dma memory the task has written */
 	hw_offset = index * queue->task_dma_size;
 	sw_offset = index * queue->task_kmem_size;
 	task_kmem = (u8 *)task_pool->kmem_addr + sw_offset;
 	task_dma_va = (u8 *)task_pool->va + hw_offset;
 
-	memset(task_kmem, 0, queue->task_kmem_size);
-	memset(task_dma_va, 0, queue->task_dma_size);
+	memset(task_kmem, 0, min(kmem_used, queue->task_kmem_size));
+	memset(task_dma_va, 0, min(dma_used, queue->task_dma_size));
+
+	atomic_dec(&task_pool->in_use);
 
-	mutex_lock(&task_pool->lock);
-	clear_bit(index, &task_pool->alloc_table);
-	mutex_unlock(&task_pool->lock);
+	/* release ordering: the cleared memory is visible before reuse */
+	clear_bit_unlock(index, task_pool->alloc_table);
+}
+
+void nvhost_queue_free_task_memory(struct nvhost_queue *queue, int index)
+{
+	nvhost_queue_free_task_memory_used(queue, index,
+					   queue->task_kmem_size,
+					   queue->task_dma_size);
 }
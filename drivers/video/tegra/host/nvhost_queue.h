@@ -260,6 +260,24 @@ int nvhost_queue_alloc_task_memory(
  */
 void nvhost_queue_free_task_memory(struct nvhost_queue *queue, int index);
 
+/**
+ * @brief	Free the assigned task memory, clearing only what was used
+ *
+ * Like nvhost_queue_free_task_memory(), but only the first kmem_used
+ * bytes of the kernel task memory and the first dma_used bytes of the
+ * task dma memory are cleared. The caller is responsible for having
+ * cleared anything it wrote beyond these.
+ *
+ * @param queue		Pointer to an allocated queue
+ * @param index		Index of the assigned task pool memory
+ * @param kmem_used	Bytes of kernel task memory to clear
+ * @param dma_used	Bytes of task dma memory to clear
+ * @return		void
+ *
+ */
+void nvhost_queue_free_task_memory_used(struct nvhost_queue *queue, int index,
+					size_t kmem_used, size_t dma_used);
+
 /**
  * @brief	Sets the attribute to the queue
  *
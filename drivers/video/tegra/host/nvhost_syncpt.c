@@ -22,6 +22,8 @@
 #include <uapi/linux/nvhost_ioctl.h>
 #include <linux/platform_device.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
 #include <linux/stat.h>
 #include <linux/export.h>
 #include <linux/delay.h>
@@ -95,12 +97,19 @@ void nvhost_syncpt_save(struct nvhost_syncpt *sp)
 {
 	u32 i;
 	struct nvhost_master *master = syncpt_to_dev(sp);
+	bool refreshed = false;
+
+	if (syncpt_op().update_min_all) {
+		syncpt_op().update_min_all(sp);
+		refreshed = true;
+	}
 
 	for (i = nvhost_syncpt_pts_base(sp);
 			i < nvhost_syncpt_pts_limit(sp); i++) {
-		if (nvhost_syncpt_client_managed(sp, i))
-			syncpt_op().update_min(sp, i);
-		else
+		if (nvhost_syncpt_client_managed(sp, i)) {
+			if (!refreshed)
+				syncpt_op().update_min(sp, i);
+		} else
 			if (!nvhost_syncpt_min_eq_max(sp, i)) {
 				nvhost_warn(&master->dev->dev,
 				 "invalid save state for syncpt %u (%s)\n",
@@ -195,20 +204,55 @@ int nvhost_syncpt_incr(struct nvhost_syncpt *sp, u32 id)
 	nvhost_syncpt_cpu_incr(sp, id);
 	mutex_unlock(&sp->cpu_increment_mutex);
 
+	/*
+	 * Refresh the shadow right away so that waiters polling it see the
+	 * increment without waiting for the next threshold interrupt. The
+	 * read also flushes the posted increment write.
+	 */
+	nvhost_syncpt_update_min(sp, id);
+
 	nvhost_module_idle(syncpt_to_dev(sp)->dev);
 
 	return 0;
 }
 
 /**
- * Updated sync point form hardware, and returns true if syncpoint is expired,
- * false if we may need to wait
+ * Maps the shadow syncpoint value table read-only into user space, so that
+ * fences can be polled without a syscall. A value read from the table may
+ * lag the hardware; a fence that does not look expired there has to be
+ * waited for through the ctrl node, which refreshes the shadow.
+ */
+int nvhost_syncpt_mmap_shadow(struct nvhost_syncpt *sp,
+			      struct vm_area_struct *vma)
+{
+	size_t size = vma->vm_end - vma->vm_start;
+	size_t table_size =
+		PAGE_ALIGN(sizeof(atomic_t) * nvhost_syncpt_nb_hw_pts(sp));
+
+	if (vma->vm_pgoff || size > table_size)
+		return -EINVAL;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return remap_vmalloc_range(vma, sp->min_val, 0);
+}
+
+/**
+ * Returns true if syncpoint is expired, false if we may need to wait. The
+ * shadow value only ever lags the hardware, so the register is read only
+ * when the shadow says the threshold has not been reached yet.
  */
 static bool syncpt_update_min_is_expired(
 	struct nvhost_syncpt *sp,
 	u32 id,
 	u32 thresh)
 {
+	if (nvhost_syncpt_is_expired(sp, id, thresh))
+		return true;
+
 	syncpt_op().update_min(sp, id);
 	return nvhost_syncpt_is_expired(sp, id, thresh);
 }
@@ -1118,7 +1162,7 @@ int nvhost_syncpt_init(struct platform_device *dev,
 	sp->client_managed = kzalloc(sizeof(bool) * nb_pts, GFP_KERNEL);
 	sp->syncpt_names = kzalloc(sizeof(char *) * nb_pts, GFP_KERNEL);
 	sp->last_used_by = kzalloc(sizeof(char *) * nb_pts, GFP_KERNEL);
-	sp->min_val = kzalloc(sizeof(atomic_t) * nb_pts, GFP_KERNEL);
+	sp->min_val = vmalloc_user(PAGE_ALIGN(sizeof(atomic_t) * nb_pts));
 	sp->max_val = kzalloc(sizeof(atomic_t) * nb_pts, GFP_KERNEL);
 	sp->lock_counts =
 		kzalloc(sizeof(atomic_t) * nvhost_syncpt_nb_mlocks(sp),
@@ -1271,7 +1315,7 @@ void nvhost_syncpt_deinit(struct nvhost_syncpt *sp)
 {
 	kobject_put(sp->kobj);
 
-	kfree(sp->min_val);
+	vfree(sp->min_val);
 	sp->min_val = NULL;
 
 	kfree(sp->max_val);
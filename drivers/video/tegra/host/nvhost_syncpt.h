@@ -36,6 +36,7 @@
 #define NVHOST_SYNCPT_FREE_WAIT_TIMEOUT (1 * HZ)
 
 struct nvhost_syncpt;
+struct vm_area_struct;
 
 /* Attribute struct for sysfs min and max attributes */
 struct nvhost_syncpt_attr {
@@ -50,6 +51,11 @@ struct nvhost_syncpt {
 	bool *client_managed;
 	struct kobject *kobj;
 	struct mutex syncpt_mutex;
+	/*
+	 * Shadow of the syncpoint values last read from hardware, one 32-bit
+	 * word per syncpoint id. Page aligned so that user space can map it
+	 * read-only through the ctrl node, see nvhost_syncpt_mmap_shadow().
+	 */
 	atomic_t *min_val;
 	atomic_t *max_val;
 	atomic_t *lock_counts;
@@ -159,6 +165,9 @@ u32 nvhost_syncpt_read(struct nvhost_syncpt *sp, u32 id);
 
 int nvhost_syncpt_incr(struct nvhost_syncpt *sp, u32 id);
 
+int nvhost_syncpt_mmap_shadow(struct nvhost_syncpt *sp,
+			      struct vm_area_struct *vma);
+
 int nvhost_syncpt_wait_timeout(struct nvhost_syncpt *sp, u32 id, u32 thresh,
 			u32 timeout, u32 *value, struct nvhost_timespec *ts,
 			bool interruptible);
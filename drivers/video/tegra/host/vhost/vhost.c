@@ -18,12 +18,23 @@
 
 #include <linux/slab.h>
 #include <linux/uaccess.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
 #include <linux/tegra_vhost.h>
 #include <linux/nvhost.h>
 
 #include "vhost.h"
 #include "../host1x/host1x.h"
 
+#define VHOST_FEATURES_SUPPORTED			\
+	(TEGRA_VHOST_FEATURE_SYNCPT_READ_BATCH |	\
+	 TEGRA_VHOST_FEATURE_SUBMIT_BATCH |		\
+	 TEGRA_VHOST_FEATURE_SYNCPT_PUSH)
+
+struct vhost_stats vhost_stats;
+static struct dentry *vhost_debugfs;
+
 static inline int vhost_comm_init(struct platform_device *pdev,
 					  bool channel_management_in_guest)
 {
@@ -32,6 +43,10 @@ static inline int vhost_comm_init(struct platform_device *pdev,
 		channel_management_in_guest ?
 		1 : ARRAY_SIZE(queue_sizes);
 
+	/* the stand-in server answers in place, there is no peer */
+	if (IS_ENABLED(CONFIG_TEGRA_GRHOST_VHOST_LOOPBACK))
+		return 0;
+
 	return tegra_gr_comm_init(pdev, num_queues, queue_sizes,
 			TEGRA_VHOST_QUEUE_CMD, num_queues);
 }
@@ -43,6 +58,9 @@ static inline void vhost_comm_deinit(bool channel_management_in_guest)
 		channel_management_in_guest ?
 		1 : ARRAY_SIZE(queue_sizes);
 
+	if (IS_ENABLED(CONFIG_TEGRA_GRHOST_VHOST_LOOPBACK))
+		return;
+
 	tegra_gr_comm_deinit(TEGRA_VHOST_QUEUE_CMD, num_queues);
 }
 
@@ -125,6 +143,22 @@ static u64 vhost_virt_connect(int moduleid)
 	return (err || msg.ret) ? 0 : p->handle;
 }
 
+static u64 vhost_virt_get_features(u64 handle)
+{
+	struct tegra_vhost_cmd_msg msg;
+	struct tegra_vhost_features_params *p = &msg.params.features;
+	int err;
+
+	msg.cmd = TEGRA_VHOST_CMD_GET_FEATURES;
+	msg.handle = handle;
+	p->features = VHOST_FEATURES_SUPPORTED;
+
+	/* older servers reject the command, run without extensions then */
+	err = vhost_sendrecv(&msg);
+
+	return (err || msg.ret) ? 0 : p->features & VHOST_FEATURES_SUPPORTED;
+}
+
 int vhost_sendrecv(struct tegra_vhost_cmd_msg *msg)
 {
 	void *handle;
@@ -133,6 +167,11 @@ int vhost_sendrecv(struct tegra_vhost_cmd_msg *msg)
 	void *data = msg;
 	int err;
 
+	atomic64_inc(&vhost_stats.cmd_msgs);
+
+	if (IS_ENABLED(CONFIG_TEGRA_GRHOST_VHOST_LOOPBACK))
+		return vhost_loopback_sendrecv(msg, size);
+
 	err = tegra_gr_comm_sendrecv(tegra_gr_comm_get_server_vmid(),
 				TEGRA_VHOST_QUEUE_CMD, &handle, &data, &size);
 	if (!err) {
@@ -144,6 +183,63 @@ int vhost_sendrecv(struct tegra_vhost_cmd_msg *msg)
 	return err;
 }
 
+int vhost_pb_sendrecv(struct tegra_vhost_cmd_msg *msg, size_t size_in,
+		size_t size_out)
+{
+	void *handle;
+	size_t size = size_in;
+	void *data = msg;
+	int err;
+
+	atomic64_inc(&vhost_stats.pb_msgs);
+
+	if (IS_ENABLED(CONFIG_TEGRA_GRHOST_VHOST_LOOPBACK))
+		return vhost_loopback_sendrecv(msg, size_in);
+
+	err = tegra_gr_comm_sendrecv(tegra_gr_comm_get_server_vmid(),
+				TEGRA_VHOST_QUEUE_PB, &handle, &data, &size);
+	if (!err) {
+		WARN_ON(size < size_out);
+		memcpy(msg, data, size_out);
+		tegra_gr_comm_release(handle);
+	}
+
+	return err;
+}
+
+static int vhost_stats_show(struct seq_file *s, void *unused)
+{
+	u64 cmd = atomic64_read(&vhost_stats.cmd_msgs);
+	u64 pb = atomic64_read(&vhost_stats.pb_msgs);
+	u64 jobs = atomic64_read(&vhost_stats.jobs);
+	u64 reads = atomic64_read(&vhost_stats.syncpt_reads);
+	u64 cached = atomic64_read(&vhost_stats.syncpt_cached_reads);
+
+	seq_printf(s, "cmd messages:        %llu\n", cmd);
+	seq_printf(s, "pb messages:         %llu\n", pb);
+	seq_printf(s, "jobs submitted:      %llu\n", jobs);
+	seq_printf(s, "syncpt reads:        %llu (%llu from cache)\n",
+		   reads, cached);
+	if (jobs)
+		seq_printf(s, "round trips per job: %llu.%02llu\n",
+			   div64_u64(cmd + pb, jobs),
+			   div64_u64((cmd + pb) * 100, jobs) % 100);
+
+	return 0;
+}
+
+static int vhost_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vhost_stats_show, inode->i_private);
+}
+
+static const struct file_operations vhost_stats_fops = {
+	.open		= vhost_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static void vhost_fake_debug_show_channel_cdma(struct nvhost_master *m,
 		struct nvhost_channel *ch, struct output *o, int chid)
 {
@@ -199,6 +295,18 @@ int nvhost_virt_init(struct platform_device *dev, int moduleid)
 		goto fail;
 	}
 
+	virt_ctx->features = vhost_virt_get_features(virt_ctx->handle);
+	virt_ctx->moduleid = moduleid;
+
+	if (moduleid == NVHOST_MODULE_NONE) {
+		dev_info(&dev->dev, "server features 0x%llx\n",
+			 virt_ctx->features);
+		vhost_debugfs = debugfs_create_dir("tegra_vhost", NULL);
+		if (vhost_debugfs)
+			debugfs_create_file("stats", S_IRUGO, vhost_debugfs,
+					    NULL, &vhost_stats_fops);
+	}
+
 	nvhost_set_virt_data(dev, virt_ctx);
 	return 0;
 
@@ -214,6 +322,11 @@ void nvhost_virt_deinit(struct platform_device *dev)
 
 	if (virt_ctx) {
 		/* FIXME: add virt disconnect */
+		/* only host1x created the debugfs directory */
+		if (virt_ctx->moduleid == NVHOST_MODULE_NONE) {
+			debugfs_remove_recursive(vhost_debugfs);
+			vhost_debugfs = NULL;
+		}
 		vhost_comm_deinit(host->info.vmserver_owns_engines);
 		kfree(virt_ctx);
 	}
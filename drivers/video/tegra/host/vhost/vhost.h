@@ -25,9 +25,22 @@
 
 struct nvhost_virt_ctx {
 	u64 handle;
+	u64 features;		/* TEGRA_VHOST_FEATURE_* enabled by server */
+	int moduleid;		/* NVHOST_MODULE_NONE for host1x */
 	struct task_struct *syncpt_handler;
 };
 
+/* server round trips, for judging how well submits get batched */
+struct vhost_stats {
+	atomic64_t cmd_msgs;
+	atomic64_t pb_msgs;
+	atomic64_t jobs;
+	atomic64_t syncpt_reads;
+	atomic64_t syncpt_cached_reads;
+};
+
+extern struct vhost_stats vhost_stats;
+
 #ifdef CONFIG_TEGRA_GRHOST_VHOST
 
 #include <linux/tegra_gr_comm.h>
@@ -51,6 +64,10 @@ void vhost_init_host1x_cdma_ops(struct nvhost_cdma_ops *ops);
 void vhost_init_host1x_debug_ops(struct nvhost_debug_ops *ops);
 int vhost_syncpt_get_range(u64 handle, u32 *base, u32 *size);
 int vhost_sendrecv(struct tegra_vhost_cmd_msg *msg);
+int vhost_pb_sendrecv(struct tegra_vhost_cmd_msg *msg, size_t size_in,
+		size_t size_out);
+void vhost_intr_dispatch(struct nvhost_master *dev,
+		struct tegra_vhost_intr_msg *msg);
 int vhost_virt_moduleid(int moduleid);
 int vhost_moduleid_virt_to_hw(int moduleid);
 u32 vhost_channel_alloc_clientid(u64 handle, u32 moduleid);
@@ -68,6 +85,24 @@ void vhost_cdma_timeout(struct nvhost_master *dev,
 int vhost_prod_apply(struct platform_device *pdev, u32 phy_mode);
 int vhost_cil_sw_reset(struct platform_device *pdev, u32 lanes, u32 enable);
 
+#ifdef CONFIG_TEGRA_GRHOST_VHOST_LOOPBACK
+int vhost_loopback_sendrecv(struct tegra_vhost_cmd_msg *msg, size_t size);
+void vhost_loopback_attach(struct nvhost_master *dev);
+void vhost_loopback_detach(void);
+#else
+static inline int vhost_loopback_sendrecv(struct tegra_vhost_cmd_msg *msg,
+		size_t size)
+{
+	return -ENODEV;
+}
+static inline void vhost_loopback_attach(struct nvhost_master *dev)
+{
+}
+static inline void vhost_loopback_detach(void)
+{
+}
+#endif
+
 #else
 
 static inline void vhost_init_host1x_intr_ops(struct nvhost_intr_ops *ops)
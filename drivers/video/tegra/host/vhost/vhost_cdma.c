@@ -24,80 +24,162 @@
 #include "../dev.h"
 #include "../bus_client.h"
 
-static int vhost_pb_sendrecv(struct tegra_vhost_cmd_msg *msg, size_t size_in,
-		size_t size_out)
+/* a submit message built under sync_queue_lock, sent once it is dropped */
+struct vhost_submit_msg {
+	struct list_head list;
+	size_t size_in;
+	size_t size_out;
+	u32 num_jobs;
+	struct tegra_vhost_cmd_msg msg;	/* must be last, payload follows */
+};
+
+static struct vhost_submit_msg *vhost_submit_msg_alloc(size_t size)
 {
-	void *handle;
-	size_t size = size_in;
-	void *data = msg;
-	int err;
+	struct vhost_submit_msg *m;
 
-	err = tegra_gr_comm_sendrecv(tegra_gr_comm_get_server_vmid(),
-				TEGRA_VHOST_QUEUE_PB, &handle, &data, &size);
-	if (!err) {
-		WARN_ON(size < size_out);
-		memcpy(msg, data, size_out);
-		tegra_gr_comm_release(handle);
-	}
+	m = kmalloc(offsetof(struct vhost_submit_msg, msg) + size, GFP_KERNEL);
+	if (!m)
+		return NULL;
 
-	return err;
+	m->size_in = size;
+	m->size_out = sizeof(m->msg);
+	m->msg.ret = 0;
+	return m;
 }
 
-static int vhost_channel_submit(u64 handle, struct nvhost_job *job,
-		u32 *pb_base, u32 start, u32 end, u32 job_id)
+/* bytes of push buffer and fence data a job adds to a submit message */
+static inline size_t vhost_job_payload(struct nvhost_job *job)
 {
-	struct tegra_vhost_cmd_msg *msg;
-	struct tegra_vhost_channel_submit_params *p;
-	u32 num_entries, i;
-	size_t size;
-	char *ptr;
+	/* opcode/data pairs and id/fence pairs are 8 bytes each */
+	return 8 * (job->num_slots + job->num_syncpts);
+}
+
+/* copy out a job's push buffer slots, which may wrap around the end */
+static char *vhost_copy_job(char *ptr, struct nvhost_cdma *cdma,
+		struct nvhost_job *job)
+{
+	struct push_buffer *pb = &cdma->push_buffer;
+	u32 start = job->first_get - pb->dma_addr;
+	u32 len = 8 * job->num_slots;
+	u32 first = min_t(u32, len, PUSH_BUFFER_SIZE - start);
 	u32 *ptr32;
-	int err;
+	int i;
+
+	memcpy(ptr, (u8 *)pb->mapped + start, first);
+	memcpy(ptr + first, pb->mapped, len - first);
+	ptr += len;
+
+	/* Now update syncpt information */
+	ptr32 = (u32 *)ptr;
+	for (i = 0; i < job->num_syncpts; i++) {
+		struct nvhost_job_syncpt *sp = job->sp + i;
+		*ptr32++ = sp->id;
+		*ptr32++ = sp->fence;
+	}
+
+	return (char *)ptr32;
+}
 
-	/* number of opcode/data pairs (8 bytes each) */
-	num_entries = ((end - start) & (PUSH_BUFFER_SIZE - 1)) / 8;
+static struct vhost_submit_msg *vhost_build_submit(u64 handle,
+		struct nvhost_cdma *cdma, struct nvhost_job *job)
+{
+	struct vhost_submit_msg *m;
+	struct tegra_vhost_channel_submit_params *p;
 
-	size = sizeof(*msg) + 8 * (num_entries + job->num_syncpts);
-	msg = kmalloc(size, GFP_KERNEL);
-	if (!msg)
-		return -1;
+	m = vhost_submit_msg_alloc(sizeof(m->msg) + vhost_job_payload(job));
+	if (!m)
+		return NULL;
 
-	msg->cmd = TEGRA_VHOST_CMD_HOST1X_CDMA_SUBMIT;
-	msg->handle = handle;
-	msg->ret = 0;
-	p = &msg->params.cdma_submit;
+	m->num_jobs = 1;
+	m->msg.cmd = TEGRA_VHOST_CMD_HOST1X_CDMA_SUBMIT;
+	m->msg.handle = handle;
+	p = &m->msg.params.cdma_submit;
 	p->clientid = job->clientid;
-	p->job_id = job_id;
+	p->job_id = job->first_get;
 	p->timeout = job->timeout;
-	p->num_entries = num_entries;
+	p->num_entries = job->num_slots;
 	p->num_syncpts = job->num_syncpts;
 
-	ptr = (char *)msg + sizeof(*msg);
+	vhost_copy_job((char *)(&m->msg + 1), cdma, job);
 
-	/* Copy pushbuffer contents first */
-	if ((start < end) || (end == 0)) {
-		memcpy(ptr, (u8 *)pb_base + start, 8 * num_entries);
-		ptr += 8 * num_entries;
-	}
-	else {
-		memcpy(ptr, (u8 *)pb_base + start, PUSH_BUFFER_SIZE - start);
-		ptr += PUSH_BUFFER_SIZE - start;
-		memcpy(ptr, pb_base, end);
-		ptr += end;
+	return m;
+}
+
+/*
+ * Pack *pos and as many of the jobs following it as fit into one PB frame.
+ * A job too large for a frame on its own still goes out alone, as it did
+ * with single submits. *pos is advanced past the packed jobs.
+ */
+static struct vhost_submit_msg *vhost_build_submit_batch(u64 handle,
+		struct nvhost_cdma *cdma, struct nvhost_job **pos)
+{
+	struct vhost_submit_msg *m;
+	struct tegra_vhost_submit_desc *desc;
+	struct nvhost_job *job = *pos;
+	size_t size = sizeof(m->msg), len;
+	u32 i, num_jobs = 0;
+	char *ptr;
+
+	list_for_each_entry_from(job, &cdma->sync_queue, list) {
+		len = sizeof(*desc) + vhost_job_payload(job);
+		if (num_jobs && size + len > TEGRA_VHOST_PB_FRAME_SIZE)
+			break;
+		size += len;
+		num_jobs++;
 	}
 
-	/* Now update syncpt information */
-	ptr32 = (u32 *)ptr;
-	for (i = 0; i < p->num_syncpts; i++) {
-		struct nvhost_job_syncpt *sp = job->sp + i;
-		*ptr32++ = sp->id;
-		*ptr32++ = sp->fence;
+	m = vhost_submit_msg_alloc(size);
+	if (!m)
+		return NULL;
+
+	m->num_jobs = num_jobs;
+	m->size_out = sizeof(m->msg) + num_jobs * sizeof(*desc);
+	m->msg.cmd = TEGRA_VHOST_CMD_HOST1X_CDMA_SUBMIT_BATCH;
+	m->msg.handle = handle;
+	m->msg.params.submit_batch.num_jobs = num_jobs;
+
+	desc = (struct tegra_vhost_submit_desc *)(&m->msg + 1);
+	ptr = (char *)(desc + num_jobs);
+	job = *pos;
+	for (i = 0; i < num_jobs; i++, desc++) {
+		desc->clientid = job->clientid;
+		desc->job_id = job->first_get;
+		desc->timeout = job->timeout;
+		desc->num_entries = job->num_slots;
+		desc->num_syncpts = job->num_syncpts;
+		desc->ret = 0;
+		ptr = vhost_copy_job(ptr, cdma, job);
+		job = list_next_entry(job, list);
 	}
 
-	err = vhost_pb_sendrecv(msg, size, sizeof(*msg));
+	*pos = job;
+	return m;
+}
+
+static int vhost_send_submit(struct vhost_submit_msg *m)
+{
+	struct tegra_vhost_submit_desc *desc;
+	int err;
+	u32 i;
+
+	err = vhost_pb_sendrecv(&m->msg, m->size_in, m->size_out);
+	if (err || m->msg.ret)
+		return -EIO;
+
+	atomic64_add(m->num_jobs, &vhost_stats.jobs);
+
+	if (m->msg.cmd != TEGRA_VHOST_CMD_HOST1X_CDMA_SUBMIT_BATCH)
+		return 0;
+
+	desc = (struct tegra_vhost_submit_desc *)(&m->msg + 1);
+	for (i = 0; i < m->num_jobs; i++, desc++) {
+		if (desc->ret) {
+			pr_err("%s: job 0x%x rejected by server: %d\n",
+				__func__, desc->job_id, desc->ret);
+			err = -EIO;
+		}
+	}
 
-	err = (err || msg->ret) ? -1 : 0;
-	kfree(msg);
 	return err;
 }
 
@@ -135,40 +217,78 @@ static void vhost_cdma_stop(struct nvhost_cdma *cdma)
 }
 
 /**
- * Kick channel DMA into action by writing its PUT offset (if it has changed)
+ * Kick channel DMA into action by sending the jobs pushed since the last
+ * kick to the server, as few messages as the server allows.
  */
 static void vhost_cdma_kick(struct nvhost_cdma *cdma)
 {
-	struct nvhost_job *job;
-	u32 put;
-	int err;
+	struct nvhost_channel *ch = cdma_to_channel(cdma);
+	struct nvhost_virt_ctx *virt_ctx = nvhost_get_virt_data(ch->dev);
+	struct vhost_submit_msg *m, *tmp;
+	struct nvhost_job *job, *first = NULL;
+	LIST_HEAD(msgs);
+	u32 put, pending, slots = 0;
+	int err = 0;
+
+	/*
+	 * A kick from the middle of a batch has a partially pushed job at
+	 * the end of the push buffer. The server takes whole jobs only, so
+	 * stop in front of it.
+	 */
+	if (cdma->batching)
+		put = cdma->first_get;
+	else
+		put = nvhost_push_buffer_putptr(&cdma->push_buffer);
+
+	if (put == cdma->last_put)
+		return;
+
+	pending = ((put - cdma->last_put) & (PUSH_BUFFER_SIZE - 1)) / 8;
 
 	mutex_lock(&cdma->sync_queue_lock);
-	job = list_entry(cdma->sync_queue.prev, struct nvhost_job, list);
+
+	/* the unsent jobs are the ones at the tail covering those slots */
+	list_for_each_entry_reverse(job, &cdma->sync_queue, list) {
+		if (slots >= pending)
+			break;
+		slots += job->num_slots;
+		first = job;
+	}
+
+	job = first;
+	while (job && &job->list != &cdma->sync_queue) {
+		if (virt_ctx->features & TEGRA_VHOST_FEATURE_SUBMIT_BATCH) {
+			m = vhost_build_submit_batch(virt_ctx->handle, cdma,
+						     &job);
+		} else {
+			m = vhost_build_submit(virt_ctx->handle, cdma, job);
+			job = list_next_entry(job, list);
+		}
+		if (!m) {
+			err = -ENOMEM;
+			break;
+		}
+		list_add_tail(&m->list, &msgs);
+	}
+
 	mutex_unlock(&cdma->sync_queue_lock);
 
-	put = nvhost_push_buffer_putptr(&cdma->push_buffer);
-
-	if (put != cdma->last_put) {
-		u32 start = cdma->last_put - cdma->push_buffer.dma_addr;
-		u32 end = put - cdma->push_buffer.dma_addr;
-		struct nvhost_channel *ch = cdma_to_channel(cdma);
-		struct nvhost_virt_ctx *virt_ctx =
-						nvhost_get_virt_data(ch->dev);
-
-		/* Don't hold the lock while we're waiting
-		 * for this to complete
-		 */
-		up_read(&cdma->lock);
-		err = vhost_channel_submit(virt_ctx->handle, job,
-					cdma->push_buffer.mapped,
-					start, end, cdma->last_put);
-		down_read(&cdma->lock);
-		if (err)
-			pr_err("%s: error return from host1x_cdma_kick\n",
-				__func__);
-		cdma->last_put = put;
+	cdma->last_put = put;
+
+	/* Don't hold the lock while we're waiting
+	 * for this to complete
+	 */
+	up_read(&cdma->lock);
+	list_for_each_entry_safe(m, tmp, &msgs, list) {
+		if (!err)
+			err = vhost_send_submit(m);
+		list_del(&m->list);
+		kfree(m);
 	}
+	down_read(&cdma->lock);
+
+	if (err)
+		pr_err("%s: error return from host1x_cdma_kick\n", __func__);
 }
 
 /*
@@ -62,6 +62,49 @@ static void syncpt_thresh_cascade_handler(struct nvhost_master *dev,
 
 }
 
+static void syncpt_update_handler(struct nvhost_master *dev,
+			struct tegra_vhost_syncpt_update_info *info)
+{
+	struct nvhost_syncpt *sp = &dev->syncpt;
+	u32 old;
+
+	if (unlikely(!nvhost_syncpt_is_valid_hw_pt(sp, info->id))) {
+		dev_err_ratelimited(&dev->dev->dev,
+			"%s(): invalid syncpoint id %d\n", __func__, info->id);
+		return;
+	}
+
+	/* updates may be reordered against reads, never move backwards */
+	do {
+		old = nvhost_syncpt_read_min(sp, info->id);
+		if ((s32)(info->val - old) <= 0)
+			return;
+	} while ((u32)atomic_cmpxchg(&sp->min_val[info->id], old,
+				     info->val) != old);
+}
+
+void vhost_intr_dispatch(struct nvhost_master *dev,
+			struct tegra_vhost_intr_msg *msg)
+{
+	switch (msg->event) {
+	case TEGRA_VHOST_EVENT_SYNCPT_INTR:
+		syncpt_thresh_cascade_handler(dev,
+			&msg->info.syncpt_intr);
+		break;
+	case TEGRA_VHOST_EVENT_CHAN_TIMEOUT_INTR:
+		vhost_cdma_timeout(dev,
+			&msg->info.chan_timeout);
+		break;
+	case TEGRA_VHOST_EVENT_SYNCPT_UPDATE:
+		syncpt_update_handler(dev, &msg->info.syncpt_update);
+		break;
+	default:
+		dev_warn(&dev->dev->dev,
+			"Unknown interrupt event %d\n", msg->event);
+		break;
+	}
+}
+
 static int vhost_intr_handler(void *dev_id)
 {
 	struct nvhost_master *dev = dev_id;
@@ -84,20 +127,7 @@ static int vhost_intr_handler(void *dev_id)
 			break;
 		}
 
-		switch (msg->event) {
-		case TEGRA_VHOST_EVENT_SYNCPT_INTR:
-			syncpt_thresh_cascade_handler(dev,
-				&msg->info.syncpt_intr);
-			break;
-		case TEGRA_VHOST_EVENT_CHAN_TIMEOUT_INTR:
-			vhost_cdma_timeout(dev,
-				&msg->info.chan_timeout);
-			break;
-		default:
-			dev_warn(&dev->dev->dev,
-				"Unknown interrupt event %d\n", msg->event);
-			break;
-		}
+		vhost_intr_dispatch(dev, msg);
 
 		tegra_gr_comm_release(handle);
 	}
@@ -180,11 +210,18 @@ static int vhost_intr_init(struct nvhost_intr *intr)
 
 	intr_op().disable_all_syncpt_intrs(intr);
 
+	if (IS_ENABLED(CONFIG_TEGRA_GRHOST_VHOST_LOOPBACK)) {
+		/* events are delivered by the stand-in server */
+		vhost_loopback_attach(dev);
+		goto enable_host_sp;
+	}
+
 	ctx->syncpt_handler =
 		kthread_run(vhost_intr_handler, dev, "vhost_intr");
 	if (IS_ERR(ctx->syncpt_handler))
 		return PTR_ERR(ctx->syncpt_handler);
 
+enable_host_sp:
 	vhost_syncpt_enable_intr(ctx->handle,
 			nvhost_syncpt_graphics_host_sp(&dev->syncpt), 1);
 
@@ -202,6 +239,11 @@ static void vhost_intr_deinit(struct nvhost_intr *intr)
 	vhost_intr_disable_syncpt_intr(intr,
 			nvhost_syncpt_graphics_host_sp(&dev->syncpt));
 
+	if (IS_ENABLED(CONFIG_TEGRA_GRHOST_VHOST_LOOPBACK)) {
+		vhost_loopback_detach();
+		return;
+	}
+
 	msg.event = TEGRA_VHOST_EVENT_ABORT;
 	err = tegra_gr_comm_send(TEGRA_GR_COMM_ID_SELF, TEGRA_VHOST_QUEUE_INTR,
 				&msg, sizeof(msg));
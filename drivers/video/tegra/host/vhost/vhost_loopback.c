@@ -0,0 +1,350 @@
+/*
+ * Tegra Graphics Virtualization Host stand-in server
+ *
+ * Copyright (c) 2019, NVIDIA Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Answers vhost commands in place instead of sending them to the server VM,
+ * so the client side can be brought up and its round trips per job measured
+ * without a hypervisor. Syncpoints live in a table here, submitted jobs
+ * complete immediately by moving their syncpoints to the job fences, and
+ * interrupt events are delivered from a work item like the vhost_intr
+ * thread would.
+ */
+
+#include <linux/module.h>
+#include <linux/delay.h>
+#include <linux/kfifo.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+
+#include "vhost.h"
+#include "dev.h"
+
+#define LOOPBACK_MAX_SYNCPTS	1024
+#define LOOPBACK_MAX_MLOCKS	64
+#define LOOPBACK_EVENTS		1024
+
+/* emulated cost of one round trip to the server VM */
+static uint loopback_rtt_us = 20;
+module_param(loopback_rtt_us, uint, 0644);
+
+/* TEGRA_VHOST_FEATURE_* offered, clear bits to emulate an older server */
+static ulong loopback_features = ~0UL;
+module_param(loopback_features, ulong, 0644);
+
+/* syncpoints handed to the guest, must not exceed what the chip has */
+static uint loopback_nb_pts = 32;
+module_param(loopback_nb_pts, uint, 0444);
+
+static DEFINE_SPINLOCK(loopback_lock);
+static u32 loopback_syncpt[LOOPBACK_MAX_SYNCPTS];
+static u32 loopback_thresh[LOOPBACK_MAX_SYNCPTS];
+static DECLARE_BITMAP(loopback_intr_enabled, LOOPBACK_MAX_SYNCPTS);
+static u32 loopback_waitbase[LOOPBACK_MAX_SYNCPTS];
+static DECLARE_BITMAP(loopback_mlocked, LOOPBACK_MAX_MLOCKS);
+static u64 loopback_handles;
+static u32 loopback_clientids;
+static bool loopback_push;
+
+static struct nvhost_master *loopback_dev;
+static DEFINE_KFIFO(loopback_events, struct tegra_vhost_intr_msg,
+		    LOOPBACK_EVENTS);
+
+static void loopback_event_work(struct work_struct *work)
+{
+	struct tegra_vhost_intr_msg msg;
+
+	while (kfifo_get(&loopback_events, &msg)) {
+		if (loopback_dev)
+			vhost_intr_dispatch(loopback_dev, &msg);
+	}
+}
+
+static DECLARE_WORK(loopback_work, loopback_event_work);
+
+/* called with loopback_lock held */
+static void loopback_post(unsigned int event, u32 id, u32 val)
+{
+	struct tegra_vhost_intr_msg msg;
+
+	msg.event = event;
+	msg.info.syncpt_update.id = id;
+	msg.info.syncpt_update.val = val;
+
+	if (!kfifo_put(&loopback_events, msg))
+		pr_warn_ratelimited("%s: event queue full, dropped %u\n",
+				    __func__, event);
+	schedule_work(&loopback_work);
+}
+
+static inline bool loopback_pt_valid(u32 id)
+{
+	return id < min_t(u32, loopback_nb_pts, LOOPBACK_MAX_SYNCPTS);
+}
+
+/* called with loopback_lock held */
+static void loopback_syncpt_set(u32 id, u32 val)
+{
+	loopback_syncpt[id] = val;
+
+	if (loopback_push)
+		loopback_post(TEGRA_VHOST_EVENT_SYNCPT_UPDATE, id, val);
+
+	if (test_bit(id, loopback_intr_enabled) &&
+	    (s32)(val - loopback_thresh[id]) >= 0) {
+		/* like the hardware, one shot until the next threshold */
+		clear_bit(id, loopback_intr_enabled);
+		loopback_post(TEGRA_VHOST_EVENT_SYNCPT_INTR, id, val);
+	}
+}
+
+/* complete a job by moving its syncpoints to the fences */
+static int loopback_complete(const u32 *fences, u32 num_syncpts)
+{
+	u32 i, id, fence;
+
+	for (i = 0; i < num_syncpts; i++) {
+		id = *fences++;
+		fence = *fences++;
+		if (!loopback_pt_valid(id))
+			return -EINVAL;
+		if ((s32)(fence - loopback_syncpt[id]) > 0)
+			loopback_syncpt_set(id, fence);
+	}
+
+	return 0;
+}
+
+static int loopback_submit(struct tegra_vhost_cmd_msg *msg, size_t size)
+{
+	struct tegra_vhost_channel_submit_params *p = &msg->params.cdma_submit;
+	u64 len = 8ULL * ((u64)p->num_entries + p->num_syncpts);
+	char *ptr = (char *)(msg + 1);
+
+	if (sizeof(*msg) + len > size)
+		return -EINVAL;
+
+	return loopback_complete((u32 *)(ptr + 8 * p->num_entries),
+				 p->num_syncpts);
+}
+
+static int loopback_submit_batch(struct tegra_vhost_cmd_msg *msg,
+		size_t size)
+{
+	u32 num_jobs = msg->params.submit_batch.num_jobs;
+	struct tegra_vhost_submit_desc *desc = (void *)(msg + 1);
+	char *end = (char *)msg + size;
+	char *ptr;
+	u32 i;
+
+	if (!(loopback_features & TEGRA_VHOST_FEATURE_SUBMIT_BATCH))
+		return -EINVAL;
+	if (num_jobs > (size - sizeof(*msg)) / sizeof(*desc))
+		return -EINVAL;
+
+	ptr = (char *)(desc + num_jobs);
+
+	for (i = 0; i < num_jobs; i++, desc++) {
+		u64 len = 8ULL * ((u64)desc->num_entries + desc->num_syncpts);
+
+		if (len > end - ptr)
+			return -EINVAL;
+		desc->ret = loopback_complete((u32 *)(ptr +
+					      8 * desc->num_entries),
+					      desc->num_syncpts);
+		ptr += len;
+	}
+
+	return 0;
+}
+
+static int loopback_read_batch(struct tegra_vhost_cmd_msg *msg, size_t size)
+{
+	u32 num = msg->params.syncpt_batch.num_syncpts;
+	u32 *ids = (u32 *)(msg + 1);
+	u32 i;
+
+	if (!(loopback_features & TEGRA_VHOST_FEATURE_SYNCPT_READ_BATCH))
+		return -EINVAL;
+	if (num > (size - sizeof(*msg)) / sizeof(u32))
+		return -EINVAL;
+
+	for (i = 0; i < num; i++) {
+		if (!loopback_pt_valid(ids[i]))
+			return -EINVAL;
+		ids[i] = loopback_syncpt[ids[i]];
+	}
+
+	return 0;
+}
+
+static int loopback_handle(struct tegra_vhost_cmd_msg *msg, size_t size)
+{
+	struct tegra_vhost_syncpt_params *sp = &msg->params.syncpt;
+	struct tegra_vhost_syncpt_intr_params *ip = &msg->params.syncpt_intr;
+	struct tegra_vhost_mutex_params *mp = &msg->params.mutex;
+	u32 i;
+
+	switch (msg->cmd) {
+	case TEGRA_VHOST_CMD_CONNECT:
+		msg->params.connect.handle = ++loopback_handles;
+		return 0;
+
+	case TEGRA_VHOST_CMD_GET_FEATURES:
+		msg->params.features.features &= loopback_features;
+		if (msg->params.features.features &
+		    TEGRA_VHOST_FEATURE_SYNCPT_PUSH)
+			loopback_push = true;
+		return 0;
+
+	case TEGRA_VHOST_CMD_SYNCPT_GET_RANGE:
+		msg->params.syncpt_range.base = 0;
+		msg->params.syncpt_range.size =
+			min_t(u32, loopback_nb_pts, LOOPBACK_MAX_SYNCPTS);
+		return 0;
+
+	case TEGRA_VHOST_CMD_SYNCPT_READ:
+		if (!loopback_pt_valid(sp->id))
+			return -EINVAL;
+		sp->val = loopback_syncpt[sp->id];
+		return 0;
+
+	case TEGRA_VHOST_CMD_SYNCPT_WRITE:
+		if (!loopback_pt_valid(sp->id))
+			return -EINVAL;
+		loopback_syncpt_set(sp->id, sp->val);
+		return 0;
+
+	case TEGRA_VHOST_CMD_SYNCPT_CPU_INCR:
+		if (!loopback_pt_valid(sp->id))
+			return -EINVAL;
+		loopback_syncpt_set(sp->id, loopback_syncpt[sp->id] + 1);
+		return 0;
+
+	case TEGRA_VHOST_CMD_WAITBASE_WRITE:
+	case TEGRA_VHOST_CMD_WAITBASE_READ:
+		if (!loopback_pt_valid(msg->params.waitbase.id))
+			return -EINVAL;
+		if (msg->cmd == TEGRA_VHOST_CMD_WAITBASE_WRITE)
+			loopback_waitbase[msg->params.waitbase.id] =
+				msg->params.waitbase.val;
+		else
+			msg->params.waitbase.val =
+				loopback_waitbase[msg->params.waitbase.id];
+		return 0;
+
+	case TEGRA_VHOST_CMD_MUTEX_TRY_LOCK:
+		if (mp->id >= LOOPBACK_MAX_MLOCKS)
+			return -EINVAL;
+		/* 0 means acquired, as with the mlock registers */
+		mp->locked = test_and_set_bit(mp->id, loopback_mlocked);
+		return 0;
+
+	case TEGRA_VHOST_CMD_MUTEX_UNLOCK:
+		if (mp->id >= LOOPBACK_MAX_MLOCKS)
+			return -EINVAL;
+		clear_bit(mp->id, loopback_mlocked);
+		return 0;
+
+	case TEGRA_VHOST_CMD_SYNCPT_ENABLE_INTR:
+		if (!loopback_pt_valid(ip->id))
+			return -EINVAL;
+		loopback_thresh[ip->id] = ip->thresh;
+		set_bit(ip->id, loopback_intr_enabled);
+		/* fire right away if the threshold has already passed */
+		if ((s32)(loopback_syncpt[ip->id] - ip->thresh) >= 0) {
+			clear_bit(ip->id, loopback_intr_enabled);
+			loopback_post(TEGRA_VHOST_EVENT_SYNCPT_INTR, ip->id,
+				      loopback_syncpt[ip->id]);
+		}
+		return 0;
+
+	case TEGRA_VHOST_CMD_SYNCPT_DISABLE_INTR:
+		if (!loopback_pt_valid(ip->id))
+			return -EINVAL;
+		clear_bit(ip->id, loopback_intr_enabled);
+		return 0;
+
+	case TEGRA_VHOST_CMD_SYNCPT_DISABLE_INTR_ALL:
+		bitmap_zero(loopback_intr_enabled, LOOPBACK_MAX_SYNCPTS);
+		return 0;
+
+	case TEGRA_VHOST_CMD_CHANNEL_ALLOC_CLIENTID:
+		msg->params.clientid.clientid = ++loopback_clientids;
+		return 0;
+
+	case TEGRA_VHOST_CMD_HOST1X_CDMA_SUBMIT:
+		return loopback_submit(msg, size);
+
+	case TEGRA_VHOST_CMD_HOST1X_CDMA_SUBMIT_BATCH:
+		return loopback_submit_batch(msg, size);
+
+	case TEGRA_VHOST_CMD_SYNCPT_READ_BATCH:
+		return loopback_read_batch(msg, size);
+
+	case TEGRA_VHOST_CMD_HOST1X_REGRDWR:
+		/* no engines behind the stand-in, reads return zero */
+		if (!msg->params.regrdwr.write)
+			for (i = 0; i < REGRDWR_ARRAY_SIZE; i++)
+				msg->params.regrdwr.regs[i] = 0;
+		return 0;
+
+	case TEGRA_VHOST_CMD_DISCONNECT:
+	case TEGRA_VHOST_CMD_ABORT:
+	case TEGRA_VHOST_CMD_SUSPEND:
+	case TEGRA_VHOST_CMD_RESUME:
+	case TEGRA_VHOST_CMD_PROD_APPLY:
+	case TEGRA_VHOST_CMD_CIL_SW_RESET:
+		return 0;
+
+	default:
+		pr_debug("%s: unhandled command %u\n", __func__, msg->cmd);
+		return -EINVAL;
+	}
+}
+
+/*
+ * May be called under the nvhost_intr syncpt spinlock, like the real
+ * transport, so it must not sleep.
+ */
+int vhost_loopback_sendrecv(struct tegra_vhost_cmd_msg *msg, size_t size)
+{
+	unsigned long flags;
+
+	if (size < sizeof(*msg))
+		return -EINVAL;
+
+	udelay(loopback_rtt_us);
+
+	spin_lock_irqsave(&loopback_lock, flags);
+	msg->ret = loopback_handle(msg, size);
+	spin_unlock_irqrestore(&loopback_lock, flags);
+
+	return 0;
+}
+
+void vhost_loopback_attach(struct nvhost_master *dev)
+{
+	loopback_dev = dev;
+	schedule_work(&loopback_work);
+}
+
+void vhost_loopback_detach(void)
+{
+	loopback_dev = NULL;
+	flush_work(&loopback_work);
+}
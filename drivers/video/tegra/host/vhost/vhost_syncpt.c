@@ -16,6 +16,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <linux/slab.h>
+
 #include "nvhost_syncpt.h"
 #include "vhost.h"
 #include "../host1x/host1x.h"
@@ -77,12 +79,58 @@ static u32 vhost_syncpt_read(u64 handle, u32 id)
 	return p->val;
 }
 
+/* ids per SYNCPT_READ_BATCH message */
+#define SYNCPT_BATCH_MAX \
+	((TEGRA_VHOST_PB_FRAME_SIZE - sizeof(struct tegra_vhost_cmd_msg)) / \
+	 sizeof(u32))
+
+/*
+ * Read up to SYNCPT_BATCH_MAX syncpoints in a single round trip.
+ * vals[] is filled in id order.
+ */
+static int vhost_syncpt_read_batch(u64 handle, const u32 *ids, u32 *vals,
+		u32 num)
+{
+	struct tegra_vhost_cmd_msg *msg;
+	size_t size = sizeof(*msg) + num * sizeof(u32);
+	u32 *payload;
+	int err;
+
+	msg = kmalloc(size, GFP_KERNEL);
+	if (!msg)
+		return -ENOMEM;
+
+	msg->cmd = TEGRA_VHOST_CMD_SYNCPT_READ_BATCH;
+	msg->handle = handle;
+	msg->ret = 0;
+	msg->params.syncpt_batch.num_syncpts = num;
+	payload = (u32 *)(msg + 1);
+	memcpy(payload, ids, num * sizeof(u32));
+
+	err = vhost_pb_sendrecv(msg, size, size);
+	if (!err && msg->ret)
+		err = -EIO;
+	if (!err)
+		memcpy(vals, payload, num * sizeof(u32));
+
+	kfree(msg);
+	return err;
+}
+
 static u32 vhost_syncpt_update_min(struct nvhost_syncpt *sp, u32 id)
 {
 	struct nvhost_master *dev = syncpt_to_dev(sp);
 	struct nvhost_virt_ctx *ctx = nvhost_get_virt_data(dev->dev);
 	u32 old, live;
 
+	atomic64_inc(&vhost_stats.syncpt_reads);
+
+	/* the server pushes every change, the shadow is already current */
+	if (ctx->features & TEGRA_VHOST_FEATURE_SYNCPT_PUSH) {
+		atomic64_inc(&vhost_stats.syncpt_cached_reads);
+		return nvhost_syncpt_read_min(sp, id);
+	}
+
 	do {
 		old = nvhost_syncpt_read_min(sp, id);
 		live = vhost_syncpt_read(ctx->handle, id);
@@ -91,6 +139,45 @@ static u32 vhost_syncpt_update_min(struct nvhost_syncpt *sp, u32 id)
 	return live;
 }
 
+static void vhost_syncpt_update_min_all(struct nvhost_syncpt *sp)
+{
+	struct nvhost_master *dev = syncpt_to_dev(sp);
+	struct nvhost_virt_ctx *ctx = nvhost_get_virt_data(dev->dev);
+	u32 base = nvhost_syncpt_pts_base(sp);
+	u32 limit = nvhost_syncpt_pts_limit(sp);
+	u32 ids[32], vals[32];
+	u32 i, n;
+
+	if (ctx->features & TEGRA_VHOST_FEATURE_SYNCPT_PUSH) {
+		atomic64_add(limit - base, &vhost_stats.syncpt_reads);
+		atomic64_add(limit - base, &vhost_stats.syncpt_cached_reads);
+		return;
+	}
+
+	if (!(ctx->features & TEGRA_VHOST_FEATURE_SYNCPT_READ_BATCH)) {
+		for (i = base; i < limit; i++)
+			vhost_syncpt_update_min(sp, i);
+		return;
+	}
+
+	BUILD_BUG_ON(ARRAY_SIZE(ids) > SYNCPT_BATCH_MAX);
+
+	while (base < limit) {
+		n = min_t(u32, limit - base, ARRAY_SIZE(ids));
+		for (i = 0; i < n; i++)
+			ids[i] = base + i;
+
+		atomic64_add(n, &vhost_stats.syncpt_reads);
+		if (WARN_ON(vhost_syncpt_read_batch(ctx->handle, ids, vals,
+						    n)))
+			return;
+
+		for (i = 0; i < n; i++)
+			atomic_set(&sp->min_val[ids[i]], vals[i]);
+		base += n;
+	}
+}
+
 static void vhost_syncpt_cpu_incr(struct nvhost_syncpt *sp, u32 id)
 {
 	struct nvhost_master *dev = syncpt_to_dev(sp);
@@ -155,6 +242,7 @@ void vhost_init_host1x_syncpt_ops(struct nvhost_syncpt_ops *ops)
 {
 	ops->reset = vhost_syncpt_reset;
 	ops->update_min = vhost_syncpt_update_min;
+	ops->update_min_all = vhost_syncpt_update_min_all;
 	ops->cpu_incr = vhost_syncpt_cpu_incr;
 	ops->mutex_try_lock = vhost_syncpt_mutex_try_lock;
 	ops->mutex_unlock_nvh = vhost_syncpt_mutex_unlock;
@@ -20,6 +20,11 @@
 #include <linux/device.h>
 #include <linux/slab.h>
 #include <linux/sched.h>
+#include <linux/uio.h>
+#include <linux/mm.h>
+#include <linux/uaccess.h>
+#include <linux/compat.h>
+#include <uapi/linux/nvhvivc_ioctl.h>
 
 #include "tegra_hv.h"
 
@@ -236,6 +241,130 @@ static ssize_t ivc_dev_write(struct file *filp, const char __user *buf,
 	return done;
 }
 
+/*
+ * Vectored variants: a frame may be gathered from (or scattered to) several
+ * iovecs, and all frames of one call are moved under a single lock hold.
+ * The IVC core only notifies on the empty/full transitions, so the peer sees
+ * at most one notification per call.
+ */
+static ssize_t ivc_dev_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	struct file *filp = iocb->ki_filp;
+	struct ivc_dev *ivcd = filp->private_data;
+	struct ivc *ivc;
+	const void *frame;
+	size_t done = 0, chunk;
+	int ret = 0;
+
+	BUG_ON(!ivcd);
+	ivc = tegra_hv_ivc_convert_cookie(ivcd->ivck);
+
+	if (!tegra_ivc_can_read(ivc)) {
+		if (filp->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+
+		ret = wait_event_interruptible(ivcd->wq,
+				tegra_ivc_can_read(ivc));
+		if (ret)
+			return ret;
+	}
+
+	mutex_lock(&ivcd->file_lock);
+	while (iov_iter_count(to) > 0) {
+		frame = tegra_ivc_read_get_next_frame(ivc);
+		if (IS_ERR(frame)) {
+			ret = PTR_ERR(frame);
+			break;
+		}
+
+		chunk = min_t(size_t, iov_iter_count(to), ivcd->qd->frame_size);
+		if (copy_to_iter(frame, chunk, to) != chunk) {
+			ret = -EFAULT;
+			break;
+		}
+
+		ret = tegra_ivc_read_advance(ivc);
+		if (ret < 0)
+			break;
+
+		done += chunk;
+	}
+	mutex_unlock(&ivcd->file_lock);
+
+	if (done == 0)
+		return ret;
+
+	return done;
+}
+
+static ssize_t ivc_dev_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	struct file *filp = iocb->ki_filp;
+	struct ivc_dev *ivcd = filp->private_data;
+	struct ivc *ivc;
+	void *frame;
+	size_t done = 0, chunk;
+	int ret = 0;
+
+	BUG_ON(!ivcd);
+	ivc = tegra_hv_ivc_convert_cookie(ivcd->ivck);
+
+	while (iov_iter_count(from) > 0) {
+
+		/* is queue full? */
+		if (!tegra_ivc_can_write(ivc)) {
+
+			/* check non-blocking mode */
+			if (filp->f_flags & O_NONBLOCK) {
+				ret = -EAGAIN;
+				break;
+			}
+
+			ret = wait_event_interruptible(ivcd->wq,
+					tegra_ivc_can_write(ivc));
+			if (ret)
+				break;
+		}
+
+		/* fill every free frame before dropping the lock */
+		mutex_lock(&ivcd->file_lock);
+		while (iov_iter_count(from) > 0) {
+			frame = tegra_ivc_write_get_next_frame(ivc);
+			if (IS_ERR(frame)) {
+				ret = PTR_ERR(frame);
+				break;
+			}
+
+			chunk = min_t(size_t, iov_iter_count(from),
+					ivcd->qd->frame_size);
+			if (copy_from_iter(frame, chunk, from) != chunk) {
+				ret = -EFAULT;
+				break;
+			}
+			memset(frame + chunk, 0, ivcd->qd->frame_size - chunk);
+
+			ret = tegra_ivc_write_advance(ivc);
+			if (ret < 0)
+				break;
+
+			done += chunk;
+		}
+		mutex_unlock(&ivcd->file_lock);
+
+		/* a full queue just means waiting again */
+		if (ret < 0 && ret != -ENOMEM)
+			break;
+		ret = 0;
+	}
+
+	iocb->ki_pos += done;
+
+	if (done == 0)
+		return ret;
+
+	return done;
+}
+
 static unsigned int ivc_dev_poll(struct file *filp, poll_table *wait)
 {
 	struct ivc_dev *ivcd = filp->private_data;
@@ -258,6 +387,185 @@ static unsigned int ivc_dev_poll(struct file *filp, poll_table *wait)
 	return mask;
 }
 
+/* offset of the rx queue in the queue pair, in the order tegra_hv set up */
+static uint32_t ivc_dev_rx_offset(struct ivc_dev *ivcd)
+{
+	struct ivc *ivc = tegra_hv_ivc_convert_cookie(ivcd->ivck);
+
+	if ((uintptr_t)ivc->rx_channel < (uintptr_t)ivc->tx_channel)
+		return 0;
+
+	return ivcd->qd->size;
+}
+
+/* the rx queue is mapped read-only; refuse to upgrade it on write fault */
+static int ivc_dev_pfn_mkwrite(struct vm_area_struct *vma,
+		struct vm_fault *vmf)
+{
+	return VM_FAULT_SIGBUS;
+}
+
+static const struct vm_operations_struct ivc_dev_vm_ops = {
+	.pfn_mkwrite	= ivc_dev_pfn_mkwrite,
+};
+
+/*
+ * Map the queue pair so that user space can read and fill frames in place,
+ * using the ADVANCE ioctls below instead of copying through read/write.
+ * Only the tx queue is writable; the rx queue, including the counters the
+ * peer publishes, is read-only and released through RX_ADVANCE.
+ */
+static int ivc_dev_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct ivc_dev *ivcd = filp->private_data;
+	uint64_t map_region_sz;
+	uint64_t ivc_area_pa, ivc_area_size;
+	uint32_t rx_offset, tx_offset;
+	uint32_t queue_size;
+	pgprot_t rx_prot;
+	int ret;
+
+	BUG_ON(!ivcd);
+
+	ret = tegra_hv_ivc_get_info(ivcd->ivck, &ivc_area_pa, &ivc_area_size);
+	if (ret < 0)
+		return ret;
+
+	/* never expose parts of a neighbouring queue */
+	queue_size = ivcd->qd->size;
+	if (!PAGE_ALIGNED(ivc_area_pa) || !PAGE_ALIGNED(queue_size)) {
+		dev_err(ivcd->device, "queue not page aligned, can't mmap\n");
+		return -EINVAL;
+	}
+
+	/* fail if userspace attempts to partially map the queue pair */
+	map_region_sz = vma->vm_end - vma->vm_start;
+	if (vma->vm_pgoff != 0 || map_region_sz != ivc_area_size)
+		return -EINVAL;
+
+	vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+	vma->vm_ops = &ivc_dev_vm_ops;
+
+	rx_offset = ivc_dev_rx_offset(ivcd);
+	tx_offset = queue_size - rx_offset;
+	rx_prot = vm_get_page_prot(vma->vm_flags & ~VM_WRITE);
+
+	if (remap_pfn_range(vma, vma->vm_start + tx_offset,
+				(ivc_area_pa + tx_offset) >> PAGE_SHIFT,
+				queue_size, vma->vm_page_prot))
+		return -EAGAIN;
+
+	if (remap_pfn_range(vma, vma->vm_start + rx_offset,
+				(ivc_area_pa + rx_offset) >> PAGE_SHIFT,
+				queue_size, rx_prot))
+		return -EAGAIN;
+
+	return 0;
+}
+
+static int ivc_dev_get_info(struct ivc_dev *ivcd,
+		struct tegra_ivc_dev_info *ivc_info)
+{
+	uint64_t pa, size;
+	int ret;
+
+	ret = tegra_hv_ivc_get_info(ivcd->ivck, &pa, &size);
+	if (ret < 0)
+		return ret;
+
+	memset(ivc_info, 0, sizeof(*ivc_info));
+	ivc_info->nframes = ivcd->qd->nframes;
+	ivc_info->frame_size = ivcd->qd->frame_size;
+	ivc_info->frame_offset = 2 * IVC_ALIGN;
+	ivc_info->queue_size = ivcd->qd->size;
+	ivc_info->map_size = size;
+	ivc_info->rx_offset = ivc_dev_rx_offset(ivcd);
+	ivc_info->tx_offset = ivcd->qd->size - ivc_info->rx_offset;
+
+	return 0;
+}
+
+static int ivc_dev_advance(struct ivc_dev *ivcd,
+		struct tegra_ivc_dev_advance *adv, bool rx)
+{
+	struct ivc *ivc = tegra_hv_ivc_convert_cookie(ivcd->ivck);
+	uint32_t i;
+	int ret = 0;
+
+	mutex_lock(&ivcd->file_lock);
+	for (i = 0; i < adv->count; i++) {
+		if (rx)
+			ret = tegra_ivc_read_advance(ivc);
+		else
+			ret = tegra_ivc_write_advance(ivc);
+		if (ret < 0)
+			break;
+	}
+	adv->pos = rx ? ivc->r_pos : ivc->w_pos;
+	mutex_unlock(&ivcd->file_lock);
+
+	/* running out of frames is reported through the count */
+	if (ret < 0 && ret != -ENOMEM)
+		return ret;
+
+	adv->count = i;
+
+	return 0;
+}
+
+static long ivc_dev_ioctl(struct file *filp, unsigned int cmd,
+		unsigned long arg)
+{
+	struct ivc_dev *ivcd = filp->private_data;
+	struct tegra_ivc_dev_info ivc_info;
+	struct tegra_ivc_dev_advance adv;
+	long ret = 0;
+
+	BUG_ON(!ivcd);
+
+	/* validate the cmd */
+	if (_IOC_TYPE(cmd) != TEGRA_IVC_IOCTL_MAGIC ||
+			_IOC_NR(cmd) > TEGRA_IVC_IOCTL_NUMBER_MAX)
+		return -ENOTTY;
+
+	switch (cmd) {
+	case TEGRA_IVC_IOCTL_GET_INFO:
+		ret = ivc_dev_get_info(ivcd, &ivc_info);
+		if (ret == 0 && copy_to_user((void __user *)arg, &ivc_info,
+					sizeof(ivc_info)))
+			ret = -EFAULT;
+		break;
+
+	case TEGRA_IVC_IOCTL_RX_ADVANCE:
+	case TEGRA_IVC_IOCTL_TX_ADVANCE:
+		if (copy_from_user(&adv, (void __user *)arg, sizeof(adv)))
+			return -EFAULT;
+		if (adv.count > ivcd->qd->nframes)
+			return -EINVAL;
+
+		ret = ivc_dev_advance(ivcd, &adv,
+				cmd == TEGRA_IVC_IOCTL_RX_ADVANCE);
+		if (ret == 0 && copy_to_user((void __user *)arg, &adv,
+					sizeof(adv)))
+			ret = -EFAULT;
+		break;
+
+	default:
+		ret = -ENOTTY;
+	}
+
+	return ret;
+}
+
+#ifdef CONFIG_COMPAT
+/* the ioctl structures have the same layout for 32-bit callers */
+static long ivc_dev_compat_ioctl(struct file *filp, unsigned int cmd,
+		unsigned long arg)
+{
+	return ivc_dev_ioctl(filp, cmd, (unsigned long)compat_ptr(arg));
+}
+#endif
+
 static const struct file_operations ivc_fops = {
 	.owner		= THIS_MODULE,
 	.open		= ivc_dev_open,
@@ -265,7 +573,14 @@ static const struct file_operations ivc_fops = {
 	.llseek		= noop_llseek,
 	.read		= ivc_dev_read,
 	.write		= ivc_dev_write,
+	.read_iter	= ivc_dev_read_iter,
+	.write_iter	= ivc_dev_write_iter,
 	.poll		= ivc_dev_poll,
+	.mmap		= ivc_dev_mmap,
+	.unlocked_ioctl	= ivc_dev_ioctl,
+#ifdef CONFIG_COMPAT
+	.compat_ioctl	= ivc_dev_compat_ioctl,
+#endif
 };
 
 static ssize_t id_show(struct device *dev,
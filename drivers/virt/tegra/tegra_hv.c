@@ -26,6 +26,9 @@
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_irq.h>
+#include <linux/hrtimer.h>
+#include <linux/debugfs.h>
+#include <linux/uaccess.h>
 
 #include <soc/tegra/chip-id.h>
 #include <linux/tegra-ivc.h>
@@ -67,6 +70,21 @@ struct hv_ivc {
 
 	char			name[16];
 	int			irq;
+
+	/*
+	 * Doorbell coalescing, see tegra_hv_ivc_set_coalescing().
+	 * notify_deferred is 0 when no doorbell is owed to the peer, else
+	 * one more than the frames transferred since it was deferred.
+	 */
+	struct hrtimer		notify_timer;
+	uint32_t		notify_max_frames;
+	uint32_t		notify_max_us;
+	atomic_t		notify_deferred;
+
+	atomic64_t		doorbells;
+	atomic64_t		irqs;
+	atomic64_t		tx_frames;
+	atomic64_t		rx_frames;
 };
 
 #define cookie_to_ivc_dev(_cookie) \
@@ -101,6 +119,8 @@ struct tegra_hv_data {
 	struct class *hv_class;
 
 	struct device_node *dev;
+
+	struct dentry *debugfs;
 };
 
 /*
@@ -110,10 +130,54 @@ struct tegra_hv_data {
  */
 static const struct tegra_hv_data *tegra_hv_data;
 
+static void ivc_ring_doorbell(struct hv_ivc *ivc)
+{
+	atomic64_inc(&ivc->doorbells);
+	hyp_raise_irq(ivc->qd->raise_irq, ivc->other_guestid);
+}
+
+static void ivc_flush_doorbell(struct hv_ivc *ivc)
+{
+	if (atomic_xchg(&ivc->notify_deferred, 0))
+		ivc_ring_doorbell(ivc);
+}
+
+static enum hrtimer_restart ivc_notify_timer_fn(struct hrtimer *timer)
+{
+	struct hv_ivc *ivc = container_of(timer, struct hv_ivc, notify_timer);
+
+	ivc_flush_doorbell(ivc);
+	return HRTIMER_NORESTART;
+}
+
 static void ivc_raise_irq(struct ivc *ivc_channel)
 {
 	struct hv_ivc *ivc = container_of(ivc_channel, struct hv_ivc, ivc);
-	hyp_raise_irq(ivc->qd->raise_irq, ivc->other_guestid);
+	uint32_t max_us = READ_ONCE(ivc->notify_max_us);
+
+	if (!max_us) {
+		ivc_ring_doorbell(ivc);
+		return;
+	}
+
+	/* the first deferred doorbell arms the time budget */
+	if (atomic_cmpxchg(&ivc->notify_deferred, 0, 1) == 0)
+		hrtimer_start(&ivc->notify_timer, ns_to_ktime(max_us * 1000ULL),
+				HRTIMER_MODE_REL);
+}
+
+/* account a frame and ring early once the frame budget is used up */
+static void ivc_frame_done(struct hv_ivc *ivc, atomic64_t *counter)
+{
+	uint32_t max_frames = READ_ONCE(ivc->notify_max_frames);
+
+	atomic64_inc(counter);
+
+	if (max_frames && atomic_add_unless(&ivc->notify_deferred, 1, 0) &&
+			atomic_read(&ivc->notify_deferred) > max_frames) {
+		hrtimer_try_to_cancel(&ivc->notify_timer);
+		ivc_flush_doorbell(ivc);
+	}
 }
 
 static const struct tegra_hv_data *get_hvd(void)
@@ -166,6 +230,8 @@ static void ivc_handle_notification(struct hv_ivc *ivc)
 static irqreturn_t ivc_dev_cookie_irq_handler(int irq, void *data)
 {
 	struct hv_ivc *ivcd = data;
+
+	atomic64_inc(&ivcd->irqs);
 	ivc_handle_notification(ivcd);
 	return IRQ_HANDLED;
 }
@@ -260,6 +326,9 @@ static int tegra_hv_add_ivc(struct tegra_hv_data *hvd,
 
 	INFO("adding ivc%u: rx_base=%lx tx_base = %lx size=%x irq = %d (%lu)\n",
 			qd->id, rx_base, tx_base, qd->size, ivc->irq, d->hwirq);
+	hrtimer_init(&ivc->notify_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ivc->notify_timer.function = ivc_notify_timer_fn;
+
 	tegra_ivc_init(&ivc->ivc, rx_base, tx_base, qd->nframes, qd->frame_size,
 			NULL, ivc_raise_irq);
 
@@ -587,6 +656,41 @@ struct tegra_hv_ivc_cookie *tegra_hv_ivc_reserve(struct device_node *dn,
 }
 EXPORT_SYMBOL(tegra_hv_ivc_reserve);
 
+/*
+ * Let doorbells to the peer lag behind the frames they announce by up to
+ * max_us, and ring early after max_frames frames (0 for no frame limit).
+ * max_us == 0 turns coalescing off and rings any doorbell still owed.
+ */
+int tegra_hv_ivc_set_coalescing(struct tegra_hv_ivc_cookie *ivck,
+		uint32_t max_frames, uint32_t max_us)
+{
+	struct hv_ivc *ivc = cookie_to_ivc_dev(ivck);
+
+	if (max_us > USEC_PER_SEC)
+		return -EINVAL;
+
+	WRITE_ONCE(ivc->notify_max_frames, max_frames);
+	WRITE_ONCE(ivc->notify_max_us, max_us);
+
+	if (!max_us) {
+		hrtimer_cancel(&ivc->notify_timer);
+		ivc_flush_doorbell(ivc);
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL(tegra_hv_ivc_set_coalescing);
+
+/* ring a deferred doorbell now, e.g. at the end of a burst */
+void tegra_hv_ivc_notify_flush(struct tegra_hv_ivc_cookie *ivck)
+{
+	struct hv_ivc *ivc = cookie_to_ivc_dev(ivck);
+
+	hrtimer_try_to_cancel(&ivc->notify_timer);
+	ivc_flush_doorbell(ivc);
+}
+EXPORT_SYMBOL(tegra_hv_ivc_notify_flush);
+
 int tegra_hv_ivc_unreserve(struct tegra_hv_ivc_cookie *ivck)
 {
 	struct hv_ivc *ivc;
@@ -599,6 +703,8 @@ int tegra_hv_ivc_unreserve(struct tegra_hv_ivc_cookie *ivck)
 
 	mutex_lock(&ivc->lock);
 	if (ivc->reserved) {
+		/* owe the peer nothing once the channel is handed back */
+		tegra_hv_ivc_set_coalescing(ivck, 0, 0);
 		if (ivc->cookie_ops)
 			ivc_release_irq(ivc);
 		ivc->cookie_ops = NULL;
@@ -616,17 +722,27 @@ EXPORT_SYMBOL(tegra_hv_ivc_unreserve);
 int tegra_hv_ivc_write(struct tegra_hv_ivc_cookie *ivck, const void *buf,
 		int size)
 {
-	struct ivc *ivc = &cookie_to_ivc_dev(ivck)->ivc;
+	struct hv_ivc *ivc = cookie_to_ivc_dev(ivck);
+	int ret;
 
-	return tegra_ivc_write(ivc, buf, size);
+	ret = tegra_ivc_write(&ivc->ivc, buf, size);
+	if (ret >= 0)
+		ivc_frame_done(ivc, &ivc->tx_frames);
+
+	return ret;
 }
 EXPORT_SYMBOL(tegra_hv_ivc_write);
 
 int tegra_hv_ivc_read(struct tegra_hv_ivc_cookie *ivck, void *buf, int size)
 {
-	struct ivc *ivc = &cookie_to_ivc_dev(ivck)->ivc;
+	struct hv_ivc *ivc = cookie_to_ivc_dev(ivck);
+	int ret;
+
+	ret = tegra_ivc_read(&ivc->ivc, buf, size);
+	if (ret >= 0)
+		ivc_frame_done(ivc, &ivc->rx_frames);
 
-	return tegra_ivc_read(ivc, buf, size);
+	return ret;
 }
 EXPORT_SYMBOL(tegra_hv_ivc_read);
 
@@ -696,17 +812,27 @@ EXPORT_SYMBOL(tegra_hv_ivc_write_get_next_frame);
 
 int tegra_hv_ivc_write_advance(struct tegra_hv_ivc_cookie *ivck)
 {
-	struct ivc *ivc = &cookie_to_ivc_dev(ivck)->ivc;
+	struct hv_ivc *ivc = cookie_to_ivc_dev(ivck);
+	int ret;
+
+	ret = tegra_ivc_write_advance(&ivc->ivc);
+	if (ret == 0)
+		ivc_frame_done(ivc, &ivc->tx_frames);
 
-	return tegra_ivc_write_advance(ivc);
+	return ret;
 }
 EXPORT_SYMBOL(tegra_hv_ivc_write_advance);
 
 int tegra_hv_ivc_read_advance(struct tegra_hv_ivc_cookie *ivck)
 {
-	struct ivc *ivc = &cookie_to_ivc_dev(ivck)->ivc;
+	struct hv_ivc *ivc = cookie_to_ivc_dev(ivck);
+	int ret;
 
-	return tegra_ivc_read_advance(ivc);
+	ret = tegra_ivc_read_advance(&ivc->ivc);
+	if (ret == 0)
+		ivc_frame_done(ivc, &ivc->rx_frames);
+
+	return ret;
 }
 EXPORT_SYMBOL(tegra_hv_ivc_read_advance);
 
@@ -716,6 +842,24 @@ struct ivc *tegra_hv_ivc_convert_cookie(struct tegra_hv_ivc_cookie *ivck)
 }
 EXPORT_SYMBOL(tegra_hv_ivc_convert_cookie);
 
+/*
+ * Physical location of a queue pair: both directions are laid out back to
+ * back starting at qd->offset in the area shared with the peer.
+ */
+int tegra_hv_ivc_get_info(struct tegra_hv_ivc_cookie *ivck, uint64_t *pa,
+		uint64_t *size)
+{
+	struct hv_ivc *ivc = cookie_to_ivc_dev(ivck);
+	const struct tegra_hv_data *hvd = ivc->hvd;
+	uint32_t area = ivc->givci - hvd->guest_ivc_info;
+
+	*pa = hvd->info->areas[area].pa + ivc->qd->offset;
+	*size = (uint64_t)ivc->qd->size * 2;
+
+	return 0;
+}
+EXPORT_SYMBOL(tegra_hv_ivc_get_info);
+
 struct tegra_hv_ivm_cookie *tegra_hv_mempool_reserve(unsigned id)
 {
 	uint32_t i;
@@ -780,6 +924,106 @@ void tegra_hv_ivc_channel_reset(struct tegra_hv_ivc_cookie *ivck)
 }
 EXPORT_SYMBOL(tegra_hv_ivc_channel_reset);
 
+static int ivc_stats_show(struct seq_file *s, void *data)
+{
+	const struct tegra_hv_data *hvd = s->private;
+	const struct hv_ivc *ivc;
+	uint32_t i;
+
+	seq_puts(s, "queue  peer        irqs   doorbells   tx frames   rx frames  coalescing\n");
+	for (i = 0; i <= hvd->max_qid; i++) {
+		ivc = &hvd->ivc_devs[i];
+		if (!ivc->valid)
+			continue;
+		seq_printf(s, "%5u %5d %11lld %11lld %11lld %11lld  ",
+				i, ivc->other_guestid,
+				(long long)atomic64_read(&ivc->irqs),
+				(long long)atomic64_read(&ivc->doorbells),
+				(long long)atomic64_read(&ivc->tx_frames),
+				(long long)atomic64_read(&ivc->rx_frames));
+		if (ivc->notify_max_us)
+			seq_printf(s, "%u us/%u frames", ivc->notify_max_us,
+					ivc->notify_max_frames);
+		else
+			seq_puts(s, "off");
+		seq_putc(s, '\n');
+	}
+
+	return 0;
+}
+
+static int ivc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ivc_stats_show, inode->i_private);
+}
+
+static const struct file_operations ivc_stats_fops = {
+	.open		= ivc_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* "<queue id> <max frames> <max us>" configures a reserved queue */
+static ssize_t ivc_coalesce_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	const struct tegra_hv_data *hvd = file_inode(file)->i_private;
+	struct hv_ivc *ivc;
+	uint32_t id, max_frames, max_us;
+	char buf[48];
+	int ret;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	if (sscanf(buf, "%u %u %u", &id, &max_frames, &max_us) != 3)
+		return -EINVAL;
+
+	ivc = ivc_device_by_id(hvd, id);
+	if (ivc == NULL)
+		return -ENODEV;
+
+	mutex_lock(&ivc->lock);
+	if (!ivc->reserved) {
+		ret = -EINVAL;
+	} else {
+		ret = tegra_hv_ivc_set_coalescing(&ivc->cookie, max_frames,
+				max_us);
+	}
+	mutex_unlock(&ivc->lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations ivc_coalesce_fops = {
+	.write		= ivc_coalesce_write,
+	.llseek		= noop_llseek,
+};
+
+static int __init tegra_hv_debugfs_init(void)
+{
+	struct tegra_hv_data *hvd = (struct tegra_hv_data *)tegra_hv_data;
+
+	if (!hvd)
+		return 0;
+
+	hvd->debugfs = debugfs_create_dir("tegra_hv", NULL);
+	if (IS_ERR_OR_NULL(hvd->debugfs))
+		return 0;
+
+	debugfs_create_file("ivc_stats", S_IRUGO, hvd->debugfs, hvd,
+			&ivc_stats_fops);
+	debugfs_create_file("ivc_coalesce", S_IWUSR, hvd->debugfs, hvd,
+			&ivc_coalesce_fops);
+
+	return 0;
+}
+
 core_initcall(tegra_hv_init);
+late_initcall(tegra_hv_debugfs_init);
 
 MODULE_LICENSE("GPL");
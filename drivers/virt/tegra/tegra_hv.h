@@ -15,4 +15,11 @@
 const struct ivc_info_page *tegra_hv_get_ivc_info(void);
 int tegra_hv_get_vmid(void);
 
+struct tegra_hv_ivc_cookie;
+int tegra_hv_ivc_get_info(struct tegra_hv_ivc_cookie *ivck, uint64_t *pa,
+		uint64_t *size);
+int tegra_hv_ivc_set_coalescing(struct tegra_hv_ivc_cookie *ivck,
+		uint32_t max_frames, uint32_t max_us);
+void tegra_hv_ivc_notify_flush(struct tegra_hv_ivc_cookie *ivck);
+
 #endif /* __TEGRA_HV_H__ */
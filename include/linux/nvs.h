@@ -474,6 +474,25 @@ struct nvs_fn_if {
 	int (*suspend)(void *handle);
 	int (*resume)(void *handle);
 	int (*handler)(void *handle, void *buffer, s64 ts);
+/**
+ * handler_batch - push a drained hardware FIFO
+ * @handle: NVS handle from probe
+ * @buffer: n samples, each in the same layout passed to handler
+ * @n: number of samples in buffer (oldest first)
+ * @ts: timestamp of the newest sample, typically the nvs_timestamp
+ *      taken at the FIFO watermark interrupt.  0 = now.
+ * @lost: number of samples the hardware dropped before this batch
+ *        (FIFO overflow), 0 if none.
+ *
+ * Returns the number of bytes consumed from buffer or a negative
+ * error code.
+ *
+ * The timestamps of the older samples are reconstructed from the
+ * previous push and ts.  May be NULL for kernel interfaces that
+ * don't support it, in which case handler is called per sample.
+ */
+	int (*handler_batch)(void *handle, void *buffer, unsigned int n,
+			     s64 ts, unsigned int lost);
 };
 
 extern const char * const nvs_float_significances[];
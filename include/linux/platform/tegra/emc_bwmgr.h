@@ -74,6 +74,7 @@ enum tegra_bwmgr_client_id {
 	TEGRA_BWMGR_CLIENT_DEBUG,
 	TEGRA_BWMGR_CLIENT_DLA0,
 	TEGRA_BWMGR_CLIENT_DLA1,
+	TEGRA_BWMGR_CLIENT_PREDICT,
 	TEGRA_BWMGR_CLIENT_COUNT /* Should always be last */
 };
 
@@ -86,6 +87,13 @@ enum tegra_bwmgr_request_type {
 	TEGRA_BWMGR_SET_EMC_REQ_COUNT /* Should always be last */
 };
 
+/* demand sources feeding the predictive EMC governor */
+enum tegra_bwmgr_predict_src {
+	TEGRA_BWMGR_PREDICT_SRC_ACTMON, /* actmon average activity */
+	TEGRA_BWMGR_PREDICT_SRC_BWMGR, /* aggregated client bw requests */
+	TEGRA_BWMGR_PREDICT_SRC_COUNT /* Should always be last */
+};
+
 enum bwmgr_dram_types {
 	DRAM_TYPE_NONE,
 	DRAM_TYPE_LPDDR4_16CH_ECC,
@@ -393,4 +401,19 @@ static inline int tegra_bwmgr_notifier_unregister(struct notifier_block *nb)
 }
 
 #endif /* CONFIG_TEGRA_BWMGR */
+
+#if defined(CONFIG_TEGRA_BWMGR_PREDICT)
+/**
+ * tegra_bwmgr_predict_sample - feed a demand sample to the predictive
+ *			EMC governor. Safe to call from any context.
+ *
+ * @src		source of the sample from tegra_bwmgr_predict_src
+ * @rate	demanded EMC rate in Hz
+ */
+void tegra_bwmgr_predict_sample(enum tegra_bwmgr_predict_src src,
+		unsigned long rate);
+#else
+static inline void tegra_bwmgr_predict_sample(
+		enum tegra_bwmgr_predict_src src, unsigned long rate) {}
+#endif /* CONFIG_TEGRA_BWMGR_PREDICT */
 #endif /* __EMC_BWMGR_H */
@@ -64,8 +64,21 @@ enum {
 	TEGRA_VHOST_CMD_RESUME,
 	TEGRA_VHOST_CMD_PROD_APPLY, /* WAR */
 	TEGRA_VHOST_CMD_CIL_SW_RESET, /* WAR */
+	TEGRA_VHOST_CMD_GET_FEATURES,
+	TEGRA_VHOST_CMD_SYNCPT_READ_BATCH,
+	TEGRA_VHOST_CMD_HOST1X_CDMA_SUBMIT_BATCH,
 };
 
+/*
+ * Optional protocol features. The client sends the features it supports
+ * with TEGRA_VHOST_CMD_GET_FEATURES and the server answers with the subset
+ * it enables for that handle. Servers that predate the command reject it,
+ * which leaves all features off.
+ */
+#define TEGRA_VHOST_FEATURE_SYNCPT_READ_BATCH	(1ULL << 0)
+#define TEGRA_VHOST_FEATURE_SUBMIT_BATCH	(1ULL << 1)
+#define TEGRA_VHOST_FEATURE_SYNCPT_PUSH		(1ULL << 2)
+
 struct tegra_vhost_connect_params {
 	u32 module;
 	u64 handle;
@@ -110,6 +123,36 @@ struct tegra_vhost_channel_submit_params {
 	u32 timeout;
 };
 
+struct tegra_vhost_features_params {
+	u64 features;
+};
+
+/*
+ * Sent on the PB queue, followed by num_syncpts u32 syncpoint ids which
+ * the server overwrites with the current values.
+ */
+struct tegra_vhost_syncpt_batch_params {
+	u32 num_syncpts;
+};
+
+/*
+ * Sent on the PB queue, followed by num_jobs descriptors and then, for each
+ * job in order, num_entries opcode/data pairs and num_syncpts id/fence pairs.
+ * ret in the descriptor reports the result for that job.
+ */
+struct tegra_vhost_channel_submit_batch_params {
+	u32 num_jobs;
+};
+
+struct tegra_vhost_submit_desc {
+	u32 clientid;
+	u32 job_id;
+	u32 timeout;
+	u32 num_entries;
+	u32 num_syncpts;
+	int ret;
+};
+
 #define REGRDWR_ARRAY_SIZE (u32)4
 struct tegra_vhost_channel_regrdwr_params {
 	u32 moduleid;
@@ -143,13 +186,18 @@ struct tegra_vhost_cmd_msg {
 		struct tegra_vhost_channel_regrdwr_params regrdwr;
 		struct tegra_vhost_prod_apply_params prod_apply;
 		struct tegra_vhost_cil_sw_reset_params cil_sw_reset;
+		struct tegra_vhost_features_params features;
+		struct tegra_vhost_syncpt_batch_params syncpt_batch;
+		struct tegra_vhost_channel_submit_batch_params submit_batch;
 	} params;
 };
 
 enum {
 	TEGRA_VHOST_EVENT_SYNCPT_INTR = 0,
 	TEGRA_VHOST_EVENT_CHAN_TIMEOUT_INTR,
-	TEGRA_VHOST_EVENT_ABORT
+	TEGRA_VHOST_EVENT_ABORT,
+	/* only sent when TEGRA_VHOST_FEATURE_SYNCPT_PUSH is enabled */
+	TEGRA_VHOST_EVENT_SYNCPT_UPDATE,
 };
 
 struct tegra_vhost_syncpt_intr_info {
@@ -157,6 +205,11 @@ struct tegra_vhost_syncpt_intr_info {
 	u32 thresh;
 };
 
+struct tegra_vhost_syncpt_update_info {
+	u32 id;
+	u32 val;
+};
+
 struct tegra_vhost_chan_timeout_intr_info {
 	u32 module_id;
 	u32 client_id;
@@ -169,12 +222,15 @@ struct tegra_vhost_intr_msg {
 	union {
 		struct tegra_vhost_syncpt_intr_info syncpt_intr;
 		struct tegra_vhost_chan_timeout_intr_info chan_timeout;
+		struct tegra_vhost_syncpt_update_info syncpt_update;
 	} info;
 };
 
+#define TEGRA_VHOST_PB_FRAME_SIZE	4096
+
 #define TEGRA_VHOST_QUEUE_SIZES			\
 	sizeof(struct tegra_vhost_cmd_msg),	\
-	4096,					\
+	TEGRA_VHOST_PB_FRAME_SIZE,		\
 	sizeof(struct tegra_vhost_intr_msg)
 
 #endif
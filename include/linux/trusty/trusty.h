@@ -103,7 +103,7 @@ static inline void trusty_nop_init(struct trusty_nop *nop,
 	nop->args[2] = arg2;
 }
 
-void trusty_enqueue_nop(struct device *dev, struct trusty_nop *nop);
+bool trusty_enqueue_nop(struct device *dev, struct trusty_nop *nop);
 void trusty_dequeue_nop(struct device *dev, struct trusty_nop *nop);
 int is_trusty_dev_enabled(void);
 
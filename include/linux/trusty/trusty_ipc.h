@@ -23,6 +23,7 @@
 #define ERR_NOT_FOUND           (-2)
 
 struct tipc_chan;
+struct tipc_pool;
 
 struct tipc_msg_buf {
 	void *buf_va;
@@ -31,6 +32,8 @@ struct tipc_msg_buf {
 	size_t wpos;
 	size_t rpos;
 	struct list_head node;
+	struct tipc_pool *pool;	/* set if owned by a user buffer pool */
+	unsigned int pool_idx;
 };
 
 enum tipc_chan_event {
@@ -118,6 +118,26 @@ struct nvhost_set_syncpt_name_args {
 	__u32 padding;
 };
 
+/*
+ * Usermode submit: the kernel allocates a gather buffer that the client maps
+ * through mmap() on the channel fd (offset 0, gather_size bytes) together
+ * with a syncpoint reserved for it. Commands written into the buffer are
+ * submitted with NVHOST_IOCTL_CHANNEL_USERMODE_SUBMIT, which only checks the
+ * gather range and the increment count before handing it to CDMA.
+ */
+struct nvhost_usermode_setup_args {
+	__u32 gather_size;	/* in: bytes wanted, out: bytes allocated */
+	__u32 syncpt_id;	/* out: syncpoint owned by the client */
+	__u64 gather_iova;	/* out: host1x address of the gather buffer */
+};
+
+struct nvhost_usermode_submit_args {
+	__u32 offset;		/* in: byte offset of the gather in the buffer */
+	__u32 words;		/* in: length of the gather */
+	__u32 syncpt_incrs;	/* in: increments done by the gather */
+	__u32 fence;		/* out: syncpoint value once it completes */
+};
+
 struct nvhost_set_nvmap_fd_args {
 	__u32 fd;
 } __packed;
@@ -321,6 +341,11 @@ struct nvhost_channel_map_buffer_args {
 #define NVHOST_IOCTL_CHANNEL_SET_SYNCPOINT_NAME	\
 	_IOW(NVHOST_IOCTL_MAGIC, 30, struct nvhost_set_syncpt_name_args)
 
+#define NVHOST_IOCTL_CHANNEL_USERMODE_SETUP	\
+	_IOWR(NVHOST_IOCTL_MAGIC, 31, struct nvhost_usermode_setup_args)
+#define NVHOST_IOCTL_CHANNEL_USERMODE_SUBMIT	\
+	_IOWR(NVHOST_IOCTL_MAGIC, 32, struct nvhost_usermode_submit_args)
+
 #define NVHOST_IOCTL_CHANNEL_SET_ERROR_NOTIFIER  \
 	_IOWR(NVHOST_IOCTL_MAGIC, 111, struct nvhost_set_error_notifier)
 #define NVHOST_IOCTL_CHANNEL_OPEN	\
@@ -416,6 +441,14 @@ struct nvhost_characteristics {
 #define NVHOST_CHARACTERISTICS_GFILTER (1 << 0)
 #define NVHOST_CHARACTERISTICS_RESOURCE_PER_CHANNEL_INSTANCE (1 << 1)
 #define NVHOST_CHARACTERISTICS_SUPPORT_PREFENCES (1 << 2)
+/*
+ * The ctrl node can be mmap()ed read-only at offset 0 to get the shadow
+ * syncpoint value table: one __u32 per syncpoint id, holding the value the
+ * kernel last read from hardware. The shadow never runs ahead of the
+ * hardware, so a fence with (__s32)(table[id] - thresh) >= 0 is expired;
+ * otherwise it has to be waited for with NVHOST_IOCTL_CTRL_SYNCPT_WAIT.
+ */
+#define NVHOST_CHARACTERISTICS_SYNCPT_SHADOW (1 << 3)
 	__u64 flags;
 
 	__u32 num_mlocks;
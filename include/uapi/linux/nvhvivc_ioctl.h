@@ -0,0 +1,68 @@
+/*
+ * nvhvivc_ioctl.h
+ *
+ * Declarations for Tegra Hypervisor ivc character device ioctls
+ *
+ * Copyright (c) 2019 NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This file is licensed under the terms of the GNU General Public License
+ * version 2.  This program is licensed "as is" without any warranty of any
+ * kind, whether express or implied.
+ *
+ */
+#ifndef __UAPI_NVHVIVC_IOCTL_H__
+#define __UAPI_NVHVIVC_IOCTL_H__
+
+#include <uapi/linux/ioctl.h>
+#include <linux/types.h>
+
+/* ivc character device IOCTL magic number */
+#define TEGRA_IVC_IOCTL_MAGIC 0xA7
+
+/*
+ * Layout of the queue pair as seen through mmap() of /dev/ivcN.
+ *
+ * The mapping covers map_size bytes: the rx and tx queues are found at
+ * rx_offset and tx_offset. Each queue starts with the IVC channel header
+ * (w_count at byte 0, r_count at byte frame_offset / 2) followed by
+ * nframes frames of frame_size bytes starting at frame_offset.
+ */
+struct tegra_ivc_dev_info {
+	__u32 nframes;
+	__u32 frame_size;
+	__u32 frame_offset;
+	__u32 queue_size;
+	__u32 rx_offset;
+	__u32 tx_offset;
+	__u64 map_size;
+};
+
+/*
+ * in:  count - number of frames consumed (rx) or filled in (tx)
+ * out: count - number of frames the queue was actually advanced by
+ *      pos   - index of the next frame to be read (rx) or written (tx)
+ *
+ * The peer is notified at most once per call.
+ */
+struct tegra_ivc_dev_advance {
+	__u32 count;
+	__u32 pos;
+};
+
+/* IOCTL definitions */
+
+/* query the queue geometry for mmap() */
+#define TEGRA_IVC_IOCTL_GET_INFO \
+	_IOR(TEGRA_IVC_IOCTL_MAGIC, 1, struct tegra_ivc_dev_info)
+
+/* release frames read in place from the rx queue */
+#define TEGRA_IVC_IOCTL_RX_ADVANCE \
+	_IOWR(TEGRA_IVC_IOCTL_MAGIC, 2, struct tegra_ivc_dev_advance)
+
+/* publish frames written in place to the tx queue */
+#define TEGRA_IVC_IOCTL_TX_ADVANCE \
+	_IOWR(TEGRA_IVC_IOCTL_MAGIC, 3, struct tegra_ivc_dev_advance)
+
+#define TEGRA_IVC_IOCTL_NUMBER_MAX 3
+
+#endif /* __UAPI_NVHVIVC_IOCTL_H__ */
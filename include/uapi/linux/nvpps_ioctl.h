@@ -33,7 +33,7 @@ struct nvpps_version {
 #define NVPPS_VERSION_MAJOR	0
 #define NVPPS_VERSION_MINOR	1
 #define NVPPS_API_MAJOR		0
-#define NVPPS_API_MINOR		1
+#define NVPPS_API_MINOR		2
 
 struct nvpps_params {
 	__u32	evt_mode;
@@ -61,9 +61,65 @@ struct nvpps_timeevent {
 };
 
 
+/* number of events kept in the history ring, power of 2 */
+#define NVPPS_HISTORY_LEN	64
+
+/* one PPS event, seq matches nvpps_timeevent.evt_nb */
+struct nvpps_ts_sample {
+	__u32	seq;
+	__u32	reserved;
+	__u64	tsc;		/* in TSC counts */
+	__u64	ptp;
+	__u64	irq_latency;
+};
+
+/*
+ * Smoothed PTP vs TSC mapping, updated on every event:
+ *   ptp = ptp_ref + (tsc_ns - tsc_ref_ns) + (tsc_ns - tsc_ref_ns) * ppb / 1e9
+ * where tsc_ns is the TSC converted to nsec.
+ */
+struct nvpps_drift {
+	__u64	tsc_ref_ns;
+	__u64	ptp_ref;
+	__s64	ppb;		/* PTP rate relative to TSC */
+	__u32	evt_nb;		/* event tsc_ref_ns/ptp_ref were taken from */
+	__u32	nsamples;	/* intervals accepted into the estimate */
+};
+
+/*
+ * Read-only page returned by mmap() on the nvpps device. lock is odd while
+ * the kernel updates the page; readers retry if it was odd or changed
+ * across their copy. Sample for event n is at samples[n % NVPPS_HISTORY_LEN].
+ */
+struct nvpps_history_page {
+	__u32			lock;
+	__u32			evt_nb;		/* newest event */
+	__u32			count;		/* valid samples */
+	__u32			reserved;
+	__u64			tsc_res_ns;
+	struct nvpps_drift	drift;
+	struct nvpps_ts_sample	samples[NVPPS_HISTORY_LEN];
+};
+
+/*
+ * NVPPS_GETHISTORY: copy up to count events starting at start_seq into
+ * samples. On return count is the number copied, lost is the number of
+ * requested events already overwritten, next_seq is where to resume.
+ */
+struct nvpps_history {
+	__u32	start_seq;
+	__u32	count;
+	__u32	lost;
+	__u32	next_seq;
+	__u64	samples;	/* struct nvpps_ts_sample __user * */
+};
+
+
 #define NVPPS_GETVERSION	_IOR('p', 0x1, struct nvpps_version *)
 #define NVPPS_GETPARAMS		_IOR('p', 0x2, struct nvpps_params *)
 #define NVPPS_SETPARAMS		_IOW('p', 0x3, struct nvpps_params *)
 #define NVPPS_GETEVENT		_IOR('p', 0x4, struct nvpps_timeevent *)
+#define NVPPS_GETHISTORY	_IOWR('p', 0x5, struct nvpps_history)
+#define NVPPS_GETDRIFT		_IOR('p', 0x6, struct nvpps_drift)
 
 #endif /* __UAPI_NVPPS_IOCTL_H__ */
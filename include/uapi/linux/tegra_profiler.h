@@ -21,7 +21,7 @@
 #include <linux/types.h>
 
 #define QUADD_SAMPLES_VERSION	47
-#define QUADD_IO_VERSION	26
+#define QUADD_IO_VERSION	27
 
 #define QUADD_IO_VERSION_DYNAMIC_RB		5
 #define QUADD_IO_VERSION_RB_MAX_FILL_COUNT	6
@@ -45,6 +45,7 @@
 #define QUADD_IO_VERSION_FORCE_ARCH_TIMER	24
 #define QUADD_IO_VERSION_SAMPLE_ALL_TASKS	25
 #define QUADD_IO_VERSION_EXTABLES_PID		26
+#define QUADD_IO_VERSION_RB_POLL		27
 
 #define QUADD_SAMPLE_VERSION_THUMB_MODE_FLAG	17
 #define QUADD_SAMPLE_VERSION_GROUP_SAMPLES	18
@@ -439,6 +440,8 @@ enum {
 	QUADD_PARAM_IDX_SIZE_OF_RB	= 0,
 	QUADD_PARAM_IDX_EXTRA		= 1,
 	QUADD_PARAM_IDX_BT_LOWER_BOUND	= 2,
+	QUADD_PARAM_IDX_RB_COMMIT_SIZE	= 3,
+	QUADD_PARAM_IDX_RB_WAKEUP_PERCENT = 4,
 };
 
 #define QUADD_PARAM_EXTRA_GET_MMAP		(1 << 0)
@@ -535,6 +538,7 @@ enum {
 #define QUADD_COMM_CAP_EXTRA_RB_MMAP_OP		(1 << 9)
 #define QUADD_COMM_CAP_EXTRA_CPU_MASK		(1 << 10)
 #define QUADD_COMM_CAP_EXTRA_ARCH_TIMER_USR	(1 << 11)
+#define QUADD_COMM_CAP_EXTRA_RB_POLL		(1 << 12)
 
 struct quadd_comm_cap {
 	__u32	pmu:1,
@@ -560,8 +564,11 @@ struct quadd_comm_cap_for_cpu {
 enum {
 	QUADD_MOD_STATE_IDX_RB_MAX_FILL_COUNT = 0,
 	QUADD_MOD_STATE_IDX_STATUS,
+	QUADD_MOD_STATE_IDX_RB_LOST,	/* per-CPU lost samples, cpu 0..7 */
 };
 
+#define QUADD_MOD_STATE_NR_RB_LOST	8
+
 #define QUADD_MOD_STATE_STATUS_IS_ACTIVE	(1 << 0)
 #define QUADD_MOD_STATE_STATUS_IS_AUTH_OPEN	(1 << 1)
 
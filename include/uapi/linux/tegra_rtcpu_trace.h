@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#ifndef _UAPI_LINUX_TEGRA_RTCPU_TRACE_H_
+#define _UAPI_LINUX_TEGRA_RTCPU_TRACE_H_
+
+#include <linux/types.h>
+
+/*
+ * Raw RTCPU trace stream (/dev/rtcpu-trace)
+ *
+ * Every open file gets its own ring of raw trace events, each one a
+ * struct camrtc_event_struct as written by the RTCPU firmware. The ring can
+ * be consumed with read(), which only returns whole events, or by mapping
+ * it: the first page holds struct rtcpu_trace_stream_header and the events
+ * start at data_offset.
+ *
+ * head and tail are free running event counters. The driver advances head
+ * after new events have been written, the reader advances tail once it is
+ * done with them. Events that do not fit into the ring are dropped and
+ * counted in dropped.
+ */
+
+#define RTCPU_TRACE_STREAM_VERSION	1
+
+struct rtcpu_trace_stream_header {
+	__u32 version;
+	__u32 entry_size;
+	__u32 entry_count;
+	__u32 data_offset;
+	__u32 head;
+	__u32 tail;
+	__u64 dropped;
+};
+
+#endif
@@ -29,6 +29,8 @@
 	_IOWR(TE_IOCTL_MAGIC_NUMBER, 0x11, union te_cmd)
 #define TE_IOCTL_LAUNCH_OPERATION \
 	_IOWR(TE_IOCTL_MAGIC_NUMBER, 0x14, union te_cmd)
+#define TE_IOCTL_LAUNCH_OPERATION_BATCH \
+	_IOWR(TE_IOCTL_MAGIC_NUMBER, 0x15, struct te_launchop_batch)
 
 /* secure storage ioctl */
 #define TE_IOCTL_SS_CMD \
@@ -88,4 +90,17 @@ union te_cmd {
 	struct te_launchop	launchop;
 };
 
+/*
+ * LaunchOperation batch: ops points to count struct te_launchop, all sent
+ * to the secure world with a single SMC. Each op reports its own status
+ * through its answer. Persistent memory params are not supported here.
+ */
+#define TE_LAUNCHOP_BATCH_MAX	16
+
+struct te_launchop_batch {
+	uint64_t	ops;
+	uint32_t	count;
+	uint32_t	reserved;
+};
+
 #endif
\ No newline at end of file
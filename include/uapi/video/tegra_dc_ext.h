@@ -1378,6 +1378,41 @@ struct tegra_dc_ext_scanline_info {
 #define TEGRA_DC_EXT_CRC_GET \
 	_IOWR('D', 0x28, struct tegra_dc_ext_crc_arg)
 
+/* Retrieve the CRCs for up to TEGRA_DC_EXT_CRC_MAX_BATCH flips in one call.
+ * The call blocks until the most recent of the flips has been matched with a
+ * frame or skipped. Flips that have no CRCs in the kernel CRC buffer have all
+ * their confs returned with crc.valid cleared instead of failing the call.
+ *
+ * Returns
+ * -EINVAL   Same conditions as mentioned for TEGRA_DC_EXT_CRC_ENABLE, or if
+ *           arg.num_flips is 0 or more than TEGRA_DC_EXT_CRC_MAX_BATCH
+ * -ENODEV   Same conditions as mentioned for TEGRA_DC_EXT_CRC_ENABLE
+ * -EPERM    Same conditions as mentioned for TEGRA_DC_EXT_CRC_DISABLE
+ * -ENOTSUPP if the arg.conf.type is not supported
+ * -ETIME    if wait for the next Frame End Interrupt timed out
+ * -ENODATA  if none of the flips in arg.flip_ids has been programmed
+ */
+#define TEGRA_DC_EXT_CRC_GET_BATCH \
+	_IOWR('D', 0x29, struct tegra_dc_ext_crc_batch_arg)
+
+/* Compose a frame in software from the windows described by the caller and
+ * return CRCs over it, so that window and blend configurations can be checked
+ * on systems without a panel. RG and COMP confs return the CRC of the whole
+ * frame, RG_REGIONAL confs the CRC of the region described by conf.region.
+ * The CRC is the CRC32 of the frame's X8R8G8B8 pixels, line by line, and is
+ * not comparable with the CRCs generated by the display HW. Only available
+ * with CONFIG_TEGRA_DC_CRC_REF.
+ *
+ * Returns
+ * -EINVAL   if arg.magic or a window or region is invalid
+ * -EBADF    if a window's buff_id is not a dma-buf fd
+ * -ENOTSUPP if the IOCTL is not built in, or a window uses a pixel format,
+ *           flag or scaling the reference compositor does not model, or
+ *           arg.conf.type is TEGRA_DC_EXT_CRC_TYPE_OR
+ */
+#define TEGRA_DC_EXT_CRC_REF_GET \
+	_IOWR('D', 0x2A, struct tegra_dc_ext_crc_ref_arg)
+
 enum tegra_dc_ext_control_output_type {
 	TEGRA_DC_EXT_DSI,
 	TEGRA_DC_EXT_LVDS,
@@ -1664,6 +1699,94 @@ struct tegra_dc_ext_crc_arg {
 	__u8 reserved[32]; /* unused - must be 0 */
 } __attribute__((__packed__));
 
+#define TEGRA_DC_EXT_CRC_MAX_BATCH 64
+
+/*
+ * tegra_dc_ext_crc_batch_arg - The argument to CRC GET BATCH IOCTL
+ * @magic     - Magic bytes 'TCRC'
+ * @version   - In case the structure needs to change in future
+ * @num_conf  - Num of configuration data structures per flip
+ * @num_flips - Num of flip IDs in @flip_ids, at most
+ *              TEGRA_DC_EXT_CRC_MAX_BATCH
+ * @conf      - Pointer to an array of @num_flips * @num_conf configuration
+ *              data structures. The confs for flip_ids[i] are the @num_conf
+ *              structures starting at conf[i * @num_conf]
+ * @flip_ids  - Pointer to an array of __u64 flip IDs. U64_MAX stands for the
+ *              most recently programmed flip, as for the GET IOCTL
+ * @reserved  - Easier way to extend the data structure
+ */
+struct tegra_dc_ext_crc_batch_arg {
+	__u8 magic[4];
+	enum tegra_dc_ext_crc_arg_version version;
+	__u8 num_conf;
+	__u16 num_flips;
+	__u64 __user conf;
+	__u64 __user flip_ids;
+	__u8 reserved[32]; /* unused - must be 0 */
+} __attribute__((__packed__));
+
+/*
+ * tegra_dc_ext_crc_ref_win - A window of a software composed frame
+ * @buff_id      - dma-buf fd of the window surface
+ * @offset       - Byte offset of the surface's first line in the dma-buf
+ * @stride       - Bytes per line of the surface
+ * @pixformat    - TEGRA_DC_EXT_FMT_T_A8R8G8B8, _T_A8B8G8R8, _T_X8R8G8B8 or
+ *                 _T_X8B8G8R8 with TEGRA_DC_EXT_FMT_BYTEORDER_NOSWAP. The
+ *                 surface is pitch linear
+ * @blend        - TEGRA_DC_EXT_BLEND_*
+ * @x, @y        - Origin of the source rectangle in the surface, in pixels
+ * @out_x .. h   - Destination rectangle in the frame. The source rectangle
+ *                 has the same size, since scaling is not modelled
+ * @z            - Blend depth. Windows with a lower depth are composed over
+ *                 windows with a higher depth
+ * @global_alpha - Constant alpha (K1) applied by the blender
+ * @reserved     - Easier way to extend the data structure
+ */
+struct tegra_dc_ext_crc_ref_win {
+	__s32 buff_id;
+	__u32 offset;
+	__u32 stride;
+	__u32 pixformat;
+	__u32 blend;
+	__u16 x;
+	__u16 y;
+	__u16 out_x;
+	__u16 out_y;
+	__u16 out_w;
+	__u16 out_h;
+	__u8 z;
+	__u8 global_alpha;
+	__u8 reserved[16]; /* unused - must be 0 */
+} __attribute__((__packed__));
+
+/*
+ * tegra_dc_ext_crc_ref_arg - The argument to CRC REF GET IOCTL
+ * @magic      - Magic bytes 'TCRC'
+ * @version    - In case the structure needs to change in future
+ * @num_conf   - Num of valid configuration data structures in @conf
+ * @num_wins   - Num of windows in @wins, at most TEGRA_DC_EXT_N_WINDOWS
+ * @width      - Width of the frame. 0 selects the active width of the
+ *               current mode of the head
+ * @height     - Height of the frame. 0 selects the active height of the
+ *               current mode of the head
+ * @background - X8R8G8B8 color of the pixels not covered by any window
+ * @conf       - Pointer to an array of tegra_dc_ext_crc_conf
+ * @wins       - Pointer to an array of tegra_dc_ext_crc_ref_win
+ * @reserved   - Easier way to extend the data structure
+ */
+struct tegra_dc_ext_crc_ref_arg {
+	__u8 magic[4];
+	enum tegra_dc_ext_crc_arg_version version;
+	__u8 num_conf;
+	__u8 num_wins;
+	__u16 width;
+	__u16 height;
+	__u32 background;
+	__u64 __user conf;
+	__u64 __user wins;
+	__u8 reserved[32]; /* unused - must be 0 */
+} __attribute__((__packed__));
+
 #define TEGRA_DC_EXT_CONTROL_GET_NUM_OUTPUTS \
 	_IOR('C', 0x00, __u32)
 #define TEGRA_DC_EXT_CONTROL_GET_OUTPUT_PROPERTIES \
@@ -26,6 +26,10 @@
 #include <linux/sched.h>
 #include <linux/mm.h>
 #include <linux/pagemap.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/ote_protocol.h>
 #include <asm/smp_plat.h>
 
@@ -36,6 +40,66 @@ core_param(verbose_smc, verbose_smc, bool, 0644);
 
 #define SET_RESULT(req, r, ro)	{ req->result = r; req->result_origin = ro; }
 
+/* request latency histogram, bucket n counts [2^n, 2^(n+1)) usecs */
+#define TLK_LAT_BUCKETS		16
+
+struct tlk_smc_stats {
+	u64 world_switches;
+	u64 smc_calls;
+	u64 batches;
+	u64 batched_reqs;
+	u64 batch_fallbacks;
+	u64 reqs;
+	u64 lat_min_ns;
+	u64 lat_max_ns;
+	u64 lat_sum_ns;
+	u64 lat_hist[TLK_LAT_BUCKETS];
+};
+
+static struct tlk_smc_stats smc_stats = { .lat_min_ns = U64_MAX };
+static DEFINE_SPINLOCK(smc_stats_lock);
+
+/* set once the secure world rejects TE_SMC_LAUNCH_BATCH */
+static bool batch_unsupported;
+
+static void tlk_stats_req_done(uint32_t nreqs, ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	unsigned int bucket = 0;
+	unsigned long flags;
+
+	if (ns >= NSEC_PER_USEC)
+		bucket = min_t(unsigned int, ilog2(div_u64(ns, NSEC_PER_USEC)),
+			       TLK_LAT_BUCKETS - 1);
+
+	/* batched requests all complete when the batch SMC returns */
+	spin_lock_irqsave(&smc_stats_lock, flags);
+	smc_stats.reqs += nreqs;
+	smc_stats.lat_sum_ns += ns * nreqs;
+	smc_stats.lat_hist[bucket] += nreqs;
+	if (ns < smc_stats.lat_min_ns)
+		smc_stats.lat_min_ns = ns;
+	if (ns > smc_stats.lat_max_ns)
+		smc_stats.lat_max_ns = ns;
+	spin_unlock_irqrestore(&smc_stats_lock, flags);
+}
+
+static uint32_t tlk_world_switch(uint32_t arg0, uintptr_t arg1,
+				 uintptr_t arg2)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&smc_stats_lock, flags);
+	smc_stats.world_switches++;
+	spin_unlock_irqrestore(&smc_stats_lock, flags);
+
+#ifdef CONFIG_TRUSTED_LITTLE_KERNEL_MOCK
+	return ote_mock_smc(arg0, arg1, arg2);
+#else
+	return _tlk_generic_smc(arg0, arg1, arg2);
+#endif
+}
+
 static struct te_session *te_get_session(struct tlk_context *context,
 					uint32_t session_id)
 {
@@ -90,13 +154,13 @@ static long tlk_generic_smc_on_cpu0(void *args)
 	uint32_t retval;
 
 	work = (struct tlk_smc_work_args *)args;
-	retval = _tlk_generic_smc(work->arg0, work->arg1, work->arg2);
+	retval = tlk_world_switch(work->arg0, work->arg1, work->arg2);
 
 	while (retval == TE_ERROR_PREEMPT_BY_IRQ ||
 	       retval == TE_ERROR_PREEMPT_BY_FS) {
 		if (retval == TE_ERROR_PREEMPT_BY_FS)
 			callback_status = tlk_ss_op();
-		retval = _tlk_generic_smc(TE_SMC_RESTART, callback_status, 0);
+		retval = tlk_world_switch(TE_SMC_RESTART, callback_status, 0);
 	}
 
 	/* Print TLK logs if any */
@@ -118,6 +182,11 @@ uint32_t tlk_send_smc(uint32_t arg0, uintptr_t arg1, uintptr_t arg2)
 {
 	long ret;
 	struct tlk_smc_work_args work_args;
+	unsigned long flags;
+
+	spin_lock_irqsave(&smc_stats_lock, flags);
+	smc_stats.smc_calls++;
+	spin_unlock_irqrestore(&smc_stats_lock, flags);
 
 	work_args.arg0 = arg0;
 	work_args.arg1 = arg1;
@@ -159,6 +228,7 @@ static void do_smc(struct te_request *request, struct tlk_device *dev)
 	uint32_t smc_args;
 	uint32_t smc_params = 0;
 	uint32_t retval = 0;
+	ktime_t start;
 
 	smc_args = (uintptr_t)request - (uintptr_t)dev->req_addr;
 	if (request->params) {
@@ -166,7 +236,9 @@ static void do_smc(struct te_request *request, struct tlk_device *dev)
 			(uintptr_t)request->params - (uintptr_t)dev->req_addr;
 	}
 
+	start = ktime_get();
 	retval = tlk_send_smc(request->type, smc_args, smc_params);
+	tlk_stats_req_done(1, start);
 
 	/**
 	 * Check for return code from TLK kernel and propagate to NS userspace
@@ -186,6 +258,86 @@ static void do_smc(struct te_request *request, struct tlk_device *dev)
 	}
 }
 
+/*
+ * Do a single SMC for count consecutive requests, falling back to one SMC
+ * per request if the secure world doesn't know about batches.
+ */
+static void do_smc_batch(struct te_request *requests, uint32_t count,
+			 struct tlk_device *dev)
+{
+	uint64_t params_va[TE_LAUNCHOP_BATCH_MAX];
+	struct te_request *request;
+	uint32_t i, nreqs = 0;
+	uint32_t retval;
+	unsigned long flags;
+	ktime_t start;
+
+	for (i = 0; i < count; i++)
+		if (requests[i].type)
+			nreqs++;
+
+	if (!nreqs)
+		return;
+
+	if (!batch_unsupported) {
+		/*
+		 * Only the array offset goes in the SMC, so the secure world
+		 * finds each params array through the request itself: make
+		 * those offsets into the shared buffer too, as do_smc() does.
+		 */
+		for (i = 0; i < count; i++) {
+			request = requests + i;
+			params_va[i] = request->params;
+			if (request->type && request->params)
+				request->params = (uintptr_t)request->params -
+						  (uintptr_t)dev->req_addr;
+		}
+
+		start = ktime_get();
+		retval = tlk_send_smc(TE_SMC_LAUNCH_BATCH,
+			(uintptr_t)requests - (uintptr_t)dev->req_addr, count);
+
+		for (i = 0; i < count; i++)
+			requests[i].params = params_va[i];
+
+		if (retval != TE_ERROR_UNKNOWN_SMC &&
+		    retval != OTE_ERROR_NOT_IMPLEMENTED &&
+		    retval != OTE_ERROR_NOT_SUPPORTED) {
+			tlk_stats_req_done(nreqs, start);
+
+			spin_lock_irqsave(&smc_stats_lock, flags);
+			smc_stats.batches++;
+			smc_stats.batched_reqs += nreqs;
+			spin_unlock_irqrestore(&smc_stats_lock, flags);
+
+			/* same propagation as do_smc(), per request */
+			for (i = 0; i < count; i++) {
+				request = requests + i;
+				if (request->type &&
+				    (retval != OTE_SUCCESS) &&
+				    (request->result == OTE_SUCCESS)) {
+					request->result = retval;
+					request->result_origin =
+						OTE_RESULT_ORIGIN_KERNEL;
+				}
+			}
+			return;
+		}
+
+		pr_info("%s: secure world has no batch support (0x%x)\n",
+			__func__, retval);
+		batch_unsupported = true;
+	}
+
+	spin_lock_irqsave(&smc_stats_lock, flags);
+	smc_stats.batch_fallbacks++;
+	spin_unlock_irqrestore(&smc_stats_lock, flags);
+
+	for (i = 0; i < count; i++)
+		if (requests[i].type)
+			do_smc(requests + i, dev);
+}
+
 void tlk_restore_keyslots(void)
 {
 	uint32_t retval;
@@ -353,6 +505,159 @@ error:
 	te_release_mem_buffers(&session->inactive_persist_shmem_list);
 }
 
+/*
+ * Launch a batch of operations with a single SMC. requests are consecutive
+ * in the shared request buffer; entries already carrying an error result
+ * are skipped.
+ */
+void te_launch_operation_batch(struct te_launchop *cmds,
+			      struct te_request *requests, uint32_t count,
+			      struct tlk_context *context)
+{
+	struct te_session *sessions[TE_LAUNCHOP_BATCH_MAX] = { NULL };
+	struct te_oper_param *params;
+	struct te_request *request;
+	uint32_t i, j, p;
+	int ret;
+
+	for (i = 0; i < count; i++) {
+		request = requests + i;
+		if (request->result)
+			goto skip;
+
+		sessions[i] = te_get_session(context, cmds[i].session_id);
+		if (!sessions[i]) {
+			pr_info("%s: session_id not found: 0x%x\n",
+				__func__, cmds[i].session_id);
+			SET_RESULT(request, OTE_ERROR_BAD_PARAMETERS,
+					OTE_RESULT_ORIGIN_API);
+			goto skip;
+		}
+
+		/* persistent buffers can't be attributed to one op here */
+		params = (struct te_oper_param *)(uintptr_t)request->params;
+		for (p = 0; p < request->params_size; p++) {
+			if (params[p].type == TE_PARAM_TYPE_PERSIST_MEM_RO ||
+			    params[p].type == TE_PARAM_TYPE_PERSIST_MEM_RW) {
+				SET_RESULT(request, OTE_ERROR_NOT_SUPPORTED,
+						OTE_RESULT_ORIGIN_API);
+				sessions[i] = NULL;
+				goto skip;
+			}
+		}
+
+		request->session_id = cmds[i].session_id;
+		request->command_id = cmds[i].operation.command;
+		request->type = TE_SMC_LAUNCH_OPERATION;
+
+		ret = te_prep_mem_buffers(request, sessions[i]);
+		if (ret != OTE_SUCCESS) {
+			pr_err("%s: te_prep_mem_buffers failed err (0x%x)\n",
+				__func__, ret);
+			SET_RESULT(request, ret, OTE_RESULT_ORIGIN_API);
+			/*
+			 * On failure the whole session temp list was released,
+			 * so earlier ops on this session lost their buffers.
+			 */
+			for (j = 0; j < i; j++) {
+				if (sessions[j] != sessions[i])
+					continue;
+				SET_RESULT((requests + j), OTE_ERROR_CANCEL,
+						OTE_RESULT_ORIGIN_API);
+				requests[j].type = 0;
+				sessions[j] = NULL;
+			}
+			sessions[i] = NULL;
+			goto skip;
+		}
+		continue;
+skip:
+		request->type = 0;
+	}
+
+	do_smc_batch(requests, count, context->dev);
+
+	/* release temporary mem buffers */
+	for (i = 0; i < count; i++)
+		if (sessions[i])
+			te_release_mem_buffers(&sessions[i]->temp_shmem_list);
+}
+
+static int tlk_smc_stats_show(struct seq_file *s, void *data)
+{
+	struct tlk_smc_stats stats;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&smc_stats_lock, flags);
+	stats = smc_stats;
+	spin_unlock_irqrestore(&smc_stats_lock, flags);
+
+	seq_printf(s, "world_switches  %llu\n", stats.world_switches);
+	seq_printf(s, "smc_calls       %llu\n", stats.smc_calls);
+	seq_printf(s, "batches         %llu\n", stats.batches);
+	seq_printf(s, "batched_reqs    %llu\n", stats.batched_reqs);
+	seq_printf(s, "batch_fallbacks %llu\n", stats.batch_fallbacks);
+	seq_printf(s, "batch_support   %d\n", !batch_unsupported);
+	seq_printf(s, "reqs            %llu\n", stats.reqs);
+	if (stats.reqs) {
+		seq_printf(s, "lat_min_ns      %llu\n", stats.lat_min_ns);
+		seq_printf(s, "lat_avg_ns      %llu\n",
+			   div64_u64(stats.lat_sum_ns, stats.reqs));
+		seq_printf(s, "lat_max_ns      %llu\n", stats.lat_max_ns);
+	}
+	seq_puts(s, "lat_hist_us\n");
+	for (i = 0; i < TLK_LAT_BUCKETS; i++)
+		seq_printf(s, "  >=%-6u %llu\n", 1U << i, stats.lat_hist[i]);
+
+	return 0;
+}
+
+static int tlk_smc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tlk_smc_stats_show, inode->i_private);
+}
+
+/* any write clears the counters */
+static ssize_t tlk_smc_stats_write(struct file *file,
+				   const char __user *buf, size_t count,
+				   loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&smc_stats_lock, flags);
+	memset(&smc_stats, 0, sizeof(smc_stats));
+	smc_stats.lat_min_ns = U64_MAX;
+	spin_unlock_irqrestore(&smc_stats_lock, flags);
+
+	return count;
+}
+
+static const struct file_operations tlk_smc_stats_fops = {
+	.open = tlk_smc_stats_open,
+	.read = seq_read,
+	.write = tlk_smc_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+int tlk_smc_stats_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("tlk", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return -ENODEV;
+
+	if (!debugfs_create_file("smc_stats", 0644, dir, NULL,
+				 &tlk_smc_stats_fops)) {
+		debugfs_remove_recursive(dir);
+		return -ENODEV;
+	}
+
+	return 0;
+}
+
 /*
  * Command to open a session with the trusted app.
  * This API should only be called from the kernel space.
@@ -165,6 +165,37 @@ struct te_cmd_req_desc *te_get_free_cmd_desc(struct tlk_device *dev)
 	return cmd_desc;
 }
 
+/*
+ * Get count free cmd descs whose requests are consecutive in the shared
+ * request buffer, as needed for a batch SMC. Returns the first request.
+ */
+struct te_request *te_get_free_cmd_descs(struct tlk_device *dev,
+	struct te_cmd_req_desc **cmd_descs, unsigned int count)
+{
+	DECLARE_BITMAP(busy, TE_CMD_DESC_MAX);
+	struct te_cmd_req_desc *cmd_desc, *tmp_cmd_desc;
+	unsigned long idx, start;
+
+	bitmap_fill(busy, TE_CMD_DESC_MAX);
+	list_for_each_entry(cmd_desc, &(dev->free_cmd_list), list)
+		clear_bit(cmd_desc->req_addr - dev->req_addr, busy);
+
+	start = bitmap_find_next_zero_area(busy, TE_CMD_DESC_MAX, 0, count, 0);
+	if (start >= TE_CMD_DESC_MAX)
+		return NULL;
+
+	list_for_each_entry_safe(cmd_desc, tmp_cmd_desc,
+			&(dev->free_cmd_list), list) {
+		idx = cmd_desc->req_addr - dev->req_addr;
+		if (idx < start || idx >= start + count)
+			continue;
+		list_move_tail(&cmd_desc->list, &(dev->used_cmd_list));
+		cmd_descs[idx - start] = cmd_desc;
+	}
+
+	return dev->req_addr + start;
+}
+
 void te_put_used_cmd_desc(struct tlk_device *dev,
 	struct te_cmd_req_desc *cmd_desc)
 {
@@ -509,6 +540,118 @@ error:
 	return err;
 }
 
+static long te_handle_batch_ioctl(struct file *file,
+	unsigned long ioctl_param)
+{
+	long err = 0;
+	uint32_t i, count;
+	struct te_launchop_batch batch;
+	struct te_launchop *cmds = NULL;
+	struct te_operation *operation;
+	struct te_request *requests, *request;
+	struct te_answer answer;
+	struct te_cmd_req_desc *cmd_descs[TE_LAUNCHOP_BATCH_MAX] = { NULL };
+	struct te_oper_param *params[TE_LAUNCHOP_BATCH_MAX] = { NULL };
+	struct te_oper_param *caller_params[TE_LAUNCHOP_BATCH_MAX] = { NULL };
+	struct tlk_context *context = file->private_data;
+	struct tlk_device *dev = context->dev;
+
+	if (copy_from_user(&batch, (void __user *)ioctl_param,
+				sizeof(batch))) {
+		pr_err("Failed to copy batch request\n");
+		return -EFAULT;
+	}
+
+	count = batch.count;
+	if (!count || count > TE_LAUNCHOP_BATCH_MAX)
+		return -EINVAL;
+
+	cmds = kmalloc_array(count, sizeof(*cmds), GFP_KERNEL);
+	if (!cmds)
+		return -ENOMEM;
+
+	if (copy_from_user(cmds, (void __user *)(uintptr_t)batch.ops,
+				count * sizeof(*cmds))) {
+		pr_err("Failed to copy batch ops\n");
+		err = -EFAULT;
+		goto error;
+	}
+
+	requests = te_get_free_cmd_descs(dev, cmd_descs, count);
+	if (!requests) {
+		pr_err("%s: failed to get %u cmd_descs\n", __func__, count);
+		err = -EBUSY;
+		goto error;
+	}
+
+	for (i = 0; i < count; i++) {
+		operation = &cmds[i].operation;
+		request = requests + i;
+		memset(request, 0, sizeof(struct te_request));
+
+		params[i] = te_get_free_params(dev, operation->list_count);
+		if (operation->list_count && !params[i]) {
+			pr_err("failed to get params\n");
+			request->result = OTE_ERROR_OUT_OF_MEMORY;
+			request->result_origin = OTE_RESULT_ORIGIN_COMMS;
+			continue;
+		}
+
+		request->params = (uintptr_t)params[i];
+		request->params_size = operation->list_count;
+
+		if (operation->list_count > 0) {
+			caller_params[i] = kmalloc(sizeof(struct te_oper_param) *
+					operation->list_count, GFP_KERNEL);
+			if (!caller_params[i]) {
+				err = -ENOMEM;
+				goto error;
+			}
+		}
+
+		if (copy_params_from_user(request, operation,
+					caller_params[i])) {
+			pr_err("%s: failed to copy params from user\n",
+				__func__);
+			err = -EFAULT;
+			goto error;
+		}
+	}
+
+	te_launch_operation_batch(cmds, requests, count, context);
+
+	for (i = 0; i < count; i++) {
+		request = requests + i;
+
+		memset(&answer, 0, sizeof(struct te_answer));
+		SET_ANSWER(answer, request->result, request->result_origin);
+		if (copy_to_user((void __user *)(uintptr_t)cmds[i].answer,
+				&answer, sizeof(struct te_answer))) {
+			pr_err("Failed to copy answer\n");
+			err = -EFAULT;
+			continue;
+		}
+
+		if (request->params && copy_params_to_user(request,
+				&cmds[i].operation, caller_params[i])) {
+			pr_err("Failed to copy return params\n");
+			err = -EFAULT;
+		}
+	}
+
+error:
+	for (i = 0; i < count; i++) {
+		if (cmd_descs[i])
+			te_put_used_cmd_desc(dev, cmd_descs[i]);
+		if (params[i])
+			te_put_free_params(dev, params[i],
+				cmds[i].operation.list_count);
+		kfree(caller_params[i]);
+	}
+	kfree(cmds);
+	return err;
+}
+
 static long tlk_device_ioctl(struct file *file, unsigned int ioctl_num,
 	unsigned long ioctl_param)
 {
@@ -523,6 +666,12 @@ static long tlk_device_ioctl(struct file *file, unsigned int ioctl_num,
 		mutex_unlock(&smc_lock);
 		break;
 
+	case TE_IOCTL_LAUNCH_OPERATION_BATCH:
+		mutex_lock(&smc_lock);
+		err = te_handle_batch_ioctl(file, ioctl_param);
+		mutex_unlock(&smc_lock);
+		break;
+
 	case TE_IOCTL_SS_CMD:
 		err = te_handle_ss_ioctl(file, ioctl_num, ioctl_param);
 		break;
@@ -552,6 +701,10 @@ int te_is_secos_dev_enabled(void)
 	static int tlk_dev_status = 0;
 	struct device_node *node = NULL;
 
+	/* the mock secure world stands in for a missing TLK node */
+	if (IS_ENABLED(CONFIG_TRUSTED_LITTLE_KERNEL_MOCK))
+		return 1;
+
 	if (unlikely(tlk_dev_status == 0)) {
 		node = get_tlk_device_node();
 		tlk_dev_status = (node && of_device_is_available(node));
@@ -655,7 +808,8 @@ static struct platform_driver tlk_driver = {
 
 static int __init tlk_driver_init(void)
 {
-	if (get_tlk_device_node()) {
+	if (get_tlk_device_node() ||
+	    IS_ENABLED(CONFIG_TRUSTED_LITTLE_KERNEL_MOCK)) {
 		int ret;
 
 		INIT_LIST_HEAD(&(tlk_dev.used_cmd_list));
@@ -688,6 +842,9 @@ static int __init tlk_driver_misc_init(void)
 	if (ret)
 		pr_err("%s: misc_register failed: %d\n", __func__, ret);
 
+	if (tlk_smc_stats_init())
+		pr_warn("%s: no SMC stats in debugfs\n", __func__);
+
 	return ret;
 }
 
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2019 NVIDIA Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Stand-in for the TLK secure world, so the request, batch and session
+ * handling of the NS driver can be exercised on parts without TrustZone.
+ * Every SMC is answered in place; INT_RW params are incremented so the
+ * round trip is visible to the caller.
+ */
+
+#include <linux/module.h>
+#include <linux/delay.h>
+#include <linux/printk.h>
+
+#include "ote_protocol.h"
+
+/* emulated cost of one world switch */
+static uint mock_smc_delay_us = 5;
+module_param(mock_smc_delay_us, uint, 0644);
+
+/* answer TE_SMC_LAUNCH_BATCH like an older TLK would */
+static bool mock_no_batch;
+module_param(mock_no_batch, bool, 0644);
+
+static struct te_request *mock_req_base;
+static uint32_t mock_next_session_id;
+
+/*
+ * params_off is where the request's params array sits relative to the
+ * registered request buffer: the third SMC argument for a single request,
+ * the request's own params field inside a batch.
+ */
+static void mock_handle_request(struct te_request *request,
+				uintptr_t params_off)
+{
+	struct te_oper_param *params;
+	uint32_t i;
+
+	switch (request->type) {
+	case TE_SMC_OPEN_SESSION:
+		request->session_id = ++mock_next_session_id;
+		break;
+
+	case TE_SMC_CLOSE_SESSION:
+		break;
+
+	case TE_SMC_LAUNCH_OPERATION:
+		if (!params_off)
+			break;
+		params = (struct te_oper_param *)
+			((uintptr_t)mock_req_base + params_off);
+		for (i = 0; i < request->params_size; i++)
+			if (params[i].type == TE_PARAM_TYPE_INT_RW)
+				params[i].u.Int.val++;
+		break;
+
+	default:
+		request->result = OTE_ERROR_NOT_SUPPORTED;
+		request->result_origin = OTE_RESULT_ORIGIN_KERNEL;
+		return;
+	}
+
+	request->result = OTE_SUCCESS;
+	request->result_origin = OTE_RESULT_ORIGIN_TRUSTED_APP;
+}
+
+uint32_t ote_mock_smc(uint32_t arg0, uintptr_t arg1, uintptr_t arg2)
+{
+	struct te_request *request;
+	uint32_t i;
+
+	udelay(mock_smc_delay_us);
+
+	switch (arg0) {
+	case TE_SMC_REGISTER_REQ_BUF:
+		mock_req_base = (struct te_request *)arg1;
+		return OTE_SUCCESS;
+
+	case TE_SMC_OPEN_SESSION:
+	case TE_SMC_CLOSE_SESSION:
+	case TE_SMC_LAUNCH_OPERATION:
+		if (!mock_req_base)
+			return OTE_ERROR_BAD_STATE;
+		request = (struct te_request *)((uintptr_t)mock_req_base + arg1);
+		mock_handle_request(request, arg2);
+		return OTE_SUCCESS;
+
+	case TE_SMC_LAUNCH_BATCH:
+		if (mock_no_batch)
+			return TE_ERROR_UNKNOWN_SMC;
+		if (!mock_req_base)
+			return OTE_ERROR_BAD_STATE;
+		request = (struct te_request *)((uintptr_t)mock_req_base + arg1);
+		for (i = 0; i < arg2; i++, request++)
+			if (request->type)
+				mock_handle_request(request,
+						    (uintptr_t)request->params);
+		return OTE_SUCCESS;
+
+	case TE_SMC_TA_EVENT:
+		return OTE_SUCCESS;
+
+	default:
+		/* no logger, VPR or FIQ glue behind the mock */
+		pr_debug("%s: unhandled SMC 0x%x\n", __func__, arg0);
+		return TE_ERROR_UNKNOWN_SMC;
+	}
+}
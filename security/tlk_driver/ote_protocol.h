@@ -46,6 +46,8 @@ struct te_oper_param *te_get_free_params(struct tlk_device *dev,
 void te_put_free_params(struct tlk_device *dev,
 	struct te_oper_param *params, uint32_t nparams);
 struct te_cmd_req_desc *te_get_free_cmd_desc(struct tlk_device *dev);
+struct te_request *te_get_free_cmd_descs(struct tlk_device *dev,
+	struct te_cmd_req_desc **cmd_descs, unsigned int count);
 void te_put_used_cmd_desc(struct tlk_device *dev,
 	struct te_cmd_req_desc *cmd_desc);
 
@@ -53,6 +55,7 @@ void te_put_used_cmd_desc(struct tlk_device *dev,
 enum {
 	TE_ERROR_PREEMPT_BY_IRQ = 0xFFFFFFFD,
 	TE_ERROR_PREEMPT_BY_FS = 0xFFFFFFFE,
+	TE_ERROR_UNKNOWN_SMC = 0xFFFFFFFF,
 };
 
 struct tlk_device {
@@ -114,6 +117,11 @@ enum {
 	TE_SMC_CLOSE_SESSION		= 0x70000002,
 	TE_SMC_LAUNCH_OPERATION		= 0x70000003,
 	TE_SMC_TA_EVENT			= 0x70000004,
+	/*
+	 * arg1: offset of the first of arg2 consecutive requests; entries
+	 * with type 0 were failed by the NS side and must be skipped.
+	 */
+	TE_SMC_LAUNCH_BATCH		= 0x70000005,
 
 	/* Trusted OS (64-bit) calls */
 	TE_SMC_REGISTER_REQ_BUF		= 0x72000001,
@@ -189,6 +197,16 @@ void te_launch_operation(struct te_launchop *cmd,
 	struct te_request *request,
 	struct tlk_context *context);
 
+void te_launch_operation_batch(struct te_launchop *cmds,
+	struct te_request *requests, uint32_t count,
+	struct tlk_context *context);
+
+int tlk_smc_stats_init(void);
+
+#ifdef CONFIG_TRUSTED_LITTLE_KERNEL_MOCK
+uint32_t ote_mock_smc(uint32_t arg0, uintptr_t arg1, uintptr_t arg2);
+#endif
+
 enum ta_event_id {
 	TA_EVENT_RESTORE_KEYS = 0,
 
@@ -50,4 +50,9 @@
 #define TEGRA210_PEQ_SHIFT_PARAM_SIZE_PER_CH \
 	(2 + TEGRA210_PEQ_MAX_BIQUAD_STAGES)
 
+/* Default PEQ filter parameters, in tegra210_peq_alt.c */
+extern const int tegra210_peq_biquad_init_stage;
+extern const u32 tegra210_peq_biquad_init_gains[TEGRA210_PEQ_GAIN_PARAM_SIZE_PER_CH];
+extern const u32 tegra210_peq_biquad_init_shifts[TEGRA210_PEQ_SHIFT_PARAM_SIZE_PER_CH];
+
 #endif
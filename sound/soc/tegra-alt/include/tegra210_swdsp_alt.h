@@ -0,0 +1,121 @@
+/*
+ * tegra210_swdsp_alt.h - Definitions for Tegra210 AHUB software DSP engine
+ *
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TEGRA210_SWDSP_ALT_H__
+#define __TEGRA210_SWDSP_ALT_H__
+
+/*
+ * Software models of the MIXER, SFC, MVC and PEQ AHUB modules. Samples are
+ * interleaved S32 frames, as seen on the AHUB CIF, and all parameters use
+ * the fixed point formats programmed into the hardware by the drivers.
+ * They are linked into the benchmark module only; the AHUB drivers never
+ * route audio through them.
+ *
+ * Include after tegra210_mixer_alt.h, tegra210_mvc_alt.h and
+ * tegra210_peq_alt.h.
+ */
+
+#define TEGRA210_SWDSP_MAX_CHANNELS		16
+
+/* MIXER: gains are Q16, 0x10000 is unity and 0x20000 is the maximum */
+#define TEGRA210_SWDSP_MIXER_GAIN_UNITY		0x10000
+#define TEGRA210_SWDSP_MIXER_GAIN_MAX		0x20000
+
+struct tegra210_swdsp_mixer {
+	unsigned int channels;
+	unsigned int num_inputs;
+	u32 gain[TEGRA210_MIXER_AXBAR_RX_MAX];
+};
+
+void tegra210_swdsp_mixer_init(struct tegra210_swdsp_mixer *mixer,
+			       unsigned int channels, unsigned int num_inputs);
+int tegra210_swdsp_mixer_set_gain(struct tegra210_swdsp_mixer *mixer,
+				  unsigned int input, u32 gain);
+void tegra210_swdsp_mixer_process(const struct tegra210_swdsp_mixer *mixer,
+				  const s32 * const *in, s32 *out,
+				  unsigned int frames);
+
+/*
+ * SFC: 4-point cubic (Farrow) interpolation between any two of the rates
+ * the SFC supports. The output lags the input by two frames; these stay
+ * in the history until more input arrives.
+ */
+struct tegra210_swdsp_sfc {
+	unsigned int channels;
+	unsigned int in_rate;
+	unsigned int out_rate;
+	u64 step;
+	u64 phase;
+	s32 hist[TEGRA210_SWDSP_MAX_CHANNELS][4];
+};
+
+int tegra210_swdsp_sfc_rate_index(unsigned int rate);
+int tegra210_swdsp_sfc_init(struct tegra210_swdsp_sfc *sfc,
+			    unsigned int channels, unsigned int in_rate,
+			    unsigned int out_rate);
+unsigned int tegra210_swdsp_sfc_max_out_frames(
+		const struct tegra210_swdsp_sfc *sfc, unsigned int in_frames);
+unsigned int tegra210_swdsp_sfc_process(struct tegra210_swdsp_sfc *sfc,
+					const s32 *in, unsigned int in_frames,
+					s32 *out, unsigned int out_frames,
+					unsigned int *consumed);
+
+/*
+ * MVC: volume takes the TEGRA210_MVC_TARGET_VOL register value, i.e.
+ * 0-100 in Q24 for CURVE_POLY and -120dB to +40dB in Q8 for CURVE_LINEAR.
+ * The resulting gain is Q24 and is ramped linearly over ramp_frames.
+ */
+struct tegra210_swdsp_mvc {
+	unsigned int channels;
+	int curve_type;
+	bool mute;
+	s32 volume;
+	u32 gain;
+	u32 target_gain;
+	unsigned int ramp_left;
+};
+
+u32 tegra210_swdsp_mvc_db_to_gain(s32 db_q8);
+void tegra210_swdsp_mvc_init(struct tegra210_swdsp_mvc *mvc,
+			     unsigned int channels, int curve_type);
+void tegra210_swdsp_mvc_set_volume(struct tegra210_swdsp_mvc *mvc,
+				   s32 volume, unsigned int ramp_frames);
+void tegra210_swdsp_mvc_process(struct tegra210_swdsp_mvc *mvc,
+				const s32 *in, s32 *out, unsigned int frames);
+
+/*
+ * PEQ: gains and shifts use the layout of the PEQ gain and shift RAM of
+ * one channel (pre-gain, b0 b1 b2 a1 a2 per band, post-gain) and apply to
+ * all channels.
+ */
+struct tegra210_swdsp_peq {
+	unsigned int channels;
+	unsigned int stages;
+	s32 gains[TEGRA210_PEQ_GAIN_PARAM_SIZE_PER_CH];
+	u32 shifts[TEGRA210_PEQ_SHIFT_PARAM_SIZE_PER_CH];
+	s32 state[TEGRA210_SWDSP_MAX_CHANNELS]
+		 [TEGRA210_PEQ_MAX_BIQUAD_STAGES][4];
+};
+
+int tegra210_swdsp_peq_init(struct tegra210_swdsp_peq *peq,
+			    unsigned int channels, unsigned int stages,
+			    const s32 *gains, const u32 *shifts);
+void tegra210_swdsp_peq_process(struct tegra210_swdsp_peq *peq,
+				const s32 *in, s32 *out, unsigned int frames);
+
+#endif
@@ -42,11 +42,15 @@ static const struct reg_default tegra210_peq_reg_defaults[] = {
 	{ TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_SHIFT_CTRL, 0x00004000},
 };
 
-/* Default PEQ filter parameters for a 5-stage biquad*/
-static const int biquad_init_stage = 5;
-static const u32 biquad_init_gains[TEGRA210_PEQ_GAIN_PARAM_SIZE_PER_CH] = {
+/*
+ * Default PEQ filter parameters for a 5-stage biquad, also loaded into
+ * the software PEQ model by the swdsp benchmark
+ */
+const int tegra210_peq_biquad_init_stage = 5;
+EXPORT_SYMBOL_GPL(tegra210_peq_biquad_init_stage);
+const u32 tegra210_peq_biquad_init_gains[TEGRA210_PEQ_GAIN_PARAM_SIZE_PER_CH] = {
 	1495012349, /* pre-gain */
-	/* Gains : b0, b1, a0, a1, a2 */
+	/* Gains : b0, b1, b2, a1, a2 */
 	536870912, -1073741824, 536870912, 2143508246, -1069773768, /* band-0 */
 	134217728, -265414508, 131766272, 2140402222, -1071252997, /* band-1 */
 	268435456, -233515765, -33935948, 1839817267, -773826124, /* band-2 */
@@ -61,12 +65,14 @@ static const u32 biquad_init_gains[TEGRA210_PEQ_GAIN_PARAM_SIZE_PER_CH] = {
 	1, 0, 0, 0, 0, /* band-11 */
 	963423114, /* post-gain */
 };
+EXPORT_SYMBOL_GPL(tegra210_peq_biquad_init_gains);
 
-static const u32 biquad_init_shifts[TEGRA210_PEQ_SHIFT_PARAM_SIZE_PER_CH] = {
+const u32 tegra210_peq_biquad_init_shifts[TEGRA210_PEQ_SHIFT_PARAM_SIZE_PER_CH] = {
 	23, /* pre-shift */
 	30, 30, 30, 30, 30, 0, 0, 0, 0, 0, 0, 0, /* shift for bands */
 	28, /* post-shift */
 };
+EXPORT_SYMBOL_GPL(tegra210_peq_biquad_init_shifts);
 
 static s32 biquad_coeff_buffer[TEGRA210_PEQ_GAIN_PARAM_SIZE_PER_CH];
 
@@ -338,7 +344,7 @@ int tegra210_peq_codec_init(struct snd_soc_codec *codec)
 		0 << TEGRA210_PEQ_CONFIG_MODE_SHIFT);
 	regmap_update_bits(ope->peq_regmap, TEGRA210_PEQ_CONFIG,
 		TEGRA210_PEQ_CONfIG_BIQUAD_STAGES_MASK,
-		(biquad_init_stage - 1) <<
+		(tegra210_peq_biquad_init_stage - 1) <<
 		TEGRA210_PEQ_CONFIG_BIQUAD_STAGES_SHIFT);
 
 	/* Initialize PEQ AHUB RAM with default params */
@@ -348,7 +354,7 @@ int tegra210_peq_codec_init(struct snd_soc_codec *codec)
 			TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_CTRL,
 			TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_DATA,
 			(i * TEGRA210_PEQ_GAIN_PARAM_SIZE_PER_CH),
-			(u32 *)&biquad_init_gains,
+			(u32 *)&tegra210_peq_biquad_init_gains,
 			TEGRA210_PEQ_GAIN_PARAM_SIZE_PER_CH);
 
 		/* Set default shift params */
@@ -356,7 +362,7 @@ int tegra210_peq_codec_init(struct snd_soc_codec *codec)
 			TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_SHIFT_CTRL,
 			TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_SHIFT_DATA,
 			(i * TEGRA210_PEQ_SHIFT_PARAM_SIZE_PER_CH),
-			(u32 *)&biquad_init_shifts,
+			(u32 *)&tegra210_peq_biquad_init_shifts,
 			TEGRA210_PEQ_SHIFT_PARAM_SIZE_PER_CH);
 	}
 	pm_runtime_put_sync(codec->dev);
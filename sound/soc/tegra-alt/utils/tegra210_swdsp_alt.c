@@ -0,0 +1,356 @@
+/*
+ * tegra210_swdsp_alt.c - Tegra210 AHUB software DSP models for the benchmark
+ *
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/regmap.h>
+#include <linux/string.h>
+#include <sound/soc.h>
+
+#include "tegra210_xbar_alt.h"
+#include "tegra210_mixer_alt.h"
+#include "tegra210_mvc_alt.h"
+#include "tegra210_peq_alt.h"
+#include "tegra210_swdsp_alt.h"
+
+/* Mixer inputs are accumulated over blocks of this many samples */
+#define SWDSP_MIXER_BLOCK		64
+
+#define SWDSP_MVC_GAIN_UNITY		(1 << 24)
+#define SWDSP_MVC_MIN_DB_Q8		(-120 << 8)
+#define SWDSP_MVC_MAX_DB_Q8		(40 << 8)
+
+#define SWDSP_SFC_PHASE_ONE		(1ULL << 32)
+
+static inline s32 swdsp_sat(s64 val)
+{
+	return clamp_t(s64, val, S32_MIN, S32_MAX);
+}
+
+void tegra210_swdsp_mixer_init(struct tegra210_swdsp_mixer *mixer,
+			       unsigned int channels, unsigned int num_inputs)
+{
+	unsigned int i;
+
+	mixer->channels = clamp_t(unsigned int, channels, 1,
+				  TEGRA210_SWDSP_MAX_CHANNELS);
+	mixer->num_inputs = clamp_t(unsigned int, num_inputs, 1,
+				    TEGRA210_MIXER_AXBAR_RX_MAX);
+	for (i = 0; i < TEGRA210_MIXER_AXBAR_RX_MAX; i++)
+		mixer->gain[i] = TEGRA210_SWDSP_MIXER_GAIN_UNITY;
+}
+
+int tegra210_swdsp_mixer_set_gain(struct tegra210_swdsp_mixer *mixer,
+				  unsigned int input, u32 gain)
+{
+	if (input >= TEGRA210_MIXER_AXBAR_RX_MAX ||
+	    gain > TEGRA210_SWDSP_MIXER_GAIN_MAX)
+		return -EINVAL;
+
+	mixer->gain[input] = gain;
+	return 0;
+}
+
+/*
+ * Each input is streamed into a small accumulator block in turn, which
+ * keeps the gain in a register and the inner loop free of branches.
+ */
+void tegra210_swdsp_mixer_process(const struct tegra210_swdsp_mixer *mixer,
+				  const s32 * const *in, s32 *out,
+				  unsigned int frames)
+{
+	unsigned int samples = frames * mixer->channels;
+	s64 acc[SWDSP_MIXER_BLOCK];
+	unsigned int base, len, i, j;
+
+	for (base = 0; base < samples; base += len) {
+		len = min_t(unsigned int, samples - base, SWDSP_MIXER_BLOCK);
+
+		for (i = 0; i < len; i++)
+			acc[i] = (s64)in[0][base + i] * mixer->gain[0];
+
+		for (j = 1; j < mixer->num_inputs; j++) {
+			const s32 *src = in[j] + base;
+			s64 gain = mixer->gain[j];
+
+			for (i = 0; i < len; i++)
+				acc[i] += src[i] * gain;
+		}
+
+		for (i = 0; i < len; i++)
+			out[base + i] = swdsp_sat(acc[i] >> 16);
+	}
+}
+
+/* Indexed by TEGRA210_SFC_FS* */
+static const unsigned int tegra210_swdsp_sfc_rates[] = {
+	8000, 11025, 16000, 22050, 24000, 32000, 44100,
+	48000, 64000, 88200, 96000, 176400, 192000,
+};
+
+int tegra210_swdsp_sfc_rate_index(unsigned int rate)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tegra210_swdsp_sfc_rates); i++)
+		if (tegra210_swdsp_sfc_rates[i] == rate)
+			return i;
+
+	return -EINVAL;
+}
+
+int tegra210_swdsp_sfc_init(struct tegra210_swdsp_sfc *sfc,
+			    unsigned int channels, unsigned int in_rate,
+			    unsigned int out_rate)
+{
+	if (!channels || channels > TEGRA210_SWDSP_MAX_CHANNELS)
+		return -EINVAL;
+	if (tegra210_swdsp_sfc_rate_index(in_rate) < 0 ||
+	    tegra210_swdsp_sfc_rate_index(out_rate) < 0)
+		return -EINVAL;
+
+	memset(sfc, 0, sizeof(*sfc));
+	sfc->channels = channels;
+	sfc->in_rate = in_rate;
+	sfc->out_rate = out_rate;
+	sfc->step = div_u64((u64)in_rate << 32, out_rate);
+	/* Fill the history up to the first input frame before interpolating */
+	sfc->phase = 3 * SWDSP_SFC_PHASE_ONE;
+
+	return 0;
+}
+
+unsigned int tegra210_swdsp_sfc_max_out_frames(
+		const struct tegra210_swdsp_sfc *sfc, unsigned int in_frames)
+{
+	return div_u64((u64)(in_frames + 1) * sfc->out_rate,
+		       sfc->in_rate) + 1;
+}
+
+/*
+ * Catmull-Rom interpolation between x[1] and x[2], t in Q16. The
+ * polynomial coefficients are kept doubled so they stay integers.
+ */
+static inline s32 swdsp_sfc_cubic(const s32 *x, s64 t)
+{
+	s64 c1 = (s64)x[2] - x[0];
+	s64 c2 = 2 * (s64)x[0] - 5 * (s64)x[1] + 4 * (s64)x[2] - x[3];
+	s64 c3 = (s64)x[3] - x[0] + 3 * ((s64)x[1] - x[2]);
+	s64 acc;
+
+	acc = (c3 * t) >> 16;
+	acc = ((acc + c2) * t) >> 16;
+	acc = ((acc + c1) * t) >> 16;
+
+	return swdsp_sat(x[1] + (acc >> 1));
+}
+
+/*
+ * Returns the number of output frames written. Input frames that did not
+ * fit into out are not consumed, see *consumed.
+ */
+unsigned int tegra210_swdsp_sfc_process(struct tegra210_swdsp_sfc *sfc,
+					const s32 *in, unsigned int in_frames,
+					s32 *out, unsigned int out_frames,
+					unsigned int *consumed)
+{
+	const unsigned int channels = sfc->channels;
+	unsigned int i = 0, o = 0, c;
+	s64 t;
+
+	while (o < out_frames) {
+		while (sfc->phase >= SWDSP_SFC_PHASE_ONE) {
+			if (i == in_frames)
+				goto done;
+
+			for (c = 0; c < channels; c++) {
+				s32 *h = sfc->hist[c];
+
+				h[0] = h[1];
+				h[1] = h[2];
+				h[2] = h[3];
+				h[3] = in[i * channels + c];
+			}
+			i++;
+			sfc->phase -= SWDSP_SFC_PHASE_ONE;
+		}
+
+		t = sfc->phase >> 16;
+		for (c = 0; c < channels; c++)
+			out[o * channels + c] = swdsp_sfc_cubic(sfc->hist[c], t);
+		o++;
+		sfc->phase += sfc->step;
+	}
+
+done:
+	if (consumed)
+		*consumed = i;
+
+	return o;
+}
+
+/* 2^(k/16) in Q30 */
+static const u32 swdsp_exp2_table[17] = {
+	1073741824, 1121280436, 1170923762, 1222764986, 1276901417,
+	1333434672, 1392470869, 1454120821, 1518500250, 1585730000,
+	1655936265, 1729250827, 1805811301, 1885761398, 1969251188,
+	2056437387, 2147483648,
+};
+
+/* Converts a CURVE_LINEAR volume (dB in Q8) to a Q24 gain */
+u32 tegra210_swdsp_mvc_db_to_gain(s32 db_q8)
+{
+	s32 exponent, n;
+	u32 frac, lo, hi, m;
+
+	db_q8 = clamp_t(s32, db_q8, SWDSP_MVC_MIN_DB_Q8, SWDSP_MVC_MAX_DB_Q8);
+
+	/* gain = 2^exponent, exponent = dB * log2(10) / 20 in Q16 */
+	exponent = (db_q8 * 10885) >> 8;
+	n = exponent >> 16;
+	frac = exponent & 0xffff;
+
+	lo = swdsp_exp2_table[frac >> 12];
+	hi = swdsp_exp2_table[(frac >> 12) + 1];
+	m = lo + (u32)(((u64)(hi - lo) * (frac & 0xfff)) >> 12);
+
+	/* n is within [-20, 6] for the clamped range */
+	return m >> (6 - n);
+}
+
+void tegra210_swdsp_mvc_init(struct tegra210_swdsp_mvc *mvc,
+			     unsigned int channels, int curve_type)
+{
+	memset(mvc, 0, sizeof(*mvc));
+	mvc->channels = clamp_t(unsigned int, channels, 1,
+				TEGRA210_SWDSP_MAX_CHANNELS);
+	mvc->curve_type = curve_type;
+	tegra210_swdsp_mvc_set_volume(mvc, curve_type == CURVE_POLY ?
+			TEGRA210_MVC_INIT_VOL_DEFAULT_POLY :
+			TEGRA210_MVC_INIT_VOL_DEFAULT_LINEAR, 0);
+}
+
+/*
+ * The hardware maps CURVE_POLY volumes through the poly_coeff curve, which
+ * is not modelled; the volume is treated as a linear percentage instead.
+ */
+void tegra210_swdsp_mvc_set_volume(struct tegra210_swdsp_mvc *mvc,
+				   s32 volume, unsigned int ramp_frames)
+{
+	mvc->volume = volume;
+	if (mvc->curve_type == CURVE_POLY)
+		mvc->target_gain = clamp_t(s32, volume, 0, 100 << 24) / 100;
+	else
+		mvc->target_gain = tegra210_swdsp_mvc_db_to_gain(volume);
+
+	mvc->ramp_left = ramp_frames;
+	if (!ramp_frames)
+		mvc->gain = mvc->target_gain;
+}
+
+void tegra210_swdsp_mvc_process(struct tegra210_swdsp_mvc *mvc,
+				const s32 *in, s32 *out, unsigned int frames)
+{
+	const unsigned int channels = mvc->channels;
+	unsigned int samples = frames * channels;
+	unsigned int i = 0, c;
+	s64 gain;
+
+	if (mvc->mute) {
+		memset(out, 0, samples * sizeof(*out));
+		return;
+	}
+
+	for (; mvc->ramp_left && i < samples; i += channels) {
+		s64 delta = (s64)mvc->target_gain - mvc->gain;
+
+		mvc->gain += div_s64(delta, mvc->ramp_left--);
+		gain = mvc->gain;
+		for (c = 0; c < channels; c++)
+			out[i + c] = swdsp_sat((in[i + c] * gain) >> 24);
+	}
+
+	gain = mvc->gain;
+	if (gain == SWDSP_MVC_GAIN_UNITY) {
+		if (in != out)
+			memcpy(out + i, in + i, (samples - i) * sizeof(*out));
+		return;
+	}
+
+	for (; i < samples; i++)
+		out[i] = swdsp_sat((in[i] * gain) >> 24);
+}
+
+int tegra210_swdsp_peq_init(struct tegra210_swdsp_peq *peq,
+			    unsigned int channels, unsigned int stages,
+			    const s32 *gains, const u32 *shifts)
+{
+	if (!channels || channels > TEGRA210_SWDSP_MAX_CHANNELS ||
+	    !stages || stages > TEGRA210_PEQ_MAX_BIQUAD_STAGES)
+		return -EINVAL;
+
+	memset(peq, 0, sizeof(*peq));
+	peq->channels = channels;
+	peq->stages = stages;
+	memcpy(peq->gains, gains, sizeof(peq->gains));
+	memcpy(peq->shifts, shifts, sizeof(peq->shifts));
+
+	return 0;
+}
+
+/*
+ * Direct form I biquads, y = (b0 x + b1 x1 + b2 x2 + a1 y1 + a2 y2) >> shift,
+ * between the pre and post gain stages. Channels are filtered one at a time,
+ * which keeps the state of the whole cascade of a channel together.
+ */
+void tegra210_swdsp_peq_process(struct tegra210_swdsp_peq *peq,
+				const s32 *in, s32 *out, unsigned int frames)
+{
+	const unsigned int channels = peq->channels;
+	const s32 *gains = peq->gains;
+	const u32 *shifts = peq->shifts;
+	s64 pre_gain = gains[0];
+	s64 post_gain = gains[TEGRA210_PEQ_GAIN_PARAM_SIZE_PER_CH - 1];
+	u32 pre_shift = shifts[0];
+	u32 post_shift = shifts[TEGRA210_PEQ_SHIFT_PARAM_SIZE_PER_CH - 1];
+	unsigned int c, f, s, i;
+
+	for (c = 0; c < channels; c++) {
+		for (f = 0, i = c; f < frames; f++, i += channels) {
+			s32 x = swdsp_sat((in[i] * pre_gain) >> pre_shift);
+
+			for (s = 0; s < peq->stages; s++) {
+				const s32 *b = &gains[1 + s * 5];
+				s32 *st = peq->state[c][s];
+				s64 acc;
+
+				acc = (s64)b[0] * x + (s64)b[1] * st[0] +
+				      (s64)b[2] * st[1] + (s64)b[3] * st[2] +
+				      (s64)b[4] * st[3];
+
+				st[1] = st[0];
+				st[0] = x;
+				st[3] = st[2];
+				st[2] = swdsp_sat(acc >> shifts[1 + s]);
+				x = st[2];
+			}
+
+			out[i] = swdsp_sat((x * post_gain) >> post_shift);
+		}
+	}
+}
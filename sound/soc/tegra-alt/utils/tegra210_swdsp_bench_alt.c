@@ -0,0 +1,387 @@
+/*
+ * tegra210_swdsp_bench_alt.c - Tegra210 AHUB software DSP benchmark
+ *
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * On load, the software models are checked against their pass-through
+ * configurations, and then every selected module is timed on its own for
+ * 1 to 16 channels. If more than one module is selected, the whole chain
+ * is timed as well, with the modules connected in the order they are
+ * listed, e.g.
+ *
+ *   modprobe snd-soc-tegra210-alt-swdsp-bench modules=mixer,sfc,peq,mvc
+ *
+ * Results are reported in input samples per second.
+ */
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/regmap.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <sound/soc.h>
+
+#include "tegra210_xbar_alt.h"
+#include "tegra210_mixer_alt.h"
+#include "tegra210_mvc_alt.h"
+#include "tegra210_peq_alt.h"
+#include "tegra210_swdsp_alt.h"
+
+static char *modules = "mixer,sfc,peq,mvc";
+module_param(modules, charp, 0444);
+MODULE_PARM_DESC(modules, "Modules to run, in chain order");
+
+static unsigned int frames = 4800;
+module_param(frames, uint, 0444);
+MODULE_PARM_DESC(frames, "Input frames per run");
+
+static unsigned int runs = 50;
+module_param(runs, uint, 0444);
+MODULE_PARM_DESC(runs, "Number of timed runs");
+
+static unsigned int mixer_inputs = 4;
+module_param(mixer_inputs, uint, 0444);
+MODULE_PARM_DESC(mixer_inputs, "Number of MIXER inputs");
+
+static unsigned int sfc_in_rate = 48000;
+module_param(sfc_in_rate, uint, 0444);
+MODULE_PARM_DESC(sfc_in_rate, "SFC input rate");
+
+static unsigned int sfc_out_rate = 44100;
+module_param(sfc_out_rate, uint, 0444);
+MODULE_PARM_DESC(sfc_out_rate, "SFC output rate");
+
+enum {
+	SWDSP_BENCH_MIXER,
+	SWDSP_BENCH_SFC,
+	SWDSP_BENCH_MVC,
+	SWDSP_BENCH_PEQ,
+	SWDSP_BENCH_NUM_MODULES,
+};
+
+static const char * const swdsp_bench_names[SWDSP_BENCH_NUM_MODULES] = {
+	[SWDSP_BENCH_MIXER] = "mixer",
+	[SWDSP_BENCH_SFC] = "sfc",
+	[SWDSP_BENCH_MVC] = "mvc",
+	[SWDSP_BENCH_PEQ] = "peq",
+};
+
+static const unsigned int swdsp_bench_channels[] = { 1, 2, 4, 8, 16 };
+
+struct swdsp_bench {
+	unsigned int max_frames;
+	s32 *src[TEGRA210_MIXER_AXBAR_RX_MAX];
+	s32 *buf[2];
+	struct tegra210_swdsp_mixer mixer;
+	struct tegra210_swdsp_sfc sfc;
+	struct tegra210_swdsp_mvc mvc;
+	struct tegra210_swdsp_peq peq;
+};
+
+static int swdsp_bench_parse(int *mods)
+{
+	char *list, *p, *name;
+	int nr_mods = 0, ret = 0, i, j;
+
+	list = kstrdup(modules, GFP_KERNEL);
+	if (!list)
+		return -ENOMEM;
+
+	p = list;
+	while ((name = strsep(&p, ",")) != NULL) {
+		name = strim(name);
+		if (!*name)
+			continue;
+
+		for (i = 0; i < SWDSP_BENCH_NUM_MODULES; i++)
+			if (!strcmp(name, swdsp_bench_names[i]))
+				break;
+		for (j = 0; j < nr_mods; j++)
+			if (mods[j] == i)
+				break;
+
+		if (i == SWDSP_BENCH_NUM_MODULES || j < nr_mods) {
+			pr_err("swdsp bench: invalid module list \"%s\"\n",
+			       modules);
+			ret = -EINVAL;
+			goto out;
+		}
+		mods[nr_mods++] = i;
+	}
+	ret = nr_mods ? nr_mods : -EINVAL;
+
+out:
+	kfree(list);
+	return ret;
+}
+
+static int swdsp_bench_setup(struct swdsp_bench *b, unsigned int channels)
+{
+	int ret;
+
+	tegra210_swdsp_mixer_init(&b->mixer, channels, mixer_inputs);
+
+	ret = tegra210_swdsp_sfc_init(&b->sfc, channels, sfc_in_rate,
+				      sfc_out_rate);
+	if (ret < 0)
+		return ret;
+
+	tegra210_swdsp_mvc_init(&b->mvc, channels, CURVE_LINEAR);
+	tegra210_swdsp_mvc_set_volume(&b->mvc, -6 << 8, 0);
+
+	return tegra210_swdsp_peq_init(&b->peq, channels,
+			tegra210_peq_biquad_init_stage,
+			(const s32 *)tegra210_peq_biquad_init_gains,
+			tegra210_peq_biquad_init_shifts);
+}
+
+static unsigned int swdsp_bench_run(struct swdsp_bench *b, int mod,
+				    const s32 *in, unsigned int n, s32 *out)
+{
+	const s32 *inputs[TEGRA210_MIXER_AXBAR_RX_MAX];
+	unsigned int i;
+
+	switch (mod) {
+	case SWDSP_BENCH_MIXER:
+		inputs[0] = in;
+		for (i = 1; i < b->mixer.num_inputs; i++)
+			inputs[i] = b->src[i];
+		tegra210_swdsp_mixer_process(&b->mixer, inputs, out, n);
+		return n;
+	case SWDSP_BENCH_SFC:
+		return tegra210_swdsp_sfc_process(&b->sfc, in, n, out,
+						  b->max_frames, NULL);
+	case SWDSP_BENCH_MVC:
+		tegra210_swdsp_mvc_process(&b->mvc, in, out, n);
+		return n;
+	case SWDSP_BENCH_PEQ:
+		tegra210_swdsp_peq_process(&b->peq, in, out, n);
+		return n;
+	}
+
+	return 0;
+}
+
+static u64 swdsp_bench_time(struct swdsp_bench *b, const int *mods,
+			    int nr_mods)
+{
+	u64 start, elapsed = 0;
+	unsigned int r, n;
+	const s32 *in;
+	int k;
+
+	for (r = 0; r < runs; r++) {
+		start = ktime_get_ns();
+		in = b->src[0];
+		n = frames;
+		for (k = 0; k < nr_mods; k++) {
+			n = swdsp_bench_run(b, mods[k], in, n, b->buf[k & 1]);
+			in = b->buf[k & 1];
+		}
+		elapsed += ktime_get_ns() - start;
+		cond_resched();
+	}
+
+	return elapsed;
+}
+
+static void swdsp_bench_report(const char *name, unsigned int channels,
+			       u64 elapsed)
+{
+	u64 samples = (u64)frames * channels * runs;
+
+	if (!elapsed)
+		elapsed = 1;
+
+	pr_info("swdsp bench: %-20s %2u ch: %llu samples/s, %llu ns/frame\n",
+		name, channels, div64_u64(samples * NSEC_PER_SEC, elapsed),
+		div64_u64(elapsed, (u64)frames * runs));
+}
+
+static bool swdsp_bench_same(const s32 *a, const s32 *b, unsigned int n)
+{
+	return !memcmp(a, b, n * sizeof(*a));
+}
+
+/* Each model must pass its input through unchanged in these settings */
+static int swdsp_bench_check(struct swdsp_bench *b)
+{
+	const unsigned int channels = 2;
+	const unsigned int samples = frames * channels;
+	s32 gains[TEGRA210_PEQ_GAIN_PARAM_SIZE_PER_CH] = { 0 };
+	u32 shifts[TEGRA210_PEQ_SHIFT_PARAM_SIZE_PER_CH] = { 0 };
+	const s32 *inputs[1] = { b->src[0] };
+	unsigned int n, consumed;
+	int ret = 0;
+
+	tegra210_swdsp_mixer_init(&b->mixer, channels, 1);
+	tegra210_swdsp_mixer_process(&b->mixer, inputs, b->buf[0], frames);
+	if (!swdsp_bench_same(b->src[0], b->buf[0], samples)) {
+		pr_err("swdsp bench: mixer check failed\n");
+		ret = -EINVAL;
+	}
+
+	tegra210_swdsp_sfc_init(&b->sfc, channels, 48000, 48000);
+	n = tegra210_swdsp_sfc_process(&b->sfc, b->src[0], frames, b->buf[0],
+				       b->max_frames, &consumed);
+	if (consumed != frames || n != frames - 2 ||
+	    !swdsp_bench_same(b->src[0], b->buf[0], n * channels)) {
+		pr_err("swdsp bench: sfc check failed\n");
+		ret = -EINVAL;
+	}
+
+	tegra210_swdsp_mvc_init(&b->mvc, channels, CURVE_LINEAR);
+	tegra210_swdsp_mvc_process(&b->mvc, b->src[0], b->buf[0], frames);
+	if (!swdsp_bench_same(b->src[0], b->buf[0], samples)) {
+		pr_err("swdsp bench: mvc check failed\n");
+		ret = -EINVAL;
+	}
+
+	gains[0] = 1;
+	gains[1] = 1;
+	gains[TEGRA210_PEQ_GAIN_PARAM_SIZE_PER_CH - 1] = 1;
+	tegra210_swdsp_peq_init(&b->peq, channels, 1, gains, shifts);
+	tegra210_swdsp_peq_process(&b->peq, b->src[0], b->buf[0], frames);
+	if (!swdsp_bench_same(b->src[0], b->buf[0], samples)) {
+		pr_err("swdsp bench: peq check failed\n");
+		ret = -EINVAL;
+	}
+
+	return ret;
+}
+
+static void swdsp_bench_free(struct swdsp_bench *b)
+{
+	int i;
+
+	for (i = 0; i < TEGRA210_MIXER_AXBAR_RX_MAX; i++)
+		vfree(b->src[i]);
+	vfree(b->buf[0]);
+	vfree(b->buf[1]);
+	kfree(b);
+}
+
+static struct swdsp_bench *swdsp_bench_alloc(void)
+{
+	struct tegra210_swdsp_sfc sfc;
+	struct swdsp_bench *b;
+	size_t size;
+	u32 seed = 1;
+	int i, j;
+
+	b = kzalloc(sizeof(*b), GFP_KERNEL);
+	if (!b)
+		return NULL;
+
+	tegra210_swdsp_sfc_init(&sfc, 1, sfc_in_rate, sfc_out_rate);
+	b->max_frames = max(frames,
+			    tegra210_swdsp_sfc_max_out_frames(&sfc, frames));
+	size = (size_t)b->max_frames * TEGRA210_SWDSP_MAX_CHANNELS *
+	       sizeof(s32);
+
+	for (i = 0; i < TEGRA210_MIXER_AXBAR_RX_MAX; i++) {
+		b->src[i] = vmalloc(size);
+		if (!b->src[i])
+			goto err;
+
+		/* Noise at -18dBFS, different for every input */
+		for (j = 0; j < size / sizeof(s32); j++) {
+			seed = seed * 1664525 + 1013904223;
+			b->src[i][j] = (s32)seed >> 3;
+		}
+	}
+
+	for (i = 0; i < 2; i++) {
+		b->buf[i] = vzalloc(size);
+		if (!b->buf[i])
+			goto err;
+	}
+
+	return b;
+
+err:
+	swdsp_bench_free(b);
+	return NULL;
+}
+
+static int __init tegra210_swdsp_bench_init(void)
+{
+	int mods[SWDSP_BENCH_NUM_MODULES];
+	struct swdsp_bench *b;
+	int nr_mods, ret, i, k;
+
+	if (frames < 64 || frames > 192000 || !runs)
+		return -EINVAL;
+
+	if (tegra210_swdsp_sfc_rate_index(sfc_in_rate) < 0 ||
+	    tegra210_swdsp_sfc_rate_index(sfc_out_rate) < 0) {
+		pr_err("swdsp bench: unsupported SFC rates %u -> %u\n",
+		       sfc_in_rate, sfc_out_rate);
+		return -EINVAL;
+	}
+
+	nr_mods = swdsp_bench_parse(mods);
+	if (nr_mods < 0)
+		return nr_mods;
+
+	b = swdsp_bench_alloc();
+	if (!b)
+		return -ENOMEM;
+
+	ret = swdsp_bench_check(b);
+	if (ret < 0)
+		goto out;
+
+	for (i = 0; i < ARRAY_SIZE(swdsp_bench_channels); i++) {
+		unsigned int channels = swdsp_bench_channels[i];
+
+		for (k = 0; k < nr_mods; k++) {
+			ret = swdsp_bench_setup(b, channels);
+			if (ret < 0)
+				goto out;
+			swdsp_bench_report(swdsp_bench_names[mods[k]], channels,
+					   swdsp_bench_time(b, &mods[k], 1));
+		}
+
+		if (nr_mods < 2)
+			continue;
+
+		ret = swdsp_bench_setup(b, channels);
+		if (ret < 0)
+			goto out;
+		swdsp_bench_report(modules, channels,
+				   swdsp_bench_time(b, mods, nr_mods));
+	}
+
+out:
+	swdsp_bench_free(b);
+	return ret;
+}
+
+static void __exit tegra210_swdsp_bench_exit(void)
+{
+}
+
+module_init(tegra210_swdsp_bench_init);
+module_exit(tegra210_swdsp_bench_exit);
+
+MODULE_DESCRIPTION("Tegra210 AHUB software DSP benchmark");
+MODULE_LICENSE("GPL v2");